@@ -0,0 +1,50 @@
+/**************************************************************//**
+*
+* \file test.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Minimal test harness. Each suite builds its fixtures in memory
+*   or in temporary files, and counts its checks and failures.
+*
+*******************************************************************/
+
+#ifndef TEST_H_
+#define TEST_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <math.h>
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Check a condition, reporting the file and line if it is false
+#define TEST_CHECK(condition) test_check((condition), #condition, __FILE__, __LINE__)
+// Check that two numbers agree within a tolerance
+#define TEST_NEAR(actual, expected, tolerance) \
+    test_check(fabs((double)(actual) - (double)(expected)) <= (tolerance), #actual " == " #expected, __FILE__, __LINE__)
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool test_check(bool condition, const char* text, const char* file, int line);
+void test_skip(const char* reason);
+bool test_temp_path(const char* name, char* path, size_t size);
+bool test_read_file(const char* path, uint8_t** data, size_t* size);
+
+// Suites
+void test_lens(void);
+void test_scrub(void);
+void test_stream(void);
+void test_sample(void);
+
+#endif /* end test.h */
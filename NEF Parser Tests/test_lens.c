@@ -0,0 +1,219 @@
+/**************************************************************//**
+*
+* \file test_lens.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Tests of the Nikon LensData decoders. Each fixture is a LensData
+*   entry of one layout, encrypted with the key stream of a known
+*   serial number and shutter count where the layout is encrypted.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lens.h"
+#include "test.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define TEST_SERIAL_NUMBER  "3013812"
+#define TEST_SHUTTER_COUNT  12532
+#define TEST_LENS_TYPE      0x4E
+#define TEST_LENS_NAME      "AF-S Nikkor 24-70mm f/2.8E ED VR"
+#define TEST_LENS_MODEL     "NIKKOR Z 50mm f/1.8 S"
+#define TEST_Z_LENS_ID      1
+#define TEST_Z_LENS_NAME    "Nikkor Z 24-70mm f/4 S"
+#define TEST_DATA_SIZE      0x400
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// LensIDNumber to MCUVersion of the AF-S Nikkor 24-70mm f/2.8E ED VR
+static const uint8_t test_lens_id[LENS_ID_LENGTH] = { 0xAA, 0x48, 0x37, 0x5C, 0x24, 0x24, 0xC5 };
+
+// Layouts holding the F-mount lens fields
+static const struct
+{
+    const char* version;
+    uint32_t size;
+    uint32_t id_offset;
+    bool encrypted;
+} test_id_layouts[] = {
+    { "0100", 0x0D, 0x06, false },
+    { "0101", 0x12, 0x0B, false },
+    { "0201", 0x12, 0x0B, true  },
+    { "0204", 0x13, 0x0C, true  },
+    { "0800", 0x32, 0x0C, true  },  // F-mount lens on the FTZ adapter
+};
+
+// Layouts holding the lens model string
+static const struct
+{
+    const char* version;
+    uint32_t model_offset;
+} test_model_layouts[] = {
+    { "0400", 0x18A },
+    { "0401", 0x18A },
+    { "0402", 0x18B },
+    { "0403", 0x2AC },
+};
+
+static uint8_t test_data[TEST_DATA_SIZE];
+static nef_record_t test_record;
+
+/******************************************************************
+*
+* \details Clear the fixture and write its version string.
+*
+*******************************************************************/
+static void lens_fixture(const char* version)
+{
+    memset(test_data, 0, sizeof(test_data));
+    memcpy(test_data, version, LENS_DATA_VERSION_LENGTH);
+}
+
+/******************************************************************
+*
+* \details
+*   Decode the fixture into test_record. The key stream is applied
+*   with XOR, so decrypting the plain text fixture encrypts it.
+*
+* \param[in] size       : Size of the fixture (in bytes).
+* \param[in] encrypted  : The layout is encrypted.
+* \param[in] big_endian : Byte order of the Makernote.
+*
+* \return None
+*
+*******************************************************************/
+static void lens_fixture_decode(uint32_t size, bool encrypted, bool big_endian)
+{
+    parse_context_t context;
+
+    memset(&context, 0, sizeof(context));
+    memset(&test_record, 0, sizeof(test_record));
+    strcpy_s(test_record.camera.serial_number, sizeof(test_record.camera.serial_number), TEST_SERIAL_NUMBER);
+    test_record.image.shutter_count = TEST_SHUTTER_COUNT;
+    context.big_endian = big_endian;
+    context.record = &test_record;
+
+    if (encrypted)
+    {
+        lens_decrypt(&test_data[LENS_DATA_VERSION_LENGTH], size - LENS_DATA_VERSION_LENGTH, test_record.camera.serial_number, TEST_SHUTTER_COUNT);
+    }
+
+    lens_decode(&context, test_data, size, TEST_LENS_TYPE, &test_record);
+}
+
+/******************************************************************
+*
+* \details F-mount lens fields and the Lens ID composite tag.
+*
+*******************************************************************/
+static void test_lens_fields(void)
+{
+    for (unsigned i = 0; i < sizeof(test_id_layouts) / sizeof(test_id_layouts[0]); ++i)
+    {
+        const lens_info_t* info = &test_record.camera.lens_info;
+
+        lens_fixture(test_id_layouts[i].version);
+        memcpy(&test_data[test_id_layouts[i].id_offset], test_lens_id, sizeof(test_lens_id));
+        lens_fixture_decode(test_id_layouts[i].size, test_id_layouts[i].encrypted, false);
+
+        TEST_CHECK(info->data_version == (uint16_t)atoi(test_id_layouts[i].version));
+        TEST_CHECK(strcmp(test_record.camera.lens, TEST_LENS_NAME) == 0);
+        TEST_CHECK(info->id_number == 0xAA);
+        TEST_CHECK(info->mcu_version == 0xC5);
+        TEST_CHECK(info->z_lens_id == 0);
+        TEST_NEAR(info->f_stops, 6.0, 0.001);
+        TEST_NEAR(info->min_focal_length, 24.49, 0.01);
+        TEST_NEAR(info->max_focal_length, 71.27, 0.01);
+        TEST_NEAR(info->max_aperture_min_focal, 2.83, 0.01);
+        TEST_NEAR(info->max_aperture_max_focal, 2.83, 0.01);
+    }
+}
+
+/******************************************************************
+*
+* \details Lens model strings, which are not NULL terminated.
+*
+*******************************************************************/
+static void test_lens_model(void)
+{
+    for (unsigned i = 0; i < sizeof(test_model_layouts) / sizeof(test_model_layouts[0]); ++i)
+    {
+        uint32_t offset = test_model_layouts[i].model_offset;
+
+        lens_fixture(test_model_layouts[i].version);
+        memset(&test_data[offset], ' ', LENS_MODEL_LENGTH);
+        memcpy(&test_data[offset], TEST_LENS_MODEL, strlen(TEST_LENS_MODEL));
+        // Not part of the model string
+        test_data[offset + LENS_MODEL_LENGTH] = 'X';
+        lens_fixture_decode(offset + LENS_MODEL_LENGTH + 1, true, false);
+
+        TEST_CHECK(strcmp(test_record.camera.lens, TEST_LENS_MODEL) == 0);
+    }
+}
+
+/******************************************************************
+*
+* \details Z-mount lens IDs in both Makernote byte orders.
+*
+*******************************************************************/
+static void test_lens_z_mount(void)
+{
+    for (unsigned big_endian = 0; big_endian < 2; ++big_endian)
+    {
+        lens_fixture("0800");
+        test_data[0x30] = big_endian ? 0 : TEST_Z_LENS_ID;
+        test_data[0x31] = big_endian ? TEST_Z_LENS_ID : 0;
+        lens_fixture_decode(0x32, true, big_endian == 1);
+
+        TEST_CHECK(test_record.camera.lens_info.z_lens_id == TEST_Z_LENS_ID);
+        TEST_CHECK(strcmp(test_record.camera.lens, TEST_Z_LENS_NAME) == 0);
+    }
+}
+
+/******************************************************************
+*
+* \details Unknown layouts and entries too short for their layout
+*   leave the lens unset.
+*
+*******************************************************************/
+static void test_lens_unsupported(void)
+{
+    lens_fixture("0300");
+    memcpy(&test_data[0x0C], test_lens_id, sizeof(test_lens_id));
+    lens_fixture_decode(0x13, false, false);
+
+    TEST_CHECK(test_record.camera.lens_info.data_version == 300);
+    TEST_CHECK(test_record.camera.lens[0] == '\0');
+
+    lens_fixture("0204");
+    memcpy(&test_data[0x0C], test_lens_id, sizeof(test_lens_id));
+    lens_fixture_decode(0x12, true, false);
+
+    TEST_CHECK(test_record.camera.lens[0] == '\0');
+    TEST_CHECK(test_record.camera.lens_info.id_number == 0);
+}
+
+/******************************************************************
+*
+* \details LensData decoder suite.
+*
+*******************************************************************/
+void test_lens(void)
+{
+    test_lens_fields();
+    test_lens_model();
+    test_lens_z_mount();
+    test_lens_unsupported();
+}
@@ -0,0 +1,176 @@
+/**************************************************************//**
+*
+* \file test_main.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Run the test suites and display a summary per suite. The exit
+*   code is 1 if any check failed.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define TEST_NAME_WIDTH     14
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const struct
+{
+    const char* name;
+    void (*run)(void);
+} test_suites[] = {
+    { "Lens Data",  test_lens   },
+    { "Scrub",      test_scrub  },
+    { "Stream",     test_stream },
+    { "Sample",     test_sample },
+};
+
+static unsigned test_checks;
+static unsigned test_failures;
+static const char* test_skipped;
+
+/******************************************************************
+*
+* \details Count a check and report it if it failed.
+*
+* \param[in] condition : Result of the check.
+* \param[in] text      : Check as written.
+* \param[in] file      : Source file of the check.
+* \param[in] line      : Source line of the check.
+*
+* \return
+*   Return the condition.
+*
+*******************************************************************/
+bool test_check(bool condition, const char* text, const char* file, int line)
+{
+    test_checks++;
+
+    if (!condition)
+    {
+        test_failures++;
+        fprintf(stderr, "%s(%d): Check failed: %s\n", file, line, text);
+    }
+
+    return condition;
+}
+
+/******************************************************************
+*
+* \details Note tests of the current suite that were skipped, e.g.
+*   because a run time library is not installed.
+*
+*******************************************************************/
+void test_skip(const char* reason)
+{
+    test_skipped = reason;
+}
+
+/******************************************************************
+*
+* \details Path of a fixture file in the temporary directory.
+*
+* \param[in] name  : File name.
+* \param[out] path : Path of the file.
+* \param[in] size  : Size of path (in bytes).
+*
+* \return
+*   Return true if the path fits.
+*
+*******************************************************************/
+bool test_temp_path(const char* name, char* path, size_t size)
+{
+    DWORD length = GetTempPathA((DWORD)size, path);
+
+    return (length > 0) && (length < size) && (strcat_s(path, size, name) == 0);
+}
+
+/******************************************************************
+*
+* \details Read a whole file.
+*
+* \param[in] path  : File.
+* \param[out] data : Contents. Released by the caller with free.
+* \param[out] size : Size of the contents (in bytes).
+*
+* \return
+*   Return true if the file was read.
+*
+*******************************************************************/
+bool test_read_file(const char* path, uint8_t** data, size_t* size)
+{
+    bool success = false;
+    FILE* file = NULL;
+
+    *data = NULL;
+    *size = 0;
+
+    if ((fopen_s(&file, path, "rb") == 0) && (NULL != file))
+    {
+        if ((fseek(file, 0, SEEK_END) == 0) && (ftell(file) >= 0))
+        {
+            *size = (size_t)ftell(file);
+            *data = malloc(*size + 1);
+            rewind(file);
+            success = (NULL != *data) && (fread_s(*data, *size + 1, 1, *size, file) == *size);
+        }
+
+        fclose(file);
+    }
+
+    if (!success)
+    {
+        free(*data);
+        *data = NULL;
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Test entry point.
+*
+*******************************************************************/
+int main(int argc, char** argv)
+{
+    unsigned failed = 0;
+
+    for (unsigned i = 0; i < sizeof(test_suites) / sizeof(test_suites[0]); ++i)
+    {
+        unsigned checks = test_checks;
+        unsigned failures = test_failures;
+
+        test_skipped = NULL;
+        test_suites[i].run();
+
+        printf("%-*s| %u checks, %u failed", TEST_NAME_WIDTH, test_suites[i].name, test_checks - checks, test_failures - failures);
+
+        if (NULL != test_skipped)
+        {
+            printf(", skipped %s", test_skipped);
+        }
+
+        printf("\n");
+
+        failed += (test_failures != failures) ? 1 : 0;
+    }
+
+    printf("%-*s| %u of %u suites failed\n", TEST_NAME_WIDTH, "Total", failed, (unsigned)(sizeof(test_suites) / sizeof(test_suites[0])));
+
+    return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+/**************************************************************//**
+*
+* \file test_sample.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Tests of the sample estimator against estimates worked by hand
+*   from the formulas in sample.c, and of the proportional
+*   allocation of a stratified sample.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sample.h"
+#include "test.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define TEST_RECORD_COUNT   8
+#define TEST_TOLERANCE      1e-9
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static nef_record_t test_records[TEST_RECORD_COUNT];
+
+/******************************************************************
+*
+* \details Fill the records of a sample with ISO values. A value of
+*   0 leaves the field absent, and no file has a rating.
+*
+*******************************************************************/
+static void sample_fixture(const uint32_t* iso, unsigned count)
+{
+    memset(test_records, 0, sizeof(test_records));
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        test_records[i].valid = true;
+        test_records[i].image.iso = iso[i];
+        test_records[i].xmp.rating = XMP_RATING_NONE;
+    }
+}
+
+/******************************************************************
+*
+* \details Estimate a quantity given as on the command line.
+*
+*******************************************************************/
+static bool sample_run(const sampler_t* sampler, const char* text, sample_result_t* result)
+{
+    sample_estimate_t estimate;
+
+    memset(result, 0, sizeof(sample_result_t));
+
+    return TEST_CHECK(sample_parse_estimate(text, &estimate)) &&
+           TEST_CHECK(sample_estimate(sampler, &estimate, test_records, result));
+}
+
+/******************************************************************
+*
+* \details
+*   Two strata, the first with 4 of 10 files sampled and the second
+*   with 3 of 30:
+*
+*       iso = 0.25 * 250 + 0.75 * 900 = 737.5
+*       var = 0.25^2 * 0.6 * 16666.67 / 4 + 0.75^2 * 0.9 * 30000 / 3
+*           = 5218.75
+*
+*******************************************************************/
+static void test_sample_stratified(void)
+{
+    static const uint32_t iso[] = { 100, 200, 300, 400, 800, 800, 1100 };
+    sample_stratum_t strata[2] = { { 0, 10, 4 }, { 4, 30, 3 } };
+    sampler_t sampler;
+    sample_result_t result;
+
+    memset(&sampler, 0, sizeof(sampler));
+    sampler.strata_list = strata;
+    sampler.stratum_count = 2;
+    sampler.population = 40;
+    sampler.sampled = 7;
+    sample_fixture(iso, 7);
+
+    if (sample_run(&sampler, "iso", &result))
+    {
+        TEST_CHECK(result.count == 7);
+        TEST_CHECK(result.population == 40);
+        TEST_NEAR(result.value, 737.5, TEST_TOLERANCE);
+        TEST_NEAR(result.margin, SAMPLE_Z_95 * sqrt(5218.75), TEST_TOLERANCE);
+    }
+
+    // Proportions of 1 in 4 and 3 in 3, so only the first stratum varies
+    if (sample_run(&sampler, "iso>300", &result))
+    {
+        TEST_NEAR(result.value, 0.25 * 0.25 + 0.75 * 1.0, TEST_TOLERANCE);
+        TEST_NEAR(result.margin, SAMPLE_Z_95 * sqrt(0.0625 * 0.6 * 0.25 / 4), TEST_TOLERANCE);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   A stratum with a single sampled value uses the variance of the
+*   whole sample (25000 for 100 to 500):
+*
+*       var = 0.5^2 * 0.6 * 16666.67 / 4 + 0.5^2 * 0.9 * 25000 / 1
+*           = 6250
+*
+*******************************************************************/
+static void test_sample_pooled(void)
+{
+    static const uint32_t iso[] = { 100, 200, 300, 400, 500 };
+    sample_stratum_t strata[2] = { { 0, 10, 4 }, { 4, 10, 1 } };
+    sampler_t sampler;
+    sample_result_t result;
+
+    memset(&sampler, 0, sizeof(sampler));
+    sampler.strata_list = strata;
+    sampler.stratum_count = 2;
+    sampler.population = 20;
+    sampler.sampled = 5;
+    sample_fixture(iso, 5);
+
+    if (sample_run(&sampler, "iso", &result))
+    {
+        TEST_NEAR(result.value, 375.0, TEST_TOLERANCE);
+        TEST_NEAR(result.margin, SAMPLE_Z_95 * sqrt(6250.0), TEST_TOLERANCE);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   A stratum without a sampled value is left out, so the estimate
+*   covers only the 10 files of the first stratum.
+*
+*******************************************************************/
+static void test_sample_uncovered(void)
+{
+    static const uint32_t iso[] = { 100, 300, 0, 0 };
+    sample_stratum_t strata[2] = { { 0, 10, 2 }, { 2, 30, 2 } };
+    sampler_t sampler;
+    sample_result_t result;
+
+    memset(&sampler, 0, sizeof(sampler));
+    sampler.strata_list = strata;
+    sampler.stratum_count = 2;
+    sampler.population = 40;
+    sampler.sampled = 4;
+    sample_fixture(iso, 4);
+
+    if (sample_run(&sampler, "iso", &result))
+    {
+        TEST_CHECK(result.count == 2);
+        TEST_CHECK(result.population == 10);
+        TEST_NEAR(result.value, 200.0, TEST_TOLERANCE);
+    }
+
+    // Proportions count every parsed file, so both strata are covered
+    if (sample_run(&sampler, "iso>200", &result))
+    {
+        TEST_CHECK(result.population == 40);
+        TEST_NEAR(result.value, 0.25 * 0.5, TEST_TOLERANCE);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Every file of a census is sampled, so estimates are exact.
+*   Means only count files with a value, proportions count every
+*   parsed file, and files that failed to parse are left out.
+*
+*******************************************************************/
+static void test_sample_census(void)
+{
+    static const uint32_t iso[] = { 100, 0, 300, 500 };
+    sample_stratum_t strata[1] = { { 0, 4, 4 } };
+    sampler_t sampler;
+    sample_result_t result;
+
+    memset(&sampler, 0, sizeof(sampler));
+    sampler.strata_list = strata;
+    sampler.stratum_count = 1;
+    sampler.population = 4;
+    sampler.sampled = 4;
+    sample_fixture(iso, 4);
+    test_records[3].valid = false;
+    strcpy_s(test_records[0].camera.model, sizeof(test_records[0].camera.model), "NIKON D850");
+
+    if (sample_run(&sampler, "iso", &result))
+    {
+        TEST_CHECK(result.count == 2);
+        TEST_NEAR(result.value, 200.0, TEST_TOLERANCE);
+        TEST_NEAR(result.margin, 0.0, TEST_TOLERANCE);
+    }
+
+    if (sample_run(&sampler, "iso<1000", &result))
+    {
+        TEST_CHECK(result.count == 3);
+        TEST_NEAR(result.value, 2.0 / 3.0, TEST_TOLERANCE);
+    }
+
+    if (sample_run(&sampler, "model=NIKON D850", &result))
+    {
+        TEST_NEAR(result.value, 1.0 / 3.0, TEST_TOLERANCE);
+    }
+
+    if (sample_run(&sampler, "rating", &result))
+    {
+        TEST_CHECK(result.count == 0);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   A sample of 4 from directories of 6 and 2 files takes 3 and 1,
+*   and lists the sampled files first.
+*
+*******************************************************************/
+static void test_sample_allocation(void)
+{
+    char* files[] = { "a\\1.nef", "b\\1.nef", "a\\2.nef", "a\\3.nef", "a\\4.nef", "b\\2.nef", "a\\5.nef", "a\\6.nef" };
+    unsigned count = sizeof(files) / sizeof(files[0]);
+    sampler_t sampler;
+    unsigned selected = 0;
+
+    memset(&sampler, 0, sizeof(sampler));
+    sampler.size = 4;
+    sampler.strata = SAMPLE_STRATA_DIRECTORY;
+    sampler.seed = 1;
+
+    if (TEST_CHECK(sample_select(&sampler, files, count, &selected)))
+    {
+        TEST_CHECK(selected == 4);
+        TEST_CHECK(sampler.population == count);
+        TEST_CHECK(sampler.stratum_count == 2);
+        TEST_CHECK((sampler.strata_list[0].population == 6) && (sampler.strata_list[0].sampled == 3));
+        TEST_CHECK((sampler.strata_list[1].population == 2) && (sampler.strata_list[1].sampled == 1));
+
+        for (unsigned i = 0; i < selected; ++i)
+        {
+            TEST_CHECK(files[i][0] == ((i < 3) ? 'a' : 'b'));
+        }
+    }
+
+    sample_free(&sampler);
+}
+
+/******************************************************************
+*
+* \details Sample suite.
+*
+*******************************************************************/
+void test_sample(void)
+{
+    test_sample_stratified();
+    test_sample_pooled();
+    test_sample_uncovered();
+    test_sample_census();
+    test_sample_allocation();
+}
@@ -0,0 +1,203 @@
+/**************************************************************//**
+*
+* \file test_scrub.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Tests of the scrub catalog across runs: resuming an interrupted
+*   pass, starting the next pass once every file was checked, and
+*   checking off files that cannot be fingerprinted. Each run opens
+*   and closes the catalog as a scrub of the batch would.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "scrub.h"
+#include "test.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define TEST_CATALOG        "nef_parser_test.catalog"
+#define TEST_FILE_COUNT     3
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const char* test_files[TEST_FILE_COUNT] = { "a.nef", "b.nef", "c.nef" };
+static const uint8_t test_contents[] = "NEF Parser scrub fixture";
+static nef_record_t test_record;
+
+/******************************************************************
+*
+* \details Check a file as the parser would after reading it.
+*
+* \param[in,out] scrubber : Scrubber.
+* \param[in] path         : File.
+* \param[in] data         : Contents, or NULL if the file could not
+*                           be read.
+* \param[in] size         : Size of the contents (in bytes).
+*
+* \return None
+*
+*******************************************************************/
+static void scrub_file(scrubber_t* scrubber, const char* path, const uint8_t* data, uint32_t size)
+{
+    scrub_fingerprint_t fingerprint;
+
+    memset(&test_record, 0, sizeof(test_record));
+    memset(&fingerprint, 0, sizeof(fingerprint));
+    test_record.valid = (NULL != data);
+
+    if (NULL != data)
+    {
+        scrub_read(scrubber, data, size, &fingerprint);
+    }
+
+    scrub_verify(scrubber, path, &test_record, data, size, &fingerprint);
+}
+
+/******************************************************************
+*
+* \details Open the catalog and list the files of a run.
+*
+* \param[out] scrubber : Scrubber.
+* \param[in] catalog   : Catalog file.
+* \param[in] range     : Bytes fingerprinted.
+* \param[out] files    : Files of the run, pending files first.
+* \param[in] count     : Number of files.
+*
+* \return
+*   Return the number of pending files, or UINT_MAX if the catalog
+*   could not be opened.
+*
+*******************************************************************/
+static unsigned scrub_run(scrubber_t* scrubber, const char* catalog, scrub_range_t range, const char** files, unsigned count)
+{
+    unsigned pending = UINT_MAX;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        files[i] = test_files[i];
+    }
+
+    if (!scrub_open(scrubber, catalog, range) || !scrub_pending(scrubber, (char**)files, count, &pending))
+    {
+        pending = UINT_MAX;
+    }
+
+    return pending;
+}
+
+/******************************************************************
+*
+* \details
+*   An interrupted pass resumes with the files it did not check,
+*   and the next run starts a new pass with every file.
+*
+*******************************************************************/
+static void test_scrub_resume(const char* catalog)
+{
+    scrubber_t scrubber;
+    const char* files[TEST_FILE_COUNT];
+
+    // First run, interrupted after two files. b.nef cannot be read.
+    TEST_CHECK(scrub_run(&scrubber, catalog, SCRUB_RANGE_FILE, files, TEST_FILE_COUNT) == TEST_FILE_COUNT);
+    TEST_CHECK(scrubber.pass == 1);
+    scrub_file(&scrubber, "a.nef", test_contents, sizeof(test_contents));
+    scrub_file(&scrubber, "b.nef", NULL, 0);
+    TEST_CHECK(scrubber.enrolled == 1);
+    TEST_CHECK(scrubber.unreadable == 1);
+    TEST_CHECK(scrub_close(&scrubber));
+
+    // Second run resumes with c.nef only
+    TEST_CHECK(scrub_run(&scrubber, catalog, SCRUB_RANGE_FILE, files, TEST_FILE_COUNT) == 1);
+    TEST_CHECK(scrubber.pass == 1);
+    TEST_CHECK(scrubber.skipped == 2);
+    TEST_CHECK(strcmp(files[0], "c.nef") == 0);
+    scrub_file(&scrubber, "c.nef", test_contents, sizeof(test_contents));
+    TEST_CHECK(scrub_close(&scrubber));
+
+    // Third run starts the next pass with every file
+    TEST_CHECK(scrub_run(&scrubber, catalog, SCRUB_RANGE_FILE, files, TEST_FILE_COUNT) == TEST_FILE_COUNT);
+    TEST_CHECK(scrubber.pass == 2);
+    TEST_CHECK(scrubber.skipped == 0);
+    TEST_CHECK(strcmp(files[0], "a.nef") == 0);
+
+    // a.nef matches its fingerprint, b.nef is enrolled now that it can be read
+    // and c.nef has changed
+    scrub_file(&scrubber, "a.nef", test_contents, sizeof(test_contents));
+    scrub_file(&scrubber, "b.nef", test_contents, sizeof(test_contents));
+    scrub_file(&scrubber, "c.nef", test_contents, sizeof(test_contents) - 1);
+    TEST_CHECK(scrubber.verified == 1);
+    TEST_CHECK(scrubber.enrolled == 1);
+    TEST_CHECK(scrubber.mismatched == 1);
+    TEST_CHECK(test_record.errors.counts[NEF_ERROR_FINGERPRINT] == 1);
+    TEST_CHECK(scrub_close(&scrubber));
+}
+
+/******************************************************************
+*
+* \details
+*   Files whose raw image data is not located are never
+*   fingerprinted, and still end the pass.
+*
+*******************************************************************/
+static void test_scrub_unreadable(const char* catalog)
+{
+    scrubber_t scrubber;
+    const char* files[TEST_FILE_COUNT];
+
+    for (uint32_t pass = 1; pass <= 3; ++pass)
+    {
+        TEST_CHECK(scrub_run(&scrubber, catalog, SCRUB_RANGE_RAW, files, 1) == 1);
+        TEST_CHECK(scrubber.pass == pass);
+        // The record of the fixture holds no raw image data
+        scrub_file(&scrubber, "a.nef", test_contents, sizeof(test_contents));
+        TEST_CHECK(scrubber.unreadable == 1);
+        TEST_CHECK(scrubber.enrolled == 0);
+        TEST_CHECK(test_record.errors.counts[NEF_ERROR_RAW_RANGE] == 1);
+        TEST_CHECK(scrub_close(&scrubber));
+    }
+}
+
+/******************************************************************
+*
+* \details Fingerprints of another range are not compared. The
+*   catalog is refused with an error message.
+*
+*******************************************************************/
+static void test_scrub_range(const char* catalog)
+{
+    scrubber_t scrubber;
+
+    TEST_CHECK(!scrub_open(&scrubber, catalog, SCRUB_RANGE_FILE));
+}
+
+/******************************************************************
+*
+* \details Scrub suite. Each test starts from a new catalog.
+*
+*******************************************************************/
+void test_scrub(void)
+{
+    char catalog[MAX_PATH];
+
+    if (TEST_CHECK(test_temp_path(TEST_CATALOG, catalog, sizeof(catalog))))
+    {
+        DeleteFileA(catalog);
+        test_scrub_resume(catalog);
+        DeleteFileA(catalog);
+        test_scrub_unreadable(catalog);
+        test_scrub_range(catalog);
+        DeleteFileA(catalog);
+    }
+}
@@ -0,0 +1,234 @@
+/**************************************************************//**
+*
+* \file test_stream.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Tests of the output stream. Compressed output is checked against
+*   its seek table: the frames add up to the table's offset, each
+*   frame decompresses to the size the table records, and frames hold
+*   whole writes. Compression needs libzstd.dll, and the compressed
+*   tests are skipped without it.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "test.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define TEST_OUTPUT             "nef_parser_test.out"
+#define TEST_WRITE_SIZE         1000    // Does not divide the block size
+#define TEST_WRITE_COUNT        2600    // Three blocks, the last one partly filled
+#define TEST_SKIPPABLE_MAGIC    0x184D2A5E
+#define TEST_SEEKABLE_MAGIC     0x8F92EAB1
+#define TEST_FOOTER_SIZE        9
+#define TEST_LEVEL              3
+#define TEST_THREADS            4
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// zstd functions used to read the frames back
+typedef struct
+{
+    size_t (*decompress)(void* destination, size_t capacity, const void* source, size_t size);
+    unsigned (*isError)(size_t code);
+} test_zstd_t;
+
+/******************************************************************
+*
+* \details Contents of a write, distinct for each write.
+*
+*******************************************************************/
+static void stream_fixture(unsigned index, uint8_t* data)
+{
+    for (unsigned i = 0; i < TEST_WRITE_SIZE; ++i)
+    {
+        data[i] = (uint8_t)(index * 7 + i / 10);
+    }
+}
+
+/******************************************************************
+*
+* \details Write the fixture writes to a stream.
+*
+* \return
+*   Return true if the stream was written and closed.
+*
+*******************************************************************/
+static bool stream_fill(const char* path, int level)
+{
+    bool success = false;
+    stream_t stream;
+    uint8_t data[TEST_WRITE_SIZE];
+
+    if (stream_open(&stream, path, level, TEST_THREADS))
+    {
+        success = true;
+
+        for (unsigned i = 0; success && (i < TEST_WRITE_COUNT); ++i)
+        {
+            stream_fixture(i, data);
+            success = stream_write(&stream, data, sizeof(data));
+        }
+
+        success = stream_close(&stream) && success;
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Check that data holds the fixture writes from first on.
+*
+*******************************************************************/
+static bool stream_matches(const uint8_t* data, size_t size, unsigned first)
+{
+    bool match = (size % TEST_WRITE_SIZE == 0);
+    uint8_t expected[TEST_WRITE_SIZE];
+
+    for (size_t offset = 0; match && (offset < size); offset += TEST_WRITE_SIZE)
+    {
+        stream_fixture(first++, expected);
+        match = (memcmp(&data[offset], expected, TEST_WRITE_SIZE) == 0);
+    }
+
+    return match;
+}
+
+/******************************************************************
+*
+* \details Uncompressed output is the data as written.
+*
+*******************************************************************/
+static void test_stream_plain(const char* path)
+{
+    uint8_t* data = NULL;
+    size_t size = 0;
+
+    TEST_CHECK(stream_fill(path, 0));
+
+    if (TEST_CHECK(test_read_file(path, &data, &size)))
+    {
+        TEST_CHECK(size == (size_t)TEST_WRITE_SIZE * TEST_WRITE_COUNT);
+        TEST_CHECK(stream_matches(data, size, 0));
+        free(data);
+    }
+}
+
+/******************************************************************
+*
+* \details Compressed output and its seek table.
+*
+*******************************************************************/
+static void test_stream_seek_table(const char* path, const test_zstd_t* zstd)
+{
+    uint8_t* data = NULL;
+    size_t size = 0;
+
+    TEST_CHECK(stream_fill(path, TEST_LEVEL));
+
+    if (TEST_CHECK(test_read_file(path, &data, &size)) && TEST_CHECK(size > 8 + TEST_FOOTER_SIZE))
+    {
+        uint32_t frame_count = 0;
+        uint32_t magic = 0;
+        uint32_t header[2] = { 0 };
+        size_t table = 0;
+
+        memcpy(&frame_count, &data[size - TEST_FOOTER_SIZE], sizeof(uint32_t));
+        memcpy(&magic, &data[size - sizeof(uint32_t)], sizeof(uint32_t));
+        TEST_CHECK(magic == TEST_SEEKABLE_MAGIC);
+        // No checksums
+        TEST_CHECK(data[size - TEST_FOOTER_SIZE + sizeof(uint32_t)] == 0);
+        TEST_CHECK(frame_count == 3);
+
+        if (TEST_CHECK(size >= 8 + (size_t)frame_count * 8 + TEST_FOOTER_SIZE))
+        {
+            table = size - (8 + (size_t)frame_count * 8 + TEST_FOOTER_SIZE);
+            memcpy(header, &data[table], sizeof(header));
+            TEST_CHECK(header[0] == TEST_SKIPPABLE_MAGIC);
+            TEST_CHECK(header[1] == frame_count * 8 + TEST_FOOTER_SIZE);
+        }
+
+        if (table > 0)
+        {
+            size_t block = (STREAM_BLOCK_SIZE / TEST_WRITE_SIZE) * TEST_WRITE_SIZE;
+            uint8_t* frame = malloc(STREAM_BLOCK_SIZE);
+            size_t offset = 0;
+            unsigned written = 0;
+
+            for (uint32_t i = 0; (i < frame_count) && (NULL != frame); ++i)
+            {
+                uint32_t sizes[2];
+
+                memcpy(sizes, &data[table + 8 + (size_t)i * 8], sizeof(sizes));
+
+                // Frames hold whole writes, so only the last block is partly filled
+                TEST_CHECK(sizes[1] == ((i + 1 < frame_count) ? block : (size_t)TEST_WRITE_SIZE * TEST_WRITE_COUNT - 2 * block));
+
+                if (TEST_CHECK(offset + sizes[0] <= table))
+                {
+                    size_t length = zstd->decompress(frame, STREAM_BLOCK_SIZE, &data[offset], sizes[0]);
+
+                    TEST_CHECK(!zstd->isError(length) && (length == sizes[1]));
+                    TEST_CHECK(!zstd->isError(length) && stream_matches(frame, length, written));
+                    written += sizes[1] / TEST_WRITE_SIZE;
+                    offset += sizes[0];
+                }
+            }
+
+            // The table follows the last frame
+            TEST_CHECK(offset == table);
+            TEST_CHECK(written == TEST_WRITE_COUNT);
+            free(frame);
+        }
+
+        free(data);
+    }
+}
+
+/******************************************************************
+*
+* \details Stream suite.
+*
+*******************************************************************/
+void test_stream(void)
+{
+    char path[MAX_PATH];
+    HMODULE library = LoadLibraryA(STREAM_LIBRARY);
+    test_zstd_t zstd = { 0 };
+
+    if (NULL != library)
+    {
+        zstd.decompress = (size_t (*)(void*, size_t, const void*, size_t))GetProcAddress(library, "ZSTD_decompress");
+        zstd.isError = (unsigned (*)(size_t))GetProcAddress(library, "ZSTD_isError");
+    }
+
+    if (TEST_CHECK(test_temp_path(TEST_OUTPUT, path, sizeof(path))))
+    {
+        test_stream_plain(path);
+
+        if ((NULL != zstd.decompress) && (NULL != zstd.isError))
+        {
+            test_stream_seek_table(path, &zstd);
+        }
+        else
+        {
+            test_skip("compression (" STREAM_LIBRARY " not found)");
+        }
+
+        DeleteFileA(path);
+    }
+}
@@ -0,0 +1,238 @@
+/**************************************************************//**
+*
+* \file alloc.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Heap allocation accounting. Per file allocations go through
+*   nef_malloc, which tags each block with its size and stage so
+*   nef_free can account for it. Totals are kept for the process,
+*   and a thread parsing a file also charges its allocations to
+*   the profile of that file.
+*
+*   The parse stages decode the metadata in place into the record,
+*   so the heap blocks of a parse are its read buffers (read stage).
+*   Sidecars and encoded records are charged to the output stage.
+*   Allocations made without nef_malloc, such as those of the C
+*   run time, zstd, SQLite or the NUMA node pools, are not counted.
+*   The working set is that of the whole process.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <psapi.h>
+#include "alloc.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Prefix of each block. Keeps the block aligned for any type.
+typedef union
+{
+    struct
+    {
+        size_t size;
+        perf_stage_t stage;
+    } info;
+    double align[2];
+} alloc_header_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static volatile LONG64 total_allocations[PERF_STAGE_COUNT];
+static volatile LONG64 total_bytes[PERF_STAGE_COUNT];
+static volatile LONG64 total_live_bytes = 0;
+static volatile LONG64 total_peak_bytes = 0;
+static DWORD alloc_index = TLS_OUT_OF_INDEXES; // Profile of the file the thread is parsing
+
+/******************************************************************
+*
+* \details Enable per file profiles. Process totals are always kept.
+*
+* \return
+*   Return true if per file profiles are enabled.
+*
+*******************************************************************/
+bool alloc_init(void)
+{
+    if (TLS_OUT_OF_INDEXES == alloc_index)
+    {
+        alloc_index = TlsAlloc();
+    }
+
+    return (TLS_OUT_OF_INDEXES != alloc_index);
+}
+
+/******************************************************************
+*
+* \details Allocate a block charged to a stage.
+*
+* \param[in] size  : Block size (in bytes).
+* \param[in] stage : Stage making the allocation.
+*
+* \return
+*   Return the block, or NULL if it could not be allocated.
+*
+*******************************************************************/
+void* nef_malloc(size_t size, perf_stage_t stage)
+{
+    alloc_header_t* header = malloc(sizeof(alloc_header_t) + size);
+    void* block = NULL;
+
+    if (NULL != header)
+    {
+        header->info.size = size;
+        header->info.stage = stage;
+        InterlockedIncrement64(&total_allocations[stage]);
+        InterlockedAdd64(&total_bytes[stage], (LONG64)size);
+        LONG64 live = InterlockedAdd64(&total_live_bytes, (LONG64)size);
+        LONG64 peak = total_peak_bytes;
+
+        while ((live > peak) && (InterlockedCompareExchange64(&total_peak_bytes, live, peak) != peak))
+        {
+            peak = total_peak_bytes;
+        }
+
+        alloc_profile_t* profile = (TLS_OUT_OF_INDEXES != alloc_index) ? (alloc_profile_t*)TlsGetValue(alloc_index) : NULL;
+
+        if (NULL != profile)
+        {
+            profile->stages[stage].allocations++;
+            profile->stages[stage].bytes += size;
+            profile->live_bytes += size;
+            profile->peak_bytes = max(profile->peak_bytes, profile->live_bytes);
+        }
+
+        block = header + 1;
+    }
+
+    return block;
+}
+
+/******************************************************************
+*
+* \details Free a block allocated by nef_malloc.
+*
+* \param[in] block : Block to free (may be NULL).
+*
+* \return None
+*
+*******************************************************************/
+void nef_free(void* block)
+{
+    if (NULL != block)
+    {
+        alloc_header_t* header = (alloc_header_t*)block - 1;
+        alloc_profile_t* profile = (TLS_OUT_OF_INDEXES != alloc_index) ? (alloc_profile_t*)TlsGetValue(alloc_index) : NULL;
+
+        InterlockedAdd64(&total_live_bytes, -(LONG64)header->info.size);
+
+        // Blocks may outlive the file that allocated them
+        if ((NULL != profile) && (profile->live_bytes >= header->info.size))
+        {
+            profile->live_bytes -= header->info.size;
+        }
+
+        free(header);
+    }
+}
+
+/******************************************************************
+*
+* \details Charge the allocations of the calling thread to a file
+*          until alloc_end.
+*
+* \param[out] profile : Profile of the file.
+*
+* \return None
+*
+*******************************************************************/
+void alloc_begin(alloc_profile_t* profile)
+{
+    if (TLS_OUT_OF_INDEXES != alloc_index)
+    {
+        memset(profile, 0, sizeof(alloc_profile_t));
+        TlsSetValue(alloc_index, profile);
+    }
+}
+
+/******************************************************************
+*
+* \details Stop charging the calling thread's allocations to a file
+*          and record the process working set.
+*
+* \param[in,out] profile : Profile of the file.
+*
+* \return None
+*
+*******************************************************************/
+void alloc_end(alloc_profile_t* profile)
+{
+    if (TLS_OUT_OF_INDEXES != alloc_index)
+    {
+        uint64_t peak = 0;
+
+        TlsSetValue(alloc_index, NULL);
+        alloc_working_set(&profile->working_set, &peak);
+    }
+}
+
+/******************************************************************
+*
+* \details Process allocation totals.
+*
+* \param[out] total : Totals by stage and live and peak heap bytes.
+*
+* \return None
+*
+*******************************************************************/
+void alloc_totals(alloc_profile_t* total)
+{
+    uint64_t peak = 0;
+
+    memset(total, 0, sizeof(alloc_profile_t));
+
+    for (unsigned i = 0; i < PERF_STAGE_COUNT; ++i)
+    {
+        total->stages[i].allocations = (uint64_t)total_allocations[i];
+        total->stages[i].bytes = (uint64_t)total_bytes[i];
+    }
+
+    total->live_bytes = (uint64_t)total_live_bytes;
+    total->peak_bytes = (uint64_t)total_peak_bytes;
+    alloc_working_set(&total->working_set, &peak);
+}
+
+/******************************************************************
+*
+* \details Current and peak working set (resident memory) of the process.
+*
+* \param[out] current : Current working set (in bytes).
+* \param[out] peak    : Peak working set (in bytes).
+*
+* \return
+*   Return true if the working set was read.
+*
+*******************************************************************/
+bool alloc_working_set(uint64_t* current, uint64_t* peak)
+{
+    bool success = false;
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        *current = (uint64_t)counters.WorkingSetSize;
+        *peak = (uint64_t)counters.PeakWorkingSetSize;
+        success = true;
+    }
+
+    return success;
+}
@@ -0,0 +1,53 @@
+/**************************************************************//**
+*
+* \file alloc.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Heap allocation accounting by parse stage.
+*
+*******************************************************************/
+
+#ifndef ALLOC_H_
+#define ALLOC_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "perf.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    uint64_t allocations;
+    uint64_t bytes;
+} alloc_counters_t;
+
+typedef struct
+{
+    alloc_counters_t stages[PERF_STAGE_COUNT];
+    uint64_t live_bytes;    // Heap bytes allocated and not yet freed
+    uint64_t peak_bytes;    // Peak of live_bytes
+    uint64_t working_set;   // Process working set, shared by all threads (when the profile was taken)
+} alloc_profile_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool alloc_init(void);
+void* nef_malloc(size_t size, perf_stage_t stage);
+void nef_free(void* block);
+void alloc_begin(alloc_profile_t* profile);
+void alloc_end(alloc_profile_t* profile);
+void alloc_totals(alloc_profile_t* total);
+bool alloc_working_set(uint64_t* current, uint64_t* peak);
+
+#endif /* end alloc.h */
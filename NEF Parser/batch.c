@@ -0,0 +1,704 @@
+/**************************************************************//**
+*
+* \file batch.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Parallel batch processing of image files. Worker threads claim
+*   files from a shared index, so each record is written by
+*   exactly one thread and results stay in input order.
+*
+*   On NUMA systems the files are split into a queue per node, in
+*   proportion to the workers of the node. Workers are pinned to
+*   the cores of their node and read files into node local buffers,
+*   so a file's buffer and its parser share a node. A worker whose
+*   queue is empty takes files from the other queues, still reading
+*   them into buffers on its own node.
+*
+*   Interactive requests have a lane of their own. Workers check it
+*   before claiming each file, so a request waits for at most one
+*   file per worker, and reserved workers serve only the lane so a
+*   request never waits behind the batch at all. Workers out of
+*   files serve the lane until it is closed. Each lane keeps its
+*   recent latencies.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define PATH_LIST_INITIAL_CAPACITY 256
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Growable list of file paths
+typedef struct
+{
+    char** paths;
+    unsigned count;
+    unsigned capacity;
+} path_list_t;
+
+// Files [next, end) of a node, claimed from the front
+typedef struct
+{
+    volatile LONG next;
+    LONG end;
+} batch_queue_t;
+
+typedef struct
+{
+    batch_t* batch;
+    batch_queue_t queues[NUMA_MAX_NODES];
+    uint32_t queue_count;   // One unless the workers are grouped by node
+    volatile LONG active;   // Workers still claiming files
+} batch_state_t;
+
+typedef struct
+{
+    batch_state_t* state;
+    uint32_t node;          // Queue and node of the worker
+    uint32_t core;          // Core within the node
+    bool reserved;          // Serves only the interactive lane
+} batch_worker_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const char* batch_lane_names[BATCH_LANE_COUNT] = {
+    "interactive",
+    "batch",
+};
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static DWORD WINAPI batch_worker(LPVOID parameter);
+static LONG batch_claim(batch_state_t* state, uint32_t node);
+static void batch_retire(batch_state_t* state);
+static bool batch_serve(batch_t* batch, bool wait);
+static LONG64 batch_now(void);
+static void batch_latency_record(batch_latency_t* latency, LONG64 ticks);
+static int compare_ticks(const void* a, const void* b);
+static bool path_list_add(path_list_t* list, const char* path);
+static bool expand_directory(path_list_t* list, const char* directory, const char** extensions, unsigned extension_count);
+
+/******************************************************************
+*
+* \details Worker thread processing files until the batch is exhausted.
+*
+* \param[in] parameter : Worker being started.
+*
+* \return Thread exit code.
+*
+*******************************************************************/
+static DWORD WINAPI batch_worker(LPVOID parameter)
+{
+    batch_worker_t* worker = (batch_worker_t*)parameter;
+    batch_state_t* state = worker->state;
+    batch_t* batch = state->batch;
+    batch_lanes_t* lanes = batch->lanes;
+    bool exhausted = worker->reserved;
+    nef_record_t scratch;   // Record of the current file when the batch keeps none
+    LONG index;
+
+    // Reserved workers are left unpinned, so a request is not held
+    // up by the batch worker sharing its core
+    if ((NULL != batch->numa) && !worker->reserved)
+    {
+        numa_bind_thread(batch->numa, worker->node, worker->core);
+    }
+
+    while (!exhausted)
+    {
+        // Interactive requests preempt the batch at file boundaries
+        if ((NULL != lanes) && (lanes->pending > 0) && batch_serve(batch, false))
+        {
+            continue;
+        }
+
+        if ((index = batch_claim(state, worker->node)) >= 0)
+        {
+            LONG64 claimed = batch_now();
+            nef_record_t* record = (NULL != batch->records) ? &batch->records[index] : &scratch;
+
+            batch->parse(batch->files[index], record);
+
+            if (NULL != batch->callback)
+            {
+                perf_counters_t start;
+
+                perf_start(&start);
+                batch->callback(record, batch->context);
+                perf_stop(&record->profile, PERF_STAGE_OUTPUT, &start);
+            }
+
+            if (NULL != lanes)
+            {
+                batch_latency_record(&lanes->latency[BATCH_LANE_BATCH], batch_now() - claimed);
+            }
+        }
+        else
+        {
+            exhausted = true;
+            batch_retire(state);
+        }
+    }
+
+    // Serve the interactive lane until it is closed and drained
+    while ((NULL != lanes) && batch_serve(batch, true))
+    {
+    }
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details
+*   Claim the next file for a worker. Files are taken from the
+*   queue of the worker's node first, then from the other queues.
+*
+* \param[in,out] state : Batch being processed.
+* \param[in] node      : Queue of the worker.
+*
+* \return
+*   Return the index of the file, or -1 if the batch is exhausted.
+*
+*******************************************************************/
+static LONG batch_claim(batch_state_t* state, uint32_t node)
+{
+    LONG index = -1;
+
+    for (uint32_t i = 0; (i < state->queue_count) && (index < 0); ++i)
+    {
+        batch_queue_t* queue = &state->queues[(node + i) % state->queue_count];
+
+        // Exhausted queues are skipped without touching their index
+        if (queue->next < queue->end)
+        {
+            LONG claimed = InterlockedIncrement(&queue->next) - 1;
+            index = (claimed < queue->end) ? claimed : -1;
+        }
+    }
+
+    return index;
+}
+
+/******************************************************************
+*
+* \details
+*   Count a worker out of files. The last one closes the
+*   interactive lane, unless it is held open.
+*
+*******************************************************************/
+static void batch_retire(batch_state_t* state)
+{
+    batch_lanes_t* lanes = state->batch->lanes;
+
+    if ((InterlockedDecrement(&state->active) == 0) && (NULL != lanes) && !lanes->hold)
+    {
+        batch_lanes_close(lanes);
+    }
+}
+
+/******************************************************************
+*
+* \details Parse the next interactive request.
+*
+* \param[in] batch : Batch being processed.
+* \param[in] wait  : Block until a request arrives or the lane is closed.
+*
+* \return
+*   Return true if a request was served.
+*
+*******************************************************************/
+static bool batch_serve(batch_t* batch, bool wait)
+{
+    batch_lanes_t* lanes = batch->lanes;
+    batch_request_t* request = NULL;
+    uint32_t popped = wait ? queue_pop_batch(&lanes->queue, (void**)&request, 1)
+                           : queue_try_pop_batch(&lanes->queue, (void**)&request, 1);
+
+    if (popped > 0)
+    {
+        InterlockedDecrement(&lanes->pending);
+        batch->parse(request->path, request->record);
+        batch_latency_record(&lanes->latency[BATCH_LANE_INTERACTIVE], batch_now() - request->submitted);
+        SetEvent(request->done);
+    }
+
+    return (popped > 0);
+}
+
+/******************************************************************
+*
+* \details Current performance counter ticks.
+*
+*******************************************************************/
+static LONG64 batch_now(void)
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+
+    return now.QuadPart;
+}
+
+/******************************************************************
+*
+* \details Record the latency of a request or file.
+*
+*******************************************************************/
+static void batch_latency_record(batch_latency_t* latency, LONG64 ticks)
+{
+    AcquireSRWLockExclusive(&latency->lock);
+
+    latency->samples[latency->count % BATCH_LATENCY_SAMPLES] = ticks;
+    latency->count++;
+
+    if (ticks > latency->max)
+    {
+        latency->max = ticks;
+    }
+
+    ReleaseSRWLockExclusive(&latency->lock);
+}
+
+/******************************************************************
+*
+* \details qsort comparison of latencies (in ticks).
+*
+*******************************************************************/
+static int compare_ticks(const void* a, const void* b)
+{
+    LONG64 x = *(const LONG64*)a;
+    LONG64 y = *(const LONG64*)b;
+
+    return (x > y) - (x < y);
+}
+
+/******************************************************************
+*
+* \details Process all files of a batch and wait for completion.
+*
+* \param[in] batch : Batch to be processed.
+* \param[out] None
+*
+* \return
+*   Return true if all worker threads were started.
+*
+*******************************************************************/
+bool batch_run(batch_t* batch)
+{
+    HANDLE threads[BATCH_MAX_THREADS];
+    batch_worker_t workers[BATCH_MAX_THREADS];
+    uint32_t node_workers[NUMA_MAX_NODES] = { 0 };
+    batch_state_t state;
+    unsigned started = 0;
+    unsigned started_workers = 0; // Started threads claiming files
+    unsigned count = batch->threads;
+    unsigned reserved = (NULL != batch->lanes) ? batch->reserved : 0;
+
+    if ((count == 0) || (count > BATCH_MAX_THREADS))
+    {
+        count = batch_default_threads();
+    }
+
+    // No point starting more threads than files
+    if (count > batch->count)
+    {
+        count = (batch->count > 0) ? batch->count : 1;
+    }
+
+    if (reserved > BATCH_MAX_THREADS - count)
+    {
+        reserved = BATCH_MAX_THREADS - count;
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.batch = batch;
+    state.queue_count = (NULL != batch->numa) ? batch->numa->count : 1;
+    state.active = (LONG)count;
+
+    // Workers are spread over the nodes in proportion to their processors
+    for (unsigned i = 0; i < count; ++i)
+    {
+        uint32_t node = 0;
+
+        if (NULL != batch->numa)
+        {
+            uint64_t position = (uint64_t)i * batch->numa->processors / count;
+            uint64_t first = 0;
+
+            while ((node + 1 < state.queue_count) && (position >= first + batch->numa->nodes[node].processors))
+            {
+                first += batch->numa->nodes[node++].processors;
+            }
+        }
+
+        workers[i].state = &state;
+        workers[i].node = node;
+        workers[i].core = node_workers[node]++;
+        workers[i].reserved = false;
+    }
+
+    for (unsigned i = count; i < count + reserved; ++i)
+    {
+        workers[i].state = &state;
+        workers[i].node = 0;
+        workers[i].core = 0;
+        workers[i].reserved = true;
+    }
+
+    // Files are split in proportion to the workers of each node
+    uint32_t assigned = 0;
+    LONG first = 0;
+
+    for (uint32_t node = 0; node < state.queue_count; ++node)
+    {
+        assigned += node_workers[node];
+        state.queues[node].next = first;
+        state.queues[node].end = (LONG)((uint64_t)batch->count * assigned / count);
+        first = state.queues[node].end;
+    }
+
+    for (unsigned i = 0; i < count + reserved; ++i)
+    {
+        threads[started] = CreateThread(NULL, 0, batch_worker, &workers[i], 0, NULL);
+
+        if (NULL != threads[started])
+        {
+            started_workers += workers[i].reserved ? 0 : 1;
+            started++;
+        }
+    }
+
+    if (started_workers == 0)
+    {
+        // Process the batch on the calling thread
+        state.active = 1;
+        batch_worker(&workers[0]);
+    }
+    else
+    {
+        // Files of workers that failed to start are claimed by the others
+        for (unsigned i = started_workers; i < count; ++i)
+        {
+            batch_retire(&state);
+        }
+    }
+
+    if (started > 0)
+    {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+
+        for (unsigned i = 0; i < started; ++i)
+        {
+            CloseHandle(threads[i]);
+        }
+    }
+
+    return (started == count + reserved);
+}
+
+/******************************************************************
+*
+* \details Default number of worker threads (one per processor).
+*
+*******************************************************************/
+unsigned batch_default_threads(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return (info.dwNumberOfProcessors > BATCH_MAX_THREADS) ? BATCH_MAX_THREADS : info.dwNumberOfProcessors;
+}
+
+/******************************************************************
+*
+* \details Append a copy of a path to a path list.
+*
+*******************************************************************/
+static bool path_list_add(path_list_t* list, const char* path)
+{
+    if (list->count == list->capacity)
+    {
+        unsigned capacity = (list->capacity > 0) ? list->capacity * 2 : PATH_LIST_INITIAL_CAPACITY;
+        char** paths = realloc(list->paths, capacity * sizeof(char*));
+
+        if (NULL == paths)
+        {
+            return false;
+        }
+
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    list->paths[list->count] = _strdup(path);
+
+    return (NULL != list->paths[list->count++]);
+}
+
+/******************************************************************
+*
+* \details Recursively add files with one of the given extensions in a directory.
+*
+*******************************************************************/
+static bool expand_directory(path_list_t* list, const char* directory, const char** extensions, unsigned extension_count)
+{
+    bool success = true;
+    char path[MAX_PATH];
+    WIN32_FIND_DATAA data;
+
+    snprintf(path, sizeof(path), "%s\\*", directory);
+    HANDLE find = FindFirstFileA(path, &data);
+
+    if (INVALID_HANDLE_VALUE != find)
+    {
+        do
+        {
+            if ((strcmp(data.cFileName, ".") == 0) || (strcmp(data.cFileName, "..") == 0))
+            {
+                continue;
+            }
+
+            if (snprintf(path, sizeof(path), "%s\\%s", directory, data.cFileName) >= (int)sizeof(path))
+            {
+                fprintf(stderr, "Error: Path too long in %s.\n", directory);
+            }
+            else if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                success = expand_directory(list, path, extensions, extension_count);
+            }
+            else
+            {
+                const char* file_extension = strrchr(data.cFileName, '.');
+                bool matched = false;
+
+                for (unsigned i = 0; (i < extension_count) && (NULL != file_extension) && !matched; ++i)
+                {
+                    matched = (_stricmp(file_extension + 1, extensions[i]) == 0);
+                }
+
+                if (matched)
+                {
+                    success = path_list_add(list, path);
+                }
+            }
+        } while (success && FindNextFileA(find, &data));
+
+        FindClose(find);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Expand the input paths into a list of files. Directories are
+*   searched recursively for files with one of the given extensions.
+*   Other paths are passed through unchanged.
+*
+* \param[in] inputs          : Input paths.
+* \param[in] input_count     : Number of input paths.
+* \param[in] extensions      : File extensions to search directories for (without '.').
+* \param[in] extension_count : Number of extensions.
+* \param[out] files          : Allocated list of files. Release with batch_free_paths.
+* \param[out] file_count     : Number of files.
+*
+* \return
+*   Return true if the paths were expanded.
+*
+*******************************************************************/
+bool batch_expand_paths(char** inputs, unsigned input_count, const char** extensions, unsigned extension_count, char*** files, unsigned* file_count)
+{
+    bool success = true;
+    path_list_t list = { NULL, 0, 0 };
+
+    for (unsigned i = 0; (i < input_count) && success; ++i)
+    {
+        DWORD attributes = GetFileAttributesA(inputs[i]);
+
+        if ((INVALID_FILE_ATTRIBUTES != attributes) && (attributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            success = expand_directory(&list, inputs[i], extensions, extension_count);
+        }
+        else
+        {
+            success = path_list_add(&list, inputs[i]);
+        }
+    }
+
+    if (!success)
+    {
+        batch_free_paths(list.paths, list.count);
+        list.paths = NULL;
+        list.count = 0;
+    }
+
+    *files = list.paths;
+    *file_count = list.count;
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Release a list of files returned by batch_expand_paths.
+*
+*******************************************************************/
+void batch_free_paths(char** files, unsigned file_count)
+{
+    if (NULL != files)
+    {
+        for (unsigned i = 0; i < file_count; ++i)
+        {
+            free(files[i]);
+        }
+
+        free(files);
+    }
+}
+
+/******************************************************************
+*
+* \details Prepare the interactive lane of a batch.
+*
+* \param[out] lanes : Lanes to be initialized.
+* \param[in] hold   : Keep serving requests once the files are done,
+*                     until batch_lanes_close is called.
+*
+* \return
+*   Return true if the lanes were initialized.
+*
+*******************************************************************/
+bool batch_lanes_init(batch_lanes_t* lanes, bool hold)
+{
+    LARGE_INTEGER frequency;
+
+    memset(lanes, 0, sizeof(batch_lanes_t));
+    QueryPerformanceFrequency(&frequency);
+    lanes->frequency = frequency.QuadPart;
+    lanes->hold = hold;
+
+    for (unsigned i = 0; i < BATCH_LANE_COUNT; ++i)
+    {
+        InitializeSRWLock(&lanes->latency[i].lock);
+    }
+
+    return queue_init(&lanes->queue, BATCH_LANE_CAPACITY);
+}
+
+/******************************************************************
+*
+* \details Release the lanes once batch_run has returned.
+*
+*******************************************************************/
+void batch_lanes_free(batch_lanes_t* lanes)
+{
+    queue_free(&lanes->queue);
+}
+
+/******************************************************************
+*
+* \details
+*   Queue an interactive request ahead of the files of the batch.
+*   request->done is set once request->record has been parsed.
+*
+* \param[in,out] lanes : Lanes of a running batch.
+* \param[in] request   : Request. Must remain valid until done is set.
+*
+* \return
+*   Return false if the lane has been closed.
+*
+*******************************************************************/
+bool batch_submit(batch_lanes_t* lanes, batch_request_t* request)
+{
+    bool submitted;
+
+    request->submitted = batch_now();
+    // Counted first, so workers look for the request as soon as it is queued
+    InterlockedIncrement(&lanes->pending);
+    submitted = queue_push(&lanes->queue, request);
+
+    if (!submitted)
+    {
+        InterlockedDecrement(&lanes->pending);
+    }
+
+    return submitted;
+}
+
+/******************************************************************
+*
+* \details
+*   Stop accepting requests. Queued requests are still served, and
+*   batch_run returns once they are done.
+*
+*******************************************************************/
+void batch_lanes_close(batch_lanes_t* lanes)
+{
+    queue_close(&lanes->queue);
+}
+
+/******************************************************************
+*
+* \details Latency of the recent requests or files of a lane.
+*
+* \param[in] lanes    : Lanes.
+* \param[in] lane     : Lane to summarize.
+* \param[out] summary : Request count and latency percentiles.
+*
+* \return None
+*
+*******************************************************************/
+void batch_lane_summary(batch_lanes_t* lanes, batch_lane_t lane, batch_lane_summary_t* summary)
+{
+    batch_latency_t* latency = &lanes->latency[lane];
+    LONG64 samples[BATCH_LATENCY_SAMPLES];
+    uint32_t count;
+    LONG64 max;
+
+    AcquireSRWLockShared(&latency->lock);
+    summary->count = latency->count;
+    count = (uint32_t)min(latency->count, BATCH_LATENCY_SAMPLES);
+    memcpy(samples, latency->samples, count * sizeof(LONG64));
+    max = latency->max;
+    ReleaseSRWLockShared(&latency->lock);
+
+    qsort(samples, count, sizeof(LONG64), compare_ticks);
+
+    // Nearest rank percentiles
+    uint32_t p50 = (uint32_t)(0.50 * count + 0.999999);
+    uint32_t p99 = (uint32_t)(0.99 * count + 0.999999);
+    double ms = 1000.0 / (double)lanes->frequency;
+
+    summary->p50_ms = (count > 0) ? (double)samples[(p50 > 0) ? p50 - 1 : 0] * ms : 0.0;
+    summary->p99_ms = (count > 0) ? (double)samples[(p99 > 0) ? p99 - 1 : 0] * ms : 0.0;
+    summary->max_ms = (double)max * ms;
+}
+
+/******************************************************************
+*
+* \details Name of a lane.
+*
+*******************************************************************/
+const char* batch_lane_name(batch_lane_t lane)
+{
+    return (lane < BATCH_LANE_COUNT) ? batch_lane_names[lane] : "unknown";
+}
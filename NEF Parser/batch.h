@@ -0,0 +1,113 @@
+/**************************************************************//**
+*
+* \file batch.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Parallel batch processing of image files.
+*
+*******************************************************************/
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "numa.h"
+#include "queue.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define BATCH_MAX_THREADS 64
+#define BATCH_LANE_CAPACITY     64      // Interactive requests waiting for a worker
+#define BATCH_LATENCY_SAMPLES   1024    // Recent latencies kept per lane
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Parse a single file into a record
+typedef bool (*batch_parse_t)(const char* path, nef_record_t* record);
+// Called on the worker thread after each file is parsed
+typedef void (*batch_record_callback_t)(nef_record_t* record, void* context);
+
+typedef enum
+{
+    BATCH_LANE_INTERACTIVE = 0, // Requests served ahead of the files
+    BATCH_LANE_BATCH,           // Files of the batch
+    BATCH_LANE_COUNT
+} batch_lane_t;
+
+// File parsed ahead of the batch for an interactive client
+typedef struct
+{
+    const char* path;
+    nef_record_t* record;   // Receives the result
+    HANDLE done;            // Set once the record has been parsed
+    LONG64 submitted;       // Performance counter at submission
+} batch_request_t;
+
+// Recent latencies of a lane, from submission (or claim) to completion
+typedef struct
+{
+    SRWLOCK lock;
+    LONG64 samples[BATCH_LATENCY_SAMPLES]; // Ticks, oldest overwritten first
+    uint64_t count;                         // Samples recorded
+    LONG64 max;
+} batch_latency_t;
+
+typedef struct
+{
+    uint64_t count;
+    double p50_ms;  // Of the recent samples
+    double p99_ms;
+    double max_ms;  // Of all samples
+} batch_lane_summary_t;
+
+typedef struct
+{
+    queue_t queue;          // Interactive requests
+    volatile LONG pending;  // Requests not yet claimed by a worker
+    bool hold;              // Keep serving requests once the files are done, until batch_lanes_close
+    LONG64 frequency;       // Performance counter ticks per second
+    batch_latency_t latency[BATCH_LANE_COUNT];
+} batch_lanes_t;
+
+typedef struct
+{
+    char** files;                     // Files to process
+    uint32_t count;                   // Number of files
+    nef_record_t* records;            // Optional. Records receiving the results (one per file).
+                                      // Without them each record is only passed to the callback.
+    unsigned threads;                 // Number of worker threads
+    batch_parse_t parse;
+    batch_record_callback_t callback; // Optional
+    void* context;                    // Passed to callback
+    const numa_topology_t* numa;      // Optional. Workers are grouped and pinned by node.
+    batch_lanes_t* lanes;             // Optional. Interactive requests served ahead of the files.
+    unsigned reserved;                // Additional workers serving only the interactive lane
+} batch_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool batch_run(batch_t* batch);
+unsigned batch_default_threads(void);
+bool batch_expand_paths(char** inputs, unsigned input_count, const char** extensions, unsigned extension_count, char*** files, unsigned* file_count);
+void batch_free_paths(char** files, unsigned file_count);
+bool batch_lanes_init(batch_lanes_t* lanes, bool hold);
+void batch_lanes_free(batch_lanes_t* lanes);
+bool batch_submit(batch_lanes_t* lanes, batch_request_t* request);
+void batch_lanes_close(batch_lanes_t* lanes);
+void batch_lane_summary(batch_lanes_t* lanes, batch_lane_t lane, batch_lane_summary_t* summary);
+const char* batch_lane_name(batch_lane_t lane);
+
+#endif /* end batch.h */
@@ -0,0 +1,405 @@
+/**************************************************************//**
+*
+* \file benchmark.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Comparison of the file read strategies. Each strategy parses
+*   every file twice with the normal batch: a cold run that evicts
+*   each file from the system cache before parsing it, followed by
+*   a warm run served from the cache. Each run reports throughput,
+*   bytes read, file system calls and per-file latency percentiles,
+*   overall and by file size.
+*
+*   The memory harness parses every file once with allocation
+*   profiles, and fails when a file or the batch exceeds its limit.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "alloc.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define BENCHMARK_NAME_WIDTH 12
+#define BENCHMARK_FILE_WIDTH 24
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Results of a group of files
+typedef struct
+{
+    uint32_t files;
+    uint32_t parsed;
+    uint64_t bytes;
+    uint64_t calls;
+    uint32_t latency_count;
+} benchmark_group_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Upper bound (exclusive) of each size class
+static const uint64_t size_class_limits[BENCHMARK_SIZE_CLASSES] = {
+    1ULL << 20,
+    16ULL << 20,
+    64ULL << 20,
+    UINT64_MAX,
+};
+
+static const char* size_class_names[BENCHMARK_SIZE_CLASSES] = {
+    "< 1 MiB",
+    "1-16 MiB",
+    "16-64 MiB",
+    ">= 64 MiB",
+};
+
+// State of the run in progress, used by benchmark_parse on the worker threads
+static const benchmark_t* active_benchmark = NULL;
+static nef_record_t* active_records = NULL;
+static uint64_t* active_latencies = NULL;  // Ticks per file
+static bool active_cold = false;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool benchmark_parse(const char* path, nef_record_t* record);
+static int compare_ticks(const void* a, const void* b);
+static uint64_t percentile(uint64_t* sorted, uint32_t count, double fraction);
+static void print_group(const char* strategy, const char* cache, const char* size, const benchmark_group_t* group,
+                        uint64_t* latencies, double files_per_second, double frequency);
+
+/******************************************************************
+*
+* \details Batch parse function timing each file of a run.
+*
+* \param[in] path    : File to parse.
+* \param[out] record : Parsed record.
+*
+* \return
+*   Return true if the file was parsed successfully.
+*
+*******************************************************************/
+static bool benchmark_parse(const char* path, nef_record_t* record)
+{
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+
+    if (active_cold)
+    {
+        io_evict(path);
+    }
+
+    QueryPerformanceCounter(&start);
+    bool parsed = active_benchmark->parse(path, record);
+    QueryPerformanceCounter(&end);
+    active_latencies[record - active_records] = (uint64_t)(end.QuadPart - start.QuadPart);
+
+    return parsed;
+}
+
+/******************************************************************
+*
+* \details Comparison function for sorting latencies.
+*
+*******************************************************************/
+static int compare_ticks(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/******************************************************************
+*
+* \details Nearest rank percentile of sorted latencies.
+*
+*******************************************************************/
+static uint64_t percentile(uint64_t* sorted, uint32_t count, double fraction)
+{
+    uint32_t rank = (uint32_t)(fraction * count + 0.999999);
+
+    return (count > 0) ? sorted[(rank > 0) ? rank - 1 : 0] : 0;
+}
+
+/******************************************************************
+*
+* \details Display the results of a group of files.
+*
+* \param[in] strategy         : Strategy name.
+* \param[in] cache            : Cold or warm.
+* \param[in] size             : Size class name.
+* \param[in] group            : Results of the group.
+* \param[in,out] latencies    : Latencies of the group (sorted in place).
+* \param[in] files_per_second : Throughput, or 0 if not measured for the group.
+* \param[in] frequency        : Performance counter frequency.
+*
+* \return None
+*
+*******************************************************************/
+static void print_group(const char* strategy, const char* cache, const char* size, const benchmark_group_t* group,
+                        uint64_t* latencies, double files_per_second, double frequency)
+{
+    qsort(latencies, group->latency_count, sizeof(uint64_t), compare_ticks);
+
+    printf("%-*s| %-5s | %-9s | %7u | %7u | ", BENCHMARK_NAME_WIDTH, strategy, cache, size, group->files, group->parsed);
+
+    if (files_per_second > 0)
+    {
+        printf("%9.1f", files_per_second);
+    }
+    else
+    {
+        printf("%9s", "-");
+    }
+
+    printf(" | %10.1f | %9llu | %10.1f | %10.1f\n", (double)group->bytes / (1024.0 * 1024.0), (unsigned long long)group->calls,
+           (double)percentile(latencies, group->latency_count, 0.50) * 1e6 / frequency,
+           (double)percentile(latencies, group->latency_count, 0.99) * 1e6 / frequency);
+}
+
+/******************************************************************
+*
+* \details Run the comparison and display the results.
+*
+* \param[in] benchmark : Files and parse function to benchmark.
+*
+* \return
+*   Return true if the benchmark ran.
+*
+*******************************************************************/
+bool benchmark_run(const benchmark_t* benchmark)
+{
+    bool success = false;
+    uint32_t count = benchmark->count;
+    nef_record_t* records = calloc((count > 0) ? count : 1, sizeof(nef_record_t));
+    uint64_t* latencies = calloc((count > 0) ? count : 1, sizeof(uint64_t));
+    uint64_t* group_latencies = calloc((count > 0) ? count : 1, sizeof(uint64_t));
+    uint64_t* sizes = calloc((count > 0) ? count : 1, sizeof(uint64_t));
+
+    if ((NULL == records) || (NULL == latencies) || (NULL == group_latencies) || (NULL == sizes))
+    {
+        fprintf(stderr, "Error: Insufficient memory to allocate benchmark.\n");
+    }
+    else
+    {
+        LARGE_INTEGER frequency;
+        io_strategy_t selected = *benchmark->strategy;
+
+        QueryPerformanceFrequency(&frequency);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            HANDLE file = CreateFileA(benchmark->files[i], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            LARGE_INTEGER size = { 0 };
+
+            if (INVALID_HANDLE_VALUE != file)
+            {
+                GetFileSizeEx(file, &size);
+                CloseHandle(file);
+            }
+
+            sizes[i] = (uint64_t)size.QuadPart;
+        }
+
+        active_benchmark = benchmark;
+        active_records = records;
+        active_latencies = latencies;
+        printf("%-*s| %-5s | %-9s | %7s | %7s | %9s | %10s | %9s | %10s | %10s\n", BENCHMARK_NAME_WIDTH, "Strategy", "Cache", "Size",
+               "Files", "Parsed", "Files/s", "MiB Read", "Calls", "p50 us", "p99 us");
+
+        for (unsigned strategy = 0; strategy < IO_STRATEGY_COUNT; ++strategy)
+        {
+            for (unsigned run = 0; run < 2; ++run)
+            {
+                // Unnamed fields (callback, NUMA grouping, lanes) stay unset
+                batch_t batch = { .files = benchmark->files, .count = count, .records = records,
+                                  .threads = benchmark->threads, .parse = benchmark_parse };
+                benchmark_group_t total = { 0 };
+                LARGE_INTEGER start;
+                LARGE_INTEGER end;
+
+                *benchmark->strategy = (io_strategy_t)strategy;
+                active_cold = (run == 0);
+                memset(records, 0, count * sizeof(nef_record_t));
+                memset(latencies, 0, count * sizeof(uint64_t));
+
+                QueryPerformanceCounter(&start);
+                batch_run(&batch);
+                QueryPerformanceCounter(&end);
+
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    total.files++;
+                    total.parsed += records[i].valid ? 1 : 0;
+                    total.bytes += records[i].io.bytes;
+                    total.calls += records[i].io.calls;
+                    group_latencies[total.latency_count++] = latencies[i];
+                }
+
+                double seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+                print_group(io_strategy_name((io_strategy_t)strategy), active_cold ? "cold" : "warm", "All", &total, group_latencies,
+                            (seconds > 0) ? count / seconds : 0, (double)frequency.QuadPart);
+
+                for (unsigned size_class = 0; size_class < BENCHMARK_SIZE_CLASSES; ++size_class)
+                {
+                    benchmark_group_t group = { 0 };
+                    uint64_t lower = (size_class > 0) ? size_class_limits[size_class - 1] : 0;
+
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        if ((sizes[i] >= lower) && (sizes[i] < size_class_limits[size_class]))
+                        {
+                            group.files++;
+                            group.parsed += records[i].valid ? 1 : 0;
+                            group.bytes += records[i].io.bytes;
+                            group.calls += records[i].io.calls;
+                            group_latencies[group.latency_count++] = latencies[i];
+                        }
+                    }
+
+                    // Only size classes that differ from the total are shown
+                    if ((group.files > 0) && (group.files < total.files))
+                    {
+                        print_group("", "", size_class_names[size_class], &group, group_latencies, 0, (double)frequency.QuadPart);
+                    }
+                }
+            }
+        }
+
+        *benchmark->strategy = selected;
+        active_benchmark = NULL;
+        success = true;
+    }
+
+    free(records);
+    free(latencies);
+    free(group_latencies);
+    free(sizes);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Parse the files once with allocation profiles enabled and
+*   display the heap allocations and working set of each file,
+*   followed by the totals of the batch by stage. Metadata is
+*   decoded in place, so the heap of a file is its read buffer,
+*   unless the buffer came from a NUMA node pool. The working set
+*   is shared by the worker threads, so it is only displayed per
+*   file with one thread, and the working set limit applies to the
+*   whole process.
+*
+* \param[in] benchmark      : Files, parse function and limits.
+* \param[out] within_limits : Set false if a limit was exceeded.
+*
+* \return
+*   Return true if the files were parsed.
+*
+*******************************************************************/
+bool benchmark_memory(const benchmark_t* benchmark, bool* within_limits)
+{
+    bool success = false;
+    uint32_t count = benchmark->count;
+    nef_record_t* records = calloc((count > 0) ? count : 1, sizeof(nef_record_t));
+
+    *within_limits = true;
+
+    if (NULL == records)
+    {
+        fprintf(stderr, "Error: Insufficient memory to allocate records.\n");
+    }
+    else if (!alloc_init())
+    {
+        fprintf(stderr, "Error: Failed to enable allocation profiles.\n");
+    }
+    else
+    {
+        batch_t batch = { .files = benchmark->files, .count = count, .records = records,
+                          .threads = benchmark->threads, .parse = benchmark->parse };
+        alloc_profile_t total;
+        uint64_t working_set = 0;
+        uint64_t peak_working_set = 0;
+
+        batch_run(&batch);
+        printf("%-*s| %8s | %12s | %12s | %12s\n", BENCHMARK_FILE_WIDTH, "File", "Allocs", "Bytes", "Peak Heap", "Working Set");
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const alloc_profile_t* memory = &records[i].memory;
+            const char* filename = strrchr(records[i].path, '\\');
+            uint64_t allocations = 0;
+            uint64_t bytes = 0;
+
+            for (unsigned stage = 0; stage < PERF_STAGE_COUNT; ++stage)
+            {
+                allocations += memory->stages[stage].allocations;
+                bytes += memory->stages[stage].bytes;
+            }
+
+            printf("%-*s| %8llu | %12llu | %12llu | ", BENCHMARK_FILE_WIDTH, (NULL != filename) ? filename + 1 : records[i].path,
+                   (unsigned long long)allocations, (unsigned long long)bytes, (unsigned long long)memory->peak_bytes);
+
+            // Other workers share the working set, so it only belongs to this file with one thread
+            if (benchmark->threads == 1)
+            {
+                printf("%12llu\n", (unsigned long long)memory->working_set);
+            }
+            else
+            {
+                printf("%12s\n", "-");
+            }
+
+            if ((benchmark->max_file_heap > 0) && (memory->peak_bytes > benchmark->max_file_heap))
+            {
+                fprintf(stderr, "Error: Peak heap of %s (%llu bytes) exceeds the limit of %llu bytes.\n", records[i].path,
+                        (unsigned long long)memory->peak_bytes, (unsigned long long)benchmark->max_file_heap);
+                *within_limits = false;
+            }
+        }
+
+        alloc_totals(&total);
+        alloc_working_set(&working_set, &peak_working_set);
+        printf("\n%-*s| %12s | %14s\n", BENCHMARK_NAME_WIDTH + 2, "Stage", "Allocations", "Bytes");
+
+        for (unsigned stage = 0; stage < PERF_STAGE_COUNT; ++stage)
+        {
+            if (total.stages[stage].allocations > 0)
+            {
+                printf("%-*s| %12llu | %14llu\n", BENCHMARK_NAME_WIDTH + 2, perf_stage_name((perf_stage_t)stage),
+                       (unsigned long long)total.stages[stage].allocations, (unsigned long long)total.stages[stage].bytes);
+            }
+        }
+
+        printf("%-*s| %llu bytes\n", BENCHMARK_NAME_WIDTH + 2, "Peak Heap", (unsigned long long)total.peak_bytes);
+        printf("%-*s| %llu bytes\n", BENCHMARK_NAME_WIDTH + 2, "Leaked Heap", (unsigned long long)total.live_bytes);
+        printf("%-*s| %llu bytes\n", BENCHMARK_NAME_WIDTH + 2, "Peak RSS", (unsigned long long)peak_working_set);
+
+        if ((benchmark->max_working_set > 0) && (peak_working_set > benchmark->max_working_set))
+        {
+            fprintf(stderr, "Error: Peak working set (%llu bytes) exceeds the limit of %llu bytes.\n",
+                    (unsigned long long)peak_working_set, (unsigned long long)benchmark->max_working_set);
+            *within_limits = false;
+        }
+
+        success = true;
+    }
+
+    free(records);
+
+    return success;
+}
@@ -0,0 +1,52 @@
+/**************************************************************//**
+*
+* \file benchmark.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Comparison of the file read strategies and memory accounting
+*   over a set of image files.
+*
+*******************************************************************/
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "batch.h"
+#include "io.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define BENCHMARK_SIZE_CLASSES 4
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    char** files;               // Files to process
+    uint32_t count;             // Number of files
+    unsigned threads;           // Number of worker threads
+    batch_parse_t parse;        // Parses a file with *strategy
+    io_strategy_t* strategy;    // Strategy used by parse
+    uint64_t max_file_heap;     // Peak heap bytes allowed per file (0 = no limit)
+    uint64_t max_working_set;   // Peak process working set allowed (in bytes, 0 = no limit)
+} benchmark_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool benchmark_run(const benchmark_t* benchmark);
+bool benchmark_memory(const benchmark_t* benchmark, bool* within_limits);
+
+#endif /* end benchmark.h */
@@ -0,0 +1,544 @@
+/**************************************************************//**
+*
+* \file control.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Named pipe for adjusting a running scan. A server thread
+*   accepts clients and serves each one on its own thread, which
+*   reads a single command message and writes back a single reply
+*   message. A client that sends nothing, or does not read its
+*   reply, is dropped after CONTROL_TIMEOUT_MS.
+*
+*   Commands:
+*     bandwidth <MiB/s>   Cap the read bandwidth (0 = unlimited)
+*     iops <ops/s>        Cap the file system operations (0 = unlimited)
+*     status              Display the caps and the time spent waiting
+*     parse <path>        Parse a file ahead of the batch and display it
+*     lanes               Display the latency of each lane
+*     quit                Stop serving requests once the batch is done
+*
+*   The pipe rejects remote clients, so only processes on the same
+*   host can change the caps.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "control.h"
+#include "io.h"
+#include "batch.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef bool (*control_handler_t)(control_t* control, const char* argument, char* reply, size_t size);
+
+typedef struct
+{
+    const char* name;
+    control_handler_t handler;
+} control_command_t;
+
+// Connected client handed to its thread
+typedef struct
+{
+    control_t* control;
+    HANDLE pipe;
+} control_client_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool control_bandwidth(control_t* control, const char* argument, char* reply, size_t size);
+static bool control_iops(control_t* control, const char* argument, char* reply, size_t size);
+static bool control_status(control_t* control, const char* argument, char* reply, size_t size);
+static bool control_parse(control_t* control, const char* argument, char* reply, size_t size);
+static bool control_lanes(control_t* control, const char* argument, char* reply, size_t size);
+static bool control_quit(control_t* control, const char* argument, char* reply, size_t size);
+static void control_execute(control_t* control, char* request, char* reply, size_t size);
+static bool control_complete(control_t* control, HANDLE pipe, BOOL finished, OVERLAPPED* overlapped, DWORD timeout, DWORD* transferred);
+static DWORD WINAPI control_client(LPVOID parameter);
+static DWORD WINAPI control_thread(LPVOID parameter);
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const control_command_t control_commands[] = {
+    { "bandwidth",  control_bandwidth },
+    { "iops",       control_iops },
+    { "status",     control_status },
+    { "parse",      control_parse },
+    { "lanes",      control_lanes },
+    { "quit",       control_quit },
+};
+
+/******************************************************************
+*
+* \details Cap the read bandwidth (in MiB/s, 0 = unlimited).
+*
+*******************************************************************/
+static bool control_bandwidth(control_t* control, const char* argument, char* reply, size_t size)
+{
+    bool success = false;
+    uint64_t mebibytes = 0;
+    io_limits_t limits;
+
+    (void)control;
+
+    if ((NULL != argument) && (sscanf_s(argument, "%llu", &mebibytes) == 1))
+    {
+        io_get_limits(&limits);
+        io_set_limits(mebibytes * 1024 * 1024, limits.ops_per_second);
+        sprintf_s(reply, size, "Bandwidth = %llu MiB/s\n", mebibytes);
+        success = true;
+    }
+    else
+    {
+        sprintf_s(reply, size, "Error: bandwidth expects a rate in MiB/s.\n");
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Cap the file system operations (per second, 0 = unlimited).
+*
+*******************************************************************/
+static bool control_iops(control_t* control, const char* argument, char* reply, size_t size)
+{
+    bool success = false;
+    uint64_t operations = 0;
+    io_limits_t limits;
+
+    (void)control;
+
+    if ((NULL != argument) && (sscanf_s(argument, "%llu", &operations) == 1))
+    {
+        io_get_limits(&limits);
+        io_set_limits(limits.bytes_per_second, operations);
+        sprintf_s(reply, size, "IOPS = %llu\n", operations);
+        success = true;
+    }
+    else
+    {
+        sprintf_s(reply, size, "Error: iops expects a rate in operations per second.\n");
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Display the caps and the time spent waiting on them.
+*
+*******************************************************************/
+static bool control_status(control_t* control, const char* argument, char* reply, size_t size)
+{
+    io_limits_t limits;
+
+    (void)control;
+    (void)argument;
+    io_get_limits(&limits);
+    sprintf_s(reply, size, "Bandwidth = %llu MiB/s\nIOPS = %llu\nWaited = %.3f s\n",
+              limits.bytes_per_second / (1024 * 1024), limits.ops_per_second, limits.waited_seconds);
+
+    return true;
+}
+
+/******************************************************************
+*
+* \details
+*   Parse a file in the interactive lane of the running batch and
+*   display its main fields.
+*
+*******************************************************************/
+static bool control_parse(control_t* control, const char* argument, char* reply, size_t size)
+{
+    bool success = false;
+    batch_request_t request = { argument, NULL, NULL, 0 };
+
+    if ((NULL == control->lanes) || (NULL == argument) || (argument[0] == '\0'))
+    {
+        sprintf_s(reply, size, (NULL == control->lanes) ? "Error: No batch is running.\n" : "Error: parse expects a path.\n");
+    }
+    else if ((NULL == (request.record = calloc(1, sizeof(nef_record_t)))) ||
+             (NULL == (request.done = CreateEventA(NULL, TRUE, FALSE, NULL))))
+    {
+        sprintf_s(reply, size, "Error: Insufficient memory to parse %s.\n", argument);
+    }
+    else if (!batch_submit(control->lanes, &request))
+    {
+        sprintf_s(reply, size, "Error: The batch is no longer accepting requests.\n");
+    }
+    else
+    {
+        const nef_record_t* record = request.record;
+
+        // Queued requests are served before batch_run returns, so this
+        // only blocks the thread of this client
+        WaitForSingleObject(request.done, INFINITE);
+
+        if (record->valid)
+        {
+            sprintf_s(reply, size,
+                      "%-*s| %s\n%-*s| %s\n%-*s| %s\n%-*s| %s\n%-*s| %s\n%-*s| f/%.1f\n%-*s| %u\n%-*s| %.2f mm\n%-*s| %u\n",
+                      CONTROL_REPLY_WIDTH, "File", record->path,
+                      CONTROL_REPLY_WIDTH, "Camera Make", record->camera.make,
+                      CONTROL_REPLY_WIDTH, "Camera Model", record->camera.model,
+                      CONTROL_REPLY_WIDTH, "Camera Lens", record->camera.lens,
+                      CONTROL_REPLY_WIDTH, "Time Stamp", record->image.timestamp,
+                      CONTROL_REPLY_WIDTH, "Aperature", record->image.aperature,
+                      CONTROL_REPLY_WIDTH, "ISO", record->image.iso,
+                      CONTROL_REPLY_WIDTH, "Focal Length", record->image.focal_length,
+                      CONTROL_REPLY_WIDTH, "Shutter Count", record->image.shutter_count);
+            success = true;
+        }
+        else
+        {
+            sprintf_s(reply, size, "Error: Failed to parse %s (%s).\n", argument,
+                      (record->errors.count > 0) ? nef_error_name((nef_error_code_t)record->errors.entries[0].code) : "unknown");
+        }
+    }
+
+    if (NULL != request.done)
+    {
+        CloseHandle(request.done);
+    }
+
+    free(request.record);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Display the latency of each lane.
+*
+*******************************************************************/
+static bool control_lanes(control_t* control, const char* argument, char* reply, size_t size)
+{
+    bool success = false;
+    size_t length = 0;
+
+    (void)argument;
+
+    if (NULL != control->lanes)
+    {
+        length += sprintf_s(reply, size, "%-*s| %10s | %9s | %9s | %9s\n", CONTROL_REPLY_WIDTH, "Lane", "Count", "p50 ms", "p99 ms", "Max ms");
+
+        for (unsigned lane = 0; lane < BATCH_LANE_COUNT; ++lane)
+        {
+            batch_lane_summary_t summary;
+
+            batch_lane_summary(control->lanes, (batch_lane_t)lane, &summary);
+            length += sprintf_s(reply + length, size - length, "%-*s| %10llu | %9.3f | %9.3f | %9.3f\n",
+                                CONTROL_REPLY_WIDTH, batch_lane_name((batch_lane_t)lane), summary.count,
+                                summary.p50_ms, summary.p99_ms, summary.max_ms);
+        }
+
+        success = true;
+    }
+    else
+    {
+        sprintf_s(reply, size, "Error: No batch is running.\n");
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Stop serving requests. The batch finishes its files.
+*
+*******************************************************************/
+static bool control_quit(control_t* control, const char* argument, char* reply, size_t size)
+{
+    (void)argument;
+
+    if (NULL != control->lanes)
+    {
+        batch_lanes_close(control->lanes);
+    }
+
+    sprintf_s(reply, size, "Stopping\n");
+
+    return true;
+}
+
+/******************************************************************
+*
+* \details Run a command and format its reply.
+*
+* \param[in] control     : Control pipe.
+* \param[in,out] request : Command line (split in place).
+* \param[out] reply      : Reply text.
+* \param[in] size        : Size of reply.
+*
+* \return None
+*
+*******************************************************************/
+static void control_execute(control_t* control, char* request, char* reply, size_t size)
+{
+    char* context = NULL;
+    const char* name = strtok_s(request, " \t\r\n", &context);
+    // The rest of the line, so paths may contain spaces
+    char* argument = (NULL != name) ? strtok_s(NULL, "\r\n", &context) : NULL;
+    bool found = false;
+
+    while ((NULL != argument) && ((*argument == ' ') || (*argument == '\t')))
+    {
+        argument++;
+    }
+
+    for (unsigned i = 0; (i < sizeof(control_commands) / sizeof(control_commands[0])) && (NULL != name) && !found; ++i)
+    {
+        if (_stricmp(name, control_commands[i].name) == 0)
+        {
+            control_commands[i].handler(control, argument, reply, size);
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        sprintf_s(reply, size, "Error: Unknown command. Expected bandwidth, iops, status, parse, lanes or quit.\n");
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Wait for an overlapped operation on a client pipe. The operation
+*   is cancelled when it times out or control_stop is called.
+*
+* \param[in] control      : Control pipe.
+* \param[in] pipe         : Client pipe.
+* \param[in] finished     : Result of the call that started the operation.
+* \param[in] overlapped   : Overlapped structure of the operation.
+* \param[in] timeout      : Longest wait (in ms).
+* \param[out] transferred : Bytes transferred.
+*
+* \return
+*   Return true if the operation completed successfully.
+*
+*******************************************************************/
+static bool control_complete(control_t* control, HANDLE pipe, BOOL finished, OVERLAPPED* overlapped, DWORD timeout, DWORD* transferred)
+{
+    bool complete = false;
+
+    if (finished || (GetLastError() == ERROR_IO_PENDING))
+    {
+        HANDLE handles[2] = { overlapped->hEvent, control->stop };
+
+        if (WaitForMultipleObjects(2, handles, FALSE, timeout) == WAIT_OBJECT_0)
+        {
+            complete = GetOverlappedResult(pipe, overlapped, transferred, FALSE);
+        }
+        else
+        {
+            CancelIoEx(pipe, overlapped);
+            GetOverlappedResult(pipe, overlapped, transferred, TRUE);
+        }
+    }
+
+    return complete;
+}
+
+/******************************************************************
+*
+* \details Serve the command of a connected client.
+*
+* \param[in] parameter : Client (control_client_t, freed here).
+*
+* \return 0
+*
+*******************************************************************/
+static DWORD WINAPI control_client(LPVOID parameter)
+{
+    control_client_t* client = parameter;
+    control_t* control = client->control;
+    HANDLE pipe = client->pipe;
+    OVERLAPPED overlapped = { 0 };
+    char request[CONTROL_MAX_MESSAGE];
+    char reply[CONTROL_MAX_MESSAGE];
+    DWORD read = 0;
+    DWORD written = 0;
+
+    free(client);
+    overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    if ((NULL != overlapped.hEvent) &&
+        control_complete(control, pipe, ReadFile(pipe, request, sizeof(request) - 1, NULL, &overlapped),
+                         &overlapped, CONTROL_TIMEOUT_MS, &read))
+    {
+        request[read] = '\0';
+        control_execute(control, request, reply, sizeof(reply));
+
+        if (control_complete(control, pipe, WriteFile(pipe, reply, (DWORD)strlen(reply), NULL, &overlapped),
+                             &overlapped, CONTROL_TIMEOUT_MS, &written))
+        {
+            // Disconnecting discards an unread reply, so wait for the
+            // client to close its end (FlushFileBuffers has no timeout)
+            control_complete(control, pipe, ReadFile(pipe, request, sizeof(request), NULL, &overlapped),
+                             &overlapped, CONTROL_TIMEOUT_MS, &read);
+        }
+    }
+
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+
+    if (NULL != overlapped.hEvent)
+    {
+        CloseHandle(overlapped.hEvent);
+    }
+
+    InterlockedDecrement(&control->clients);
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details
+*   Accept clients until control_stop is called. Each client is
+*   served on its own thread, so a slow one does not hold the pipe.
+*
+* \param[in] parameter : Control pipe (control_t).
+*
+* \return 0
+*
+*******************************************************************/
+static DWORD WINAPI control_thread(LPVOID parameter)
+{
+    control_t* control = parameter;
+    OVERLAPPED overlapped = { 0 };
+
+    overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    while ((NULL != overlapped.hEvent) && !control->stopping)
+    {
+        HANDLE pipe = CreateNamedPipeA(control->path, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+                                       PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                       PIPE_UNLIMITED_INSTANCES, CONTROL_MAX_MESSAGE, CONTROL_MAX_MESSAGE, 0, NULL);
+        control_client_t* client = NULL;
+        HANDLE thread = NULL;
+        DWORD transferred = 0;
+        BOOL connected;
+
+        if (INVALID_HANDLE_VALUE == pipe)
+        {
+            fprintf(stderr, "Error: Failed to create the control pipe %s.\n", control->path);
+            break;
+        }
+
+        connected = ConnectNamedPipe(pipe, &overlapped);
+        connected = (!connected && (GetLastError() == ERROR_PIPE_CONNECTED)) ||
+                    control_complete(control, pipe, connected, &overlapped, INFINITE, &transferred);
+
+        if (connected && (NULL != (client = malloc(sizeof(control_client_t)))))
+        {
+            client->control = control;
+            client->pipe = pipe;
+            InterlockedIncrement(&control->clients);
+            thread = CreateThread(NULL, 0, control_client, client, 0, NULL);
+
+            if (NULL == thread)
+            {
+                InterlockedDecrement(&control->clients);
+                free(client);
+            }
+        }
+
+        if (NULL != thread)
+        {
+            CloseHandle(thread);
+        }
+        else
+        {
+            DisconnectNamedPipe(pipe);
+            CloseHandle(pipe);
+        }
+    }
+
+    if (NULL != overlapped.hEvent)
+    {
+        CloseHandle(overlapped.hEvent);
+    }
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details Start serving the control pipe.
+*
+* \param[out] control : Control pipe.
+* \param[in] name     : Pipe name, without the \\.\pipe\ prefix.
+* \param[in] lanes    : Lanes of the batch served by the pipe (may be NULL).
+*
+* \return
+*   Return true if the server thread was started.
+*
+*******************************************************************/
+bool control_start(control_t* control, const char* name, batch_lanes_t* lanes)
+{
+    bool success = false;
+
+    control->thread = NULL;
+    control->stopping = 0;
+    control->clients = 0;
+    control->lanes = lanes;
+    control->stop = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    if ((NULL != control->stop) && (sprintf_s(control->path, sizeof(control->path), "%s%s", CONTROL_PIPE_PREFIX, name) > 0))
+    {
+        control->thread = CreateThread(NULL, 0, control_thread, control, 0, NULL);
+        success = (NULL != control->thread);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Stop serving the control pipe.
+*
+* \param[in,out] control : Control pipe started by control_start.
+*
+* \return None
+*
+*******************************************************************/
+void control_stop(control_t* control)
+{
+    if (NULL != control->thread)
+    {
+        // Cancels the pending connect and the reads and writes of the clients
+        InterlockedExchange(&control->stopping, 1);
+        SetEvent(control->stop);
+
+        WaitForSingleObject(control->thread, INFINITE);
+        CloseHandle(control->thread);
+        control->thread = NULL;
+
+        // A client parsing a file waits for it, at most until the batch is done
+        while (control->clients > 0)
+        {
+            Sleep(CONTROL_STOP_POLL_MS);
+        }
+    }
+
+    if (NULL != control->stop)
+    {
+        CloseHandle(control->stop);
+        control->stop = NULL;
+    }
+}
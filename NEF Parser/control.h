@@ -0,0 +1,54 @@
+/**************************************************************//**
+*
+* \file control.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Named pipe for adjusting and querying a running scan.
+*
+*******************************************************************/
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "batch.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define CONTROL_PIPE_PREFIX     "\\\\.\\pipe\\"
+#define CONTROL_MAX_PATH        256
+#define CONTROL_MAX_MESSAGE     2048 // Command or reply
+#define CONTROL_REPLY_WIDTH     14
+#define CONTROL_STOP_POLL_MS    10
+#define CONTROL_TIMEOUT_MS      5000 // Longest wait for a client to send its command or read the reply
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    char path[CONTROL_MAX_PATH];    // Pipe path
+    HANDLE thread;                  // Thread accepting clients
+    HANDLE stop;                    // Signaled by control_stop, cancels pending pipe I/O
+    volatile LONG stopping;         // Set by control_stop
+    volatile LONG clients;          // Clients being served
+    batch_lanes_t* lanes;           // Interactive lane of the batch (may be NULL)
+} control_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool control_start(control_t* control, const char* name, batch_lanes_t* lanes);
+void control_stop(control_t* control);
+
+#endif /* end control.h */
@@ -0,0 +1,504 @@
+/**************************************************************//**
+*
+* \file cpu.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Runtime CPU feature dispatch of the hot kernels. Every kernel
+*   has a scalar variant and SSE4.2, AVX2 and AVX-512 variants that
+*   produce identical results. The widest supported variants are
+*   bound once at startup, before any worker thread is started.
+*
+*   The vector variants are compiled without /arch flags, so they
+*   are only ever reached through cpu_kernels after cpu_dispatch
+*   has checked the processor supports them.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <intrin.h>
+#include <string.h>
+#include "cpu.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// CPUID feature bits
+#define CPUID_1_ECX_SSE42       (1 << 20)
+#define CPUID_1_ECX_OSXSAVE     (1 << 27)
+#define CPUID_1_ECX_AVX         (1 << 28)
+#define CPUID_7_EBX_AVX2        (1 << 5)
+#define CPUID_7_EBX_AVX512F     (1 << 16)
+#define CPUID_7_EBX_AVX512BW    (1 << 30)
+
+// XCR0 state enabled by the operating system
+#define XCR0_AVX_STATE          0x06    // SSE and AVX
+#define XCR0_AVX512_STATE       0xE6    // SSE, AVX, opmask and ZMM
+
+// Key stream steps held per vector (16 bit lanes, even or odd bytes)
+#define DECRYPT_MAX_LANES       32
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static void decrypt_scalar(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck);
+static void decrypt_sse42(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck);
+static void decrypt_avx2(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck);
+static void decrypt_avx512(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck);
+static const char* find_scalar(const char* begin, const char* end, const char* needle, size_t length);
+static const char* find_sse42(const char* begin, const char* end, const char* needle, size_t length);
+static const char* find_avx2(const char* begin, const char* end, const char* needle, size_t length);
+static const char* find_avx512(const char* begin, const char* end, const char* needle, size_t length);
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+cpu_kernels_t cpu_kernels = { decrypt_scalar, find_scalar };
+
+static cpu_level_t cpu_selected = CPU_LEVEL_SCALAR;
+
+static const char* cpu_level_names[CPU_LEVEL_COUNT] = {
+    "scalar",
+    "sse4.2",
+    "avx2",
+    "avx512",
+};
+
+static const cpu_kernels_t cpu_variants[CPU_LEVEL_COUNT] = {
+    { decrypt_scalar, find_scalar },
+    { decrypt_sse42,  find_sse42  },
+    { decrypt_avx2,   find_avx2   },
+    { decrypt_avx512, find_avx512 },
+};
+
+// Key stream byte j of a block is cj + ci * ((j + 1) * ck + j * (j + 1) / 2),
+// where ci, cj and ck are the state before the block. Steps hold (j + 1) and
+// j * (j + 1) / 2 for the even and odd bytes of a block.
+static uint16_t decrypt_even_scale[DECRYPT_MAX_LANES];
+static uint16_t decrypt_even_offset[DECRYPT_MAX_LANES];
+static uint16_t decrypt_odd_scale[DECRYPT_MAX_LANES];
+static uint16_t decrypt_odd_offset[DECRYPT_MAX_LANES];
+
+/******************************************************************
+*
+* \details
+*   Detect the widest kernel variants supported by the processor
+*   and enabled by the operating system.
+*
+* \return
+*   Return the supported level.
+*
+*******************************************************************/
+cpu_level_t cpu_detect(void)
+{
+    cpu_level_t level = CPU_LEVEL_SCALAR;
+    int info[4];
+
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    if (max_leaf >= 1)
+    {
+        __cpuid(info, 1);
+        int features = info[2];
+
+        if (features & CPUID_1_ECX_SSE42)
+        {
+            level = CPU_LEVEL_SSE42;
+
+            // Wider registers are only usable if the operating system saves them
+            uint64_t xcr0 = (features & CPUID_1_ECX_OSXSAVE) ? _xgetbv(0) : 0;
+
+            if ((max_leaf >= 7) && (features & CPUID_1_ECX_AVX) && ((xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE))
+            {
+                __cpuidex(info, 7, 0);
+
+                if (info[1] & CPUID_7_EBX_AVX2)
+                {
+                    level = CPU_LEVEL_AVX2;
+
+                    if ((info[1] & CPUID_7_EBX_AVX512F) && (info[1] & CPUID_7_EBX_AVX512BW) &&
+                        ((xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE))
+                    {
+                        level = CPU_LEVEL_AVX512;
+                    }
+                }
+            }
+        }
+    }
+
+    return level;
+}
+
+/******************************************************************
+*
+* \details
+*   Bind the kernels to the variants of a level. Must be called
+*   before any worker thread is started.
+*
+* \param[in] level : Level to bind. Detected with cpu_detect, or
+*                    a lower level to test the narrower variants.
+*
+* \return
+*   Return false if the processor does not support the level, in
+*   which case the kernels are unchanged.
+*
+*******************************************************************/
+bool cpu_dispatch(cpu_level_t level)
+{
+    bool supported = (level < CPU_LEVEL_COUNT) && (level <= cpu_detect());
+
+    if (supported)
+    {
+        for (uint32_t i = 0; i < DECRYPT_MAX_LANES; ++i)
+        {
+            uint32_t even = 2 * i;
+            uint32_t odd = even + 1;
+
+            decrypt_even_scale[i] = (uint16_t)(even + 1);
+            decrypt_even_offset[i] = (uint16_t)(even * (even + 1) / 2);
+            decrypt_odd_scale[i] = (uint16_t)(odd + 1);
+            decrypt_odd_offset[i] = (uint16_t)(odd * (odd + 1) / 2);
+        }
+
+        cpu_kernels = cpu_variants[level];
+        cpu_selected = level;
+    }
+
+    return supported;
+}
+
+/******************************************************************
+*
+* \details Level the kernels are bound to.
+*
+*******************************************************************/
+cpu_level_t cpu_level(void)
+{
+    return cpu_selected;
+}
+
+/******************************************************************
+*
+* \details Parse a level name (scalar, sse4.2, avx2 or avx512).
+*
+* \return
+*   Return true if the name is valid.
+*
+*******************************************************************/
+bool cpu_parse_level(const char* name, cpu_level_t* level)
+{
+    bool valid = false;
+
+    for (unsigned i = 0; (i < CPU_LEVEL_COUNT) && !valid; ++i)
+    {
+        if (_stricmp(name, cpu_level_names[i]) == 0)
+        {
+            *level = (cpu_level_t)i;
+            valid = true;
+        }
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details Name of a level.
+*
+*******************************************************************/
+const char* cpu_level_name(cpu_level_t level)
+{
+    return (level < CPU_LEVEL_COUNT) ? cpu_level_names[level] : "unknown";
+}
+
+/******************************************************************
+*
+* \details
+*   Nikon lens data decryption. The key stream is generated one
+*   byte at a time.
+*
+*******************************************************************/
+static void decrypt_scalar(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck)
+{
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        cj = (cj + ci * ck) & 0xFF;
+        ck = (ck + 1) & 0xFF;
+        data[i] ^= cj;
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Nikon lens data decryption, 16 bytes at a time. The key stream
+*   of a block is computed in closed form from the state before the
+*   block. Lanes are 16 bit, and only the low byte of each product
+*   is kept, so the arithmetic matches the byte arithmetic of the
+*   scalar variant.
+*
+*******************************************************************/
+static void decrypt_sse42(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck)
+{
+    const __m128i even_scale = _mm_loadu_si128((const __m128i*)decrypt_even_scale);
+    const __m128i even_offset = _mm_loadu_si128((const __m128i*)decrypt_even_offset);
+    const __m128i odd_scale = _mm_loadu_si128((const __m128i*)decrypt_odd_scale);
+    const __m128i odd_offset = _mm_loadu_si128((const __m128i*)decrypt_odd_offset);
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    const __m128i vci = _mm_set1_epi16(ci);
+    uint32_t i = 0;
+
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i))
+    {
+        __m128i vck = _mm_set1_epi16(ck);
+        __m128i vcj = _mm_set1_epi16(cj);
+        __m128i even = _mm_add_epi16(_mm_mullo_epi16(_mm_add_epi16(_mm_mullo_epi16(even_scale, vck), even_offset), vci), vcj);
+        __m128i odd = _mm_add_epi16(_mm_mullo_epi16(_mm_add_epi16(_mm_mullo_epi16(odd_scale, vck), odd_offset), vci), vcj);
+        __m128i key = _mm_or_si128(_mm_and_si128(even, low_byte), _mm_slli_epi16(odd, 8));
+        __m128i block = _mm_loadu_si128((const __m128i*)&data[i]);
+
+        _mm_storeu_si128((__m128i*)&data[i], _mm_xor_si128(block, key));
+        // State after the last byte of the block
+        cj = (uint8_t)(cj + ci * (16 * ck + 120));
+        ck = (uint8_t)(ck + 16);
+    }
+
+    decrypt_scalar(&data[i], size - i, ci, cj, ck);
+}
+
+/******************************************************************
+*
+* \details Nikon lens data decryption, 32 bytes at a time.
+*
+*******************************************************************/
+static void decrypt_avx2(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck)
+{
+    const __m256i even_scale = _mm256_loadu_si256((const __m256i*)decrypt_even_scale);
+    const __m256i even_offset = _mm256_loadu_si256((const __m256i*)decrypt_even_offset);
+    const __m256i odd_scale = _mm256_loadu_si256((const __m256i*)decrypt_odd_scale);
+    const __m256i odd_offset = _mm256_loadu_si256((const __m256i*)decrypt_odd_offset);
+    const __m256i low_byte = _mm256_set1_epi16(0x00FF);
+    const __m256i vci = _mm256_set1_epi16(ci);
+    uint32_t i = 0;
+
+    for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
+    {
+        __m256i vck = _mm256_set1_epi16(ck);
+        __m256i vcj = _mm256_set1_epi16(cj);
+        __m256i even = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_add_epi16(_mm256_mullo_epi16(even_scale, vck), even_offset), vci), vcj);
+        __m256i odd = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_add_epi16(_mm256_mullo_epi16(odd_scale, vck), odd_offset), vci), vcj);
+        __m256i key = _mm256_or_si256(_mm256_and_si256(even, low_byte), _mm256_slli_epi16(odd, 8));
+        __m256i block = _mm256_loadu_si256((const __m256i*)&data[i]);
+
+        _mm256_storeu_si256((__m256i*)&data[i], _mm256_xor_si256(block, key));
+        cj = (uint8_t)(cj + ci * (32 * ck + 496));
+        ck = (uint8_t)(ck + 32);
+    }
+
+    decrypt_scalar(&data[i], size - i, ci, cj, ck);
+}
+
+/******************************************************************
+*
+* \details Nikon lens data decryption, 64 bytes at a time.
+*
+*******************************************************************/
+static void decrypt_avx512(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck)
+{
+    const __m512i even_scale = _mm512_loadu_si512(decrypt_even_scale);
+    const __m512i even_offset = _mm512_loadu_si512(decrypt_even_offset);
+    const __m512i odd_scale = _mm512_loadu_si512(decrypt_odd_scale);
+    const __m512i odd_offset = _mm512_loadu_si512(decrypt_odd_offset);
+    const __m512i low_byte = _mm512_set1_epi16(0x00FF);
+    const __m512i vci = _mm512_set1_epi16(ci);
+    uint32_t i = 0;
+
+    for (; i + sizeof(__m512i) <= size; i += sizeof(__m512i))
+    {
+        __m512i vck = _mm512_set1_epi16(ck);
+        __m512i vcj = _mm512_set1_epi16(cj);
+        __m512i even = _mm512_add_epi16(_mm512_mullo_epi16(_mm512_add_epi16(_mm512_mullo_epi16(even_scale, vck), even_offset), vci), vcj);
+        __m512i odd = _mm512_add_epi16(_mm512_mullo_epi16(_mm512_add_epi16(_mm512_mullo_epi16(odd_scale, vck), odd_offset), vci), vcj);
+        __m512i key = _mm512_or_si512(_mm512_and_si512(even, low_byte), _mm512_slli_epi16(odd, 8));
+        __m512i block = _mm512_loadu_si512(&data[i]);
+
+        _mm512_storeu_si512(&data[i], _mm512_xor_si512(block, key));
+        cj = (uint8_t)(cj + ci * (64 * ck + 2016));
+        ck = (uint8_t)(ck + 64);
+    }
+
+    decrypt_scalar(&data[i], size - i, ci, cj, ck);
+}
+
+/******************************************************************
+*
+* \details Find the first occurrence of needle in [begin, end).
+*
+*******************************************************************/
+static const char* find_scalar(const char* begin, const char* end, const char* needle, size_t length)
+{
+    const char* match = NULL;
+
+    while ((NULL == match) && (length > 0) && (begin + length <= end))
+    {
+        const char* candidate = memchr(begin, needle[0], (end - begin) - length + 1);
+
+        if (NULL == candidate)
+        {
+            break;
+        }
+        else if (memcmp(candidate, needle, length) == 0)
+        {
+            match = candidate;
+        }
+        else
+        {
+            begin = candidate + 1;
+        }
+    }
+
+    return match;
+}
+
+/******************************************************************
+*
+* \details
+*   Find the first occurrence of needle in [begin, end), matching
+*   up to 16 bytes of the needle per block with PCMPESTRI. A match
+*   that runs past the end of a block is retried from its start.
+*
+*******************************************************************/
+static const char* find_sse42(const char* begin, const char* end, const char* needle, size_t length)
+{
+    const char* match = NULL;
+    int prefix = (int)((length < sizeof(__m128i)) ? length : sizeof(__m128i));
+    char pattern[sizeof(__m128i)] = { 0 };
+
+    if (length > 0)
+    {
+        memcpy(pattern, needle, prefix);
+        const __m128i vpattern = _mm_loadu_si128((const __m128i*)pattern);
+
+        while ((NULL == match) && (begin + sizeof(__m128i) <= end))
+        {
+            __m128i block = _mm_loadu_si128((const __m128i*)begin);
+            int index = _mm_cmpestri(vpattern, prefix, block, sizeof(__m128i),
+                                     _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED | _SIDD_LEAST_SIGNIFICANT);
+
+            if (index == sizeof(__m128i))
+            {
+                begin += sizeof(__m128i);
+            }
+            else if (index + prefix > (int)sizeof(__m128i))
+            {
+                // Partial match at the end of the block
+                begin += index;
+            }
+            else if ((begin + index + length <= end) && (memcmp(begin + index, needle, length) == 0))
+            {
+                match = begin + index;
+            }
+            else
+            {
+                begin += index + 1;
+            }
+        }
+
+        match = (NULL != match) ? match : find_scalar(begin, end, needle, length);
+    }
+
+    return match;
+}
+
+/******************************************************************
+*
+* \details
+*   Find the first occurrence of needle in [begin, end), 32
+*   candidates at a time. Candidates must match the first and last
+*   byte of the needle before the whole needle is compared.
+*
+*******************************************************************/
+static const char* find_avx2(const char* begin, const char* end, const char* needle, size_t length)
+{
+    const char* match = NULL;
+
+    if (length > 0)
+    {
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[length - 1]);
+
+        while ((NULL == match) && (begin + length - 1 + sizeof(__m256i) <= end))
+        {
+            __m256i head = _mm256_loadu_si256((const __m256i*)begin);
+            __m256i tail = _mm256_loadu_si256((const __m256i*)(begin + length - 1));
+            uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+
+            while ((NULL == match) && (mask != 0))
+            {
+                unsigned long bit;
+
+                _BitScanForward(&bit, mask);
+                match = (memcmp(begin + bit, needle, length) == 0) ? begin + bit : NULL;
+                mask &= mask - 1;
+            }
+
+            begin += (NULL == match) ? sizeof(__m256i) : 0;
+        }
+
+        match = (NULL != match) ? match : find_scalar(begin, end, needle, length);
+    }
+
+    return match;
+}
+
+/******************************************************************
+*
+* \details
+*   Find the first occurrence of needle in [begin, end), 64
+*   candidates at a time.
+*
+*******************************************************************/
+static const char* find_avx512(const char* begin, const char* end, const char* needle, size_t length)
+{
+    const char* match = NULL;
+
+    if (length > 0)
+    {
+        const __m512i first = _mm512_set1_epi8(needle[0]);
+        const __m512i last = _mm512_set1_epi8(needle[length - 1]);
+
+        while ((NULL == match) && (begin + length - 1 + sizeof(__m512i) <= end))
+        {
+            __m512i head = _mm512_loadu_si512(begin);
+            __m512i tail = _mm512_loadu_si512(begin + length - 1);
+            __mmask64 candidates = _mm512_cmpeq_epi8_mask(head, first) & _mm512_cmpeq_epi8_mask(tail, last);
+            // Scanned as two halves, as 32 bit builds have no 64 bit bit scan
+            uint32_t masks[2] = { (uint32_t)candidates, (uint32_t)(candidates >> 32) };
+
+            for (unsigned half = 0; (half < 2) && (NULL == match); ++half)
+            {
+                while ((NULL == match) && (masks[half] != 0))
+                {
+                    unsigned long bit;
+
+                    _BitScanForward(&bit, masks[half]);
+                    bit += half * 32;
+                    match = (memcmp(begin + bit, needle, length) == 0) ? begin + bit : NULL;
+                    masks[half] &= masks[half] - 1;
+                }
+            }
+
+            begin += (NULL == match) ? sizeof(__m512i) : 0;
+        }
+
+        match = (NULL != match) ? match : find_scalar(begin, end, needle, length);
+    }
+
+    return match;
+}
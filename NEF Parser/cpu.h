@@ -0,0 +1,64 @@
+/**************************************************************//**
+*
+* \file cpu.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Runtime CPU feature dispatch of the hot kernels. Features are
+*   detected once at startup and each kernel is bound to the widest
+*   variant the processor supports, so a single binary runs on
+*   every host.
+*
+*******************************************************************/
+
+#ifndef CPU_H_
+#define CPU_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Kernel variants, ordered by width
+typedef enum
+{
+    CPU_LEVEL_SCALAR = 0,
+    CPU_LEVEL_SSE42,
+    CPU_LEVEL_AVX2,
+    CPU_LEVEL_AVX512,   // AVX-512 F and BW
+    CPU_LEVEL_COUNT
+} cpu_level_t;
+
+typedef struct
+{
+    // XOR data with the Nikon lens data key stream. ci, cj and ck are
+    // the key stream state before the first byte.
+    void (*decrypt)(uint8_t* data, uint32_t size, uint8_t ci, uint8_t cj, uint8_t ck);
+    // First occurrence of needle in [begin, end), or NULL if not found.
+    const char* (*find)(const char* begin, const char* end, const char* needle, size_t length);
+} cpu_kernels_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Bound to the scalar variants until cpu_dispatch is called
+extern cpu_kernels_t cpu_kernels;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+cpu_level_t cpu_detect(void);
+bool cpu_dispatch(cpu_level_t level);
+cpu_level_t cpu_level(void);
+bool cpu_parse_level(const char* name, cpu_level_t* level);
+const char* cpu_level_name(cpu_level_t level);
+
+#endif /* end cpu.h */
@@ -0,0 +1,451 @@
+/**************************************************************//**
+*
+* \file database.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	SQLite export of parsed records. The batch worker threads queue
+*   their records and a single writer thread inserts them with a
+*   prepared statement, committing one transaction per batch of
+*   records. The database uses write-ahead logging, so each
+*   commit is a sequential append to the log.
+*
+*   SQLite is loaded at run time (sqlite3.dll), so the export is
+*   only unavailable, rather than the application, when the
+*   library is missing. See https://www.sqlite.org/c3ref/intro.html.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "database.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SQLITE_OK       0
+#define SQLITE_DONE     101
+#define SQLITE_STATIC   ((void (*)(void*))0)
+
+// Maximum number of records inserted per writer thread wakeup
+#define DATABASE_WRITE_BATCH 256
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct sqlite3 sqlite3;
+typedef struct sqlite3_stmt sqlite3_stmt;
+
+// SQLite functions used by the export
+typedef struct
+{
+    int (*open)(const char* filename, sqlite3** database);
+    int (*close)(sqlite3* database);
+    int (*exec)(sqlite3* database, const char* sql, void* callback, void* context, char** error);
+    int (*prepare_v2)(sqlite3* database, const char* sql, int size, sqlite3_stmt** statement, const char** tail);
+    int (*bind_text)(sqlite3_stmt* statement, int index, const char* value, int size, void (*destructor)(void*));
+    int (*bind_int64)(sqlite3_stmt* statement, int index, int64_t value);
+    int (*bind_double)(sqlite3_stmt* statement, int index, double value);
+    int (*bind_null)(sqlite3_stmt* statement, int index);
+    int (*step)(sqlite3_stmt* statement);
+    int (*reset)(sqlite3_stmt* statement);
+    int (*finalize)(sqlite3_stmt* statement);
+    int (*get_autocommit)(sqlite3* database);
+    const char* (*errmsg)(sqlite3* database);
+    void (*free)(void* data);
+} sqlite_api_t;
+
+// Insert statement parameters
+enum
+{
+    COLUMN_PATH = 1,
+    COLUMN_MODEL,
+    COLUMN_SERIAL_NUMBER,
+    COLUMN_LENS,
+    COLUMN_SHUTTER_COUNT,
+    COLUMN_DATE_TIME_ORIGINAL,
+    COLUMN_EXPOSURE_TIME,
+    COLUMN_FNUMBER,
+    COLUMN_ISO,
+    COLUMN_FOCAL_LENGTH,
+    COLUMN_LATITUDE,
+    COLUMN_LONGITUDE,
+    COLUMN_ALTITUDE,
+    COLUMN_RATING
+};
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const char database_schema[] =
+    "PRAGMA journal_mode=WAL;"
+    "PRAGMA synchronous=NORMAL;"
+    "CREATE TABLE IF NOT EXISTS images ("
+    " path TEXT PRIMARY KEY,"
+    " model TEXT,"
+    " serial_number TEXT,"
+    " lens TEXT,"
+    " shutter_count INTEGER,"
+    " date_time_original TEXT,"
+    " exposure_time REAL,"
+    " fnumber REAL,"
+    " iso INTEGER,"
+    " focal_length REAL,"
+    " latitude REAL,"
+    " longitude REAL,"
+    " altitude REAL,"
+    " rating INTEGER);";
+
+static const char database_insert[] =
+    "INSERT OR REPLACE INTO images VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+
+static sqlite_api_t sqlite;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool load_sqlite(HMODULE library);
+static bool execute(database_writer_t* writer, const char* sql);
+static bool insert(database_writer_t* writer, const nef_record_t* record);
+static void commit(database_writer_t* writer, LONG inserted);
+static DWORD WINAPI database_writer_thread(LPVOID parameter);
+
+/******************************************************************
+*
+* \details Resolve the SQLite functions used by the export.
+*
+* \return
+*   Return true if every function was found.
+*
+*******************************************************************/
+static bool load_sqlite(HMODULE library)
+{
+    bool success = true;
+    const struct { const char* name; void** function; } functions[] = {
+        { "sqlite3_open",        (void**)&sqlite.open },
+        { "sqlite3_close",       (void**)&sqlite.close },
+        { "sqlite3_exec",        (void**)&sqlite.exec },
+        { "sqlite3_prepare_v2",  (void**)&sqlite.prepare_v2 },
+        { "sqlite3_bind_text",   (void**)&sqlite.bind_text },
+        { "sqlite3_bind_int64",  (void**)&sqlite.bind_int64 },
+        { "sqlite3_bind_double", (void**)&sqlite.bind_double },
+        { "sqlite3_bind_null",   (void**)&sqlite.bind_null },
+        { "sqlite3_step",        (void**)&sqlite.step },
+        { "sqlite3_reset",       (void**)&sqlite.reset },
+        { "sqlite3_finalize",    (void**)&sqlite.finalize },
+        { "sqlite3_get_autocommit", (void**)&sqlite.get_autocommit },
+        { "sqlite3_errmsg",      (void**)&sqlite.errmsg },
+        { "sqlite3_free",        (void**)&sqlite.free },
+    };
+
+    for (unsigned i = 0; success && (i < sizeof(functions) / sizeof(functions[0])); ++i)
+    {
+        *functions[i].function = (void*)GetProcAddress(library, functions[i].name);
+
+        if (NULL == *functions[i].function)
+        {
+            fprintf(stderr, "Error: %s not found in %s.\n", functions[i].name, DATABASE_LIBRARY);
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Execute SQL statements without results.
+*
+*******************************************************************/
+static bool execute(database_writer_t* writer, const char* sql)
+{
+    char* error = NULL;
+    bool success = (sqlite.exec((sqlite3*)writer->database, sql, NULL, NULL, &error) == SQLITE_OK);
+
+    if (!success)
+    {
+        fprintf(stderr, "Error: SQLite: %s\n", (NULL != error) ? error : "Unknown error.");
+        sqlite.free(error);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Insert a record with the prepared statement.
+*
+* \return
+*   Return true if the record was inserted.
+*
+*******************************************************************/
+static bool insert(database_writer_t* writer, const nef_record_t* record)
+{
+    sqlite3_stmt* statement = (sqlite3_stmt*)writer->insert;
+    const image_data_t* image = &record->image;
+    const camera_data_t* camera = &record->camera;
+
+    // Record strings outlive the statement step, so they are not copied
+    sqlite.bind_text(statement, COLUMN_PATH, record->path, -1, SQLITE_STATIC);
+    sqlite.bind_text(statement, COLUMN_MODEL, camera->model, -1, SQLITE_STATIC);
+    sqlite.bind_text(statement, COLUMN_SERIAL_NUMBER, camera->serial_number, -1, SQLITE_STATIC);
+    sqlite.bind_text(statement, COLUMN_LENS, camera->lens, -1, SQLITE_STATIC);
+    sqlite.bind_int64(statement, COLUMN_SHUTTER_COUNT, image->shutter_count);
+    sqlite.bind_text(statement, COLUMN_DATE_TIME_ORIGINAL, image->timestamp, -1, SQLITE_STATIC);
+    sqlite.bind_double(statement, COLUMN_EXPOSURE_TIME, image->shutter_speed);
+    sqlite.bind_double(statement, COLUMN_FNUMBER, image->aperature);
+    sqlite.bind_int64(statement, COLUMN_ISO, image->iso);
+    sqlite.bind_double(statement, COLUMN_FOCAL_LENGTH, image->focal_length);
+
+    if (record->gps.valid)
+    {
+        sqlite.bind_double(statement, COLUMN_LATITUDE, record->gps.latitude);
+        sqlite.bind_double(statement, COLUMN_LONGITUDE, record->gps.longitude);
+        sqlite.bind_double(statement, COLUMN_ALTITUDE, record->gps.altitude);
+    }
+    else
+    {
+        sqlite.bind_null(statement, COLUMN_LATITUDE);
+        sqlite.bind_null(statement, COLUMN_LONGITUDE);
+        sqlite.bind_null(statement, COLUMN_ALTITUDE);
+    }
+
+    if (record->xmp.present && (XMP_RATING_NONE != record->xmp.rating))
+    {
+        sqlite.bind_int64(statement, COLUMN_RATING, record->xmp.rating);
+    }
+    else
+    {
+        sqlite.bind_null(statement, COLUMN_RATING);
+    }
+
+    bool success = (sqlite.step(statement) == SQLITE_DONE);
+
+    if (!success)
+    {
+        fprintf(stderr, "Error: SQLite: %s: %s\n", record->path, sqlite.errmsg((sqlite3*)writer->database));
+    }
+
+    sqlite.reset(statement);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Commit the open transaction. If the commit fails, the
+*   transaction is rolled back and its records are counted as
+*   failed instead of inserted.
+*
+* \param[in] writer   : Database writer.
+* \param[in] inserted : Records inserted in the transaction.
+*
+* \return None
+*
+*******************************************************************/
+static void commit(database_writer_t* writer, LONG inserted)
+{
+    if (!execute(writer, "COMMIT;"))
+    {
+        // SQLite may already have rolled the transaction back (e.g. on a full disk)
+        if (!sqlite.get_autocommit((sqlite3*)writer->database))
+        {
+            execute(writer, "ROLLBACK;");
+        }
+
+        InterlockedAdd(&writer->inserted, -inserted);
+        InterlockedAdd(&writer->failed, inserted);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Writer thread. Records are inserted inside a transaction that
+*   is committed every batch_size records and when the queue is
+*   closed.
+*
+*******************************************************************/
+static DWORD WINAPI database_writer_thread(LPVOID parameter)
+{
+    database_writer_t* writer = (database_writer_t*)parameter;
+    void* records[DATABASE_WRITE_BATCH];
+    uint32_t count = 0;
+    uint32_t pending = 0;
+    LONG inserted = 0;      // Records inserted in the open transaction
+
+    while ((count = queue_pop_batch(&writer->queue, records, DATABASE_WRITE_BATCH)) > 0)
+    {
+        if ((pending == 0) && !execute(writer, "BEGIN;"))
+        {
+            InterlockedAdd(&writer->failed, count);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (insert(writer, (nef_record_t*)records[i]))
+            {
+                InterlockedIncrement(&writer->inserted);
+                inserted++;
+            }
+            else
+            {
+                InterlockedIncrement(&writer->failed);
+            }
+        }
+
+        pending += count;
+
+        if (pending >= writer->batch_size)
+        {
+            commit(writer, inserted);
+            pending = 0;
+            inserted = 0;
+        }
+    }
+
+    if (pending > 0)
+    {
+        commit(writer, inserted);
+    }
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details Open the database and start the writer thread.
+*
+* \param[out] writer    : Database writer.
+* \param[in] path       : Database file. Created if it does not exist.
+* \param[in] batch_size : Records inserted per transaction.
+*
+* \return
+*   Return true if the writer was started.
+*
+*******************************************************************/
+bool database_writer_start(database_writer_t* writer, const char* path, uint32_t batch_size)
+{
+    bool success = false;
+    sqlite3* database = NULL;
+    sqlite3_stmt* statement = NULL;
+
+    memset(writer, 0, sizeof(database_writer_t));
+    writer->batch_size = (batch_size > 0) ? batch_size : DATABASE_DEFAULT_BATCH_SIZE;
+    writer->library = LoadLibraryA(DATABASE_LIBRARY);
+
+    if (NULL == writer->library)
+    {
+        fprintf(stderr, "Error: Unable to load %s.\n", DATABASE_LIBRARY);
+    }
+    else if (load_sqlite(writer->library))
+    {
+        if (sqlite.open(path, &database) != SQLITE_OK)
+        {
+            fprintf(stderr, "Error: Unable to open database %s: %s\n", path, sqlite.errmsg(database));
+        }
+
+        writer->database = database;
+
+        if ((NULL != database) && execute(writer, database_schema))
+        {
+            if (sqlite.prepare_v2(database, database_insert, -1, &statement, NULL) == SQLITE_OK)
+            {
+                writer->insert = statement;
+                success = queue_init(&writer->queue, DATABASE_QUEUE_CAPACITY);
+            }
+            else
+            {
+                fprintf(stderr, "Error: SQLite: %s\n", sqlite.errmsg(database));
+            }
+        }
+    }
+
+    if (success)
+    {
+        writer->thread = CreateThread(NULL, 0, database_writer_thread, writer, 0, NULL);
+
+        if (NULL == writer->thread)
+        {
+            queue_free(&writer->queue);
+            success = false;
+        }
+    }
+
+    if (!success)
+    {
+        database_writer_stop(writer);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Queue a record for insertion. Called from the batch worker
+*   threads. The record must remain valid until the writer is
+*   stopped.
+*
+* \param[in] writer : Database writer.
+* \param[in] record : Parsed record.
+*
+* \return None
+*
+*******************************************************************/
+void database_writer_submit(database_writer_t* writer, nef_record_t* record)
+{
+    if (record->valid && !queue_push(&writer->queue, record))
+    {
+        InterlockedIncrement(&writer->failed);
+    }
+}
+
+/******************************************************************
+*
+* \details Insert the remaining records, stop the writer thread and
+*          close the database.
+*
+* \param[in] writer : Database writer.
+*
+* \return None
+*
+*******************************************************************/
+void database_writer_stop(database_writer_t* writer)
+{
+    if (NULL != writer->thread)
+    {
+        queue_close(&writer->queue);
+        WaitForSingleObject(writer->thread, INFINITE);
+        CloseHandle(writer->thread);
+        writer->thread = NULL;
+        queue_free(&writer->queue);
+    }
+
+    if (NULL != writer->insert)
+    {
+        sqlite.finalize((sqlite3_stmt*)writer->insert);
+        writer->insert = NULL;
+    }
+
+    if (NULL != writer->database)
+    {
+        sqlite.close((sqlite3*)writer->database);
+        writer->database = NULL;
+    }
+
+    if (NULL != writer->library)
+    {
+        FreeLibrary(writer->library);
+        writer->library = NULL;
+    }
+}
@@ -0,0 +1,56 @@
+/**************************************************************//**
+*
+* \file database.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	SQLite export of parsed records.
+*
+*******************************************************************/
+
+#ifndef DATABASE_H_
+#define DATABASE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "queue.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define DATABASE_LIBRARY            "sqlite3.dll"
+#define DATABASE_QUEUE_CAPACITY     4096
+// Default number of records inserted per transaction
+#define DATABASE_DEFAULT_BATCH_SIZE 10000
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    queue_t queue;          // Records waiting to be inserted
+    HANDLE thread;          // Writer thread
+    uint32_t batch_size;    // Records per transaction
+    HMODULE library;        // SQLite library
+    void* database;         // sqlite3 connection
+    void* insert;           // Prepared insert statement
+    volatile LONG inserted; // Number of records inserted
+    volatile LONG failed;   // Number of records that could not be inserted
+} database_writer_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool database_writer_start(database_writer_t* writer, const char* path, uint32_t batch_size);
+void database_writer_submit(database_writer_t* writer, nef_record_t* record);
+void database_writer_stop(database_writer_t* writer);
+
+#endif /* end database.h */
@@ -0,0 +1,224 @@
+/**************************************************************//**
+*
+* \file error.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Structured parse errors. Reporting an error only fills a fixed
+*   slot in the record of the file, so the parse path does no
+*   formatting or allocation. Messages are formatted after the
+*   batch, and the errors of the batch are counted by kind.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <string.h>
+#include "error.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define ERROR_NAME_WIDTH 18
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Names reported to monitoring
+static const char* error_names[NEF_ERROR_COUNT] = {
+    "none",
+    "unsupported_type",
+    "open",
+    "read",
+    "invalid_header",
+    "invalid_makernote",
+    "value_range",
+    "entry_type",
+    "invalid_xmp",
+    "ifd_cycle",
+    "ifd_limit",
+    "entry_limit",
+    "byte_limit",
+    "deadline",
+    "worker_crash",
+    "quarantined",
+    "fingerprint",
+    "raw_range",
+    "invalid_value",
+};
+
+static const char* error_messages[NEF_ERROR_COUNT] = {
+    "No error",
+    "Unsupported file type",
+    "Failed to open",
+    "Failed to read",
+    "Invalid raw file header",
+    "Invalid Makernote",
+    "Value exceeds file size",
+    "Unexpected entry type",
+    "Invalid XMP packet",
+    "IFD already visited",
+    "IFD limit exceeded",
+    "Entry limit exceeded",
+    "Byte limit exceeded",
+    "Deadline exceeded",
+    "Worker process crashed",
+    "Skipped quarantined file",
+    "Fingerprint mismatch",
+    "Raw image data not found",
+    "Invalid value",
+};
+
+static const char* ifd_names[NEF_IFD_COUNT] = {
+    "",
+    "IFD0",
+    "Sub-IFD",
+    "EXIF",
+    "GPS",
+    "Makernote",
+};
+
+/******************************************************************
+*
+* \details Report an error of the file being parsed.
+*
+* \param[in,out] list : Errors of the file.
+* \param[in] code     : Error kind.
+* \param[in] ifd      : IFD being parsed.
+* \param[in] tag      : Tag being parsed (0 = none).
+* \param[in] offset   : Offset within the file.
+* \param[in] value    : Code specific detail.
+*
+* \return None
+*
+*******************************************************************/
+void nef_error_report(nef_error_list_t* list, nef_error_code_t code, nef_ifd_t ifd, uint16_t tag, uint32_t offset, uint32_t value)
+{
+    if ((code > NEF_ERROR_NONE) && (code < NEF_ERROR_COUNT))
+    {
+        if (list->counts[code] < UINT16_MAX)
+        {
+            list->counts[code]++;
+        }
+
+        if (list->count < NEF_MAX_ERRORS)
+        {
+            nef_error_t* error = &list->entries[list->count++];
+            error->code = (uint8_t)code;
+            error->ifd = (uint8_t)ifd;
+            error->tag = tag;
+            error->offset = offset;
+            error->value = value;
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Name of an error kind, as reported to monitoring.
+*
+*******************************************************************/
+const char* nef_error_name(nef_error_code_t code)
+{
+    return (code < NEF_ERROR_COUNT) ? error_names[code] : "unknown";
+}
+
+/******************************************************************
+*
+* \details Display the errors of a file.
+*
+* \param[in] stream : Output stream.
+* \param[in] path   : Path of the file.
+* \param[in] list   : Errors of the file.
+*
+* \return None
+*
+*******************************************************************/
+void nef_error_print(FILE* stream, const char* path, const nef_error_list_t* list)
+{
+    uint32_t total = 0;
+
+    for (unsigned i = 0; i < list->count; ++i)
+    {
+        const nef_error_t* error = &list->entries[i];
+
+        fprintf(stream, "Error: %s in %s", error_messages[error->code], path);
+
+        if (error->ifd != NEF_IFD_NONE)
+        {
+            fprintf(stream, " (%s IFD, tag 0x%04X, offset 0x%08X", ifd_names[error->ifd], error->tag, error->offset);
+
+            if (error->value != 0)
+            {
+                fprintf(stream, ", %u", error->value);
+            }
+
+            fprintf(stream, ")");
+        }
+        else if (error->value != 0)
+        {
+            fprintf(stream, " (%u)", error->value);
+        }
+
+        fprintf(stream, ".\n");
+    }
+
+    for (unsigned i = 0; i < NEF_ERROR_COUNT; ++i)
+    {
+        total += list->counts[i];
+    }
+
+    if (total > list->count)
+    {
+        fprintf(stream, "Error: %u more errors in %s.\n", total - list->count, path);
+    }
+}
+
+/******************************************************************
+*
+* \details Add the errors of a file to the errors of a batch.
+*
+* \param[in,out] summary : Errors of the batch.
+* \param[in] list        : Errors of the file.
+*
+* \return None
+*
+*******************************************************************/
+void nef_error_summarize(nef_error_summary_t* summary, const nef_error_list_t* list)
+{
+    bool failed = false;
+
+    for (unsigned i = 0; i < NEF_ERROR_COUNT; ++i)
+    {
+        summary->counts[i] += list->counts[i];
+        failed = failed || (list->counts[i] > 0);
+    }
+
+    summary->files += failed ? 1 : 0;
+}
+
+/******************************************************************
+*
+* \details Display the error counts of a batch by kind.
+*
+* \param[in] summary : Errors of the batch.
+*
+* \return None
+*
+*******************************************************************/
+void nef_error_print_summary(const nef_error_summary_t* summary)
+{
+    printf("%-*s| %u\n", ERROR_NAME_WIDTH, "Files With Errors", summary->files);
+
+    for (unsigned i = 1; i < NEF_ERROR_COUNT; ++i)
+    {
+        if (summary->counts[i] > 0)
+        {
+            printf("%-*s| %u\n", ERROR_NAME_WIDTH, error_names[i], summary->counts[i]);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/**************************************************************//**
+*
+* \file error.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Structured parse errors. Errors are stored in the record of the
+*   file without allocation and formatted after the batch.
+*
+*******************************************************************/
+
+#ifndef ERROR_H_
+#define ERROR_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define NEF_MAX_ERRORS 8 // Errors kept per file. Further errors are only counted.
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Error kinds. Append only, the values are reported to monitoring.
+typedef enum
+{
+    NEF_ERROR_NONE = 0,
+    NEF_ERROR_UNSUPPORTED_TYPE,     // File extension is not supported
+    NEF_ERROR_OPEN,                 // File could not be opened
+    NEF_ERROR_READ,                 // File could not be read
+    NEF_ERROR_INVALID_HEADER,       // Not a TIFF based raw file
+    NEF_ERROR_INVALID_MAKERNOTE,    // Nikon Makernote missing or invalid
+    NEF_ERROR_VALUE_RANGE,          // Value lies outside the file
+    NEF_ERROR_ENTRY_TYPE,           // Entry has an unexpected type or count
+    NEF_ERROR_INVALID_XMP,          // XMP packet is invalid
+    NEF_ERROR_IFD_CYCLE,            // IFD was already visited
+    NEF_ERROR_IFD_LIMIT,            // Too many IFDs
+    NEF_ERROR_ENTRY_LIMIT,          // Too many entries in an IFD
+    NEF_ERROR_BYTE_LIMIT,           // Too many bytes read
+    NEF_ERROR_DEADLINE,             // Parse took too long
+    NEF_ERROR_WORKER_CRASH,         // Worker process died parsing the file
+    NEF_ERROR_QUARANTINED,          // File crashed a worker in an earlier run
+    NEF_ERROR_FINGERPRINT,          // File no longer matches its scrub fingerprint
+    NEF_ERROR_RAW_RANGE,            // Raw image data not found within the file
+    NEF_ERROR_INVALID_VALUE,        // Value cannot be represented (e.g. zero denominator)
+    NEF_ERROR_COUNT
+} nef_error_code_t;
+
+// IFD being parsed when an error occurred
+typedef enum
+{
+    NEF_IFD_NONE = 0,
+    NEF_IFD_0,
+    NEF_IFD_SUB,
+    NEF_IFD_EXIF,
+    NEF_IFD_GPS,
+    NEF_IFD_MAKERNOTE,
+    NEF_IFD_COUNT
+} nef_ifd_t;
+
+typedef struct
+{
+    uint8_t code;       // nef_error_code_t
+    uint8_t ifd;        // nef_ifd_t
+    uint16_t tag;       // Tag being parsed (0 = none)
+    uint32_t offset;    // Offset within the file
+    uint32_t value;     // Code specific detail (limit, entry count)
+} nef_error_t;
+
+typedef struct
+{
+    nef_error_t entries[NEF_MAX_ERRORS];
+    uint8_t count;                          // Errors stored
+    uint16_t counts[NEF_ERROR_COUNT];       // Errors reported by kind, including those not stored
+} nef_error_list_t;
+
+// Error counts of a batch
+typedef struct
+{
+    uint32_t counts[NEF_ERROR_COUNT];
+    uint32_t files;     // Files with at least one error
+} nef_error_summary_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+void nef_error_report(nef_error_list_t* list, nef_error_code_t code, nef_ifd_t ifd, uint16_t tag, uint32_t offset, uint32_t value);
+const char* nef_error_name(nef_error_code_t code);
+void nef_error_print(FILE* stream, const char* path, const nef_error_list_t* list);
+void nef_error_summarize(nef_error_summary_t* summary, const nef_error_list_t* list);
+void nef_error_print_summary(const nef_error_summary_t* summary);
+
+#endif /* end error.h */
@@ -15,9 +15,19 @@
 #ifndef EXIF_H_
 #define EXIF_H_
 
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "tiff.h"
+
 /******************************************************************
                         Defines
 *******************************************************************/
+#define GPS_LATITUDE_SOUTH  'S'
+#define GPS_LONGITUDE_WEST  'W'
+#define GPS_ALTITUDE_BELOW  1
 
 /******************************************************************
                         Typdefs
@@ -52,16 +62,52 @@ typedef enum
     EXIF_TAG_MAX_SAMPLE_VALUE           = 0x0119,
     EXIF_TAG_X_RESOLUTION               = 0x011A,
     EXIF_TAG_Y_RESOLUTION               = 0x011B,
+    EXIF_TAG_DATE_TIME                  = 0x0132,
+    EXIF_TAG_ARTIST                     = 0x013B,
+    EXIF_TAG_TILE_OFFSETS               = 0x0144,
+    EXIF_TAG_TILE_BYTE_COUNTS           = 0x0145,
     EXIF_TAG_SUBIFD_OFFSET              = 0x014A,
+    EXIF_TAG_XMP                        = 0x02BC,
     EXIF_TAG_EXPOSURE_TIME              = 0x829A,
+    EXIF_TAG_COPYRIGHT                  = 0x8298,
     EXIF_TAG_FNUMBER                    = 0x829D,
     EXIF_TAG_EXIF_OFFSET                = 0x8769,
+    EXIF_TAG_GPS_OFFSET                 = 0x8825,
+    EXIF_TAG_ISO                        = 0x8827,
     EXIF_TAG_DATE_TIME_ORIGINAL         = 0x9003,
+    EXIF_TAG_CREATE_DATE                = 0x9004,
     EXIF_TAG_SHUTTER_SPEED              = 0x9201,
     EXIF_TAG_APERTURE                   = 0x9202,
     EXIF_TAG_METERING_MODE              = 0x9207,
     EXIF_TAG_FOCAL_LENGTH               = 0x920A,
-    EXIF_TAG_MAKERNOTE                  = 0x927C
+    EXIF_TAG_MAKERNOTE                  = 0x927C,
+    EXIF_TAG_BODY_SERIAL_NUMBER         = 0xA431,
+    EXIF_TAG_LENS_MODEL                 = 0xA434
 } exif_tag_t;
 
+// GPS Tag Identifiers
+// See https://exiftool.org/TagNames/GPS.html
+typedef enum
+{
+    GPS_TAG_VERSION_ID                  = 0x0000,
+    GPS_TAG_LATITUDE_REF                = 0x0001,
+    GPS_TAG_LATITUDE                    = 0x0002,
+    GPS_TAG_LONGITUDE_REF               = 0x0003,
+    GPS_TAG_LONGITUDE                   = 0x0004,
+    GPS_TAG_ALTITUDE_REF                = 0x0005,
+    GPS_TAG_ALTITUDE                    = 0x0006,
+    GPS_TAG_TIME_STAMP                  = 0x0007,
+    GPS_TAG_DATE_STAMP                  = 0x001D
+} gps_tag_t;
+
+// Information describing the capture location
+typedef struct
+{
+    bool valid;                           // Latitude and longitude are present
+    double latitude;                      // Degrees, negative south of the equator
+    double longitude;                     // Degrees, negative west of the prime meridian
+    double altitude;                      // Meters, negative below sea level
+    char timestamp[TIFF_DATE_TIME_LENGTH]; // UTC "YYYY:MM:DD HH:MM:SS"
+} gps_data_t;
+
 #endif
@@ -0,0 +1,354 @@
+/**************************************************************//**
+*
+* \file gps_index.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Grid based spatial index over batch results. Each record with
+*   a valid position is keyed by its grid cell and the keys are
+*   sorted, so the cells of one latitude row are contiguous and a
+*   radius query is a binary search per overlapping row. The
+*   index pays for itself once several queries share it; a single
+*   query scans the records instead.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdlib.h>
+#include <math.h>
+#include "gps_index.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define GPS_LATITUDE_CELLS   ((uint32_t)(180.0 / GPS_INDEX_CELL_DEGREES))
+#define GPS_LONGITUDE_CELLS  ((uint32_t)(360.0 / GPS_INDEX_CELL_DEGREES))
+#define DEGREES_TO_RADIANS(x) ((x) * 3.14159265358979323846 / 180.0)
+
+/******************************************************************
+                        Macros
+*******************************************************************/
+#define GPS_CELL_KEY(row, column) (((uint64_t)(row) << 32) | (uint32_t)(column))
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static uint32_t latitude_cell(double latitude);
+static uint32_t longitude_cell(double longitude);
+static int compare_entries(const void* a, const void* b);
+static uint32_t lower_bound(const gps_index_t* index, uint64_t key);
+static uint32_t query_cells(const gps_index_t* index, uint32_t row, uint32_t first_column, uint32_t last_column,
+                            double latitude, double longitude, double radius_km,
+                            gps_index_callback_t callback, void* context);
+
+/******************************************************************
+*
+* \details Helper functions to map a coordinate to its grid cell.
+*
+* \param[in] latitude/longitude : Coordinate in degrees.
+* \param[out] None
+*
+* \return
+*   Return the grid cell row or column.
+*
+*******************************************************************/
+static uint32_t latitude_cell(double latitude)
+{
+    double row = (latitude + 90.0) / GPS_INDEX_CELL_DEGREES;
+
+    // Clamped before the conversion, so out of range (or NaN) positions land in an edge cell
+    if (!(row > 0.0))
+    {
+        return 0;
+    }
+
+    return (row < GPS_LATITUDE_CELLS) ? (uint32_t)row : GPS_LATITUDE_CELLS - 1;
+}
+
+static uint32_t longitude_cell(double longitude)
+{
+    double column = (longitude + 180.0) / GPS_INDEX_CELL_DEGREES;
+
+    if (!(column > 0.0))
+    {
+        return 0;
+    }
+
+    return (column < GPS_LONGITUDE_CELLS) ? (uint32_t)column : GPS_LONGITUDE_CELLS - 1;
+}
+
+/******************************************************************
+*
+* \details qsort comparison function ordering entries by cell.
+*
+*******************************************************************/
+static int compare_entries(const void* a, const void* b)
+{
+    const struct gps_index_entry_t* lhs = (const struct gps_index_entry_t*)a;
+    const struct gps_index_entry_t* rhs = (const struct gps_index_entry_t*)b;
+    return (lhs->cell > rhs->cell) - (lhs->cell < rhs->cell);
+}
+
+/******************************************************************
+*
+* \details Find the first entry with a cell key not less than key.
+*
+* \param[in] index : Spatial index.
+* \param[in] key   : Cell key to search for.
+* \param[out] None
+*
+* \return
+*   Return the position of the first matching entry, or the entry
+*   count if all entries are less than key.
+*
+*******************************************************************/
+static uint32_t lower_bound(const gps_index_t* index, uint64_t key)
+{
+    uint32_t first = 0;
+    uint32_t count = index->count;
+
+    while (count > 0)
+    {
+        uint32_t step = count / 2;
+
+        if (index->entries[first + step].cell < key)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+/******************************************************************
+*
+* \details Visit the records in a contiguous range of cells within
+*          a single latitude row.
+*
+* \return
+*   Return the number of records within the query radius.
+*
+*******************************************************************/
+static uint32_t query_cells(const gps_index_t* index, uint32_t row, uint32_t first_column, uint32_t last_column,
+                            double latitude, double longitude, double radius_km,
+                            gps_index_callback_t callback, void* context)
+{
+    uint32_t matches = 0;
+    uint64_t last_key = GPS_CELL_KEY(row, last_column);
+
+    for (uint32_t i = lower_bound(index, GPS_CELL_KEY(row, first_column));
+         (i < index->count) && (index->entries[i].cell <= last_key); ++i)
+    {
+        const nef_record_t* record = &index->records[index->entries[i].record];
+        double distance = gps_distance_km(latitude, longitude, record->gps.latitude, record->gps.longitude);
+
+        if (distance <= radius_km)
+        {
+            matches++;
+
+            if (NULL != callback)
+            {
+                callback(record, distance, context);
+            }
+        }
+    }
+
+    return matches;
+}
+
+/******************************************************************
+*
+* \details Great-circle distance between two coordinates.
+*
+* \param[in] latitude1/longitude1 : First coordinate in degrees.
+* \param[in] latitude2/longitude2 : Second coordinate in degrees.
+* \param[out] None
+*
+* \return
+*   Return the haversine distance in kilometers.
+*
+*******************************************************************/
+double gps_distance_km(double latitude1, double longitude1, double latitude2, double longitude2)
+{
+    double d_latitude = DEGREES_TO_RADIANS(latitude2 - latitude1);
+    double d_longitude = DEGREES_TO_RADIANS(longitude2 - longitude1);
+    double a = sin(d_latitude / 2) * sin(d_latitude / 2) +
+               cos(DEGREES_TO_RADIANS(latitude1)) * cos(DEGREES_TO_RADIANS(latitude2)) *
+               sin(d_longitude / 2) * sin(d_longitude / 2);
+
+    return 2 * GPS_EARTH_RADIUS_KM * atan2(sqrt(a), sqrt(1 - a));
+}
+
+/******************************************************************
+*
+* \details Build a spatial index over the records with a position.
+*
+* \param[out] index : Spatial index to be initialized.
+* \param[in] records : Batch records. Must outlive the index.
+* \param[in] count   : Number of records.
+*
+* \return
+*   Return true if the index was built, false if memory could not
+*   be allocated.
+*
+*******************************************************************/
+bool gps_index_build(gps_index_t* index, const nef_record_t* records, uint32_t count)
+{
+    bool success = false;
+
+    if ((NULL != index) && (NULL != records))
+    {
+        index->records = records;
+        index->count = 0;
+        index->entries = malloc((count > 0 ? count : 1) * sizeof(struct gps_index_entry_t));
+
+        if (NULL != index->entries)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (records[i].valid && records[i].gps.valid)
+                {
+                    index->entries[index->count].cell = GPS_CELL_KEY(latitude_cell(records[i].gps.latitude),
+                                                                     longitude_cell(records[i].gps.longitude));
+                    index->entries[index->count].record = i;
+                    index->count++;
+                }
+            }
+
+            qsort(index->entries, index->count, sizeof(struct gps_index_entry_t), compare_entries);
+            success = true;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Find all records within a radius of a coordinate.
+*
+* \param[in] index     : Spatial index.
+* \param[in] latitude  : Query latitude in degrees.
+* \param[in] longitude : Query longitude in degrees.
+* \param[in] radius_km : Query radius in kilometers.
+* \param[in] callback  : Called for each matching record. May be NULL.
+* \param[in] context   : User context passed to callback.
+*
+* \return
+*   Return the number of records within the query radius.
+*
+*******************************************************************/
+uint32_t gps_index_query(const gps_index_t* index, double latitude, double longitude, double radius_km,
+                         gps_index_callback_t callback, void* context)
+{
+    uint32_t matches = 0;
+
+    if ((NULL != index) && (index->count > 0) && (radius_km >= 0))
+    {
+        double d_latitude = radius_km / GPS_KM_PER_DEGREE;
+        double min_latitude = fmax(latitude - d_latitude, -90.0);
+        double max_latitude = fmin(latitude + d_latitude, 90.0);
+        // Longitude degrees shrink towards the poles. Use the widest row of the search area.
+        double widest = cos(DEGREES_TO_RADIANS(fmax(fabs(min_latitude), fabs(max_latitude))));
+        double d_longitude = (widest > 1e-6) ? d_latitude / widest : 360.0;
+
+        for (uint32_t row = latitude_cell(min_latitude); row <= latitude_cell(max_latitude); ++row)
+        {
+            if (d_longitude >= 180.0)
+            {
+                matches += query_cells(index, row, 0, GPS_LONGITUDE_CELLS - 1, latitude, longitude, radius_km, callback, context);
+            }
+            else
+            {
+                double west = longitude - d_longitude;
+                double east = longitude + d_longitude;
+
+                if (west < -180.0)
+                {
+                    // Search area crosses the antimeridian
+                    matches += query_cells(index, row, longitude_cell(west + 360.0), GPS_LONGITUDE_CELLS - 1, latitude, longitude, radius_km, callback, context);
+                    matches += query_cells(index, row, 0, longitude_cell(east), latitude, longitude, radius_km, callback, context);
+                }
+                else if (east > 180.0)
+                {
+                    matches += query_cells(index, row, longitude_cell(west), GPS_LONGITUDE_CELLS - 1, latitude, longitude, radius_km, callback, context);
+                    matches += query_cells(index, row, 0, longitude_cell(east - 360.0), latitude, longitude, radius_km, callback, context);
+                }
+                else
+                {
+                    matches += query_cells(index, row, longitude_cell(west), longitude_cell(east), latitude, longitude, radius_km, callback, context);
+                }
+            }
+        }
+    }
+
+    return matches;
+}
+
+/******************************************************************
+*
+* \details Find all records within a radius of a coordinate without
+*          an index.
+*
+* \param[in] records   : Batch records.
+* \param[in] count     : Number of records.
+* \param[in] latitude  : Query latitude in degrees.
+* \param[in] longitude : Query longitude in degrees.
+* \param[in] radius_km : Query radius in kilometers.
+* \param[in] callback  : Called for each matching record. May be NULL.
+* \param[in] context   : User context passed to callback.
+*
+* \return
+*   Return the number of records within the query radius.
+*
+*******************************************************************/
+uint32_t gps_scan(const nef_record_t* records, uint32_t count, double latitude, double longitude, double radius_km,
+                  gps_index_callback_t callback, void* context)
+{
+    uint32_t matches = 0;
+
+    for (uint32_t i = 0; (i < count) && (NULL != records); ++i)
+    {
+        if (records[i].valid && records[i].gps.valid)
+        {
+            double distance = gps_distance_km(latitude, longitude, records[i].gps.latitude, records[i].gps.longitude);
+
+            if (distance <= radius_km)
+            {
+                matches++;
+
+                if (NULL != callback)
+                {
+                    callback(&records[i], distance, context);
+                }
+            }
+        }
+    }
+
+    return matches;
+}
+
+/******************************************************************
+*
+* \details Release memory owned by the spatial index.
+*
+*******************************************************************/
+void gps_index_free(gps_index_t* index)
+{
+    if (NULL != index)
+    {
+        free(index->entries);
+        index->entries = NULL;
+        index->count = 0;
+    }
+}
@@ -0,0 +1,80 @@
+/**************************************************************//**
+*
+* \file gps_index.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Spatial index over the GPS positions of a batch of records.
+*   Records are bucketed into fixed size latitude/longitude grid
+*   cells so radius queries only visit cells overlapping the
+*   search area.
+*
+*******************************************************************/
+
+#ifndef GPS_INDEX_H_
+#define GPS_INDEX_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Grid cell size (roughly 11 km of latitude)
+#define GPS_INDEX_CELL_DEGREES  0.1
+#define GPS_EARTH_RADIUS_KM     6371.0088
+#define GPS_KM_PER_DEGREE       111.195
+#define GPS_MAX_QUERIES         16
+// Building the index costs more than the scan it saves a single query
+#define GPS_INDEX_MIN_QUERIES   2
+
+/******************************************************************
+                        Structures
+*******************************************************************/
+// Record index paired with the grid cell containing its position
+struct gps_index_entry_t
+{
+    uint64_t cell;   // Latitude cell in the upper 32 bits, longitude cell in the lower 32 bits
+    uint32_t record; // Index into the record array
+};
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Radius around a position
+typedef struct
+{
+    double latitude;
+    double longitude;
+    double radius_km;
+} gps_query_t;
+
+typedef struct
+{
+    const nef_record_t* records;
+    struct gps_index_entry_t* entries; // Sorted by cell
+    uint32_t count;
+} gps_index_t;
+
+// Called for each record within the query radius
+typedef void (*gps_index_callback_t)(const nef_record_t* record, double distance_km, void* context);
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool gps_index_build(gps_index_t* index, const nef_record_t* records, uint32_t count);
+uint32_t gps_index_query(const gps_index_t* index, double latitude, double longitude, double radius_km,
+                         gps_index_callback_t callback, void* context);
+void gps_index_free(gps_index_t* index);
+uint32_t gps_scan(const nef_record_t* records, uint32_t count, double latitude, double longitude, double radius_km,
+                  gps_index_callback_t callback, void* context);
+double gps_distance_km(double latitude1, double longitude1, double latitude2, double longitude2);
+
+#endif /* end gps_index.h */
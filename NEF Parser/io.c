@@ -0,0 +1,511 @@
+/**************************************************************//**
+*
+* \file io.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Strategies for reading image files into memory. Each strategy
+*   counts the bytes it reads and the file system calls it makes,
+*   so they can be compared by the benchmark.
+*
+*   Parsing decrypts the lens data in place, so mapped files use a
+*   copy-on-write view and are never modified.
+*
+*   Workers bound to a NUMA node read into buffers from the pool of
+*   their node. Other threads read into heap blocks.
+*
+*   Reads may be capped in bytes per second and operations per
+*   second, so a scan can share a host with other work. The caps
+*   are shared by all workers and may be changed while they run.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "io.h"
+#include "alloc.h"
+#include "numa.h"
+#include "rate.h"
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const char* io_strategy_names[IO_STRATEGY_COUNT] = {
+    "read",
+    "map",
+    "window",
+    "overlapped",
+};
+
+static rate_limiter_t io_byte_limiter;  // Bytes per second
+static rate_limiter_t io_op_limiter;    // Operations per second
+static bool io_limited = false;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool read_overlapped(io_file_t* file);
+static uint8_t* io_alloc(io_file_t* file, size_t size);
+static void io_throttle(uint64_t bytes, uint32_t operations);
+
+/******************************************************************
+*
+* \details Open a file and determine its size.
+*
+* \param[out] file    : Opened file.
+* \param[in] path     : File to open.
+* \param[in] strategy : How the file will be read.
+*
+* \return
+*   Return true if the file was opened. The file must be closed
+*   with io_close either way.
+*
+*******************************************************************/
+bool io_open(io_file_t* file, const char* path, io_strategy_t strategy)
+{
+    bool success = false;
+
+    memset(file, 0, sizeof(io_file_t));
+    file->strategy = strategy;
+    file->file = INVALID_HANDLE_VALUE;
+    io_throttle(0, 1);
+
+    if (IO_STRATEGY_READ == strategy)
+    {
+        file->stats.calls++;
+        fopen_s(&file->stream, path, "rb");
+
+        if (NULL != file->stream)
+        {
+            file->stats.calls += 2;
+            fseek(file->stream, 0, SEEK_END);
+            long size = ftell(file->stream);
+            rewind(file->stream);
+
+            if (size >= 0)
+            {
+                file->file_size = (uint64_t)size;
+                success = true;
+            }
+        }
+    }
+    else
+    {
+        DWORD flags = (IO_STRATEGY_OVERLAPPED == strategy) ? FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        LARGE_INTEGER size;
+
+        file->stats.calls++;
+        file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+
+        if (INVALID_HANDLE_VALUE != file->file)
+        {
+            file->stats.calls++;
+
+            if (GetFileSizeEx(file->file, &size))
+            {
+                file->file_size = (uint64_t)size.QuadPart;
+                success = true;
+            }
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Read the contents of an opened file into file->data.
+*
+* \param[in,out] file : File opened by io_open.
+*
+* \return
+*   Return true if the contents were read.
+*
+*******************************************************************/
+bool io_read(io_file_t* file)
+{
+    bool success = false;
+
+    // Offsets within image files are 32 bits
+    if ((file->file_size > 0) && (file->file_size <= UINT32_MAX))
+    {
+        switch (file->strategy)
+        {
+        case IO_STRATEGY_READ:
+        {
+            file->data = io_alloc(file, (size_t)file->file_size);
+
+            if (NULL != file->data)
+            {
+                io_throttle(file->file_size, 1);
+                file->stats.calls++;
+                success = (fread_s(file->data, (size_t)file->file_size, (size_t)file->file_size, 1, file->stream) == 1);
+                file->size = (uint32_t)file->file_size;
+                file->stats.bytes += file->file_size;
+            }
+
+            break;
+        }
+        case IO_STRATEGY_MAP:
+        {
+            file->stats.calls++;
+            file->mapping = CreateFileMappingA(file->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+            if (NULL != file->mapping)
+            {
+                file->stats.calls++;
+                file->data = MapViewOfFile(file->mapping, FILE_MAP_COPY, 0, 0, 0);
+
+                if (NULL != file->data)
+                {
+                    // Pages are read on first access. They are charged
+                    // up front, as the parse cannot be throttled.
+                    io_throttle(file->file_size, 1);
+                    file->size = (uint32_t)file->file_size;
+                    file->stats.bytes += file->file_size;
+                    success = true;
+                }
+            }
+
+            break;
+        }
+        case IO_STRATEGY_WINDOW:
+        {
+            DWORD read = 0;
+            OVERLAPPED position = { 0 };
+
+            file->size = (uint32_t)min(file->file_size, IO_WINDOW_SIZE);
+            file->data = io_alloc(file, file->size);
+
+            if (NULL != file->data)
+            {
+                io_throttle(file->size, 1);
+                file->stats.calls++;
+                success = ReadFile(file->file, file->data, file->size, &read, &position) && (read == file->size);
+                file->stats.bytes += read;
+            }
+
+            break;
+        }
+        case IO_STRATEGY_OVERLAPPED:
+        {
+            file->size = (uint32_t)file->file_size;
+            file->data = io_alloc(file, file->size);
+
+            if (NULL != file->data)
+            {
+                success = read_overlapped(file);
+            }
+
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Allocate the buffer of a file, on the node of the calling
+*   thread if it is bound to one.
+*
+*******************************************************************/
+static uint8_t* io_alloc(io_file_t* file, size_t size)
+{
+    uint8_t* data = numa_buffer_acquire(size);
+
+    file->pooled = (NULL != data);
+
+    return (NULL != data) ? data : nef_malloc(size, PERF_STAGE_READ);
+}
+
+/******************************************************************
+*
+* \details
+*   Wait until a read may go ahead under the caps. Bytes are
+*   charged in IO_CHUNK_SIZE pieces, so a large file does not hold
+*   up the reads of the other workers until it has been paid for.
+*
+* \param[in] bytes      : Bytes about to be read.
+* \param[in] operations : File system operations about to be made.
+*
+* \return None
+*
+*******************************************************************/
+static void io_throttle(uint64_t bytes, uint32_t operations)
+{
+    if (io_limited)
+    {
+        rate_acquire(&io_op_limiter, operations);
+
+        for (uint64_t charged = 0; charged < bytes; charged += IO_CHUNK_SIZE)
+        {
+            rate_acquire(&io_byte_limiter, min(IO_CHUNK_SIZE, bytes - charged));
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Read the whole file in IO_CHUNK_SIZE pieces, keeping up to
+*   IO_QUEUE_DEPTH reads in flight so the device can service them
+*   in parallel.
+*
+* \param[in,out] file : File opened with IO_STRATEGY_OVERLAPPED.
+*
+* \return
+*   Return true if every piece was read.
+*
+*******************************************************************/
+static bool read_overlapped(io_file_t* file)
+{
+    bool success = true;
+    OVERLAPPED requests[IO_QUEUE_DEPTH];
+    HANDLE events[IO_QUEUE_DEPTH] = { NULL };
+    uint32_t chunk_count = (file->size + IO_CHUNK_SIZE - 1) / IO_CHUNK_SIZE;
+    uint32_t next = 0; // Next chunk to issue
+    uint32_t done = 0; // Next chunk to complete
+
+    for (unsigned i = 0; (i < IO_QUEUE_DEPTH) && success; ++i)
+    {
+        events[i] = CreateEventA(NULL, TRUE, FALSE, NULL);
+        success = (NULL != events[i]);
+    }
+
+    while (success && (done < chunk_count))
+    {
+        // Keep the queue full
+        while (success && (next < chunk_count) && (next - done < IO_QUEUE_DEPTH))
+        {
+            OVERLAPPED* request = &requests[next % IO_QUEUE_DEPTH];
+            uint64_t offset = (uint64_t)next * IO_CHUNK_SIZE;
+            DWORD length = (DWORD)min(IO_CHUNK_SIZE, file->size - offset);
+
+            memset(request, 0, sizeof(OVERLAPPED));
+            request->Offset = (DWORD)offset;
+            request->OffsetHigh = (DWORD)(offset >> 32);
+            request->hEvent = events[next % IO_QUEUE_DEPTH];
+            io_throttle(length, 1);
+            file->stats.calls++;
+
+            if (!ReadFile(file->file, &file->data[offset], length, NULL, request) && (GetLastError() != ERROR_IO_PENDING))
+            {
+                success = false;
+            }
+            else
+            {
+                next++;
+            }
+        }
+
+        if (success)
+        {
+            DWORD read = 0;
+
+            file->stats.calls++;
+
+            if (GetOverlappedResult(file->file, &requests[done % IO_QUEUE_DEPTH], &read, TRUE))
+            {
+                file->stats.bytes += read;
+                done++;
+            }
+            else
+            {
+                success = false;
+            }
+        }
+    }
+
+    // Reads still in flight write to the buffer, so wait for them before it is freed
+    for (; done < next; ++done)
+    {
+        DWORD read = 0;
+        GetOverlappedResult(file->file, &requests[done % IO_QUEUE_DEPTH], &read, TRUE);
+    }
+
+    for (unsigned i = 0; i < IO_QUEUE_DEPTH; ++i)
+    {
+        if (NULL != events[i])
+        {
+            CloseHandle(events[i]);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Release the contents and close the file.
+*
+* \param[in,out] file : File opened by io_open.
+*
+* \return None
+*
+*******************************************************************/
+void io_close(io_file_t* file)
+{
+    if (IO_STRATEGY_MAP == file->strategy)
+    {
+        if (NULL != file->data)
+        {
+            file->stats.calls++;
+            UnmapViewOfFile(file->data);
+        }
+
+        if (NULL != file->mapping)
+        {
+            file->stats.calls++;
+            CloseHandle(file->mapping);
+        }
+    }
+    else if (file->pooled)
+    {
+        numa_buffer_release(file->data);
+    }
+    else
+    {
+        nef_free(file->data);
+    }
+
+    if (NULL != file->stream)
+    {
+        file->stats.calls++;
+        fclose(file->stream);
+    }
+
+    if (INVALID_HANDLE_VALUE != file->file)
+    {
+        file->stats.calls++;
+        CloseHandle(file->file);
+    }
+
+    file->data = NULL;
+    file->mapping = NULL;
+    file->stream = NULL;
+    file->file = INVALID_HANDLE_VALUE;
+}
+
+/******************************************************************
+*
+* \details
+*   Remove a file from the system file cache, so the next read
+*   comes from the device. Opening a file without buffering purges
+*   its cached pages when no other handle or view of it is open.
+*
+* \param[in] path : File to evict.
+*
+* \return
+*   Return true if the file was opened without buffering.
+*
+*******************************************************************/
+bool io_evict(const char* path)
+{
+    bool success = false;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+
+    if (INVALID_HANDLE_VALUE != file)
+    {
+        CloseHandle(file);
+        success = true;
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Cap the reads of all threads. The first call must be made
+*   before any file is opened. Later calls may be made while files
+*   are being read.
+*
+* \param[in] bytes_per_second : Read bandwidth (0 = unlimited).
+* \param[in] ops_per_second   : File system operations (0 = unlimited).
+*
+* \return None
+*
+*******************************************************************/
+void io_set_limits(uint64_t bytes_per_second, uint64_t ops_per_second)
+{
+    if (!io_limited)
+    {
+        rate_init(&io_byte_limiter, bytes_per_second);
+        rate_init(&io_op_limiter, ops_per_second);
+        io_limited = true;
+    }
+    else
+    {
+        rate_set(&io_byte_limiter, bytes_per_second);
+        rate_set(&io_op_limiter, ops_per_second);
+    }
+}
+
+/******************************************************************
+*
+* \details Current caps (0 = unlimited) and time spent waiting on them.
+*
+* \param[out] limits : Caps and waits.
+*
+* \return None
+*
+*******************************************************************/
+void io_get_limits(io_limits_t* limits)
+{
+    memset(limits, 0, sizeof(io_limits_t));
+
+    if (io_limited)
+    {
+        limits->bytes_per_second = rate_get(&io_byte_limiter);
+        limits->ops_per_second = rate_get(&io_op_limiter);
+        limits->waited_seconds = rate_waited_seconds(&io_byte_limiter) + rate_waited_seconds(&io_op_limiter);
+    }
+}
+
+/******************************************************************
+*
+* \details Name of a strategy, as accepted by io_parse_strategy.
+*
+*******************************************************************/
+const char* io_strategy_name(io_strategy_t strategy)
+{
+    return (strategy < IO_STRATEGY_COUNT) ? io_strategy_names[strategy] : "unknown";
+}
+
+/******************************************************************
+*
+* \details Look up a strategy by name.
+*
+* \param[in] name      : Strategy name.
+* \param[out] strategy : Matching strategy.
+*
+* \return
+*   Return true if the name matched a strategy.
+*
+*******************************************************************/
+bool io_parse_strategy(const char* name, io_strategy_t* strategy)
+{
+    bool found = false;
+
+    for (unsigned i = 0; (i < IO_STRATEGY_COUNT) && !found; ++i)
+    {
+        if (strcmp(name, io_strategy_names[i]) == 0)
+        {
+            *strategy = (io_strategy_t)i;
+            found = true;
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,84 @@
+/**************************************************************//**
+*
+* \file io.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Strategies for reading image files into memory.
+*
+*******************************************************************/
+
+#ifndef IO_H_
+#define IO_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// NEF metadata precedes the preview and raw image data, so the
+// window strategy only reads the start of the file.
+#define IO_WINDOW_SIZE  (512 * 1024)
+#define IO_CHUNK_SIZE   (256 * 1024) // Overlapped read size
+#define IO_QUEUE_DEPTH  8            // Overlapped reads in flight
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef enum
+{
+    IO_STRATEGY_READ = 0,   // Read the whole file with fread_s
+    IO_STRATEGY_MAP,        // Copy-on-write view of the file
+    IO_STRATEGY_WINDOW,     // Positioned read of the first IO_WINDOW_SIZE bytes
+    IO_STRATEGY_OVERLAPPED, // Whole file with IO_QUEUE_DEPTH overlapped reads in flight
+    IO_STRATEGY_COUNT
+} io_strategy_t;
+
+typedef struct
+{
+    uint64_t bytes;     // Bytes read (or mapped)
+    uint32_t calls;     // File system calls made
+} io_stats_t;
+
+typedef struct
+{
+    io_strategy_t strategy;
+    FILE* stream;           // IO_STRATEGY_READ
+    HANDLE file;            // Other strategies
+    HANDLE mapping;         // IO_STRATEGY_MAP
+    uint8_t* data;          // File contents
+    bool pooled;            // data is a NUMA node pool buffer
+    uint32_t size;          // Bytes available in data
+    uint64_t file_size;
+    io_stats_t stats;
+} io_file_t;
+
+typedef struct
+{
+    uint64_t bytes_per_second;  // Read bandwidth cap (0 = unlimited)
+    uint64_t ops_per_second;    // Operation cap (0 = unlimited)
+    double waited_seconds;      // Time threads have waited on the caps
+} io_limits_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool io_open(io_file_t* file, const char* path, io_strategy_t strategy);
+bool io_read(io_file_t* file);
+void io_close(io_file_t* file);
+bool io_evict(const char* path);
+void io_set_limits(uint64_t bytes_per_second, uint64_t ops_per_second);
+void io_get_limits(io_limits_t* limits);
+const char* io_strategy_name(io_strategy_t strategy);
+bool io_parse_strategy(const char* name, io_strategy_t* strategy);
+
+#endif /* end io.h */
@@ -0,0 +1,652 @@
+/**************************************************************//**
+*
+* \file isolate.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Crash isolated batch processing. Worker processes are started
+*   once, from the same executable and command line, and parse the
+*   files handed to them by a supervising thread each. A file is
+*   requested over a named pipe and its record is returned in a
+*   shared memory slot, so no process is started per file.
+*
+*   A worker that dies, or takes longer than ISOLATE_HANG_MS on a
+*   file, is replaced. The file it was parsing is reported with a
+*   NEF_ERROR_WORKER_CRASH error and appended to the quarantine
+*   file, which later runs read to skip it.
+*
+*   Records hold pointers to string tables of the executable. They
+*   cross the process boundary as offsets from the image base.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "isolate.h"
+#include "error.h"
+#include "metrics.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define ISOLATE_MAX_REQUEST     4096    // Longest path sent to a worker (including the terminator)
+#define ISOLATE_EXIT_MS         1000    // Time allowed for a worker to exit once disconnected
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Result of a file, written by the worker process
+typedef struct
+{
+    nef_record_t record;
+    uintptr_t metering_mode;    // Offsets of the strings from the image base (0 = NULL)
+    uintptr_t compression;
+} isolate_slot_t;
+
+typedef struct
+{
+    batch_t* batch;
+    isolate_t* isolate;
+    char executable[MAX_PATH];
+    volatile LONG next;         // Next file to claim
+    volatile LONG completed;    // Files with a record
+    SRWLOCK lock;               // Serializes the quarantine file updates
+    char** quarantined;         // Files listed by earlier runs
+    unsigned quarantined_count;
+} isolate_state_t;
+
+typedef struct
+{
+    isolate_state_t* state;
+    char name[ISOLATE_NAME_LENGTH]; // Names the pipe and the slot
+    HANDLE pipe;                    // Requests and acknowledgements
+    HANDLE event;                   // Completes the pipe operations
+    HANDLE mapping;
+    isolate_slot_t* slot;
+    PROCESS_INFORMATION process;    // Zero while no worker is running
+    HANDLE thread;                  // Supervising thread
+} isolate_worker_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static uintptr_t isolate_offset(const char* text);
+static const char* isolate_string(uintptr_t offset);
+static bool isolate_load_quarantine(isolate_state_t* state);
+static void isolate_free_quarantine(isolate_state_t* state);
+static bool isolate_is_quarantined(const isolate_state_t* state, const char* path);
+static void isolate_quarantine(isolate_state_t* state, const char* path);
+static void isolate_fail(nef_record_t* record, const char* path, nef_error_code_t code, uint32_t value);
+static bool isolate_open(isolate_worker_t* worker, isolate_state_t* state, unsigned index);
+static void isolate_close(isolate_worker_t* worker);
+static bool isolate_complete(isolate_worker_t* worker, BOOL finished, OVERLAPPED* overlapped, DWORD* transferred);
+static bool isolate_spawn(isolate_worker_t* worker);
+static DWORD isolate_reap(isolate_worker_t* worker);
+static bool isolate_parse(isolate_worker_t* worker, const char* path, nef_record_t* record);
+static DWORD WINAPI isolate_supervise(LPVOID parameter);
+
+/******************************************************************
+*
+* \details Offset of a string of the executable from its image base.
+*
+*******************************************************************/
+static uintptr_t isolate_offset(const char* text)
+{
+    return (NULL != text) ? (uintptr_t)text - (uintptr_t)GetModuleHandleA(NULL) : 0;
+}
+
+/******************************************************************
+*
+* \details String of the executable at an offset from its image base.
+*
+*******************************************************************/
+static const char* isolate_string(uintptr_t offset)
+{
+    return (0 != offset) ? (const char*)GetModuleHandleA(NULL) + offset : NULL;
+}
+
+/******************************************************************
+*
+* \details
+*   Read the files quarantined by earlier runs. A missing
+*   quarantine file lists no files.
+*
+* \param[in,out] state : Batch being supervised.
+*
+* \return
+*   Return true unless memory ran out.
+*
+*******************************************************************/
+static bool isolate_load_quarantine(isolate_state_t* state)
+{
+    bool success = true;
+    FILE* file = NULL;
+
+    if ((NULL != state->isolate->quarantine) && (fopen_s(&file, state->isolate->quarantine, "r") == 0))
+    {
+        char line[ISOLATE_MAX_REQUEST];
+
+        while (success && (NULL != fgets(line, sizeof(line), file)))
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+
+            if (line[0] != '\0')
+            {
+                char** grown = realloc(state->quarantined, (state->quarantined_count + 1) * sizeof(char*));
+
+                if (NULL != grown)
+                {
+                    state->quarantined = grown;
+                    state->quarantined[state->quarantined_count] = _strdup(line);
+                    success = (NULL != state->quarantined[state->quarantined_count]);
+                    state->quarantined_count += success ? 1 : 0;
+                }
+                else
+                {
+                    success = false;
+                }
+            }
+        }
+
+        fclose(file);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Free the files quarantined by earlier runs.
+*
+*******************************************************************/
+static void isolate_free_quarantine(isolate_state_t* state)
+{
+    for (unsigned i = 0; i < state->quarantined_count; ++i)
+    {
+        free(state->quarantined[i]);
+    }
+
+    free(state->quarantined);
+    state->quarantined = NULL;
+    state->quarantined_count = 0;
+}
+
+/******************************************************************
+*
+* \details Return true if an earlier run quarantined a file.
+*
+*******************************************************************/
+static bool isolate_is_quarantined(const isolate_state_t* state, const char* path)
+{
+    bool quarantined = false;
+
+    for (unsigned i = 0; (i < state->quarantined_count) && !quarantined; ++i)
+    {
+        quarantined = (_stricmp(state->quarantined[i], path) == 0);
+    }
+
+    return quarantined;
+}
+
+/******************************************************************
+*
+* \details Append a file that crashed a worker to the quarantine file.
+*
+*******************************************************************/
+static void isolate_quarantine(isolate_state_t* state, const char* path)
+{
+    FILE* file = NULL;
+
+    if (NULL != state->isolate->quarantine)
+    {
+        AcquireSRWLockExclusive(&state->lock);
+
+        if (fopen_s(&file, state->isolate->quarantine, "a") == 0)
+        {
+            fprintf(file, "%s\n", path);
+            fclose(file);
+        }
+        else
+        {
+            fprintf(stderr, "Error: Failed to update quarantine file %s.\n", state->isolate->quarantine);
+        }
+
+        ReleaseSRWLockExclusive(&state->lock);
+    }
+}
+
+/******************************************************************
+*
+* \details Record a file that was not parsed.
+*
+*******************************************************************/
+static void isolate_fail(nef_record_t* record, const char* path, nef_error_code_t code, uint32_t value)
+{
+    memset(record, 0, sizeof(nef_record_t));
+    strncpy_s(record->path, sizeof(record->path), path, sizeof(record->path) - 1);
+    nef_error_report(&record->errors, code, NEF_IFD_NONE, 0, 0, value);
+}
+
+/******************************************************************
+*
+* \details
+*   Create the pipe and the result slot of a worker. The names are
+*   unique to the supervisor process.
+*
+* \param[out] worker : Worker.
+* \param[in] state   : Batch being supervised.
+* \param[in] index   : Worker index.
+*
+* \return
+*   Return true if the worker may be started.
+*
+*******************************************************************/
+static bool isolate_open(isolate_worker_t* worker, isolate_state_t* state, unsigned index)
+{
+    char path[ISOLATE_NAME_LENGTH + sizeof(ISOLATE_MAPPING_PREFIX) + sizeof(ISOLATE_PIPE_PREFIX)];
+
+    memset(worker, 0, sizeof(isolate_worker_t));
+    worker->state = state;
+    worker->pipe = INVALID_HANDLE_VALUE;
+    sprintf_s(worker->name, sizeof(worker->name), "nefparser-%lu-%u", GetCurrentProcessId(), index);
+
+    sprintf_s(path, sizeof(path), ISOLATE_PIPE_PREFIX "%s", worker->name);
+    worker->pipe = CreateNamedPipeA(path, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                    PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                    1, ISOLATE_MAX_REQUEST, ISOLATE_MAX_REQUEST, 0, NULL);
+    worker->event = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    sprintf_s(path, sizeof(path), ISOLATE_MAPPING_PREFIX "%s", worker->name);
+    worker->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(isolate_slot_t), path);
+
+    if (NULL != worker->mapping)
+    {
+        worker->slot = (isolate_slot_t*)MapViewOfFile(worker->mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(isolate_slot_t));
+    }
+
+    return (INVALID_HANDLE_VALUE != worker->pipe) && (NULL != worker->event) && (NULL != worker->slot);
+}
+
+/******************************************************************
+*
+* \details Release the pipe and the result slot of a worker.
+*
+*******************************************************************/
+static void isolate_close(isolate_worker_t* worker)
+{
+    if (NULL != worker->slot)
+    {
+        UnmapViewOfFile(worker->slot);
+    }
+
+    if (NULL != worker->mapping)
+    {
+        CloseHandle(worker->mapping);
+    }
+
+    if (NULL != worker->event)
+    {
+        CloseHandle(worker->event);
+    }
+
+    if (INVALID_HANDLE_VALUE != worker->pipe)
+    {
+        CloseHandle(worker->pipe);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Wait for a pipe operation of a worker. The operation is
+*   cancelled if the worker exits or hangs first.
+*
+* \param[in,out] worker   : Worker.
+* \param[in] finished     : Result of the call starting the operation.
+* \param[in,out] overlapped : Operation.
+* \param[out] transferred : Bytes transferred.
+*
+* \return
+*   Return true if the operation completed.
+*
+*******************************************************************/
+static bool isolate_complete(isolate_worker_t* worker, BOOL finished, OVERLAPPED* overlapped, DWORD* transferred)
+{
+    bool complete = false;
+
+    if (finished || (GetLastError() == ERROR_IO_PENDING))
+    {
+        // The event comes first, so an operation completed just before the exit is kept
+        HANDLE handles[2] = { overlapped->hEvent, worker->process.hProcess };
+
+        if (WaitForMultipleObjects(2, handles, FALSE, ISOLATE_HANG_MS) == WAIT_OBJECT_0)
+        {
+            complete = GetOverlappedResult(worker->pipe, overlapped, transferred, FALSE);
+        }
+        else
+        {
+            CancelIoEx(worker->pipe, overlapped);
+            GetOverlappedResult(worker->pipe, overlapped, transferred, TRUE);
+        }
+    }
+
+    return complete;
+}
+
+/******************************************************************
+*
+* \details
+*   Start a worker process and wait for it to connect. It runs the
+*   command line of the supervisor with ISOLATE_WORKER_OPTION, so
+*   it parses with the same options.
+*
+* \param[in,out] worker : Worker.
+*
+* \return
+*   Return true if the worker is ready for files.
+*
+*******************************************************************/
+static bool isolate_spawn(isolate_worker_t* worker)
+{
+    bool ready = false;
+    const char* command_line = GetCommandLineA();
+    size_t size = strlen(command_line) + sizeof(" " ISOLATE_WORKER_OPTION " ") + ISOLATE_NAME_LENGTH;
+    char* command = malloc(size);
+    STARTUPINFOA startup;
+
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+
+    if (NULL != command)
+    {
+        sprintf_s(command, size, "%s " ISOLATE_WORKER_OPTION " %s", command_line, worker->name);
+
+        // Workers share the console of the supervisor and inherit no handles
+        if (CreateProcessA(worker->state->executable, command, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &worker->process))
+        {
+            OVERLAPPED overlapped = { 0 };
+            DWORD transferred = 0;
+            BOOL connected;
+
+            overlapped.hEvent = worker->event;
+            connected = ConnectNamedPipe(worker->pipe, &overlapped);
+            ready = (!connected && (GetLastError() == ERROR_PIPE_CONNECTED)) ||
+                    isolate_complete(worker, connected, &overlapped, &transferred);
+
+            if (!ready)
+            {
+                isolate_reap(worker);
+            }
+        }
+
+        free(command);
+    }
+
+    return ready;
+}
+
+/******************************************************************
+*
+* \details
+*   Stop a worker process. A healthy worker exits once the pipe is
+*   disconnected; a hung one is terminated.
+*
+* \param[in,out] worker : Worker.
+*
+* \return
+*   Exit code of the worker.
+*
+*******************************************************************/
+static DWORD isolate_reap(isolate_worker_t* worker)
+{
+    DWORD exit_code = 0;
+
+    if (NULL != worker->process.hProcess)
+    {
+        DisconnectNamedPipe(worker->pipe);
+
+        if (WaitForSingleObject(worker->process.hProcess, ISOLATE_EXIT_MS) != WAIT_OBJECT_0)
+        {
+            TerminateProcess(worker->process.hProcess, ISOLATE_HANG_EXIT_CODE);
+            WaitForSingleObject(worker->process.hProcess, INFINITE);
+        }
+
+        GetExitCodeProcess(worker->process.hProcess, &exit_code);
+        CloseHandle(worker->process.hProcess);
+        CloseHandle(worker->process.hThread);
+        memset(&worker->process, 0, sizeof(worker->process));
+    }
+
+    return exit_code;
+}
+
+/******************************************************************
+*
+* \details Parse a file in a worker process.
+*
+* \param[in,out] worker : Worker.
+* \param[in] path       : File.
+* \param[out] record    : Record of the file.
+*
+* \return
+*   Return false if the worker was lost before returning the record.
+*
+*******************************************************************/
+static bool isolate_parse(isolate_worker_t* worker, const char* path, nef_record_t* record)
+{
+    bool delivered = false;
+    OVERLAPPED overlapped = { 0 };
+    DWORD transferred = 0;
+    uint8_t valid = 0;
+
+    overlapped.hEvent = worker->event;
+
+    if (isolate_complete(worker, WriteFile(worker->pipe, path, (DWORD)strlen(path), NULL, &overlapped), &overlapped, &transferred) &&
+        isolate_complete(worker, ReadFile(worker->pipe, &valid, sizeof(valid), NULL, &overlapped), &overlapped, &transferred) &&
+        (transferred == sizeof(valid)))
+    {
+        const isolate_slot_t* slot = worker->slot;
+
+        memcpy(record, &slot->record, sizeof(nef_record_t));
+        record->image.metering_mode = isolate_string(slot->metering_mode);
+        record->image.compression = isolate_string(slot->compression);
+        delivered = true;
+    }
+
+    return delivered;
+}
+
+/******************************************************************
+*
+* \details
+*   Supervising thread of a worker process. Claims files until the
+*   batch is done, replacing the worker whenever it is lost.
+*
+*******************************************************************/
+static DWORD WINAPI isolate_supervise(LPVOID parameter)
+{
+    isolate_worker_t* worker = (isolate_worker_t*)parameter;
+    isolate_state_t* state = worker->state;
+    batch_t* batch = state->batch;
+    bool running = isolate_spawn(worker);
+    nef_record_t scratch;   // Record of the current file when the batch keeps none
+
+    while (running)
+    {
+        LONG index = InterlockedIncrement(&state->next) - 1;
+
+        if (index >= (LONG)batch->count)
+        {
+            running = false;
+        }
+        else
+        {
+            const char* path = batch->files[index];
+            nef_record_t* record = (NULL != batch->records) ? &batch->records[index] : &scratch;
+
+            if (isolate_is_quarantined(state, path))
+            {
+                isolate_fail(record, path, NEF_ERROR_QUARANTINED, 0);
+                InterlockedIncrement(&state->isolate->skipped);
+            }
+            else if (strlen(path) >= ISOLATE_MAX_REQUEST)
+            {
+                isolate_fail(record, path, NEF_ERROR_OPEN, 0);
+            }
+            else if (!isolate_parse(worker, path, record))
+            {
+                DWORD exit_code = isolate_reap(worker);
+
+                isolate_fail(record, path, NEF_ERROR_WORKER_CRASH, exit_code);
+                isolate_quarantine(state, path);
+                InterlockedIncrement(&state->isolate->crashes);
+                running = isolate_spawn(worker);
+            }
+
+            // Worker processes have no metrics of their own
+            metrics_record_file(record);
+
+            if (NULL != batch->callback)
+            {
+                batch->callback(record, batch->context);
+            }
+
+            InterlockedIncrement(&state->completed);
+        }
+    }
+
+    isolate_reap(worker);
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details
+*   Parse the files of a batch in isolate->processes worker
+*   processes. The callback of the batch runs in this process.
+*   batch->threads, numa, lanes and reserved are not used.
+*
+* \param[in,out] batch   : Batch.
+* \param[in,out] isolate : Worker processes and quarantine file.
+*
+* \return
+*   Return true if every file has a record.
+*
+*******************************************************************/
+bool isolate_run(batch_t* batch, isolate_t* isolate)
+{
+    bool success = false;
+    isolate_state_t state;
+    isolate_worker_t* workers = calloc(isolate->processes, sizeof(isolate_worker_t));
+
+    memset(&state, 0, sizeof(state));
+    state.batch = batch;
+    state.isolate = isolate;
+    InitializeSRWLock(&state.lock);
+
+    if ((NULL != workers) && (GetModuleFileNameA(NULL, state.executable, sizeof(state.executable)) > 0) &&
+        isolate_load_quarantine(&state))
+    {
+        for (unsigned i = 0; i < isolate->processes; ++i)
+        {
+            if (isolate_open(&workers[i], &state, i))
+            {
+                workers[i].thread = CreateThread(NULL, 0, isolate_supervise, &workers[i], 0, NULL);
+            }
+        }
+
+        for (unsigned i = 0; i < isolate->processes; ++i)
+        {
+            if (NULL != workers[i].thread)
+            {
+                WaitForSingleObject(workers[i].thread, INFINITE);
+                CloseHandle(workers[i].thread);
+            }
+
+            isolate_close(&workers[i]);
+        }
+
+        success = (state.completed == (LONG)batch->count);
+    }
+
+    isolate_free_quarantine(&state);
+    free(workers);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Worker process side. Parse the files requested by the
+*   supervisor into the result slot until it disconnects.
+*
+* \param[in] name  : Worker name given by the supervisor.
+* \param[in] parse : Parses a file into a record.
+*
+* \return
+*   Return true if the worker connected and served until the
+*   supervisor disconnected.
+*
+*******************************************************************/
+bool isolate_worker(const char* name, batch_parse_t parse)
+{
+    bool success = false;
+    char path[ISOLATE_NAME_LENGTH + sizeof(ISOLATE_MAPPING_PREFIX) + sizeof(ISOLATE_PIPE_PREFIX)];
+    HANDLE mapping;
+
+    sprintf_s(path, sizeof(path), ISOLATE_MAPPING_PREFIX "%s", name);
+    mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+
+    if (NULL != mapping)
+    {
+        isolate_slot_t* slot = (isolate_slot_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(isolate_slot_t));
+
+        if (NULL != slot)
+        {
+            HANDLE pipe;
+
+            sprintf_s(path, sizeof(path), ISOLATE_PIPE_PREFIX "%s", name);
+            pipe = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+
+            if (INVALID_HANDLE_VALUE != pipe)
+            {
+                DWORD mode = PIPE_READMODE_MESSAGE;
+                char* request = malloc(ISOLATE_MAX_REQUEST);
+                DWORD length = 0;
+
+                success = (NULL != request) && SetNamedPipeHandleState(pipe, &mode, NULL, NULL);
+
+                // A failed read means the supervisor disconnected
+                while (success && ReadFile(pipe, request, ISOLATE_MAX_REQUEST - 1, &length, NULL) && (length > 0))
+                {
+                    uint8_t valid;
+                    DWORD written = 0;
+
+                    request[length] = '\0';
+                    valid = parse(request, &slot->record) ? 1 : 0;
+                    slot->metering_mode = isolate_offset(slot->record.image.metering_mode);
+                    slot->compression = isolate_offset(slot->record.image.compression);
+                    success = WriteFile(pipe, &valid, sizeof(valid), &written, NULL) && (written == sizeof(valid));
+                }
+
+                free(request);
+                CloseHandle(pipe);
+            }
+
+            UnmapViewOfFile(slot);
+        }
+
+        CloseHandle(mapping);
+    }
+
+    return success;
+}
@@ -0,0 +1,55 @@
+/**************************************************************//**
+*
+* \file isolate.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Batch processing in worker processes, so a file that crashes
+*   the parser only takes down the process parsing it.
+*
+*******************************************************************/
+
+#ifndef ISOLATE_H_
+#define ISOLATE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "batch.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define ISOLATE_MAX_PROCESSES   BATCH_MAX_THREADS
+#define ISOLATE_NAME_LENGTH     64
+#define ISOLATE_PIPE_PREFIX     "\\\\.\\pipe\\"
+#define ISOLATE_MAPPING_PREFIX  "Local\\"
+#define ISOLATE_WORKER_OPTION   "--isolate-worker"
+#define ISOLATE_HANG_MS         60000   // A file taking longer is treated as a crash
+#define ISOLATE_HANG_EXIT_CODE  WAIT_TIMEOUT
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    unsigned processes;         // Worker processes
+    const char* quarantine;     // Optional. Files that crashed a worker, skipped by later runs.
+    volatile LONG crashes;      // Workers lost (and respawned)
+    volatile LONG skipped;      // Files skipped as quarantined by a previous run
+} isolate_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool isolate_run(batch_t* batch, isolate_t* isolate);
+bool isolate_worker(const char* name, batch_parse_t parse);
+
+#endif /* end isolate.h */
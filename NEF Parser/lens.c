@@ -0,0 +1,735 @@
+/**************************************************************//**
+*
+* \file lens.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Nikon LensData Makernote entry decoding. The entry starts with
+*   a version string selecting its field layout, and the fields of
+*   versions 0201 and later are encrypted with a key stream derived
+*   from the serial number and shutter count.
+*
+*   Development Resources:
+*       - https://exiftool.org/TagNames/Nikon.html#LensData00
+*       - https://github.com/exiftool/exiftool/blob/master/lib/Image/ExifTool/Nikon.pm
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lens.h"
+#include "cpu.h"
+#include "metrics.h"
+#include "perf.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define MAX_LENS_ID_LENGTH  96
+
+/******************************************************************
+                        Structures
+*******************************************************************/
+// Lens ID entry containing composite tag and associated lens ID (model) string
+struct lens_id_entry_t
+{
+    uint8_t tag[8];
+    char id[MAX_LENS_ID_LENGTH];
+};
+
+// Z-mount lens ID entry. Z-mount lenses report a single 16-bit ID.
+struct z_lens_id_entry_t
+{
+    uint16_t id;
+    char name[MAX_LENS_ID_LENGTH];
+};
+
+// LensData entry passed to the layout decoders
+struct lens_data_t
+{
+    const parse_context_t* context; // Parse context, in the byte order of the Makernote
+    const uint8_t* data;            // Decrypted lens data (including version string)
+    uint8_t lens_type;              // Makernote lens type. Last byte of the composite tag.
+};
+
+// Field layout of a LensData version range.
+// See https://exiftool.org/TagNames/Nikon.html#LensData00
+struct lens_data_layout_t
+{
+    uint16_t first_version; // First LensData version using this layout
+    uint16_t last_version;  // Last LensData version using this layout
+    bool encrypted;         // Data following the version string is encrypted
+    uint16_t min_size;      // Minimum entry size required to decode the layout
+    // Decoder specialized for the layout offsets. Only called for
+    // entries of at least min_size bytes.
+    void (*decode)(const struct lens_data_t* lens, camera_data_t* camera);
+};
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static const char* nikon_lens_id_lookup(const uint8_t* key);
+static const char* nikon_z_lens_id_lookup(uint16_t id);
+static void decode_lens_data_00(const struct lens_data_t* lens, camera_data_t* camera);
+static void decode_lens_data_01(const struct lens_data_t* lens, camera_data_t* camera);
+static void decode_lens_data_0204(const struct lens_data_t* lens, camera_data_t* camera);
+static void decode_lens_data_0400(const struct lens_data_t* lens, camera_data_t* camera);
+static void decode_lens_data_0402(const struct lens_data_t* lens, camera_data_t* camera);
+static void decode_lens_data_0403(const struct lens_data_t* lens, camera_data_t* camera);
+static void decode_lens_data_0800(const struct lens_data_t* lens, camera_data_t* camera);
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Translation table used to decrypt lens data fields
+static const uint8_t xlat[2][256] = {
+    { 0xc1, 0xbf, 0x6d, 0x0d, 0x59, 0xc5, 0x13, 0x9d, 0x83, 0x61, 0x6b, 0x4f, 0xc7, 0x7f, 0x3d, 0x3d,
+      0x53, 0x59, 0xe3, 0xc7, 0xe9, 0x2f, 0x95, 0xa7, 0x95, 0x1f, 0xdf, 0x7f, 0x2b, 0x29, 0xc7, 0x0d,
+      0xdf, 0x07, 0xef, 0x71, 0x89, 0x3d, 0x13, 0x3d, 0x3b, 0x13, 0xfb, 0x0d, 0x89, 0xc1, 0x65, 0x1f,
+      0xb3, 0x0d, 0x6b, 0x29, 0xe3, 0xfb, 0xef, 0xa3, 0x6b, 0x47, 0x7f, 0x95, 0x35, 0xa7, 0x47, 0x4f,
+      0xc7, 0xf1, 0x59, 0x95, 0x35, 0x11, 0x29, 0x61, 0xf1, 0x3d, 0xb3, 0x2b, 0x0d, 0x43, 0x89, 0xc1,
+      0x9d, 0x9d, 0x89, 0x65, 0xf1, 0xe9, 0xdf, 0xbf, 0x3d, 0x7f, 0x53, 0x97, 0xe5, 0xe9, 0x95, 0x17,
+      0x1d, 0x3d, 0x8b, 0xfb, 0xc7, 0xe3, 0x67, 0xa7, 0x07, 0xf1, 0x71, 0xa7, 0x53, 0xb5, 0x29, 0x89,
+      0xe5, 0x2b, 0xa7, 0x17, 0x29, 0xe9, 0x4f, 0xc5, 0x65, 0x6d, 0x6b, 0xef, 0x0d, 0x89, 0x49, 0x2f,
+      0xb3, 0x43, 0x53, 0x65, 0x1d, 0x49, 0xa3, 0x13, 0x89, 0x59, 0xef, 0x6b, 0xef, 0x65, 0x1d, 0x0b,
+      0x59, 0x13, 0xe3, 0x4f, 0x9d, 0xb3, 0x29, 0x43, 0x2b, 0x07, 0x1d, 0x95, 0x59, 0x59, 0x47, 0xfb,
+      0xe5, 0xe9, 0x61, 0x47, 0x2f, 0x35, 0x7f, 0x17, 0x7f, 0xef, 0x7f, 0x95, 0x95, 0x71, 0xd3, 0xa3,
+      0x0b, 0x71, 0xa3, 0xad, 0x0b, 0x3b, 0xb5, 0xfb, 0xa3, 0xbf, 0x4f, 0x83, 0x1d, 0xad, 0xe9, 0x2f,
+      0x71, 0x65, 0xa3, 0xe5, 0x07, 0x35, 0x3d, 0x0d, 0xb5, 0xe9, 0xe5, 0x47, 0x3b, 0x9d, 0xef, 0x35,
+      0xa3, 0xbf, 0xb3, 0xdf, 0x53, 0xd3, 0x97, 0x53, 0x49, 0x71, 0x07, 0x35, 0x61, 0x71, 0x2f, 0x43,
+      0x2f, 0x11, 0xdf, 0x17, 0x97, 0xfb, 0x95, 0x3b, 0x7f, 0x6b, 0xd3, 0x25, 0xbf, 0xad, 0xc7, 0xc5,
+      0xc5, 0xb5, 0x8b, 0xef, 0x2f, 0xd3, 0x07, 0x6b, 0x25, 0x49, 0x95, 0x25, 0x49, 0x6d, 0x71, 0xc7 },
+    { 0xa7, 0xbc, 0xc9, 0xad, 0x91, 0xdf, 0x85, 0xe5, 0xd4, 0x78, 0xd5, 0x17, 0x46, 0x7c, 0x29, 0x4c,
+      0x4d, 0x03, 0xe9, 0x25, 0x68, 0x11, 0x86, 0xb3, 0xbd, 0xf7, 0x6f, 0x61, 0x22, 0xa2, 0x26, 0x34,
+      0x2a, 0xbe, 0x1e, 0x46, 0x14, 0x68, 0x9d, 0x44, 0x18, 0xc2, 0x40, 0xf4, 0x7e, 0x5f, 0x1b, 0xad,
+      0x0b, 0x94, 0xb6, 0x67, 0xb4, 0x0b, 0xe1, 0xea, 0x95, 0x9c, 0x66, 0xdc, 0xe7, 0x5d, 0x6c, 0x05,
+      0xda, 0xd5, 0xdf, 0x7a, 0xef, 0xf6, 0xdb, 0x1f, 0x82, 0x4c, 0xc0, 0x68, 0x47, 0xa1, 0xbd, 0xee,
+      0x39, 0x50, 0x56, 0x4a, 0xdd, 0xdf, 0xa5, 0xf8, 0xc6, 0xda, 0xca, 0x90, 0xca, 0x01, 0x42, 0x9d,
+      0x8b, 0x0c, 0x73, 0x43, 0x75, 0x05, 0x94, 0xde, 0x24, 0xb3, 0x80, 0x34, 0xe5, 0x2c, 0xdc, 0x9b,
+      0x3f, 0xca, 0x33, 0x45, 0xd0, 0xdb, 0x5f, 0xf5, 0x52, 0xc3, 0x21, 0xda, 0xe2, 0x22, 0x72, 0x6b,
+      0x3e, 0xd0, 0x5b, 0xa8, 0x87, 0x8c, 0x06, 0x5d, 0x0f, 0xdd, 0x09, 0x19, 0x93, 0xd0, 0xb9, 0xfc,
+      0x8b, 0x0f, 0x84, 0x60, 0x33, 0x1c, 0x9b, 0x45, 0xf1, 0xf0, 0xa3, 0x94, 0x3a, 0x12, 0x77, 0x33,
+      0x4d, 0x44, 0x78, 0x28, 0x3c, 0x9e, 0xfd, 0x65, 0x57, 0x16, 0x94, 0x6b, 0xfb, 0x59, 0xd0, 0xc8,
+      0x22, 0x36, 0xdb, 0xd2, 0x63, 0x98, 0x43, 0xa1, 0x04, 0x87, 0x86, 0xf7, 0xa6, 0x26, 0xbb, 0xd6,
+      0x59, 0x4d, 0xbf, 0x6a, 0x2e, 0xaa, 0x2b, 0xef, 0xe6, 0x78, 0xb6, 0x4e, 0xe0, 0x2f, 0xdc, 0x7c,
+      0xbe, 0x57, 0x19, 0x32, 0x7e, 0x2a, 0xd0, 0xb8, 0xba, 0x29, 0x00, 0x3c, 0x52, 0x7d, 0xa8, 0x49,
+      0x3b, 0x2d, 0xeb, 0x25, 0x49, 0xfa, 0xa3, 0xaa, 0x39, 0xa7, 0xc5, 0xa7, 0x50, 0x11, 0x36, 0xfb,
+      0xc6, 0x67, 0x4a, 0xf5, 0xa5, 0x12, 0x65, 0x7e, 0xb0, 0xdf, 0xaf, 0x4e, 0xb3, 0x61, 0x7f, 0x2f }
+};
+
+// Keyed by the 7 LensData fields from LensIDNumber to MCUVersion followed
+// by the Makernote lens type. Lenses listed twice are reported with and
+// without the E (electromagnetic aperture) or AF-P flags depending on
+// the camera firmware.
+// See https://exiftool.org/TagNames/Nikon.html#LensID.
+static const struct lens_id_entry_t nikon_lens_id_table[] = {
+    { {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01}, "Manual Lens No CPU" },
+    { {0x01, 0x58, 0x50, 0x50, 0x14, 0x14, 0x02, 0x00}, "AF Nikkor 50mm f/1.8" },
+    { {0x01, 0x58, 0x50, 0x50, 0x14, 0x14, 0x05, 0x00}, "AF Nikkor 50mm f/1.8" },
+    { {0x02, 0x42, 0x44, 0x5C, 0x2A, 0x34, 0x02, 0x00}, "AF Zoom-Nikkor 35-70mm f/3.3-4.5" },
+    { {0x02, 0x42, 0x44, 0x5C, 0x2A, 0x34, 0x08, 0x00}, "AF Zoom-Nikkor 35-70mm f/3.3-4.5" },
+    { {0x03, 0x48, 0x5C, 0x81, 0x30, 0x30, 0x02, 0x00}, "AF Zoom-Nikkor 70-210mm f/4" },
+    { {0x04, 0x48, 0x3C, 0x3C, 0x24, 0x24, 0x03, 0x00}, "AF Nikkor 28mm f/2.8" },
+    { {0x05, 0x54, 0x50, 0x50, 0x0C, 0x0C, 0x04, 0x00}, "AF Nikkor 50mm f/1.4" },
+    { {0x06, 0x54, 0x53, 0x53, 0x24, 0x24, 0x06, 0x00}, "AF Micro-Nikkor 55mm f/2.8" },
+    { {0x07, 0x40, 0x3C, 0x62, 0x2C, 0x34, 0x03, 0x00}, "AF Zoom-Nikkor 28-85mm f/3.5-4.5" },
+    { {0x08, 0x40, 0x44, 0x6A, 0x2C, 0x34, 0x04, 0x00}, "AF Zoom-Nikkor 35-105mm f/3.5-4.5" },
+    { {0x09, 0x48, 0x37, 0x37, 0x24, 0x24, 0x04, 0x00}, "AF Nikkor 24mm f/2.8" },
+    { {0x0A, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0x03, 0x00}, "AF Nikkor 300mm f/2.8 IF-ED" },
+    { {0x0A, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0x05, 0x00}, "AF Nikkor 300mm f/2.8 IF-ED N" },
+    { {0x0B, 0x48, 0x7C, 0x7C, 0x24, 0x24, 0x05, 0x00}, "AF Nikkor 180mm f/2.8 IF-ED" },
+    { {0x0D, 0x40, 0x44, 0x72, 0x2C, 0x34, 0x07, 0x00}, "AF Zoom-Nikkor 35-135mm f/3.5-4.5" },
+    { {0x0E, 0x48, 0x5C, 0x81, 0x30, 0x30, 0x05, 0x00}, "AF Zoom-Nikkor 70-210mm f/4" },
+    { {0x0F, 0x58, 0x50, 0x50, 0x14, 0x14, 0x05, 0x00}, "AF Nikkor 50mm f/1.8 N" },
+    { {0x10, 0x48, 0x8E, 0x8E, 0x30, 0x30, 0x08, 0x00}, "AF Nikkor 300mm f/4 IF-ED" },
+    { {0x11, 0x48, 0x44, 0x5C, 0x24, 0x24, 0x08, 0x00}, "AF Zoom-Nikkor 35-70mm f/2.8" },
+    { {0x12, 0x48, 0x5C, 0x81, 0x30, 0x3C, 0x09, 0x00}, "AF Nikkor 70-210mm f/4-5.6" },
+    { {0x13, 0x42, 0x37, 0x50, 0x2A, 0x34, 0x0B, 0x00}, "AF Zoom-Nikkor 24-50mm f/3.3-4.5" },
+    { {0x14, 0x48, 0x60, 0x80, 0x24, 0x24, 0x0B, 0x00}, "AF Zoom-Nikkor 80-200mm f/2.8 ED" },
+    { {0x15, 0x4C, 0x62, 0x62, 0x14, 0x14, 0x0C, 0x00}, "AF Nikkor 85mm f/1.8" },
+    { {0x17, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0x0F, 0x00}, "Nikkor 500mm f/4 P ED IF" },
+    { {0x17, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0x11, 0x00}, "Nikkor 500mm f/4 P ED IF" },
+    { {0x18, 0x40, 0x44, 0x72, 0x2C, 0x34, 0x0E, 0x00}, "AF Zoom-Nikkor 35-135mm f/3.5-4.5 N" },
+    { {0x1A, 0x54, 0x44, 0x44, 0x18, 0x18, 0x11, 0x00}, "AF Nikkor 35mm f/2" },
+    { {0x1B, 0x44, 0x5E, 0x8E, 0x34, 0x3C, 0x10, 0x00}, "AF Zoom-Nikkor 75-300mm f/4.5-5.6" },
+    { {0x1C, 0x48, 0x30, 0x30, 0x24, 0x24, 0x12, 0x00}, "AF Nikkor 20mm f/2.8" },
+    { {0x1D, 0x42, 0x44, 0x5C, 0x2A, 0x34, 0x12, 0x00}, "AF Zoom-Nikkor 35-70mm f/3.3-4.5 N" },
+    { {0x1E, 0x54, 0x56, 0x56, 0x24, 0x24, 0x13, 0x00}, "AF Micro-Nikkor 60mm f/2.8" },
+    { {0x1F, 0x54, 0x6A, 0x6A, 0x24, 0x24, 0x14, 0x00}, "AF Micro-Nikkor 105mm f/2.8" },
+    { {0x20, 0x48, 0x60, 0x80, 0x24, 0x24, 0x15, 0x00}, "AF Zoom-Nikkor 80-200mm f/2.8 ED" },
+    { {0x21, 0x40, 0x3C, 0x5C, 0x2C, 0x34, 0x16, 0x00}, "AF Zoom-Nikkor 28-70mm f/3.5-4.5" },
+    { {0x22, 0x48, 0x72, 0x72, 0x18, 0x18, 0x16, 0x00}, "AF DC-Nikkor 135mm f/2" },
+    { {0x23, 0x30, 0xBE, 0xCA, 0x3C, 0x48, 0x17, 0x00}, "Zoom-Nikkor 1200-1700mm f/5.6-8 P ED IF" },
+    { {0x24, 0x48, 0x60, 0x80, 0x24, 0x24, 0x1A, 0x02}, "AF Zoom-Nikkor 80-200mm f/2.8D ED" },
+    { {0x25, 0x48, 0x44, 0x5C, 0x24, 0x24, 0x1B, 0x02}, "AF Zoom-Nikkor 35-70mm f/2.8D" },
+    { {0x25, 0x48, 0x44, 0x5C, 0x24, 0x24, 0x3A, 0x02}, "AF Zoom-Nikkor 35-70mm f/2.8D" },
+    { {0x25, 0x48, 0x44, 0x5C, 0x24, 0x24, 0x52, 0x02}, "AF Zoom-Nikkor 35-70mm f/2.8D" },
+    { {0x26, 0x40, 0x3C, 0x5C, 0x2C, 0x34, 0x1C, 0x02}, "AF Zoom-Nikkor 28-70mm f/3.5-4.5D" },
+    { {0x27, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0x1D, 0x02}, "AF-I Nikkor 300mm f/2.8D IF-ED" },
+    { {0x27, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xF1, 0x02}, "AF-I Nikkor 300mm f/2.8D IF-ED + TC-14E" },
+    { {0x27, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xE1, 0x02}, "AF-I Nikkor 300mm f/2.8D IF-ED + TC-17E" },
+    { {0x27, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xF2, 0x02}, "AF-I Nikkor 300mm f/2.8D IF-ED + TC-20E" },
+    { {0x28, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0x1D, 0x02}, "AF-I Nikkor 600mm f/4D IF-ED" },
+    { {0x28, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xF1, 0x02}, "AF-I Nikkor 600mm f/4D IF-ED + TC-14E" },
+    { {0x28, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xE1, 0x02}, "AF-I Nikkor 600mm f/4D IF-ED + TC-17E" },
+    { {0x28, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xF2, 0x02}, "AF-I Nikkor 600mm f/4D IF-ED + TC-20E" },
+    { {0x2A, 0x54, 0x3C, 0x3C, 0x0C, 0x0C, 0x26, 0x02}, "AF Nikkor 28mm f/1.4D" },
+    { {0x2B, 0x3C, 0x44, 0x60, 0x30, 0x3C, 0x1F, 0x02}, "AF Zoom-Nikkor 35-80mm f/4-5.6D" },
+    { {0x2C, 0x48, 0x6A, 0x6A, 0x18, 0x18, 0x27, 0x02}, "AF DC-Nikkor 105mm f/2D" },
+    { {0x2D, 0x48, 0x80, 0x80, 0x30, 0x30, 0x21, 0x02}, "AF Micro-Nikkor 200mm f/4D IF-ED" },
+    { {0x2E, 0x48, 0x5C, 0x82, 0x30, 0x3C, 0x22, 0x02}, "AF Nikkor 70-210mm f/4-5.6D" },
+    { {0x2E, 0x48, 0x5C, 0x82, 0x30, 0x3C, 0x28, 0x02}, "AF Nikkor 70-210mm f/4-5.6D" },
+    { {0x2F, 0x48, 0x30, 0x44, 0x24, 0x24, 0x29, 0x02}, "AF Zoom-Nikkor 20-35mm f/2.8D IF" },
+    { {0x30, 0x48, 0x98, 0x98, 0x24, 0x24, 0x24, 0x02}, "AF-I Nikkor 400mm f/2.8D IF-ED" },
+    { {0x30, 0x48, 0x98, 0x98, 0x24, 0x24, 0xF1, 0x02}, "AF-I Nikkor 400mm f/2.8D IF-ED + TC-14E" },
+    { {0x30, 0x48, 0x98, 0x98, 0x24, 0x24, 0xE1, 0x02}, "AF-I Nikkor 400mm f/2.8D IF-ED + TC-17E" },
+    { {0x30, 0x48, 0x98, 0x98, 0x24, 0x24, 0xF2, 0x02}, "AF-I Nikkor 400mm f/2.8D IF-ED + TC-20E" },
+    { {0x31, 0x54, 0x56, 0x56, 0x24, 0x24, 0x25, 0x02}, "AF Micro-Nikkor 60mm f/2.8D" },
+    { {0x32, 0x54, 0x6A, 0x6A, 0x24, 0x24, 0x35, 0x02}, "AF Micro-Nikkor 105mm f/2.8D" },
+    { {0x33, 0x48, 0x2D, 0x2D, 0x24, 0x24, 0x31, 0x02}, "AF Nikkor 18mm f/2.8D" },
+    { {0x34, 0x48, 0x29, 0x29, 0x24, 0x24, 0x32, 0x02}, "AF Fisheye Nikkor 16mm f/2.8D" },
+    { {0x35, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0x33, 0x02}, "AF-I Nikkor 500mm f/4D IF-ED" },
+    { {0x35, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xF1, 0x02}, "AF-I Nikkor 500mm f/4D IF-ED + TC-14E" },
+    { {0x35, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xE1, 0x02}, "AF-I Nikkor 500mm f/4D IF-ED + TC-17E" },
+    { {0x35, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xF2, 0x02}, "AF-I Nikkor 500mm f/4D IF-ED + TC-20E" },
+    { {0x36, 0x48, 0x37, 0x37, 0x24, 0x24, 0x34, 0x02}, "AF Nikkor 24mm f/2.8D" },
+    { {0x37, 0x48, 0x30, 0x30, 0x24, 0x24, 0x36, 0x02}, "AF Nikkor 20mm f/2.8D" },
+    { {0x38, 0x4C, 0x62, 0x62, 0x14, 0x14, 0x37, 0x02}, "AF Nikkor 85mm f/1.8D" },
+    { {0x3A, 0x40, 0x3C, 0x5C, 0x2C, 0x34, 0x39, 0x02}, "AF Zoom-Nikkor 28-70mm f/3.5-4.5D" },
+    { {0x3B, 0x48, 0x44, 0x5C, 0x24, 0x24, 0x3A, 0x02}, "AF Zoom-Nikkor 35-70mm f/2.8D N" },
+    { {0x3C, 0x48, 0x60, 0x80, 0x24, 0x24, 0x3B, 0x02}, "AF Zoom-Nikkor 80-200mm f/2.8D ED" },
+    { {0x3D, 0x3C, 0x44, 0x60, 0x30, 0x3C, 0x3E, 0x02}, "AF Zoom-Nikkor 35-80mm f/4-5.6D" },
+    { {0x3E, 0x48, 0x3C, 0x3C, 0x24, 0x24, 0x3D, 0x02}, "AF Nikkor 28mm f/2.8D" },
+    { {0x3F, 0x40, 0x44, 0x6A, 0x2C, 0x34, 0x45, 0x02}, "AF Zoom-Nikkor 35-105mm f/3.5-4.5D" },
+    { {0x41, 0x48, 0x7C, 0x7C, 0x24, 0x24, 0x43, 0x02}, "AF Nikkor 180mm f/2.8D IF-ED" },
+    { {0x42, 0x54, 0x44, 0x44, 0x18, 0x18, 0x44, 0x02}, "AF Nikkor 35mm f/2D" },
+    { {0x43, 0x54, 0x50, 0x50, 0x0C, 0x0C, 0x46, 0x02}, "AF Nikkor 50mm f/1.4D" },
+    { {0x44, 0x44, 0x60, 0x80, 0x34, 0x3C, 0x47, 0x02}, "AF Zoom-Nikkor 80-200mm f/4.5-5.6D" },
+    { {0x45, 0x40, 0x3C, 0x60, 0x2C, 0x3C, 0x48, 0x02}, "AF Zoom-Nikkor 28-80mm f/3.5-5.6D" },
+    { {0x46, 0x3C, 0x44, 0x60, 0x30, 0x3C, 0x49, 0x02}, "AF Zoom-Nikkor 35-80mm f/4-5.6D" },
+    { {0x47, 0x42, 0x37, 0x50, 0x2A, 0x34, 0x4A, 0x02}, "AF Zoom-Nikkor 24-50mm f/3.3-4.5D" },
+    { {0x48, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0x4B, 0x02}, "AF-S Nikkor 300mm f/2.8D IF-ED" },
+    { {0x48, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xF1, 0x02}, "AF-S Nikkor 300mm f/2.8D IF-ED + TC-14E" },
+    { {0x48, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xE1, 0x02}, "AF-S Nikkor 300mm f/2.8D IF-ED + TC-17E" },
+    { {0x48, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xF2, 0x02}, "AF-S Nikkor 300mm f/2.8D IF-ED + TC-20E" },
+    { {0x49, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0x4C, 0x02}, "AF-S Nikkor 600mm f/4D IF-ED" },
+    { {0x49, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xF1, 0x02}, "AF-S Nikkor 600mm f/4D IF-ED + TC-14E" },
+    { {0x49, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xE1, 0x02}, "AF-S Nikkor 600mm f/4D IF-ED + TC-17E" },
+    { {0x49, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xF2, 0x02}, "AF-S Nikkor 600mm f/4D IF-ED + TC-20E" },
+    { {0x4A, 0x54, 0x62, 0x62, 0x0C, 0x0C, 0x4D, 0x02}, "AF Nikkor 85mm f/1.4D IF" },
+    { {0x4B, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0x4E, 0x02}, "AF-S Nikkor 500mm f/4D IF-ED" },
+    { {0x4B, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xF1, 0x02}, "AF-S Nikkor 500mm f/4D IF-ED + TC-14E" },
+    { {0x4B, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xE1, 0x02}, "AF-S Nikkor 500mm f/4D IF-ED + TC-17E" },
+    { {0x4B, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xF2, 0x02}, "AF-S Nikkor 500mm f/4D IF-ED + TC-20E" },
+    { {0x4C, 0x40, 0x37, 0x6E, 0x2C, 0x3C, 0x4F, 0x02}, "AF Zoom-Nikkor 24-120mm f/3.5-5.6D IF" },
+    { {0x4D, 0x40, 0x3C, 0x80, 0x2C, 0x3C, 0x62, 0x02}, "AF Zoom-Nikkor 28-200mm f/3.5-5.6D IF" },
+    { {0x4E, 0x48, 0x72, 0x72, 0x18, 0x18, 0x51, 0x02}, "AF DC-Nikkor 135mm f/2D" },
+    { {0x4F, 0x40, 0x37, 0x5C, 0x2C, 0x3C, 0x53, 0x06}, "IX-Nikkor 24-70mm f/3.5-5.6" },
+    { {0x50, 0x48, 0x56, 0x7C, 0x30, 0x3C, 0x54, 0x06}, "IX-Nikkor 60-180mm f/4-5.6" },
+    { {0x53, 0x48, 0x60, 0x80, 0x24, 0x24, 0x57, 0x02}, "AF Zoom-Nikkor 80-200mm f/2.8D ED" },
+    { {0x53, 0x48, 0x60, 0x80, 0x24, 0x24, 0x60, 0x02}, "AF Zoom-Nikkor 80-200mm f/2.8D ED" },
+    { {0x54, 0x44, 0x5C, 0x7C, 0x34, 0x3C, 0x58, 0x02}, "AF Zoom-Micro Nikkor 70-180mm f/4.5-5.6D ED" },
+    { {0x54, 0x44, 0x5C, 0x7C, 0x34, 0x3C, 0x61, 0x02}, "AF Zoom-Micro Nikkor 70-180mm f/4.5-5.6D ED" },
+    { {0x56, 0x48, 0x5C, 0x8E, 0x30, 0x3C, 0x5A, 0x02}, "AF Zoom-Nikkor 70-300mm f/4-5.6D ED" },
+    { {0x59, 0x48, 0x98, 0x98, 0x24, 0x24, 0x5D, 0x02}, "AF-S Nikkor 400mm f/2.8D IF-ED" },
+    { {0x59, 0x48, 0x98, 0x98, 0x24, 0x24, 0xF1, 0x02}, "AF-S Nikkor 400mm f/2.8D IF-ED + TC-14E" },
+    { {0x59, 0x48, 0x98, 0x98, 0x24, 0x24, 0xE1, 0x02}, "AF-S Nikkor 400mm f/2.8D IF-ED + TC-17E" },
+    { {0x59, 0x48, 0x98, 0x98, 0x24, 0x24, 0xF2, 0x02}, "AF-S Nikkor 400mm f/2.8D IF-ED + TC-20E" },
+    { {0x5A, 0x3C, 0x3E, 0x56, 0x30, 0x3C, 0x5E, 0x06}, "IX-Nikkor 30-60mm f/4-5.6" },
+    { {0x5B, 0x44, 0x56, 0x7C, 0x34, 0x3C, 0x5F, 0x06}, "IX-Nikkor 60-180mm f/4.5-5.6" },
+    { {0x5D, 0x48, 0x3C, 0x5C, 0x24, 0x24, 0x63, 0x02}, "AF-S Zoom-Nikkor 28-70mm f/2.8D IF-ED" },
+    { {0x5E, 0x48, 0x60, 0x80, 0x24, 0x24, 0x64, 0x02}, "AF-S Zoom-Nikkor 80-200mm f/2.8D IF-ED" },
+    { {0x5F, 0x40, 0x3C, 0x6A, 0x2C, 0x34, 0x65, 0x02}, "AF Zoom-Nikkor 28-105mm f/3.5-4.5D IF" },
+    { {0x60, 0x40, 0x3C, 0x60, 0x2C, 0x3C, 0x66, 0x02}, "AF Zoom-Nikkor 28-80mm f/3.5-5.6D" },
+    { {0x61, 0x44, 0x5E, 0x86, 0x34, 0x3C, 0x67, 0x02}, "AF Zoom-Nikkor 75-240mm f/4.5-5.6D" },
+    { {0x63, 0x48, 0x2B, 0x44, 0x24, 0x24, 0x68, 0x02}, "AF-S Nikkor 17-35mm f/2.8D IF-ED" },
+    { {0x64, 0x00, 0x62, 0x62, 0x24, 0x24, 0x6A, 0x02}, "PC Micro-Nikkor 85mm f/2.8D" },
+    { {0x65, 0x44, 0x60, 0x98, 0x34, 0x3C, 0x6B, 0x0A}, "AF VR Zoom-Nikkor 80-400mm f/4.5-5.6D ED" },
+    { {0x66, 0x40, 0x2D, 0x44, 0x2C, 0x34, 0x6C, 0x02}, "AF Zoom-Nikkor 18-35mm f/3.5-4.5D IF-ED" },
+    { {0x67, 0x48, 0x37, 0x62, 0x24, 0x30, 0x6D, 0x02}, "AF Zoom-Nikkor 24-85mm f/2.8-4D IF" },
+    { {0x68, 0x42, 0x3C, 0x60, 0x2A, 0x3C, 0x6E, 0x06}, "AF Zoom-Nikkor 28-80mm f/3.3-5.6G" },
+    { {0x69, 0x48, 0x5C, 0x8E, 0x30, 0x3C, 0x6F, 0x06}, "AF Zoom-Nikkor 70-300mm f/4-5.6G" },
+    { {0x6A, 0x48, 0x8E, 0x8E, 0x30, 0x30, 0x70, 0x02}, "AF-S Nikkor 300mm f/4D IF-ED" },
+    { {0x6B, 0x48, 0x24, 0x24, 0x24, 0x24, 0x71, 0x02}, "AF Nikkor ED 14mm f/2.8D" },
+    { {0x6D, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0x73, 0x02}, "AF-S Nikkor 300mm f/2.8D IF-ED II" },
+    { {0x6E, 0x48, 0x98, 0x98, 0x24, 0x24, 0x74, 0x02}, "AF-S Nikkor 400mm f/2.8D IF-ED II" },
+    { {0x6F, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0x75, 0x02}, "AF-S Nikkor 500mm f/4D IF-ED II" },
+    { {0x70, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0x76, 0x02}, "AF-S Nikkor 600mm f/4D IF-ED II" },
+    { {0x72, 0x48, 0x4C, 0x4C, 0x24, 0x24, 0x77, 0x00}, "Nikkor 45mm f/2.8 P" },
+    { {0x74, 0x40, 0x37, 0x62, 0x2C, 0x34, 0x78, 0x06}, "AF-S Zoom-Nikkor 24-85mm f/3.5-4.5G IF-ED" },
+    { {0x75, 0x40, 0x3C, 0x68, 0x2C, 0x3C, 0x79, 0x06}, "AF Zoom-Nikkor 28-100mm f/3.5-5.6G" },
+    { {0x76, 0x58, 0x50, 0x50, 0x14, 0x14, 0x7A, 0x02}, "AF Nikkor 50mm f/1.8D" },
+    { {0x77, 0x48, 0x5C, 0x80, 0x24, 0x24, 0x7B, 0x0E}, "AF-S VR Zoom-Nikkor 70-200mm f/2.8G IF-ED" },
+    { {0x78, 0x40, 0x37, 0x6E, 0x2C, 0x3C, 0x7C, 0x0E}, "AF-S VR Zoom-Nikkor 24-120mm f/3.5-5.6G IF-ED" },
+    { {0x79, 0x40, 0x3C, 0x80, 0x2C, 0x3C, 0x7F, 0x06}, "AF Zoom-Nikkor 28-200mm f/3.5-5.6G IF-ED" },
+    { {0x7A, 0x3C, 0x1F, 0x37, 0x30, 0x30, 0x7E, 0x06}, "AF-S DX Zoom-Nikkor 12-24mm f/4G IF-ED" },
+    { {0x7B, 0x48, 0x80, 0x98, 0x30, 0x30, 0x80, 0x0E}, "AF-S VR Zoom-Nikkor 200-400mm f/4G IF-ED" },
+    { {0x7D, 0x48, 0x2B, 0x53, 0x24, 0x24, 0x82, 0x06}, "AF-S DX Zoom-Nikkor 17-55mm f/2.8G IF-ED" },
+    { {0x7F, 0x40, 0x2D, 0x5C, 0x2C, 0x34, 0x84, 0x06}, "AF-S DX Zoom-Nikkor 18-70mm f/3.5-4.5G IF-ED" },
+    { {0x80, 0x48, 0x1A, 0x1A, 0x24, 0x24, 0x85, 0x06}, "AF DX Fisheye-Nikkor 10.5mm f/2.8G ED" },
+    { {0x81, 0x54, 0x80, 0x80, 0x18, 0x18, 0x86, 0x0E}, "AF-S VR Nikkor 200mm f/2G IF-ED" },
+    { {0x82, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0x87, 0x0E}, "AF-S VR Nikkor 300mm f/2.8G IF-ED" },
+    { {0x89, 0x3C, 0x53, 0x80, 0x30, 0x3C, 0x8B, 0x06}, "AF-S DX Zoom-Nikkor 55-200mm f/4-5.6G ED" },
+    { {0x8A, 0x54, 0x6A, 0x6A, 0x24, 0x24, 0x8C, 0x0E}, "AF-S VR Micro-Nikkor 105mm f/2.8G IF-ED" },
+    { {0x8B, 0x40, 0x2D, 0x80, 0x2C, 0x3C, 0x8D, 0x0E}, "AF-S DX VR Zoom-Nikkor 18-200mm f/3.5-5.6G IF-ED" },
+    { {0x8B, 0x40, 0x2D, 0x80, 0x2C, 0x3C, 0xFD, 0x0E}, "AF-S DX VR Zoom-Nikkor 18-200mm f/3.5-5.6G IF-ED [II]" },
+    { {0x8C, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0x8E, 0x06}, "AF-S DX Zoom-Nikkor 18-55mm f/3.5-5.6G ED" },
+    { {0x8D, 0x44, 0x5C, 0x8E, 0x34, 0x3C, 0x8F, 0x0E}, "AF-S VR Zoom-Nikkor 70-300mm f/4.5-5.6G IF-ED" },
+    { {0x8F, 0x40, 0x2D, 0x72, 0x2C, 0x3C, 0x91, 0x06}, "AF-S DX Zoom-Nikkor 18-135mm f/3.5-5.6G IF-ED" },
+    { {0x90, 0x3B, 0x53, 0x80, 0x30, 0x3C, 0x92, 0x0E}, "AF-S DX VR Zoom-Nikkor 55-200mm f/4-5.6G IF-ED" },
+    { {0x92, 0x48, 0x24, 0x37, 0x24, 0x24, 0x94, 0x06}, "AF-S Zoom-Nikkor 14-24mm f/2.8G ED" },
+    { {0x93, 0x48, 0x37, 0x5C, 0x24, 0x24, 0x95, 0x06}, "AF-S Zoom-Nikkor 24-70mm f/2.8G ED" },
+    { {0x94, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0x96, 0x06}, "AF-S DX Zoom-Nikkor 18-55mm f/3.5-5.6G ED II" },
+    { {0x95, 0x4C, 0x37, 0x37, 0x2C, 0x2C, 0x97, 0x02}, "PC-E Nikkor 24mm f/3.5D ED" },
+    { {0x95, 0x00, 0x37, 0x37, 0x2C, 0x2C, 0x97, 0x06}, "PC-E Nikkor 24mm f/3.5D ED" },
+    { {0x96, 0x48, 0x98, 0x98, 0x24, 0x24, 0x98, 0x0E}, "AF-S VR Nikkor 400mm f/2.8G ED" },
+    { {0x97, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0x99, 0x0E}, "AF-S VR Nikkor 500mm f/4G ED" },
+    { {0x98, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0x9A, 0x0E}, "AF-S VR Nikkor 600mm f/4G ED" },
+    { {0x99, 0x40, 0x29, 0x62, 0x2C, 0x3C, 0x9B, 0x0E}, "AF-S DX VR Zoom-Nikkor 16-85mm f/3.5-5.6G ED" },
+    { {0x9A, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0x9C, 0x0E}, "AF-S DX VR Zoom-Nikkor 18-55mm f/3.5-5.6G" },
+    { {0x9B, 0x54, 0x4C, 0x4C, 0x24, 0x24, 0x9D, 0x02}, "PC-E Micro Nikkor 45mm f/2.8D ED" },
+    { {0x9B, 0x00, 0x4C, 0x4C, 0x24, 0x24, 0x9D, 0x06}, "PC-E Micro Nikkor 45mm f/2.8D ED" },
+    { {0x9C, 0x54, 0x56, 0x56, 0x24, 0x24, 0x9E, 0x06}, "AF-S Micro Nikkor 60mm f/2.8G ED" },
+    { {0x9D, 0x54, 0x62, 0x62, 0x24, 0x24, 0x9F, 0x02}, "PC-E Micro Nikkor 85mm f/2.8D" },
+    { {0x9D, 0x00, 0x62, 0x62, 0x24, 0x24, 0x9F, 0x06}, "PC-E Micro Nikkor 85mm f/2.8D" },
+    { {0x9E, 0x40, 0x2D, 0x6A, 0x2C, 0x3C, 0xA0, 0x0E}, "AF-S DX VR Zoom-Nikkor 18-105mm f/3.5-5.6G ED" },
+    { {0x9F, 0x58, 0x44, 0x44, 0x14, 0x14, 0xA1, 0x06}, "AF-S DX Nikkor 35mm f/1.8G" },
+    { {0xA0, 0x54, 0x50, 0x50, 0x0C, 0x0C, 0xA2, 0x06}, "AF-S Nikkor 50mm f/1.4G" },
+    { {0xA1, 0x40, 0x18, 0x37, 0x2C, 0x34, 0xA3, 0x06}, "AF-S DX Nikkor 10-24mm f/3.5-4.5G ED" },
+    { {0xA2, 0x48, 0x5C, 0x80, 0x24, 0x24, 0xA4, 0x0E}, "AF-S Nikkor 70-200mm f/2.8G ED VR II" },
+    { {0xA3, 0x3C, 0x29, 0x44, 0x30, 0x30, 0xA5, 0x0E}, "AF-S Nikkor 16-35mm f/4G ED VR" },
+    { {0xA4, 0x54, 0x37, 0x37, 0x0C, 0x0C, 0xA6, 0x06}, "AF-S Nikkor 24mm f/1.4G ED" },
+    { {0xA5, 0x40, 0x3C, 0x8E, 0x2C, 0x3C, 0xA7, 0x0E}, "AF-S Nikkor 28-300mm f/3.5-5.6G ED VR" },
+    { {0xA6, 0x48, 0x8E, 0x8E, 0x24, 0x24, 0xA8, 0x0E}, "AF-S Nikkor 300mm f/2.8G IF-ED VR II" },
+    { {0xA7, 0x4B, 0x62, 0x62, 0x2C, 0x2C, 0xA9, 0x0E}, "AF-S DX Micro Nikkor 85mm f/3.5G ED VR" },
+    { {0xA8, 0x48, 0x80, 0x98, 0x30, 0x30, 0xAA, 0x0E}, "AF-S Zoom-Nikkor 200-400mm f/4G IF-ED VR II" },
+    { {0xA9, 0x54, 0x80, 0x80, 0x18, 0x18, 0xAB, 0x0E}, "AF-S Nikkor 200mm f/2G ED VR II" },
+    { {0xAA, 0x3C, 0x37, 0x6E, 0x30, 0x30, 0xAC, 0x0E}, "AF-S Nikkor 24-120mm f/4G ED VR" },
+    { {0xAC, 0x38, 0x53, 0x8E, 0x34, 0x3C, 0xAE, 0x0E}, "AF-S DX Nikkor 55-300mm f/4.5-5.6G ED VR" },
+    { {0xAD, 0x3C, 0x2D, 0x8E, 0x2C, 0x3C, 0xAF, 0x0E}, "AF-S DX Nikkor 18-300mm f/3.5-5.6G ED VR" },
+    { {0xAE, 0x54, 0x62, 0x62, 0x0C, 0x0C, 0xB0, 0x06}, "AF-S Nikkor 85mm f/1.4G" },
+    { {0xAF, 0x54, 0x44, 0x44, 0x0C, 0x0C, 0xB1, 0x06}, "AF-S Nikkor 35mm f/1.4G" },
+    { {0xB0, 0x4C, 0x50, 0x50, 0x14, 0x14, 0xB2, 0x06}, "AF-S Nikkor 50mm f/1.8G" },
+    { {0xB1, 0x48, 0x48, 0x48, 0x24, 0x24, 0xB3, 0x06}, "AF-S DX Micro Nikkor 40mm f/2.8G" },
+    { {0xB2, 0x48, 0x5C, 0x80, 0x30, 0x30, 0xB4, 0x0E}, "AF-S Nikkor 70-200mm f/4G ED VR" },
+    { {0xB3, 0x4C, 0x62, 0x62, 0x14, 0x14, 0xB5, 0x06}, "AF-S Nikkor 85mm f/1.8G" },
+    { {0xB4, 0x40, 0x37, 0x62, 0x2C, 0x34, 0xB6, 0x0E}, "AF-S Zoom-Nikkor 24-85mm f/3.5-4.5G IF-ED VR" },
+    { {0xB5, 0x4C, 0x3C, 0x3C, 0x14, 0x14, 0xB7, 0x06}, "AF-S Nikkor 28mm f/1.8G" },
+    { {0xB6, 0x3C, 0xB0, 0xB0, 0x3C, 0x3C, 0xB8, 0x0E}, "AF-S VR Nikkor 800mm f/5.6E FL ED" },
+    { {0xB6, 0x3C, 0xB0, 0xB0, 0x3C, 0x3C, 0xB8, 0x4E}, "AF-S VR Nikkor 800mm f/5.6E FL ED" },
+    { {0xB7, 0x44, 0x60, 0x98, 0x34, 0x3C, 0xB9, 0x0E}, "AF-S Nikkor 80-400mm f/4.5-5.6G ED VR" },
+    { {0xB8, 0x40, 0x2D, 0x44, 0x2C, 0x34, 0xBA, 0x06}, "AF-S Nikkor 18-35mm f/3.5-4.5G ED" },
+    { {0xA0, 0x40, 0x2D, 0x74, 0x2C, 0x3C, 0xBB, 0x0E}, "AF-S DX Nikkor 18-140mm f/3.5-5.6G ED VR" },
+    { {0xA1, 0x54, 0x55, 0x55, 0x0C, 0x0C, 0xBC, 0x06}, "AF-S Nikkor 58mm f/1.4G" },
+    { {0xA2, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0xBD, 0x0E}, "AF-S DX VR Nikkor 18-55mm f/3.5-5.6G II" },
+    { {0xA4, 0x40, 0x2D, 0x8E, 0x2C, 0x40, 0xBF, 0x0E}, "AF-S DX Nikkor 18-300mm f/3.5-6.3G ED VR" },
+    { {0xA5, 0x4C, 0x44, 0x44, 0x14, 0x14, 0xC0, 0x06}, "AF-S Nikkor 35mm f/1.8G ED" },
+    { {0xA6, 0x48, 0x98, 0x98, 0x24, 0x24, 0xC1, 0x0E}, "AF-S Nikkor 400mm f/2.8E FL ED VR" },
+    { {0xA7, 0x3C, 0x53, 0x80, 0x30, 0x3C, 0xC2, 0x0E}, "AF-S DX Nikkor 55-200mm f/4-5.6G ED VR II" },
+    { {0xA8, 0x48, 0x8E, 0x8E, 0x30, 0x30, 0xC3, 0x0E}, "AF-S Nikkor 300mm f/4E PF ED VR" },
+    { {0xA8, 0x48, 0x8E, 0x8E, 0x30, 0x30, 0xC3, 0x4E}, "AF-S Nikkor 300mm f/4E PF ED VR" },
+    { {0xA9, 0x4C, 0x31, 0x31, 0x14, 0x14, 0xC4, 0x06}, "AF-S Nikkor 20mm f/1.8G ED" },
+    { {0xAA, 0x48, 0x37, 0x5C, 0x24, 0x24, 0xC5, 0x0E}, "AF-S Nikkor 24-70mm f/2.8E ED VR" },
+    { {0xAA, 0x48, 0x37, 0x5C, 0x24, 0x24, 0xC5, 0x4E}, "AF-S Nikkor 24-70mm f/2.8E ED VR" },
+    { {0xAB, 0x3C, 0xA0, 0xA0, 0x30, 0x30, 0xC6, 0x4E}, "AF-S Nikkor 500mm f/4E FL ED VR" },
+    { {0xAC, 0x3C, 0xA6, 0xA6, 0x30, 0x30, 0xC7, 0x4E}, "AF-S Nikkor 600mm f/4E FL ED VR" },
+    { {0xAD, 0x48, 0x28, 0x60, 0x24, 0x30, 0xC8, 0x0E}, "AF-S DX Nikkor 16-80mm f/2.8-4E ED VR" },
+    { {0xAD, 0x48, 0x28, 0x60, 0x24, 0x30, 0xC8, 0x4E}, "AF-S DX Nikkor 16-80mm f/2.8-4E ED VR" },
+    { {0xAE, 0x3C, 0x80, 0xA0, 0x3C, 0x3C, 0xC9, 0x0E}, "AF-S Nikkor 200-500mm f/5.6E ED VR" },
+    { {0xAE, 0x3C, 0x80, 0xA0, 0x3C, 0x3C, 0xC9, 0x4E}, "AF-S Nikkor 200-500mm f/5.6E ED VR" },
+    { {0xA0, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0xCA, 0x0E}, "AF-P DX Nikkor 18-55mm f/3.5-5.6G VR" },
+    { {0xA0, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0xCA, 0x8E}, "AF-P DX Nikkor 18-55mm f/3.5-5.6G VR" },
+    { {0xA1, 0x40, 0x2D, 0x53, 0x2C, 0x3C, 0xCB, 0x86}, "AF-P DX Nikkor 18-55mm f/3.5-5.6G" },
+    { {0xAF, 0x4C, 0x37, 0x37, 0x14, 0x14, 0xCC, 0x06}, "AF-S Nikkor 24mm f/1.8G ED" },
+    { {0xA2, 0x38, 0x5C, 0x8E, 0x34, 0x40, 0xCD, 0x86}, "AF-P DX Nikkor 70-300mm f/4.5-6.3G ED" },
+    { {0xA3, 0x38, 0x5C, 0x8E, 0x34, 0x40, 0xCE, 0x0E}, "AF-P DX Nikkor 70-300mm f/4.5-6.3G ED VR" },
+    { {0xA3, 0x38, 0x5C, 0x8E, 0x34, 0x40, 0xCE, 0x8E}, "AF-P DX Nikkor 70-300mm f/4.5-6.3G ED VR" },
+    { {0xA4, 0x48, 0x5C, 0x80, 0x24, 0x24, 0xCF, 0x0E}, "AF-S Nikkor 70-200mm f/2.8E FL ED VR" },
+    { {0xA4, 0x48, 0x5C, 0x80, 0x24, 0x24, 0xCF, 0x4E}, "AF-S Nikkor 70-200mm f/2.8E FL ED VR" },
+    { {0xA5, 0x54, 0x6A, 0x6A, 0x0C, 0x0C, 0xD0, 0x06}, "AF-S Nikkor 105mm f/1.4E ED" },
+    { {0xA5, 0x54, 0x6A, 0x6A, 0x0C, 0x0C, 0xD0, 0x46}, "AF-S Nikkor 105mm f/1.4E ED" },
+    { {0xA6, 0x48, 0x2F, 0x2F, 0x30, 0x30, 0xD1, 0x06}, "PC Nikkor 19mm f/4E ED" },
+    { {0xA6, 0x48, 0x2F, 0x2F, 0x30, 0x30, 0xD1, 0x46}, "PC Nikkor 19mm f/4E ED" },
+    { {0xA7, 0x40, 0x11, 0x26, 0x2C, 0x34, 0xD2, 0x06}, "AF-S Fisheye Nikkor 8-15mm f/3.5-4.5E ED" },
+    { {0xA7, 0x40, 0x11, 0x26, 0x2C, 0x34, 0xD2, 0x46}, "AF-S Fisheye Nikkor 8-15mm f/3.5-4.5E ED" },
+    { {0xA8, 0x38, 0x18, 0x30, 0x34, 0x3C, 0xD3, 0x0E}, "AF-P DX Nikkor 10-20mm f/4.5-5.6G VR" },
+    { {0xA8, 0x38, 0x18, 0x30, 0x34, 0x3C, 0xD3, 0x8E}, "AF-P DX Nikkor 10-20mm f/4.5-5.6G VR" },
+    { {0xA9, 0x48, 0x7C, 0x98, 0x30, 0x30, 0xD4, 0x0E}, "AF-S Nikkor 180-400mm f/4E TC1.4 FL ED VR" },
+    { {0xA9, 0x48, 0x7C, 0x98, 0x30, 0x30, 0xD4, 0x4E}, "AF-S Nikkor 180-400mm f/4E TC1.4 FL ED VR" },
+    { {0xAA, 0x48, 0x88, 0xA4, 0x3C, 0x3C, 0xD5, 0x0E}, "AF-S Nikkor 180-400mm f/4E TC1.4 FL ED VR + 1.4x TC" },
+    { {0xAA, 0x48, 0x88, 0xA4, 0x3C, 0x3C, 0xD5, 0x4E}, "AF-S Nikkor 180-400mm f/4E TC1.4 FL ED VR + 1.4x TC" },
+    { {0xAB, 0x44, 0x5C, 0x8E, 0x34, 0x3C, 0xD6, 0x0E}, "AF-P Nikkor 70-300mm f/4.5-5.6E ED VR" },
+    { {0xAB, 0x44, 0x5C, 0x8E, 0x34, 0x3C, 0xD6, 0xCE}, "AF-P Nikkor 70-300mm f/4.5-5.6E ED VR" },
+    { {0xAC, 0x54, 0x3C, 0x3C, 0x0C, 0x0C, 0xD7, 0x06}, "AF-S Nikkor 28mm f/1.4E ED" },
+    { {0xAC, 0x54, 0x3C, 0x3C, 0x0C, 0x0C, 0xD7, 0x46}, "AF-S Nikkor 28mm f/1.4E ED" },
+    { {0xAD, 0x3C, 0xA0, 0xA0, 0x3C, 0x3C, 0xD8, 0x0E}, "AF-S Nikkor 500mm f/5.6E PF ED VR" },
+    { {0xAD, 0x3C, 0xA0, 0xA0, 0x3C, 0x3C, 0xD8, 0x4E}, "AF-S Nikkor 500mm f/5.6E PF ED VR" },
+    { {0xE3, 0x40, 0x76, 0xA6, 0x38, 0x40, 0xDF, 0x0E}, "Tamron SP 150-600mm f/5-6.3 Di VC USD G2" },
+    { {0xE3, 0x40, 0x76, 0xA6, 0x38, 0x40, 0xDF, 0x4E}, "Tamron SP 150-600mm f/5-6.3 Di VC USD G2" },
+};
+
+// See https://exiftool.org/TagNames/Nikon.html#LensData0800.
+static const struct z_lens_id_entry_t nikon_z_lens_id_table[] = {
+    { 1,  "Nikkor Z 24-70mm f/4 S" },
+    { 2,  "Nikkor Z 14-30mm f/4 S" },
+    { 4,  "Nikkor Z 35mm f/1.8 S" },
+    { 8,  "Nikkor Z 58mm f/0.95 S Noct" },
+    { 9,  "Nikkor Z 50mm f/1.8 S" },
+    { 11, "Nikkor Z DX 16-50mm f/3.5-6.3 VR" },
+    { 12, "Nikkor Z DX 50-250mm f/4.5-6.3 VR" },
+    { 13, "Nikkor Z 24-70mm f/2.8 S" },
+    { 14, "Nikkor Z 85mm f/1.8 S" },
+    { 15, "Nikkor Z 24mm f/1.8 S" },
+    { 16, "Nikkor Z 70-200mm f/2.8 VR S" },
+    { 17, "Nikkor Z 20mm f/1.8 S" },
+    { 18, "Nikkor Z 24-200mm f/4-6.3 VR" },
+    { 21, "Nikkor Z 50mm f/1.2 S" },
+    { 22, "Nikkor Z 24-50mm f/4-6.3" },
+    { 23, "Nikkor Z 14-24mm f/2.8 S" },
+    { 24, "Nikkor Z MC 105mm f/2.8 VR S" },
+    { 25, "Nikkor Z 40mm f/2" },
+    { 26, "Nikkor Z DX 18-140mm f/3.5-6.3 VR" },
+    { 27, "Nikkor Z MC 50mm f/2.8" },
+    { 28, "Nikkor Z 100-400mm f/4.5-5.6 VR S" },
+    { 29, "Nikkor Z 28mm f/2.8" },
+    { 30, "Nikkor Z 400mm f/2.8 TC VR S" },
+    { 31, "Nikkor Z 24-120mm f/4 S" },
+    { 32, "Nikkor Z 800mm f/6.3 VR S" },
+    { 35, "Nikkor Z 28-75mm f/2.8" },
+    { 36, "Nikkor Z 400mm f/4.5 VR S" },
+    { 37, "Nikkor Z 600mm f/4 TC VR S" },
+    { 38, "Nikkor Z 85mm f/1.2 S" },
+    { 39, "Nikkor Z 17-28mm f/2.8" },
+    { 40, "Nikkor Z 26mm f/2.8" },
+    { 41, "Nikkor Z DX 12-28mm f/3.5-5.6 PZ VR" },
+    { 42, "Nikkor Z 180-600mm f/5.6-6.3 VR" },
+    { 43, "Nikkor Z DX 24mm f/1.7" },
+    { 44, "Nikkor Z 70-180mm f/2.8" },
+    { 45, "Nikkor Z 600mm f/6.3 VR S" },
+    { 46, "Nikkor Z 135mm f/1.8 S Plena" },
+    { 47, "Nikkor Z 35mm f/1.2 S" },
+    // With the built-in 1.4x teleconverter engaged
+    { 2001, "Nikkor Z 400mm f/2.8 TC VR S + 1.4x TC" },
+    { 2101, "Nikkor Z 600mm f/4 TC VR S + 1.4x TC" },
+};
+
+/******************************************************************
+                        Lens Data Layouts
+*******************************************************************/
+// LensData layouts ordered by version.
+// See https://exiftool.org/TagNames/Nikon.html#LensData00
+static const struct lens_data_layout_t lens_data_layouts[] = {
+    { LENS_DATA_0100, LENS_DATA_0100, false, 0x0D, decode_lens_data_00   },
+    { LENS_DATA_0101, LENS_DATA_0101, false, 0x12, decode_lens_data_01   },
+    { LENS_DATA_0201, LENS_DATA_0203, true,  0x12, decode_lens_data_01   },
+    { LENS_DATA_0204, LENS_DATA_0204, true,  0x13, decode_lens_data_0204 },
+    { LENS_DATA_0400, LENS_DATA_0401, true,  0x18A + LENS_MODEL_LENGTH, decode_lens_data_0400 },
+    { LENS_DATA_0402, LENS_DATA_0402, true,  0x18B + LENS_MODEL_LENGTH, decode_lens_data_0402 },
+    { LENS_DATA_0403, LENS_DATA_0403, true,  0x2AC + LENS_MODEL_LENGTH, decode_lens_data_0403 },
+    { LENS_DATA_0800, LENS_DATA_0802, true,  0x32, decode_lens_data_0800 },
+};
+
+/******************************************************************
+*
+* \brief Decrypt Nikon lens data information.
+*
+* \details
+*   The key stream is applied with XOR, so encrypting is the same
+*   operation. Algorithm credited to Phil Harvey, creator of the EXIF Tool.
+*   See https://github.com/exiftool/exiftool/blob/master/lib/Image/ExifTool/Nikon.pm.
+*
+* \param[in] data          : Pointer to encrypted data.
+* \param[in] size          : Size of the data (in bytes) to be decrypted.
+* \param[in] serial_number : Camera serial number. Used an encryption key.
+* \param[in] shutter_count : Camera shutter count. Used an encryption key.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+void lens_decrypt(uint8_t* data, uint32_t size, const char* serial_number, uint32_t shutter_count)
+{
+    uint8_t key = 0;
+    uint8_t ci, cj, ck;
+
+    if ((NULL != data) && (size != 0))
+    {
+        // Serial number is used as a key
+        uint64_t serial = strtoull(serial_number, NULL, 10);
+        serial &= 0xFF;
+
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            // Shutter count is used as an encryption key
+            key ^= (shutter_count >> (i * 8)) & 0xFF;
+        }
+
+        ci = xlat[0][serial];
+        cj = xlat[1][key];
+        ck = 0x60;
+
+        // Bound to the widest variant the processor supports
+        cpu_kernels.decrypt(data, size, ci, cj, ck);
+        metrics_count(METRICS_DECRYPT_CALLS, 1);
+    }
+}
+
+/******************************************************************
+*
+* \details Helper function to look up Nikon lens ID in table.
+*
+* \param[in] key : Lens ID key to be matched.
+* \param[out] None
+*
+* \return
+*   Return lens ID information as a string if a match is found.
+*   Otherwise, return NULL.
+*
+*******************************************************************/
+static const char* nikon_lens_id_lookup(const uint8_t* key)
+{
+    const char* id = NULL;
+    // Calculate entries in look up table
+    unsigned int entries = sizeof(nikon_lens_id_table) / sizeof(nikon_lens_id_table[0]);
+
+    for (unsigned i = 0; i < entries; ++i)
+    {
+        if (memcmp(key, nikon_lens_id_table[i].tag, sizeof(nikon_lens_id_table[i].tag)) == 0)
+        {
+            id = nikon_lens_id_table[i].id;
+            break;
+        }
+    }
+
+    if (NULL == id)
+    {
+        metrics_count(METRICS_LENS_LOOKUP_MISSES, 1);
+    }
+
+    return id;
+}
+
+/******************************************************************
+*
+* \details Helper function to look up Nikon Z-mount lens ID in table.
+*
+* \param[in] id : Z-mount lens ID to be matched.
+* \param[out] None
+*
+* \return
+*   Return lens name as a string if a match is found.
+*   Otherwise, return NULL.
+*
+*******************************************************************/
+static const char* nikon_z_lens_id_lookup(uint16_t id)
+{
+    const char* name = NULL;
+    // Calculate entries in look up table
+    unsigned int entries = sizeof(nikon_z_lens_id_table) / sizeof(nikon_z_lens_id_table[0]);
+
+    for (unsigned i = 0; i < entries; ++i)
+    {
+        if (nikon_z_lens_id_table[i].id == id)
+        {
+            name = nikon_z_lens_id_table[i].name;
+            break;
+        }
+    }
+
+    if (NULL == name)
+    {
+        metrics_count(METRICS_LENS_LOOKUP_MISSES, 1);
+    }
+
+    return name;
+}
+
+/******************************************************************
+*
+* \details
+*   Decode the F-mount lens fields starting at the LensIDNumber
+*   offset and look up the Lens ID composite tag. The offset is a
+*   compile-time constant in each layout decoder, so this function
+*   is inlined and specialized per layout.
+*
+* \param[in] data      : Pointer to decrypted lens data.
+* \param[in] id_offset : Offset of the LensIDNumber field.
+* \param[in] lens_type : Makernote lens type. Last byte of the composite tag.
+* \param[out] camera   : Camera data updated with lens information.
+*
+* \return None
+*
+*******************************************************************/
+static inline void decode_lens_id(const uint8_t* data, uint32_t id_offset, uint8_t lens_type, camera_data_t* camera)
+{
+    const uint8_t* fields = &data[id_offset];
+    lens_info_t* info = &camera->lens_info;
+
+    // See https://exiftool.org/TagNames/Nikon.html#LensData01
+    info->id_number = fields[0];
+    info->f_stops = fields[1] / 12.0f;
+    info->min_focal_length = 5.0f * powf(2.0f, fields[2] / 24.0f);
+    info->max_focal_length = 5.0f * powf(2.0f, fields[3] / 24.0f);
+    info->max_aperture_min_focal = powf(2.0f, fields[4] / 24.0f);
+    info->max_aperture_max_focal = powf(2.0f, fields[5] / 24.0f);
+    info->mcu_version = fields[6];
+
+    // Construct Lens ID composite tag
+    // See https://exiftool.org/TagNames/Nikon.html#LensID
+    uint8_t lens_id[8];
+    memcpy_s(lens_id, sizeof(lens_id), fields, LENS_ID_LENGTH);
+    lens_id[7] = lens_type;
+    parse_copy_string(camera->lens, sizeof(camera->lens), nikon_lens_id_lookup(lens_id), MAX_LENS_ID_LENGTH);
+}
+
+/******************************************************************
+*
+* \details
+*   Use the lens model string stored in the lens data. The string
+*   is not guaranteed to be NULL terminated.
+*
+* \param[in] data         : Pointer to decrypted lens data.
+* \param[in] model_offset : Offset of the lens model string.
+* \param[out] camera      : Camera data updated with lens information.
+*
+* \return None
+*
+*******************************************************************/
+static inline void decode_lens_model(const uint8_t* data, uint32_t model_offset, camera_data_t* camera)
+{
+    parse_copy_string(camera->lens, sizeof(camera->lens), (const char*)&data[model_offset], LENS_MODEL_LENGTH);
+}
+
+/******************************************************************
+*
+* \details Layout decoders. See lens_data_layouts for the versions
+*          handled by each decoder.
+*
+* \param[in] lens    : LensData entry, at least the minimum size of
+*                      the layout.
+* \param[out] camera : Camera data updated with lens information.
+*
+* \return None
+*
+*******************************************************************/
+static void decode_lens_data_00(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    decode_lens_id(lens->data, 0x06, lens->lens_type, camera);
+}
+
+static void decode_lens_data_01(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    decode_lens_id(lens->data, 0x0B, lens->lens_type, camera);
+}
+
+static void decode_lens_data_0204(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    decode_lens_id(lens->data, 0x0C, lens->lens_type, camera);
+}
+
+static void decode_lens_data_0400(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    decode_lens_model(lens->data, 0x18A, camera);
+}
+
+static void decode_lens_data_0402(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    decode_lens_model(lens->data, 0x18B, camera);
+}
+
+static void decode_lens_data_0403(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    decode_lens_model(lens->data, 0x2AC, camera);
+}
+
+static void decode_lens_data_0800(const struct lens_data_t* lens, camera_data_t* camera)
+{
+    bool old_lens_data = false;
+
+    // F-mount lenses (e.g. via the FTZ adapter) populate the 0204 fields.
+    // Z-mount lenses leave them zeroed and report a 16-bit lens ID instead.
+    for (unsigned i = 0x04; i < 0x14; ++i)
+    {
+        if (lens->data[i] != 0)
+        {
+            old_lens_data = true;
+            break;
+        }
+    }
+
+    if (old_lens_data)
+    {
+        decode_lens_id(lens->data, 0x0C, lens->lens_type, camera);
+    }
+    else
+    {
+        camera->lens_info.z_lens_id = parse_get16(lens->context, &lens->data[0x30]);
+        parse_copy_string(camera->lens, sizeof(camera->lens), nikon_z_lens_id_lookup(camera->lens_info.z_lens_id), MAX_LENS_ID_LENGTH);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Decode the Nikon LensData Makernote entry using the field layout
+*   matching its version. Encrypted layouts are decrypted in place.
+*
+* \param[in] context   : Parse context, in the byte order of the Makernote.
+* \param[in] data      : Pointer to lens data (including version string).
+* \param[in] size      : Size of the lens data (in bytes).
+* \param[in] lens_type : Makernote lens type.
+* \param[out] record   : Record updated with lens information. Serial
+*                        number and shutter count must already be set.
+*
+* \return None
+*
+*******************************************************************/
+void lens_decode(const parse_context_t* context, uint8_t* data, uint32_t size, uint8_t lens_type, nef_record_t* record)
+{
+    camera_data_t* camera_data = &record->camera;
+    const struct lens_data_layout_t* layout = NULL;
+    char version[LENS_DATA_VERSION_LENGTH + 1];
+
+    if ((NULL != data) && (size > LENS_DATA_VERSION_LENGTH))
+    {
+        strncpy_s(version, sizeof(version), (char*)data, LENS_DATA_VERSION_LENGTH);
+        version[LENS_DATA_VERSION_LENGTH] = '\0'; // Lens data version is not NULL terminated
+        camera_data->lens_info.data_version = (uint16_t)atoi(version);
+
+        for (unsigned i = 0; i < sizeof(lens_data_layouts) / sizeof(lens_data_layouts[0]); ++i)
+        {
+            if ((camera_data->lens_info.data_version >= lens_data_layouts[i].first_version) &&
+                (camera_data->lens_info.data_version <= lens_data_layouts[i].last_version))
+            {
+                layout = &lens_data_layouts[i];
+                break;
+            }
+        }
+    }
+
+    // The decoders read fixed offsets, so short entries are not decoded
+    if ((NULL != layout) && (size >= layout->min_size))
+    {
+        struct lens_data_t lens = { context, data, lens_type };
+        perf_counters_t start;
+
+        if (layout->encrypted)
+        {
+            perf_start(&start);
+            // Encrypted data begins after version string
+            lens_decrypt(&data[LENS_DATA_VERSION_LENGTH], size - LENS_DATA_VERSION_LENGTH, camera_data->serial_number, record->image.shutter_count);
+            perf_stop(&record->profile, PERF_STAGE_DECRYPT, &start);
+        }
+
+        perf_start(&start);
+        layout->decode(&lens, camera_data);
+        perf_stop(&record->profile, PERF_STAGE_LENS_LOOKUP, &start);
+    }
+}
@@ -0,0 +1,52 @@
+/**************************************************************//**
+*
+* \file lens.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Nikon LensData Makernote entry decoding. Each LensData version
+*   range has its own field layout and a decoder specialized for it.
+*
+*******************************************************************/
+
+#ifndef LENS_H_
+#define LENS_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "parse.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Lens data versions (ASCII version string interpreted as a decimal value)
+#define LENS_DATA_0100      100
+#define LENS_DATA_0101      101
+// Lens data is encrypted is version is 201 or greater
+#define LENS_DATA_0201      201
+#define LENS_DATA_0203      203
+#define LENS_DATA_0204      204
+#define LENS_DATA_0400      400
+#define LENS_DATA_0401      401
+#define LENS_DATA_0402      402
+#define LENS_DATA_0403      403
+#define LENS_DATA_0800      800
+#define LENS_DATA_0802      802
+#define LENS_DATA_VERSION_LENGTH 4
+#define LENS_ID_LENGTH      7
+#define LENS_MODEL_LENGTH   64
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+void lens_decrypt(uint8_t* data, uint32_t size, const char* serial_number, uint32_t shutter_count);
+void lens_decode(const parse_context_t* context, uint8_t* data, uint32_t size, uint8_t lens_type, nef_record_t* record);
+
+#endif /* end lens.h */
@@ -0,0 +1,548 @@
+/**************************************************************//**
+*
+* \file makernote.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Makernote handlers of the TIFF based raw formats of other
+*   vendors. Each handler recognises the Makernote header of its
+*   vendor, selects the byte order and offset base the Makernote
+*   uses and extracts the fields the EXIF IFD lacks (serial number,
+*   lens, quality, white balance and focus mode).
+*
+*   Development Resources:
+*       - https://exiftool.org/TagNames/Canon.html
+*       - https://exiftool.org/TagNames/Sony.html
+*       - https://exiftool.org/TagNames/Pentax.html
+*       - https://exiftool.org/TagNames/Olympus.html
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "makernote.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SONY_HEADER_LENGTH          12
+#define PENTAX_AOC_HEADER_LENGTH    6   // "AOC\0" and byte order
+#define PENTAX_HEADER_LENGTH        10  // "PENTAX \0" and byte order
+#define OLYMPUS_HEADER_LENGTH       12  // "OLYMPUS\0", byte order and version
+#define OLYMPUS_OLD_HEADER_LENGTH   8   // "OLYMP\0" and version
+#define OM_SYSTEM_HEADER_LENGTH     16  // "OM SYSTEM\0\0\0", byte order and version
+
+// Canon CameraSettings and ShotInfo array indices
+#define CANON_QUALITY_INDEX         3
+#define CANON_FOCUS_MODE_INDEX      7
+#define CANON_WHITE_BALANCE_INDEX   7
+
+/******************************************************************
+                        Structures
+*******************************************************************/
+// Name of a Makernote value
+struct makernote_name_t
+{
+    uint16_t value;
+    const char* name;
+};
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const struct makernote_name_t canon_quality_names[] = {
+    { 1, "Economy" }, { 2, "Normal" }, { 3, "Fine" }, { 4, "RAW" }, { 5, "Superfine" }, { 7, "CRAW" },
+};
+
+static const struct makernote_name_t canon_focus_mode_names[] = {
+    { 0, "One-shot AF" }, { 1, "AI Servo AF" }, { 2, "AI Focus AF" }, { 3, "Manual Focus" },
+    { 4, "Single" }, { 5, "Continuous" }, { 6, "Manual Focus" },
+};
+
+static const struct makernote_name_t canon_white_balance_names[] = {
+    { 0, "Auto" }, { 1, "Daylight" }, { 2, "Cloudy" }, { 3, "Tungsten" }, { 4, "Fluorescent" },
+    { 5, "Flash" }, { 6, "Custom" }, { 8, "Shade" }, { 9, "Kelvin" },
+};
+
+static const struct makernote_name_t sony_quality_names[] = {
+    { 0, "RAW" }, { 1, "Super Fine" }, { 2, "Fine" }, { 3, "Standard" }, { 4, "Economy" },
+    { 5, "Extra Fine" }, { 6, "RAW + JPEG" }, { 7, "Compressed RAW" }, { 8, "Compressed RAW + JPEG" },
+};
+
+static const struct makernote_name_t sony_white_balance_names[] = {
+    { 0x00, "Auto" }, { 0x01, "Color Temperature" }, { 0x10, "Daylight" }, { 0x20, "Cloudy" },
+    { 0x30, "Shade" }, { 0x40, "Tungsten" }, { 0x50, "Flash" }, { 0x60, "Fluorescent" },
+    { 0x70, "Custom" }, { 0x80, "Underwater" },
+};
+
+static const struct makernote_name_t sony_focus_mode_names[] = {
+    { 0, "Manual" }, { 2, "AF-S" }, { 3, "AF-C" }, { 4, "AF-A" }, { 6, "DMF" },
+};
+
+static const struct makernote_name_t pentax_quality_names[] = {
+    { 0, "Good" }, { 1, "Better" }, { 2, "Best" }, { 3, "TIFF" }, { 4, "RAW" }, { 5, "Premium" },
+    { 7, "RAW (pixel shift)" }, { 8, "Dynamic Pixel Shift" },
+};
+
+static const struct makernote_name_t pentax_focus_mode_names[] = {
+    { 0, "Normal" }, { 1, "Macro" }, { 2, "Infinity" }, { 3, "Manual" }, { 4, "Super Macro" },
+    { 5, "Pan Focus" }, { 16, "AF-S" }, { 17, "AF-C" }, { 18, "AF-A" },
+};
+
+static const struct makernote_name_t pentax_white_balance_names[] = {
+    { 0, "Auto" }, { 1, "Daylight" }, { 2, "Shade" }, { 3, "Fluorescent" }, { 4, "Tungsten" },
+    { 5, "Manual" }, { 9, "Flash" }, { 10, "Cloudy" }, { 14, "Multi Auto" }, { 17, "Kelvin" },
+};
+
+static const struct makernote_name_t olympus_quality_names[] = {
+    { 1, "SQ" }, { 2, "HQ" }, { 3, "SHQ" }, { 4, "RAW" },
+};
+
+static const struct makernote_name_t olympus_focus_mode_names[] = {
+    { 0, "Single AF" }, { 1, "Sequential shooting AF" }, { 2, "Continuous AF" }, { 3, "Multi AF" },
+    { 4, "Face detect" }, { 10, "MF" },
+};
+
+static const struct makernote_name_t olympus_white_balance_names[] = {
+    { 0, "Auto" }, { 16, "Shade" }, { 17, "Cloudy" }, { 18, "Fine Weather" }, { 20, "Tungsten" },
+    { 23, "Flash" }, { 33, "Daylight Fluorescent" }, { 36, "White Fluorescent" }, { 67, "Underwater" },
+};
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static void store_name(char* destination, size_t size, const struct makernote_name_t* names, unsigned count, uint32_t value);
+static bool get_short(parse_context_t* context, struct ifd_entry_t* entry, uint32_t base, unsigned index, uint16_t* value);
+static void parse_olympus_ifd(parse_context_t* context, uint32_t offset, uint32_t base);
+
+/******************************************************************
+*
+* \details Store the name of a Makernote value. Unnamed values are
+*          stored as numbers.
+*
+*******************************************************************/
+static void store_name(char* destination, size_t size, const struct makernote_name_t* names, unsigned count, uint32_t value)
+{
+    const char* name = NULL;
+
+    for (unsigned i = 0; (i < count) && (NULL == name); ++i)
+    {
+        name = (names[i].value == value) ? names[i].name : NULL;
+    }
+
+    if (NULL != name)
+    {
+        strncpy_s(destination, size, name, size - 1);
+    }
+    else
+    {
+        snprintf(destination, size, "%u", value);
+    }
+}
+
+/******************************************************************
+*
+* \details Get an element of a SHORT array entry.
+*
+* \param[in,out] context : Parse context of the image file.
+* \param[in] entry       : Entry read by parse_entry.
+* \param[in] base        : Offset the value offset is relative to.
+* \param[in] index       : Array index.
+* \param[out] value      : Element.
+*
+* \return
+*   Return true if the element exists.
+*
+*******************************************************************/
+static bool get_short(parse_context_t* context, struct ifd_entry_t* entry, uint32_t base, unsigned index, uint16_t* value)
+{
+    bool found = false;
+
+    if ((TIFF_TYPE_SHORT == entry->type) && (index < entry->count))
+    {
+        if (entry->count == 1)
+        {
+            *value = (uint16_t)entry->value;
+            found = true;
+        }
+        else if (entry->count == 2)
+        {
+            // Both elements are stored in the value field, which parse_entry read as a LONG
+            unsigned shift = (context->big_endian ? 1 - index : index) * 16;
+            *value = (uint16_t)(entry->value >> shift);
+            found = true;
+        }
+        else
+        {
+            uint16_t* data = parse_value(context, base + entry->value + index * sizeof(uint16_t), sizeof(uint16_t));
+
+            if (NULL != data)
+            {
+                *value = parse_get16(context, data);
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+/******************************************************************
+*
+* \details
+*   Parse a Canon CR2 Makernote. The Makernote is a plain IFD with
+*   offsets relative to the start of the file.
+*
+* \param[in,out] context : Parse context of the image file.
+*
+* \return
+*   Return true if the Makernote was parsed.
+*
+*******************************************************************/
+bool makernote_canon(parse_context_t* context)
+{
+    nef_record_t* record = context->record;
+    struct ifd_t* ifd = parse_ifd(context, context->makernote_offset, NEF_IFD_MAKERNOTE);
+    unsigned entries = parse_entry_count(context, ifd);
+
+    for (unsigned i = 0; (i < entries) && parse_continue(context); ++i)
+    {
+        struct ifd_entry_t entry;
+        uint16_t value;
+
+        parse_entry(context, ifd, i, &entry);
+        context->tag = entry.tag;
+
+        switch (entry.tag)
+        {
+        case CANON_TAG_CAMERA_SETTINGS:
+        {
+            if (get_short(context, &entry, 0, CANON_QUALITY_INDEX, &value))
+            {
+                store_name(record->image.quality, sizeof(record->image.quality), canon_quality_names,
+                           sizeof(canon_quality_names) / sizeof(canon_quality_names[0]), value);
+            }
+
+            if (get_short(context, &entry, 0, CANON_FOCUS_MODE_INDEX, &value))
+            {
+                store_name(record->image.focus_mode, sizeof(record->image.focus_mode), canon_focus_mode_names,
+                           sizeof(canon_focus_mode_names) / sizeof(canon_focus_mode_names[0]), value);
+            }
+            break;
+        }
+        case CANON_TAG_SHOT_INFO:
+        {
+            if (get_short(context, &entry, 0, CANON_WHITE_BALANCE_INDEX, &value))
+            {
+                store_name(record->image.white_balance, sizeof(record->image.white_balance), canon_white_balance_names,
+                           sizeof(canon_white_balance_names) / sizeof(canon_white_balance_names[0]), value);
+            }
+            break;
+        }
+        case CANON_TAG_SERIAL_NUMBER:
+        {
+            snprintf(record->camera.serial_number, sizeof(record->camera.serial_number), "%u", entry.value);
+            break;
+        }
+        case CANON_TAG_LENS_MODEL:
+        {
+            parse_copy_string(record->camera.lens, sizeof(record->camera.lens), parse_string(context, &entry, 0), entry.count);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return (NULL != ifd);
+}
+
+/******************************************************************
+*
+* \details
+*   Parse a Sony ARW Makernote. The IFD follows an optional 12 byte
+*   header ("SONY DSC ", "SONY CAM " or "SONY MOBILE") and uses
+*   offsets relative to the start of the file.
+*
+* \param[in,out] context : Parse context of the image file.
+*
+* \return
+*   Return true if the Makernote was parsed.
+*
+*******************************************************************/
+bool makernote_sony(parse_context_t* context)
+{
+    nef_record_t* record = context->record;
+    uint32_t offset = context->makernote_offset;
+    char* header = (context->makernote_size >= SONY_HEADER_LENGTH) ? parse_value(context, offset, SONY_HEADER_LENGTH) : NULL;
+
+    if ((NULL != header) && (strncmp(header, "SONY", 4) == 0))
+    {
+        offset += SONY_HEADER_LENGTH;
+    }
+
+    struct ifd_t* ifd = parse_ifd(context, offset, NEF_IFD_MAKERNOTE);
+    unsigned entries = parse_entry_count(context, ifd);
+
+    for (unsigned i = 0; (i < entries) && parse_continue(context); ++i)
+    {
+        struct ifd_entry_t entry;
+
+        parse_entry(context, ifd, i, &entry);
+        context->tag = entry.tag;
+
+        switch (entry.tag)
+        {
+        case SONY_TAG_QUALITY:
+        {
+            store_name(record->image.quality, sizeof(record->image.quality), sony_quality_names,
+                       sizeof(sony_quality_names) / sizeof(sony_quality_names[0]), entry.value);
+            break;
+        }
+        case SONY_TAG_WHITE_BALANCE:
+        {
+            store_name(record->image.white_balance, sizeof(record->image.white_balance), sony_white_balance_names,
+                       sizeof(sony_white_balance_names) / sizeof(sony_white_balance_names[0]), entry.value);
+            break;
+        }
+        case SONY_TAG_FOCUS_MODE:
+        {
+            // Single byte stored in the value field
+            store_name(record->image.focus_mode, sizeof(record->image.focus_mode), sony_focus_mode_names,
+                       sizeof(sony_focus_mode_names) / sizeof(sony_focus_mode_names[0]), *(uint8_t*)&entry.value);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return (NULL != ifd);
+}
+
+/******************************************************************
+*
+* \details
+*   Parse a Pentax PEF Makernote. "AOC\0" Makernotes use offsets
+*   relative to the start of the file, while "PENTAX \0" Makernotes
+*   use offsets relative to the Makernote. Both state their own
+*   byte order.
+*
+* \param[in,out] context : Parse context of the image file.
+*
+* \return
+*   Return true if the Makernote was parsed.
+*
+*******************************************************************/
+bool makernote_pentax(parse_context_t* context)
+{
+    nef_record_t* record = context->record;
+    struct ifd_t* ifd = NULL;
+    uint32_t base = 0;
+    bool big_endian = context->big_endian;
+    char* header = (context->makernote_size >= PENTAX_HEADER_LENGTH) ? parse_value(context, context->makernote_offset, PENTAX_HEADER_LENGTH) : NULL;
+
+    if ((NULL != header) && (memcmp(header, "AOC\0", 4) == 0))
+    {
+        // Older cameras leave the byte order blank, meaning that of the file
+        context->big_endian = (memcmp(&header[4], "MM", 2) == 0) || ((memcmp(&header[4], "II", 2) != 0) && big_endian);
+        ifd = parse_ifd(context, context->makernote_offset + PENTAX_AOC_HEADER_LENGTH, NEF_IFD_MAKERNOTE);
+    }
+    else if ((NULL != header) && (memcmp(header, "PENTAX \0", 8) == 0))
+    {
+        base = context->makernote_offset;
+        context->big_endian = (memcmp(&header[8], "MM", 2) == 0);
+        ifd = parse_ifd(context, context->makernote_offset + PENTAX_HEADER_LENGTH, NEF_IFD_MAKERNOTE);
+    }
+
+    unsigned entries = parse_entry_count(context, ifd);
+
+    for (unsigned i = 0; (i < entries) && parse_continue(context); ++i)
+    {
+        struct ifd_entry_t entry;
+
+        parse_entry(context, ifd, i, &entry);
+        context->tag = entry.tag;
+
+        switch (entry.tag)
+        {
+        case PENTAX_TAG_QUALITY:
+        {
+            store_name(record->image.quality, sizeof(record->image.quality), pentax_quality_names,
+                       sizeof(pentax_quality_names) / sizeof(pentax_quality_names[0]), entry.value);
+            break;
+        }
+        case PENTAX_TAG_FOCUS_MODE:
+        {
+            store_name(record->image.focus_mode, sizeof(record->image.focus_mode), pentax_focus_mode_names,
+                       sizeof(pentax_focus_mode_names) / sizeof(pentax_focus_mode_names[0]), entry.value);
+            break;
+        }
+        case PENTAX_TAG_WHITE_BALANCE:
+        {
+            store_name(record->image.white_balance, sizeof(record->image.white_balance), pentax_white_balance_names,
+                       sizeof(pentax_white_balance_names) / sizeof(pentax_white_balance_names[0]), entry.value);
+            break;
+        }
+        case PENTAX_TAG_SERIAL_NUMBER:
+        {
+            parse_copy_string(record->camera.serial_number, sizeof(record->camera.serial_number), parse_string(context, &entry, base), entry.count);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    context->big_endian = big_endian;
+
+    return (NULL != ifd);
+}
+
+/******************************************************************
+*
+* \details
+*   Parse an Olympus ORF Makernote. The fields are held in the
+*   Equipment and CameraSettings IFDs the Makernote points to.
+*   Current Makernotes ("OLYMPUS\0" and "OM SYSTEM") use offsets
+*   relative to the Makernote and state their own byte order, the
+*   original "OLYMP\0" Makernote uses offsets relative to the file.
+*
+* \param[in,out] context : Parse context of the image file.
+*
+* \return
+*   Return true if the Makernote was parsed.
+*
+*******************************************************************/
+bool makernote_olympus(parse_context_t* context)
+{
+    struct ifd_t* ifd = NULL;
+    uint32_t base = 0;
+    bool big_endian = context->big_endian;
+    char* header = (context->makernote_size >= OM_SYSTEM_HEADER_LENGTH) ? parse_value(context, context->makernote_offset, OM_SYSTEM_HEADER_LENGTH) : NULL;
+
+    if ((NULL != header) && (memcmp(header, "OLYMPUS\0", 8) == 0))
+    {
+        base = context->makernote_offset;
+        context->big_endian = (memcmp(&header[8], "MM", 2) == 0);
+        ifd = parse_ifd(context, context->makernote_offset + OLYMPUS_HEADER_LENGTH, NEF_IFD_MAKERNOTE);
+    }
+    else if ((NULL != header) && (memcmp(header, "OM SYSTEM\0", 10) == 0))
+    {
+        base = context->makernote_offset;
+        context->big_endian = (memcmp(&header[12], "MM", 2) == 0);
+        ifd = parse_ifd(context, context->makernote_offset + OM_SYSTEM_HEADER_LENGTH, NEF_IFD_MAKERNOTE);
+    }
+    else if ((NULL != header) && (memcmp(header, "OLYMP\0", 6) == 0))
+    {
+        ifd = parse_ifd(context, context->makernote_offset + OLYMPUS_OLD_HEADER_LENGTH, NEF_IFD_MAKERNOTE);
+    }
+
+    unsigned entries = parse_entry_count(context, ifd);
+    uint32_t equipment = 0;
+    uint32_t camera_settings = 0;
+
+    for (unsigned i = 0; (i < entries) && parse_continue(context); ++i)
+    {
+        struct ifd_entry_t entry;
+
+        parse_entry(context, ifd, i, &entry);
+        context->tag = entry.tag;
+
+        switch (entry.tag)
+        {
+        case OLYMPUS_TAG_EQUIPMENT:
+            equipment = entry.value;
+            break;
+        case OLYMPUS_TAG_CAMERA_SETTINGS:
+            camera_settings = entry.value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (equipment != 0)
+    {
+        parse_olympus_ifd(context, base + equipment, base);
+    }
+
+    if (camera_settings != 0)
+    {
+        parse_olympus_ifd(context, base + camera_settings, base);
+    }
+
+    context->big_endian = big_endian;
+
+    return (NULL != ifd);
+}
+
+/******************************************************************
+*
+* \details Parse an Olympus Equipment or CameraSettings IFD.
+*
+* \param[in,out] context : Parse context of the image file.
+* \param[in] offset      : Offset of the IFD.
+* \param[in] base        : Offset the value offsets are relative to.
+*
+* \return None
+*
+*******************************************************************/
+static void parse_olympus_ifd(parse_context_t* context, uint32_t offset, uint32_t base)
+{
+    nef_record_t* record = context->record;
+    struct ifd_t* ifd = parse_ifd(context, offset, NEF_IFD_MAKERNOTE);
+    unsigned entries = parse_entry_count(context, ifd);
+
+    for (unsigned i = 0; (i < entries) && parse_continue(context); ++i)
+    {
+        struct ifd_entry_t entry;
+        uint16_t value;
+
+        parse_entry(context, ifd, i, &entry);
+        context->tag = entry.tag;
+
+        switch (entry.tag)
+        {
+        case OLYMPUS_TAG_SERIAL_NUMBER:
+        {
+            parse_copy_string(record->camera.serial_number, sizeof(record->camera.serial_number), parse_string(context, &entry, base), entry.count);
+            break;
+        }
+        case OLYMPUS_TAG_LENS_MODEL:
+        {
+            parse_copy_string(record->camera.lens, sizeof(record->camera.lens), parse_string(context, &entry, base), entry.count);
+            break;
+        }
+        case OLYMPUS_TAG_FOCUS_MODE:
+        {
+            if (get_short(context, &entry, base, 0, &value))
+            {
+                store_name(record->image.focus_mode, sizeof(record->image.focus_mode), olympus_focus_mode_names,
+                           sizeof(olympus_focus_mode_names) / sizeof(olympus_focus_mode_names[0]), value);
+            }
+            break;
+        }
+        case OLYMPUS_TAG_WHITE_BALANCE:
+        {
+            store_name(record->image.white_balance, sizeof(record->image.white_balance), olympus_white_balance_names,
+                       sizeof(olympus_white_balance_names) / sizeof(olympus_white_balance_names[0]), entry.value);
+            break;
+        }
+        case OLYMPUS_TAG_QUALITY:
+        {
+            store_name(record->image.quality, sizeof(record->image.quality), olympus_quality_names,
+                       sizeof(olympus_quality_names) / sizeof(olympus_quality_names[0]), entry.value);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
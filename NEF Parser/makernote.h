@@ -0,0 +1,79 @@
+/**************************************************************//**
+*
+* \file makernote.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Makernote handlers of the TIFF based raw formats of other
+*   vendors (Canon CR2, Sony ARW, Pentax PEF and Olympus ORF).
+*   The Nikon handler is part of the NEF parser.
+*
+*******************************************************************/
+
+#ifndef MAKERNOTE_H_
+#define MAKERNOTE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "parse.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Parses the Makernote at context->makernote_offset into context->record.
+// Returns false if the Makernote is not recognised.
+typedef bool (*makernote_parse_t)(parse_context_t* context);
+
+// Canon Makernote tag values. See https://exiftool.org/TagNames/Canon.html
+typedef enum
+{
+    CANON_TAG_CAMERA_SETTINGS   = 0x0001,
+    CANON_TAG_SHOT_INFO         = 0x0004,
+    CANON_TAG_SERIAL_NUMBER     = 0x000C,
+    CANON_TAG_LENS_MODEL        = 0x0095,
+} canon_tag_t;
+
+// Sony Makernote tag values. See https://exiftool.org/TagNames/Sony.html
+typedef enum
+{
+    SONY_TAG_QUALITY            = 0x0102,
+    SONY_TAG_WHITE_BALANCE      = 0x0115,
+    SONY_TAG_FOCUS_MODE         = 0x201B,
+} sony_tag_t;
+
+// Pentax Makernote tag values. See https://exiftool.org/TagNames/Pentax.html
+typedef enum
+{
+    PENTAX_TAG_QUALITY          = 0x0008,
+    PENTAX_TAG_FOCUS_MODE       = 0x000D,
+    PENTAX_TAG_WHITE_BALANCE    = 0x0019,
+    PENTAX_TAG_SERIAL_NUMBER    = 0x0229,
+} pentax_tag_t;
+
+// Olympus Makernote tag values. See https://exiftool.org/TagNames/Olympus.html
+typedef enum
+{
+    OLYMPUS_TAG_EQUIPMENT       = 0x2010,
+    OLYMPUS_TAG_CAMERA_SETTINGS = 0x2020,
+    OLYMPUS_TAG_SERIAL_NUMBER   = 0x0101, // Equipment IFD
+    OLYMPUS_TAG_LENS_MODEL      = 0x0203, // Equipment IFD
+    OLYMPUS_TAG_FOCUS_MODE      = 0x0301, // Camera settings IFD
+    OLYMPUS_TAG_WHITE_BALANCE   = 0x0500, // Camera settings IFD
+    OLYMPUS_TAG_QUALITY         = 0x0603, // Camera settings IFD
+} olympus_tag_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool makernote_canon(parse_context_t* context);
+bool makernote_sony(parse_context_t* context);
+bool makernote_pentax(parse_context_t* context);
+bool makernote_olympus(parse_context_t* context);
+
+#endif /* end makernote.h */
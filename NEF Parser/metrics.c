@@ -0,0 +1,511 @@
+/**************************************************************//**
+*
+* \file metrics.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Live counters, exposed in the Prometheus text format on a
+*   loopback HTTP port (GET /metrics).
+*
+*   Each thread counts into a slot of its own, so parsing never
+*   contends on a shared cache line. A scrape sums the slots.
+*   Threads beyond METRICS_MAX_SLOTS share the last slot, which
+*   is updated with interlocked operations.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+#include "error.h"
+#include "io.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    volatile uint64_t counters[METRICS_COUNTER_COUNT];
+    volatile uint64_t errors[NEF_ERROR_COUNT];
+    volatile uint64_t buckets[PERF_STAGE_COUNT][METRICS_BUCKET_COUNT]; // Not cumulative
+    volatile uint64_t ticks[PERF_STAGE_COUNT];
+} metrics_counts_t;
+
+// Padded to whole cache lines
+typedef union
+{
+    metrics_counts_t counts;
+    uint8_t align[(sizeof(metrics_counts_t) + 63) / 64 * 64];
+} metrics_slot_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+bool metrics_enabled = false;
+
+static metrics_slot_t metrics_slots[METRICS_MAX_SLOTS];
+static volatile LONG metrics_slot_count = 0;
+static DWORD metrics_index = TLS_OUT_OF_INDEXES; // Slot of the calling thread
+static LONG64 metrics_frequency = 1;
+static uint64_t metrics_bounds[METRICS_BUCKET_COUNT - 1]; // Bucket upper bounds (in ticks)
+
+// Bucket upper bounds (in seconds). The last bucket is +Inf.
+static const double metrics_seconds[METRICS_BUCKET_COUNT - 1] = {
+    0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0,
+};
+
+static const struct
+{
+    const char* name;
+    const char* help;
+} metrics_counters[METRICS_COUNTER_COUNT] = {
+    { "nefparser_files_parsed_total",       "Files parsed successfully." },
+    { "nefparser_files_failed_total",       "Files that could not be parsed." },
+    { "nefparser_bytes_read_total",         "Bytes read (or mapped) from image files." },
+    { "nefparser_io_calls_total",           "File system calls made reading image files." },
+    { "nefparser_decrypt_calls_total",      "Encrypted lens data blocks decrypted." },
+    { "nefparser_lens_lookup_misses_total", "Lens IDs missing from the lens tables." },
+};
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static metrics_counts_t* metrics_slot(bool* shared);
+static void metrics_add(volatile uint64_t* counter, uint64_t value, bool shared);
+static void metrics_sum(metrics_counts_t* total);
+static uint32_t metrics_render(char* text, uint32_t size);
+static DWORD WINAPI metrics_thread(LPVOID parameter);
+
+/******************************************************************
+*
+* \details Slot of the calling thread, assigned on first use.
+*
+* \param[out] shared : The slot is shared with other threads.
+*
+* \return Slot of the thread.
+*
+*******************************************************************/
+static metrics_counts_t* metrics_slot(bool* shared)
+{
+    uintptr_t slot = (uintptr_t)TlsGetValue(metrics_index);
+
+    // Slot index + 1, so unassigned threads read 0
+    if (slot == 0)
+    {
+        LONG index = InterlockedIncrement(&metrics_slot_count) - 1;
+
+        slot = (index < METRICS_MAX_SLOTS) ? (uintptr_t)index + 1 : METRICS_MAX_SLOTS;
+        TlsSetValue(metrics_index, (LPVOID)slot);
+    }
+
+    *shared = (slot == METRICS_MAX_SLOTS);
+
+    return &metrics_slots[slot - 1].counts;
+}
+
+/******************************************************************
+*
+* \details Add to a counter of a slot.
+*
+*******************************************************************/
+static void metrics_add(volatile uint64_t* counter, uint64_t value, bool shared)
+{
+    if (shared)
+    {
+        InterlockedAdd64((volatile LONG64*)counter, (LONG64)value);
+    }
+    else
+    {
+        *counter += value;
+    }
+}
+
+/******************************************************************
+*
+* \details Add to a counter of the calling thread.
+*
+* \param[in] counter : Counter.
+* \param[in] value   : Amount added.
+*
+* \return None
+*
+*******************************************************************/
+void metrics_count(metrics_counter_t counter, uint64_t value)
+{
+    if (metrics_enabled)
+    {
+        bool shared;
+        metrics_counts_t* slot = metrics_slot(&shared);
+
+        metrics_add(&slot->counters[counter], value, shared);
+    }
+}
+
+/******************************************************************
+*
+* \details Add a stage duration to the latency histogram.
+*
+* \param[in] stage : Stage that finished.
+* \param[in] ticks : Elapsed performance counter ticks.
+*
+* \return None
+*
+*******************************************************************/
+void metrics_observe(perf_stage_t stage, uint64_t ticks)
+{
+    if (metrics_enabled)
+    {
+        bool shared;
+        metrics_counts_t* slot = metrics_slot(&shared);
+        unsigned bucket = 0;
+
+        while ((bucket < METRICS_BUCKET_COUNT - 1) && (ticks > metrics_bounds[bucket]))
+        {
+            bucket++;
+        }
+
+        metrics_add(&slot->buckets[stage][bucket], 1, shared);
+        metrics_add(&slot->ticks[stage], ticks, shared);
+    }
+}
+
+/******************************************************************
+*
+* \details Count a parsed file, its reads and its errors.
+*
+* \param[in] record : Record of the file.
+*
+* \return None
+*
+*******************************************************************/
+void metrics_record_file(const nef_record_t* record)
+{
+    if (metrics_enabled)
+    {
+        bool shared;
+        metrics_counts_t* slot = metrics_slot(&shared);
+
+        metrics_add(&slot->counters[record->valid ? METRICS_FILES_PARSED : METRICS_FILES_FAILED], 1, shared);
+        metrics_add(&slot->counters[METRICS_BYTES_READ], record->io.bytes, shared);
+        metrics_add(&slot->counters[METRICS_IO_CALLS], record->io.calls, shared);
+
+        for (unsigned i = 0; i < NEF_ERROR_COUNT; ++i)
+        {
+            if (record->errors.counts[i] > 0)
+            {
+                metrics_add(&slot->errors[i], record->errors.counts[i], shared);
+            }
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Sum the slots. Counters are read while they are written, so a
+*   scrape may miss the updates in flight; they appear in the next.
+*
+*******************************************************************/
+static void metrics_sum(metrics_counts_t* total)
+{
+    LONG used = min(metrics_slot_count, METRICS_MAX_SLOTS);
+
+    memset((void*)total, 0, sizeof(metrics_counts_t));
+
+    for (LONG i = 0; i < used; ++i)
+    {
+        const metrics_counts_t* slot = &metrics_slots[i].counts;
+
+        for (unsigned c = 0; c < METRICS_COUNTER_COUNT; ++c)
+        {
+            total->counters[c] += slot->counters[c];
+        }
+
+        for (unsigned e = 0; e < NEF_ERROR_COUNT; ++e)
+        {
+            total->errors[e] += slot->errors[e];
+        }
+
+        for (unsigned s = 0; s < PERF_STAGE_COUNT; ++s)
+        {
+            for (unsigned b = 0; b < METRICS_BUCKET_COUNT; ++b)
+            {
+                total->buckets[s][b] += slot->buckets[s][b];
+            }
+
+            total->ticks[s] += slot->ticks[s];
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Format the metrics in the Prometheus text format.
+*
+* \param[out] text : Formatted metrics.
+* \param[in] size  : Size of text.
+*
+* \return Length of the text.
+*
+*******************************************************************/
+static uint32_t metrics_render(char* text, uint32_t size)
+{
+    metrics_counts_t* total = malloc(sizeof(metrics_counts_t));
+    io_limits_t limits;
+    int length = 0;
+
+    // Appends to text. A full buffer fails the rest of the render.
+#define METRICS_APPEND(...)                                                         \
+    do                                                                              \
+    {                                                                               \
+        int written = (length >= 0) ? sprintf_s(text + length, size - length, __VA_ARGS__) : -1; \
+        length = (written >= 0) ? length + written : -1;                            \
+    } while (0)
+
+    if (NULL != total)
+    {
+        metrics_sum(total);
+        io_get_limits(&limits);
+
+        for (unsigned c = 0; c < METRICS_COUNTER_COUNT; ++c)
+        {
+            METRICS_APPEND("# HELP %s %s\n# TYPE %s counter\n%s %llu\n", metrics_counters[c].name, metrics_counters[c].help,
+                           metrics_counters[c].name, metrics_counters[c].name, total->counters[c]);
+        }
+
+        METRICS_APPEND("# HELP nefparser_parse_errors_total Parse errors by kind.\n# TYPE nefparser_parse_errors_total counter\n");
+
+        for (unsigned e = NEF_ERROR_NONE + 1; e < NEF_ERROR_COUNT; ++e)
+        {
+            METRICS_APPEND("nefparser_parse_errors_total{kind=\"%s\"} %llu\n", nef_error_name((nef_error_code_t)e), total->errors[e]);
+        }
+
+        METRICS_APPEND("# HELP nefparser_io_throttled_seconds_total Time workers waited on the read caps.\n"
+                       "# TYPE nefparser_io_throttled_seconds_total counter\nnefparser_io_throttled_seconds_total %.6f\n",
+                       limits.waited_seconds);
+
+        METRICS_APPEND("# HELP nefparser_stage_duration_seconds Time spent in each parse stage.\n"
+                       "# TYPE nefparser_stage_duration_seconds histogram\n");
+
+        for (unsigned s = 0; s < PERF_STAGE_COUNT; ++s)
+        {
+            const char* stage = perf_stage_name((perf_stage_t)s);
+            uint64_t cumulative = 0;
+
+            for (unsigned b = 0; b < METRICS_BUCKET_COUNT - 1; ++b)
+            {
+                cumulative += total->buckets[s][b];
+                METRICS_APPEND("nefparser_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n", stage, metrics_seconds[b], cumulative);
+            }
+
+            cumulative += total->buckets[s][METRICS_BUCKET_COUNT - 1];
+            METRICS_APPEND("nefparser_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stage, cumulative);
+            METRICS_APPEND("nefparser_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n", stage, (double)total->ticks[s] / metrics_frequency);
+            METRICS_APPEND("nefparser_stage_duration_seconds_count{stage=\"%s\"} %llu\n", stage, cumulative);
+        }
+
+        free(total);
+    }
+
+#undef METRICS_APPEND
+
+    return (length > 0) ? (uint32_t)length : 0;
+}
+
+/******************************************************************
+*
+* \details Answer scrapes until the listener is closed by metrics_stop.
+*
+* \param[in] parameter : Server (metrics_server_t).
+*
+* \return 0
+*
+*******************************************************************/
+static DWORD WINAPI metrics_thread(LPVOID parameter)
+{
+    metrics_server_t* server = parameter;
+    char* body = malloc(METRICS_MAX_RESPONSE);
+    SOCKET client;
+
+    while ((NULL != body) && ((client = accept(server->listener, NULL, NULL)) != INVALID_SOCKET))
+    {
+        char request[METRICS_MAX_REQUEST];
+        char header[256];
+        DWORD timeout = METRICS_TIMEOUT_MS;
+        bool served;
+        int received = 0;
+        bool found = false;
+        uint32_t length = 0;
+
+        // A scraper that sends nothing or stops reading is dropped
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+
+        AcquireSRWLockExclusive(&server->lock);
+        served = !server->stopping;
+
+        if (served)
+        {
+            server->client = client;
+        }
+
+        ReleaseSRWLockExclusive(&server->lock);
+
+        if (served)
+        {
+            received = recv(client, request, sizeof(request) - 1, 0);
+
+            if (received > 0)
+            {
+                request[received] = '\0';
+                found = (strncmp(request, "GET /metrics ", sizeof("GET /metrics ") - 1) == 0);
+            }
+        }
+
+        if (found)
+        {
+            length = metrics_render(body, METRICS_MAX_RESPONSE);
+        }
+
+        AcquireSRWLockExclusive(&server->lock);
+
+        // Unless the request timed out or metrics_stop closed the socket
+        if (served && (received > 0) && (server->client == client))
+        {
+            int header_length = sprintf_s(header, sizeof(header),
+                                          "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+                                          found ? "200 OK" : "404 Not Found", length);
+
+            send(client, header, header_length, 0);
+            send(client, body, (int)length, 0);
+            shutdown(client, SD_SEND);
+        }
+
+        if (!served || (server->client == client))
+        {
+            closesocket(client);
+        }
+
+        server->client = INVALID_SOCKET;
+        ReleaseSRWLockExclusive(&server->lock);
+    }
+
+    free(body);
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details
+*   Start counting and serve the metrics on a loopback port. Must
+*   be called before any parsing starts.
+*
+* \param[out] server : Metrics server.
+* \param[in] port    : TCP port on 127.0.0.1.
+*
+* \return
+*   Return true if the server was started.
+*
+*******************************************************************/
+bool metrics_start(metrics_server_t* server, uint16_t port)
+{
+    bool success = false;
+    WSADATA data;
+    LARGE_INTEGER frequency;
+
+    server->listener = INVALID_SOCKET;
+    server->thread = NULL;
+    server->client = INVALID_SOCKET;
+    server->stopping = false;
+    InitializeSRWLock(&server->lock);
+
+    QueryPerformanceFrequency(&frequency);
+    metrics_frequency = frequency.QuadPart;
+
+    for (unsigned b = 0; b < METRICS_BUCKET_COUNT - 1; ++b)
+    {
+        metrics_bounds[b] = (uint64_t)(metrics_seconds[b] * metrics_frequency);
+    }
+
+    if (TLS_OUT_OF_INDEXES == metrics_index)
+    {
+        metrics_index = TlsAlloc();
+    }
+
+    if ((TLS_OUT_OF_INDEXES != metrics_index) && (WSAStartup(MAKEWORD(2, 2), &data) == 0))
+    {
+        struct sockaddr_in address = { 0 };
+
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        // Local scrapers only
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        server->listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+        if ((INVALID_SOCKET != server->listener) &&
+            (bind(server->listener, (struct sockaddr*)&address, sizeof(address)) == 0) &&
+            (listen(server->listener, SOMAXCONN) == 0))
+        {
+            server->thread = CreateThread(NULL, 0, metrics_thread, server, 0, NULL);
+            success = (NULL != server->thread);
+        }
+
+        if (!success)
+        {
+            if (INVALID_SOCKET != server->listener)
+            {
+                closesocket(server->listener);
+                server->listener = INVALID_SOCKET;
+            }
+
+            WSACleanup();
+        }
+    }
+
+    metrics_enabled = success;
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Stop serving the metrics.
+*
+* \param[in,out] server : Server started by metrics_start.
+*
+* \return None
+*
+*******************************************************************/
+void metrics_stop(metrics_server_t* server)
+{
+    if (NULL != server->thread)
+    {
+        AcquireSRWLockExclusive(&server->lock);
+        server->stopping = true;
+
+        // Closing the client fails a recv waiting on a slow scraper
+        if (INVALID_SOCKET != server->client)
+        {
+            closesocket(server->client);
+            server->client = INVALID_SOCKET;
+        }
+
+        ReleaseSRWLockExclusive(&server->lock);
+
+        // Closing the listener fails the pending accept
+        closesocket(server->listener);
+        WaitForSingleObject(server->thread, INFINITE);
+        CloseHandle(server->thread);
+        server->thread = NULL;
+        server->listener = INVALID_SOCKET;
+        WSACleanup();
+    }
+}
@@ -0,0 +1,74 @@
+/**************************************************************//**
+*
+* \file metrics.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Live counters, exposed in the Prometheus text format.
+*
+*******************************************************************/
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <winsock2.h>
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "perf.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define METRICS_MAX_SLOTS       128     // Threads with counters of their own
+#define METRICS_BUCKET_COUNT    12      // Stage latency buckets, including +Inf
+#define METRICS_MAX_REQUEST     1024
+#define METRICS_MAX_RESPONSE    (32 * 1024)
+#define METRICS_TIMEOUT_MS      5000    // Longest wait for a scraper to send its request or read the response
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef enum
+{
+    METRICS_FILES_PARSED = 0,
+    METRICS_FILES_FAILED,
+    METRICS_BYTES_READ,
+    METRICS_IO_CALLS,
+    METRICS_DECRYPT_CALLS,
+    METRICS_LENS_LOOKUP_MISSES,
+    METRICS_COUNTER_COUNT
+} metrics_counter_t;
+
+typedef struct
+{
+    SOCKET listener;    // Loopback HTTP socket
+    HANDLE thread;      // Server thread
+    SOCKET client;      // Scrape being answered
+    SRWLOCK lock;       // Guards client and stopping
+    bool stopping;      // Set by metrics_stop
+} metrics_server_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Set before any parsing starts. Counting is skipped when clear.
+extern bool metrics_enabled;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool metrics_start(metrics_server_t* server, uint16_t port);
+void metrics_stop(metrics_server_t* server);
+void metrics_count(metrics_counter_t counter, uint64_t value);
+void metrics_observe(perf_stage_t stage, uint64_t ticks);
+void metrics_record_file(const nef_record_t* record);
+
+#endif /* end metrics.h */
@@ -25,11 +25,6 @@
                         Defines
 *******************************************************************/
 #define MAKERNOTE_MAGIC     "Nikon"
-// Lens data is encrypted is version is 201 or greater
-#define LENS_DATA_0201      201
-#define LENS_ID_OFFSET      12
-#define MAX_LENS_ID_LENGTH  96
-#define MAX_LENS_ID_ENTRIES 256
 
 /******************************************************************
                         Typedefs
@@ -50,6 +45,7 @@ typedef enum
     NIKON_TAG_ISO_INFO          = 0x0025,
     NIKON_TAG_LENS_TYPE         = 0x0083,
     NIKON_TAG_LENS              = 0x0084,
+    NIKON_TAG_NEF_COMPRESSION   = 0x0093,
     NIKON_TAG_LENS_DATA         = 0x0098,
     NIKON_TAG_SHUTTER_COUNT     = 0x00A7,
 } nikon_tag_t;
@@ -69,22 +65,27 @@ struct makernote_header_t
 };
 #pragma pack(pop)
 
-// Lens ID entry containing composite tag and associated lens ID (model) string
-struct lens_id_entry_t
-{
-    uint8_t tag[8];
-    char id[MAX_LENS_ID_LENGTH];
-};
-
 /******************************************************************
                         Global Variables
 *******************************************************************/
-// See https://exiftool.org/TagNames/Nikon.html#LensID.
-struct lens_id_entry_t nikon_lens_id_table[3] = {
-    { {0xE3, 0x40, 0x76, 0xA6, 0x38, 0x40, 0xDF, 0x4E}, "Tamron SP 150-600mm f/5-6.3 Di VC USD G2" },
-    { {0xAA, 0x48, 0x37, 0x5C, 0x24, 0x24, 0xC5, 0x4E}, "AF-S Nikkor 24-70mm f/2.8E ED VR" },
-    { {0xAE, 0x3C, 0x80, 0xA0, 0x3C, 0x3C, 0xC9, 0x4E}, "AF-S Nikkor 200-500mm f/5.6E ED VR" },
-    // TODO: Implement the rest of the table
+// Raw data compression by NEFCompression value. High Efficiency (HE and HE*)
+// is used by the Z series. See https://exiftool.org/TagNames/Nikon.html
+const char* nikon_compression_names[] = {
+    NULL,
+    "Lossy (type 1)",
+    "Uncompressed",
+    "Lossless",
+    "Lossy (type 2)",
+    "Striped Packed 12 bits",
+    "Uncompressed (12 bit)",
+    "Unpacked 12 bits",
+    "Small",
+    "Packed 12 bits",
+    "Packed 14 bits",
+    NULL,
+    NULL,
+    "High Efficiency",
+    "High Efficiency*",
 };
 
 #endif /* end nef.h */
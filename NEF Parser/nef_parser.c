@@ -7,7 +7,8 @@
 * \date December 2020
 *
 * \details
-*	Application to parse Nikon Electronic File (NEF) image files.
+*	Application to parse Nikon Electronic File (NEF) image files and
+*   the TIFF based raw files of other vendors.
 * 
 *   Development Resources:
 *       - https://www.itu.int/itudoc/itu-t/com16/tiff-fx/docs/tiff6.pdf
@@ -22,14 +23,39 @@
 *******************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
 #include "nef.h"
+#include "lens.h"
 #include "tiff.h"
 #include "exif.h"
+#include "record.h"
+#include "gps_index.h"
+#include "xmp.h"
+#include "batch.h"
+#include "sidecar.h"
+#include "patch.h"
+#include "database.h"
+#include "ring.h"
+#include "record_format.h"
+#include "stream.h"
+#include "perf.h"
+#include "trace.h"
+#include "io.h"
+#include "benchmark.h"
+#include "parse.h"
+#include "makernote.h"
+#include "cpu.h"
+#include "numa.h"
+#include "control.h"
+#include "metrics.h"
+#include "isolate.h"
+#include "scrub.h"
+#include "sample.h"
 
 /******************************************************************
                         Defines
@@ -44,6 +70,17 @@ const char banner[] = "**********************************************\n"
 // Justification width for output formatting
 #define LEFT_JUSTIFY_WIDTH 14
 
+// Extensions of the Nikon image files.
+// Coolpix cameras write NRW files, which share the NEF layout.
+#define NEF_EXTENSION "NEF"
+#define NRW_EXTENSION "NRW"
+
+// Make of files whose IFD0 omits it
+#define NIKON_MAKE "NIKON CORPORATION"
+
+// Sub-IFDs followed per file. They hold the raw image and previews.
+#define MAX_SUBIFDS 4
+
 /******************************************************************
                         Macros
 *******************************************************************/
@@ -53,391 +90,877 @@ const char banner[] = "**********************************************\n"
 // Convert bytes to double words
 #define BYTES_TO_DWORDS(x) ((x) >> 2)
 
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Command line options
+typedef struct
+{
+    char** files;       // Image files and directories to process
+    unsigned file_count;
+    unsigned threads;   // Worker threads (0 selects one per processor)
+    bool sidecar;       // Write an XMP sidecar per image file instead of displaying it
+    bool overwrite;     // Replace existing sidecars
+    gps_query_t near[GPS_MAX_QUERIES]; // List the frames within each radius
+    unsigned near_count;
+    bool patch;         // Patch the date/time, Artist or Copyright tags in place
+    bool recover;       // Complete patches interrupted by a previous run
+    patcher_t patcher;
+    const char* database;       // Export the records to this SQLite database
+    uint32_t database_batch;    // Records per database transaction
+    const char* ring;           // Write the records to this shared memory ring
+    uint32_t ring_slots;        // Ring slots (power of two)
+    const char* records;        // Write the records to this binary record file
+    int compression_level;      // zstd level of the file outputs (0 = uncompressed)
+    const char* output;         // Write the displayed files to this file instead of the console
+    bool profile;               // Display the cycles and time spent in each parse stage
+    const char* trace;          // Write a Chrome trace of the parse stages to this file
+    bool benchmark;             // Compare the file read strategies instead of displaying the files
+    bool memory;                // Display the heap allocations and working set instead of the files
+    uint64_t max_file_heap;     // Peak heap bytes allowed per file (0 = no limit)
+    uint64_t max_working_set;   // Peak working set allowed (in bytes, 0 = no limit)
+    cpu_level_t cpu_level;      // Kernel variants (detected unless overridden with --cpu)
+    numa_mode_t numa;           // Group the workers by NUMA node
+    uint64_t max_bandwidth;     // Read bandwidth cap (in bytes per second, 0 = unlimited)
+    uint64_t max_iops;          // File system operation cap (per second, 0 = unlimited)
+    const char* control;        // Accept rate changes and interactive requests on this named pipe while the batch runs
+    bool serve;                 // Keep serving interactive requests once the files are done
+    unsigned interactive_threads; // Workers reserved for interactive requests
+    uint16_t metrics_port;      // Serve Prometheus metrics on this loopback port (0 = disabled)
+    unsigned isolate;           // Parse in this many worker processes (0 = in process)
+    const char* quarantine;     // Files that crashed a worker process, skipped by later runs
+    const char* isolate_worker; // Run as the worker process of this name for a supervisor
+    const char* scrub;          // Check the files against the fingerprints of this catalog
+    bool scrub_raw;             // Fingerprint only the raw image data
+    bool sampling;              // Parse a random sample of the files
+    sampler_t sampler;          // Sample and the estimates reported from it
+} nef_options_t;
+
+// TIFF based raw format, selected by file extension
+typedef struct
+{
+    const char* extension;
+    makernote_parse_t makernote; // Makernote handler (NULL = EXIF only)
+} raw_format_t;
+
+// Output of a batch that keeps no records. Errors and profiles are
+// collected as each record is passed on.
+typedef struct
+{
+    batch_record_callback_t callback; // Output of each record (NULL = none)
+    void* context;                    // Passed to callback
+    SRWLOCK lock;                     // Errors and profile
+    nef_error_summary_t errors;
+    perf_profile_t profile;
+} record_sink_t;
+
 /******************************************************************
                         Global Variables
 *******************************************************************/
-static image_data_t* image_data = NULL;
-static camera_data_t* camera_data = NULL;
-static uint32_t makernote_offset = 0;
-static uint32_t tiff_offset = 0;
-
-// Translation table used to decrypt lens data fields
-uint8_t xlat[2][256] = {
-    { 0xc1, 0xbf, 0x6d, 0x0d, 0x59, 0xc5, 0x13, 0x9d, 0x83, 0x61, 0x6b, 0x4f, 0xc7, 0x7f, 0x3d, 0x3d,
-      0x53, 0x59, 0xe3, 0xc7, 0xe9, 0x2f, 0x95, 0xa7, 0x95, 0x1f, 0xdf, 0x7f, 0x2b, 0x29, 0xc7, 0x0d,
-      0xdf, 0x07, 0xef, 0x71, 0x89, 0x3d, 0x13, 0x3d, 0x3b, 0x13, 0xfb, 0x0d, 0x89, 0xc1, 0x65, 0x1f,
-      0xb3, 0x0d, 0x6b, 0x29, 0xe3, 0xfb, 0xef, 0xa3, 0x6b, 0x47, 0x7f, 0x95, 0x35, 0xa7, 0x47, 0x4f,
-      0xc7, 0xf1, 0x59, 0x95, 0x35, 0x11, 0x29, 0x61, 0xf1, 0x3d, 0xb3, 0x2b, 0x0d, 0x43, 0x89, 0xc1,
-      0x9d, 0x9d, 0x89, 0x65, 0xf1, 0xe9, 0xdf, 0xbf, 0x3d, 0x7f, 0x53, 0x97, 0xe5, 0xe9, 0x95, 0x17,
-      0x1d, 0x3d, 0x8b, 0xfb, 0xc7, 0xe3, 0x67, 0xa7, 0x07, 0xf1, 0x71, 0xa7, 0x53, 0xb5, 0x29, 0x89,
-      0xe5, 0x2b, 0xa7, 0x17, 0x29, 0xe9, 0x4f, 0xc5, 0x65, 0x6d, 0x6b, 0xef, 0x0d, 0x89, 0x49, 0x2f,
-      0xb3, 0x43, 0x53, 0x65, 0x1d, 0x49, 0xa3, 0x13, 0x89, 0x59, 0xef, 0x6b, 0xef, 0x65, 0x1d, 0x0b,
-      0x59, 0x13, 0xe3, 0x4f, 0x9d, 0xb3, 0x29, 0x43, 0x2b, 0x07, 0x1d, 0x95, 0x59, 0x59, 0x47, 0xfb,
-      0xe5, 0xe9, 0x61, 0x47, 0x2f, 0x35, 0x7f, 0x17, 0x7f, 0xef, 0x7f, 0x95, 0x95, 0x71, 0xd3, 0xa3,
-      0x0b, 0x71, 0xa3, 0xad, 0x0b, 0x3b, 0xb5, 0xfb, 0xa3, 0xbf, 0x4f, 0x83, 0x1d, 0xad, 0xe9, 0x2f,
-      0x71, 0x65, 0xa3, 0xe5, 0x07, 0x35, 0x3d, 0x0d, 0xb5, 0xe9, 0xe5, 0x47, 0x3b, 0x9d, 0xef, 0x35,
-      0xa3, 0xbf, 0xb3, 0xdf, 0x53, 0xd3, 0x97, 0x53, 0x49, 0x71, 0x07, 0x35, 0x61, 0x71, 0x2f, 0x43,
-      0x2f, 0x11, 0xdf, 0x17, 0x97, 0xfb, 0x95, 0x3b, 0x7f, 0x6b, 0xd3, 0x25, 0xbf, 0xad, 0xc7, 0xc5,
-      0xc5, 0xb5, 0x8b, 0xef, 0x2f, 0xd3, 0x07, 0x6b, 0x25, 0x49, 0x95, 0x25, 0x49, 0x6d, 0x71, 0xc7 },
-    { 0xa7, 0xbc, 0xc9, 0xad, 0x91, 0xdf, 0x85, 0xe5, 0xd4, 0x78, 0xd5, 0x17, 0x46, 0x7c, 0x29, 0x4c,
-      0x4d, 0x03, 0xe9, 0x25, 0x68, 0x11, 0x86, 0xb3, 0xbd, 0xf7, 0x6f, 0x61, 0x22, 0xa2, 0x26, 0x34,
-      0x2a, 0xbe, 0x1e, 0x46, 0x14, 0x68, 0x9d, 0x44, 0x18, 0xc2, 0x40, 0xf4, 0x7e, 0x5f, 0x1b, 0xad,
-      0x0b, 0x94, 0xb6, 0x67, 0xb4, 0x0b, 0xe1, 0xea, 0x95, 0x9c, 0x66, 0xdc, 0xe7, 0x5d, 0x6c, 0x05,
-      0xda, 0xd5, 0xdf, 0x7a, 0xef, 0xf6, 0xdb, 0x1f, 0x82, 0x4c, 0xc0, 0x68, 0x47, 0xa1, 0xbd, 0xee,
-      0x39, 0x50, 0x56, 0x4a, 0xdd, 0xdf, 0xa5, 0xf8, 0xc6, 0xda, 0xca, 0x90, 0xca, 0x01, 0x42, 0x9d,
-      0x8b, 0x0c, 0x73, 0x43, 0x75, 0x05, 0x94, 0xde, 0x24, 0xb3, 0x80, 0x34, 0xe5, 0x2c, 0xdc, 0x9b,
-      0x3f, 0xca, 0x33, 0x45, 0xd0, 0xdb, 0x5f, 0xf5, 0x52, 0xc3, 0x21, 0xda, 0xe2, 0x22, 0x72, 0x6b,
-      0x3e, 0xd0, 0x5b, 0xa8, 0x87, 0x8c, 0x06, 0x5d, 0x0f, 0xdd, 0x09, 0x19, 0x93, 0xd0, 0xb9, 0xfc,
-      0x8b, 0x0f, 0x84, 0x60, 0x33, 0x1c, 0x9b, 0x45, 0xf1, 0xf0, 0xa3, 0x94, 0x3a, 0x12, 0x77, 0x33,
-      0x4d, 0x44, 0x78, 0x28, 0x3c, 0x9e, 0xfd, 0x65, 0x57, 0x16, 0x94, 0x6b, 0xfb, 0x59, 0xd0, 0xc8,
-      0x22, 0x36, 0xdb, 0xd2, 0x63, 0x98, 0x43, 0xa1, 0x04, 0x87, 0x86, 0xf7, 0xa6, 0x26, 0xbb, 0xd6,
-      0x59, 0x4d, 0xbf, 0x6a, 0x2e, 0xaa, 0x2b, 0xef, 0xe6, 0x78, 0xb6, 0x4e, 0xe0, 0x2f, 0xdc, 0x7c,
-      0xbe, 0x57, 0x19, 0x32, 0x7e, 0x2a, 0xd0, 0xb8, 0xba, 0x29, 0x00, 0x3c, 0x52, 0x7d, 0xa8, 0x49,
-      0x3b, 0x2d, 0xeb, 0x25, 0x49, 0xfa, 0xa3, 0xaa, 0x39, 0xa7, 0xc5, 0xa7, 0x50, 0x11, 0x36, 0xfb,
-      0xc6, 0x67, 0x4a, 0xf5, 0xa5, 0x12, 0x65, 0x7e, 0xb0, 0xdf, 0xaf, 0x4e, 0xb3, 0x61, 0x7f, 0x2f }
-};
+// XMP properties extracted from each file. Configured with --xmp.
+static const char* xmp_properties[XMP_MAX_PROPERTIES] = { XMP_PROPERTY_RATING, XMP_PROPERTY_LABEL, XMP_PROPERTY_KEYWORDS };
+static unsigned xmp_property_count = 3;
+static char xmp_property_names[XMP_MAX_PROPERTIES][XMP_MAX_NAME_LENGTH];
+
+// How image files are read. Configured with --io.
+static io_strategy_t io_strategy = IO_STRATEGY_READ;
+
+// Configured with --max-ifds, --max-entries, --max-bytes and --deadline
+static parse_limits_t parse_limits = { PARSE_DEFAULT_MAX_IFDS, PARSE_DEFAULT_MAX_ENTRIES, PARSE_DEFAULT_MAX_BYTES, 0 };
+
+// Checks each file read against its fingerprint. Configured with --scrub.
+static scrubber_t* scrubber = NULL;
 
 /******************************************************************
                         Function Prototypes
 *******************************************************************/
-static void decrypt(uint8_t* data, uint32_t size, char* serial_number, uint32_t shutter_count);
-static char* nikon_lens_id_lookup(uint8_t* key);
-static float get_tiff_rational(struct ifd_entry_t* entry, void* buffer);
-static char* get_makernote_string(struct ifd_entry_t* entry, void* buffer);
-static char* rstrip(char* str);
-static void display_data(void);
+static float get_tiff_rational(parse_context_t* context, struct ifd_entry_t* entry, uint32_t* parts);
+static bool get_gps_coordinate(parse_context_t* context, struct ifd_entry_t* entry, double* coordinate);
+static void parse_image_size(parse_context_t* context, struct ifd_t* ifd);
+static void parse_raw_range(parse_context_t* context, const struct ifd_entry_t* offsets, const struct ifd_entry_t* counts);
+static void parse_gps(parse_context_t* context, uint32_t gps_offset);
+static void parse_xmp(parse_context_t* context, struct ifd_entry_t* entry);
+static void record_location(parse_context_t* context, struct ifd_t* ifd, unsigned index);
+static void store_xmp_value(unsigned property, const char* value, uint32_t length, void* context);
+static bool parse_nikon_makernote(parse_context_t* context);
+static bool parse_image(const char* path, nef_record_t* record);
+static void display_print(stream_t* output, const char* format, ...);
+static void display_data(const nef_record_t* record, stream_t* output);
+static void display_nearby(const nef_record_t* record, double distance_km, void* context);
+static bool parse_options(int argc, char** argv, nef_options_t* options);
+static void submit_sidecar(nef_record_t* record, void* context);
+static void submit_database(nef_record_t* record, void* context);
+static void submit_ring(nef_record_t* record, void* context);
+static void submit_record(nef_record_t* record, void* context);
+static void submit_sink(nef_record_t* record, void* context);
+
+/******************************************************************
+                        Raw Formats
+*******************************************************************/
+// Formats searched for in directories. The IFDs are shared, only
+// the Makernote differs by vendor.
+static const raw_format_t raw_formats[] = {
+    { NEF_EXTENSION, parse_nikon_makernote },
+    { NRW_EXTENSION, parse_nikon_makernote },
+    { "CR2",         makernote_canon       },
+    { "ARW",         makernote_sony        },
+    { "PEF",         makernote_pentax      },
+    { "ORF",         makernote_olympus     },
+    { "DNG",         NULL                  },
+};
 
 /******************************************************************
-*
-* \brief Decrypt Nikon lens data information.
 *
 * \details
-*   Algorithm credited to Phil Harvey, creator of the EXIF Tool.
-*   See https://github.com/exiftool/exiftool/blob/master/lib/Image/ExifTool/Nikon.pm.
+*   Helper function get value of EXIF rational entries. Entries of
+*   another type and rationals with a zero denominator are reported
+*   as errors of the file.
 *
-* \param[in] data          : Pointer to encrypted data.
-* \param[in] size          : Size of the data (in bytes) to be decrypted.
-* \param[in] serial_number : Camera serial number. Used an encryption key.
-* \param[in] shutter_count : Camera shutter count. Used an encryption key.
-* \param[out] None
+* \param[in] context : Parse context of the image file.
+* \param[in] entry   : EXIF entry to be processed.
+* \param[out] parts  : Numerator and denominator as stored, or NULL
+*                      if not needed. Left unchanged if the entry
+*                      cannot be read.
 *
-* \return None
+* \return
+*   Return rational value of entry, or 0 if it cannot be read.
 *
 *******************************************************************/
-static void decrypt(uint8_t* data, uint32_t size, char* serial_number, uint32_t shutter_count)
+static float get_tiff_rational(parse_context_t* context, struct ifd_entry_t* entry, uint32_t* parts)
 {
-    uint8_t key = 0;
-    uint8_t ci, cj, ck;
+    float rational = 0;
 
-    if ((NULL != data) && (size != 0))
+    if ((NULL != context) && (NULL != entry) && (TIFF_TYPE_RATIONAL == entry->type))
     {
-        // Serial number is used as a key
-        uint64_t serial = strtoull(serial_number, NULL, 10);
-        serial &= 0xFF;
+        uint32_t* data = parse_value(context, entry->value, 2 * sizeof(uint32_t));
 
-        for (unsigned i = 0; i < 4; ++i)
+        if (NULL != data)
         {
-            // Shutter count is used as an encryption key
-            key ^= (shutter_count >> (i * 8)) & 0xFF;
+            uint32_t numerator = parse_get32(context, &data[0]);
+            uint32_t denominator = parse_get32(context, &data[1]);
+
+            if (denominator != 0)
+            {
+                rational = (float)numerator / (float)denominator;
+
+                if (NULL != parts)
+                {
+                    parts[0] = numerator;
+                    parts[1] = denominator;
+                }
+            }
+            else
+            {
+                parse_error(context, NEF_ERROR_INVALID_VALUE, entry->value, numerator);
+            }
         }
+    }
+    else if (NULL != context)
+    {
+        parse_error(context, NEF_ERROR_ENTRY_TYPE, (NULL != entry) ? entry->value : 0, (NULL != entry) ? entry->type : 0);
+    }
+
+    return rational;
+}
+
+/******************************************************************
+*
+* \details
+*   Helper function to get the value of GPS coordinate entries.
+*   Coordinates are stored as three rationals: degrees, minutes
+*   and seconds. Also used for the GPS time stamp (hours, minutes
+*   and seconds), which has the same layout. Entries of another
+*   type and rationals with a zero denominator are reported as
+*   errors of the file.
+*
+* \param[in] context     : Parse context of the image file.
+* \param[in] entry       : GPS entry to be processed.
+* \param[out] coordinate : Coordinate in degrees. Left unchanged if
+*                          the entry cannot be read.
+*
+* \return
+*   Return true if the coordinate was read.
+*
+*******************************************************************/
+static bool get_gps_coordinate(parse_context_t* context, struct ifd_entry_t* entry, double* coordinate)
+{
+    bool success = false;
+
+    if ((NULL != context) && (NULL != entry) && (TIFF_TYPE_RATIONAL == entry->type) && (entry->count == 3))
+    {
+        uint32_t* data = parse_value(context, entry->value, 6 * sizeof(uint32_t));
+        double value = 0;
+        double scale = 1;
+
+        success = (NULL != data);
 
-        ci = xlat[0][serial];
-        cj = xlat[1][key];
-        ck = 0x60;
+        for (unsigned i = 0; (i < 3) && success; ++i, scale *= 60)
+        {
+            uint32_t numerator = parse_get32(context, &data[2 * i]);
+            uint32_t denominator = parse_get32(context, &data[2 * i + 1]);
+
+            if (denominator != 0)
+            {
+                value += ((double)numerator / denominator) / scale;
+            }
+            else
+            {
+                parse_error(context, NEF_ERROR_INVALID_VALUE, entry->value, numerator);
+                success = false;
+            }
+        }
 
-        for (unsigned i = 0; i < size; ++i)
+        if (success)
         {
-            cj = (cj + ci * ck) & 0xFF;
-            ck = (ck + 1) & 0xFF;
-            data[i] ^= cj;
+            *coordinate = value;
         }
     }
+    else if (NULL != context)
+    {
+        parse_error(context, NEF_ERROR_ENTRY_TYPE, (NULL != entry) ? entry->value : 0, (NULL != entry) ? entry->type : 0);
+    }
+
+    return success;
 }
 
 /******************************************************************
 *
-* \details Helper function to look up Nikon lens ID in table.
+* \details
+*   Record the size of the image stored in an IFD if it is the full
+*   resolution image. The pixel data itself is never decoded, so
+*   any raw compression (including High Efficiency) is supported.
+*   IFDs without a NewSubfileType hold a full resolution image, as
+*   that is the TIFF default.
 *
-* \param[in] key : Lens ID key to be matched.
-* \param[out] None
+* \param[in,out] context : Parse context of the image file.
+* \param[in] ifd         : IFD0 or a Sub-IFD.
 *
-* \return
-*   Return lens ID information as a string if a match is found.
-*   Otherwise, return NULL.
+* \return None
 *
 *******************************************************************/
-static char* nikon_lens_id_lookup(uint8_t* key)
+static void parse_image_size(parse_context_t* context, struct ifd_t* ifd)
 {
-    char* id = NULL;
-    // Calculate entries in look up table
-    unsigned int entries = sizeof(nikon_lens_id_table) / sizeof(nikon_lens_id_table[0]);
+    uint32_t subfile_type = TIFF_SUBFILE_FULL_RESOLUTION;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Strips or tiles, whichever the image is stored in
+    struct ifd_entry_t data_offsets = { 0 };
+    struct ifd_entry_t data_counts = { 0 };
 
-    for (unsigned i = 0; i < entries; ++i)
+    for (unsigned i = 0; (i < parse_entry_count(context, ifd)) && parse_continue(context); ++i)
     {
-        if (memcmp(key, nikon_lens_id_table[i].tag, sizeof(nikon_lens_id_table[i].tag)) == 0)
+        struct ifd_entry_t entry;
+
+        parse_entry(context, ifd, i, &entry);
+        // SHORT values occupy the low half of the value field
+        uint32_t value = (TIFF_TYPE_SHORT == entry.type) ? (entry.value & 0xFFFF) : entry.value;
+
+        context->tag = entry.tag;
+
+        switch (entry.tag)
         {
-            id = nikon_lens_id_table[i].id;
+        case EXIF_TAG_SUBFILE_TYPE:
+            subfile_type = value;
+            break;
+        case EXIF_TAG_IMAGE_WIDTH:
+            width = value;
+            break;
+        case EXIF_TAG_IMAGE_HEIGHT:
+            height = value;
+            break;
+        case EXIF_TAG_STRIP_OFFSETS:
+        case EXIF_TAG_TILE_OFFSETS:
+            data_offsets = entry;
+            break;
+        case EXIF_TAG_STRIP_BYTE_COUNTS:
+        case EXIF_TAG_TILE_BYTE_COUNTS:
+            data_counts = entry;
+            break;
+        default:
             break;
         }
     }
 
-    return id;
+    if ((TIFF_SUBFILE_FULL_RESOLUTION == subfile_type) && (width > context->record->image.width))
+    {
+        context->record->image.width = width;
+        context->record->image.height = height;
+        parse_raw_range(context, &data_offsets, &data_counts);
+    }
 }
 
 /******************************************************************
 *
-* \details Helper function get value of EXIF rational entries.
+* \details
+*   Locate the data of the full resolution image from its strips or
+*   tiles. Neither has to be stored in order, so the data runs from
+*   the lowest offset to the furthest end.
 *
-* \param[in] entry  : EXIF entry to be processed.
-* \param[in] buffer : Pointer to image file buffer.
+* \param[in] context : Parse context of the image file.
+* \param[in] offsets : StripOffsets or TileOffsets entry.
+* \param[in] counts  : StripByteCounts or TileByteCounts entry.
 * \param[out] None
 *
-* \return
-*   Return rational value of entry.
+* \return None
 *
 *******************************************************************/
-static float get_tiff_rational(struct ifd_entry_t* entry, void* buffer)
+static void parse_raw_range(parse_context_t* context, const struct ifd_entry_t* offsets, const struct ifd_entry_t* counts)
 {
-    float rational = 0;
+    image_data_t* image = &context->record->image;
+    uint32_t start = 0;
+    uint64_t end = 0;
 
-    if ((NULL != entry) && (NULL != buffer))
+    if ((offsets->count == 1) && (counts->count == 1))
     {
-        if (TIFF_TYPE_RATIONAL == entry->type)
-        {
-            uint32_t* data = (uint32_t*)buffer;
-            unsigned offset = BYTES_TO_DWORDS(entry->value);
-            float numerator = (float)data[offset];
-            float denominator = (float)data[++offset];
-            rational = numerator / denominator;
-        }
-        else
+        // SHORT values occupy the low half of the value field
+        start = (TIFF_TYPE_SHORT == offsets->type) ? (offsets->value & 0xFFFF) : offsets->value;
+        end = (uint64_t)start + ((TIFF_TYPE_SHORT == counts->type) ? (counts->value & 0xFFFF) : counts->value);
+    }
+    else if ((offsets->count > 1) && (counts->count == offsets->count) &&
+             (TIFF_TYPE_LONG == offsets->type) && (TIFF_TYPE_LONG == counts->type))
+    {
+        uint64_t size = (uint64_t)offsets->count * sizeof(uint32_t);
+        uint32_t* offset_values = (size <= UINT32_MAX) ? parse_value(context, offsets->value, (uint32_t)size) : NULL;
+        uint32_t* count_values = (size <= UINT32_MAX) ? parse_value(context, counts->value, (uint32_t)size) : NULL;
+
+        if ((NULL != offset_values) && (NULL != count_values))
         {
-            fprintf(stderr, "Error: Entry type is not RATIONAL.\n");
+            start = UINT32_MAX;
+
+            for (uint32_t i = 0; i < offsets->count; ++i)
+            {
+                uint32_t offset = parse_get32(context, &offset_values[i]);
+
+                start = min(start, offset);
+                end = max(end, (uint64_t)offset + parse_get32(context, &count_values[i]));
+            }
         }
     }
-    else
+
+    // Ranges beyond 4 GiB or running backwards are not recorded
+    image->raw_offset = 0;
+    image->raw_bytes = 0;
+
+    if ((end > start) && (end - start <= UINT32_MAX))
     {
-        fprintf(stderr, "Error: One or more NULL input arguments.\n");
+        image->raw_offset = start;
+        image->raw_bytes = (uint32_t)(end - start);
     }
-
-    return rational;
 }
 
 /******************************************************************
 *
-* \details Helper function get value of Makernote string entries.
+* \details Parse the GPS IFD.
 *
-* \param[in] entry  : Makernote entry to be processed.
-* \param[in] buffer : Pointer to image file buffer.
+* \param[in] context    : Parse context of the image file.
+* \param[in] gps_offset : Offset of the GPS IFD.
 * \param[out] None
 *
-* \return
-*   Return pointer to entry ASCII string.
+* \return None
 *
 *******************************************************************/
-static char* get_makernote_string(struct ifd_entry_t* entry, void* buffer)
+static void parse_gps(parse_context_t* context, uint32_t gps_offset)
 {
-    char* str = NULL;
-    
-    if ((NULL != entry) && (NULL != buffer))
+    gps_data_t* gps = &context->record->gps;
+    char latitude_ref = 0;
+    char longitude_ref = 0;
+    uint8_t altitude_ref = 0;
+    bool has_latitude = false;
+    bool has_longitude = false;
+    double time_stamp = -1;
+    char date_stamp[11] = { 0 };
+
+    nef_debug_print("Processing GPS IFD...\n");
+    struct ifd_t* ifd = parse_ifd(context, gps_offset, NEF_IFD_GPS);
+    unsigned entries = parse_entry_count(context, ifd);
+    nef_debug_print("GPS IFD Entries = %d\n", entries);
+
+    for (unsigned i = 0; (i < entries) && parse_continue(context); ++i)
     {
-        if (TIFF_TYPE_ASCII == entry->type)
+        struct ifd_entry_t entry;
+
+        parse_entry(context, ifd, i, &entry);
+#if NEF_VERBOSE_DEBUG
+        printf("GPS Tag = 0x%04X\n", entry.tag);
+#endif
+        context->tag = entry.tag;
+
+        switch (entry.tag)
         {
-            if (entry->count > sizeof(uint32_t))
-            {
-                nef_debug_print("Count = %u\n", entry->count);
-                uint8_t* data = (uint8_t*)buffer;
-                // Offset is relative to the beginning of the Makernote TIFF header.
-                // Unlike the other IFD structures, which use an absolute offset.
-                uint32_t offset = makernote_offset + tiff_offset + entry->value;
-                str = (char*)&data[offset];
-            }
-            else
+        case GPS_TAG_LATITUDE_REF:
+        {
+            // Single character string stored in the value field
+            latitude_ref = (char)(entry.value & 0xFF);
+            break;
+        }
+        case GPS_TAG_LATITUDE:
+        {
+            has_latitude = get_gps_coordinate(context, &entry, &gps->latitude);
+            break;
+        }
+        case GPS_TAG_LONGITUDE_REF:
+        {
+            longitude_ref = (char)(entry.value & 0xFF);
+            break;
+        }
+        case GPS_TAG_LONGITUDE:
+        {
+            has_longitude = get_gps_coordinate(context, &entry, &gps->longitude);
+            break;
+        }
+        case GPS_TAG_ALTITUDE_REF:
+        {
+            altitude_ref = entry.value & 0xFF;
+            break;
+        }
+        case GPS_TAG_ALTITUDE:
+        {
+            gps->altitude = get_tiff_rational(context, &entry, NULL);
+            break;
+        }
+        case GPS_TAG_TIME_STAMP:
+        {
+            // Hours, minutes and seconds scale like degrees, minutes and seconds
+            double hours = 0;
+
+            if (get_gps_coordinate(context, &entry, &hours))
             {
-                str = (char*)&entry->value;
+                time_stamp = hours * 3600;
             }
+            break;
         }
-        else
+        case GPS_TAG_DATE_STAMP:
         {
-            fprintf(stderr, "Error: Entry type is not ASCII.\n");
+            parse_copy_string(date_stamp, sizeof(date_stamp), parse_value(context, entry.value, entry.count), entry.count);
+            break;
+        }
+        default:
+            break;
         }
     }
-    else
+
+    if (latitude_ref == GPS_LATITUDE_SOUTH)
+    {
+        gps->latitude = -gps->latitude;
+    }
+
+    if (longitude_ref == GPS_LONGITUDE_WEST)
+    {
+        gps->longitude = -gps->longitude;
+    }
+
+    if (altitude_ref == GPS_ALTITUDE_BELOW)
     {
-        fprintf(stderr, "Error: One or more NULL input arguments.\n");
+        gps->altitude = -gps->altitude;
     }
 
-    return str;
+    gps->valid = has_latitude && has_longitude;
+
+    if ((date_stamp[0] != '\0') && (time_stamp >= 0))
+    {
+        unsigned seconds = (unsigned)(time_stamp + 0.5);
+        snprintf(gps->timestamp, sizeof(gps->timestamp), "%s %02u:%02u:%02u",
+                 date_stamp, (seconds / 3600) % 24, (seconds / 60) % 60, seconds % 60);
+    }
 }
 
 /******************************************************************
 *
-* \details Helper function to strip trailing whitespace in a string.
+* \details
+*   Record the location of an ASCII tag value so it can later be
+*   patched in place. Values of up to four bytes are stored in the
+*   entry itself.
 *
-* \param[in] str  : String to be processed.
+* \param[in] context : Parse context of the image file.
+* \param[in] ifd     : IFD holding the tag.
+* \param[in] index   : Entry index of the tag.
 * \param[out] None
 *
-* \return
-*   Return pointer to string.
+* \return None
 *
 *******************************************************************/
-static char* rstrip(char* str)
+static void record_location(parse_context_t* context, struct ifd_t* ifd, unsigned index)
 {
-    int index;
+    nef_record_t* record = context->record;
+    struct ifd_entry_t entry;
 
-    if (NULL != str)
+    parse_entry(context, ifd, index, &entry);
+
+    if ((TIFF_TYPE_ASCII == entry.type) && (record->location_count < MAX_TAG_LOCATIONS))
     {
-        index = strlen(str) - 1;
-        while (index > 0 && isspace(str[index])) index--;
-        str[++index] = '\0';
+        struct tag_location_t* location = &record->locations[record->location_count++];
+        location->tag = entry.tag;
+        location->count = entry.count;
+        location->offset = (entry.count > sizeof(uint32_t)) ? entry.value
+                                                             : (uint32_t)((uint8_t*)&ifd->entry[index].value - context->buffer);
     }
+}
+
+/******************************************************************
+*
+* \details XMP scan callback storing a property value in the record.
+*
+* \param[in] property : Index of the property in xmp_properties.
+* \param[in] value    : Property value within the XMP packet.
+* \param[in] length   : Length of the value.
+* \param[in] context  : Record receiving the value.
+*
+* \return None
+*
+*******************************************************************/
+static void store_xmp_value(unsigned property, const char* value, uint32_t length, void* context)
+{
+    xmp_data_t* xmp = &((nef_record_t*)context)->xmp;
+    xmp_append_value(xmp->values[property], sizeof(xmp->values[property]), value, length);
 
-    return str;
+    if (strcmp(xmp_properties[property], XMP_PROPERTY_RATING) == 0)
+    {
+        xmp->rating = atoi(xmp->values[property]);
+    }
 }
 
 /******************************************************************
 *
-* \details Helper function to display the formatted image and 
-*          camera information.
+* \details
+*   Scan the XMP packet for the configured properties. The packet
+*   is scanned in place within the image file buffer.
 *
-* \param[in] None
+* \param[in] context : Parse context of the image file.
+* \param[in] entry   : IFD0 XMP entry.
 * \param[out] None
 *
+* \return None
+*
+*******************************************************************/
+static void parse_xmp(parse_context_t* context, struct ifd_entry_t* entry)
+{
+    const char* data = (entry->count > sizeof(uint32_t)) ? parse_value(context, entry->value, entry->count) : NULL;
+
+    if (NULL != data)
+    {
+        xmp_packet_t packet = { data, entry->count };
+        context->record->xmp.present = true;
+        nef_debug_print("XMP Packet Size = %u\n", packet.size);
+        xmp_scan(&packet, xmp_properties, xmp_property_count, store_xmp_value, context->record);
+    }
+    else
+    {
+        parse_error(context, NEF_ERROR_INVALID_XMP, entry->value, entry->count);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Parse the Nikon Makernote of a NEF or NRW file. The Makernote
+*   holds its own TIFF header, and its value offsets are relative
+*   to that header.
+*
+* \param[in,out] context : Parse context of the image file.
+*
 * \return
-*   None
+*   Return true if the Makernote was recognised.
 *
 *******************************************************************/
-static void display_data(void)
+static bool parse_nikon_makernote(parse_context_t* context)
 {
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Camera Model", camera_data->model);
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Serial Number", camera_data->serial_number);
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Camera Lens", camera_data->lens);
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Time Stamp", image_data->timestamp);
-    // FIXME: Update to account for slow shutter speeds (>= 1s)
-    printf("%-*s| 1/%.0f second\n", LEFT_JUSTIFY_WIDTH, "Shutter Speed", 1 / image_data->shutter_speed);
-    printf("%-*s| f/%.1f\n", LEFT_JUSTIFY_WIDTH, "Aperature", image_data->aperature);
-    printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "ISO", image_data->iso);
-    printf("%-*s| %.2f mm\n", LEFT_JUSTIFY_WIDTH, "Focal Length", image_data->focal_length);
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "White Balance", rstrip(image_data->white_balance));
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Quality", rstrip(image_data->quality));
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Focus Mode", rstrip(image_data->focus_mode));
-    printf("%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Metering Mode", image_data->metering_mode);
-    printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Shutter Count", image_data->shutter_count);
+    nef_record_t* record = context->record;
+    struct ifd_t* ifd = NULL;
+    bool big_endian = context->big_endian;
+    struct makernote_header_t* makernote_header = parse_value(context, context->makernote_offset, sizeof(struct makernote_header_t));
+
+    nef_debug_print("Processing Nikon Makernote...\n");
+
+    if ((NULL != makernote_header) && (strncmp(makernote_header->magic_value, MAKERNOTE_MAGIC, sizeof(makernote_header->magic_value)) == 0))
+    {
+        // Limit scope to Makernote processing
+        struct ifd_entry_t lens_data = { 0 };
+        uint8_t lens_type = 0;
+        uint32_t offset = context->makernote_offset + sizeof(struct makernote_header_t);
+
+        context->big_endian = (TIFF_BIG_ENDIAN == makernote_header->tiff_hdr.byte_order);
+        context->tiff_offset = sizeof(struct makernote_header_t) - sizeof(struct tiff_header_t);
+        uint32_t base = context->makernote_offset + context->tiff_offset;
+        ifd = parse_ifd(context, offset, NEF_IFD_MAKERNOTE);
+        unsigned makernote_entries = parse_entry_count(context, ifd);
+        nef_debug_print("Makernote IFD Entries = %d\n", makernote_entries);
+
+        for (unsigned i = 0; (i < makernote_entries) && parse_continue(context); ++i)
+        {
+            struct ifd_entry_t entry;
+
+            parse_entry(context, ifd, i, &entry);
+#if NEF_VERBOSE_DEBUG
+            printf("Makernote Tag = 0x%04X\n", entry.tag);
+#endif
+            context->tag = entry.tag;
+
+            switch (entry.tag)
+            {
+            case NIKON_TAG_MAKERNOTE_VERSION:
+            {
+                // Makernote version is an undefined type and must be
+                // handled differently than other EXIF string types.
+                // The version is stored in the entry value.
+                char makernote_version[sizeof(uint32_t) + 1];
+                uint32_t size = min(entry.count, (uint32_t)sizeof(uint32_t));
+
+                memcpy(makernote_version, &entry.value, size);
+                makernote_version[size] = '\0';
+                nef_debug_print("Makernote Version = \"%s\"\n", makernote_version);
+                break;
+            }
+            case NIKON_TAG_NEF_COMPRESSION:
+            {
+                uint16_t compression = entry.value & 0xFFFF;
+
+                if (compression < sizeof(nikon_compression_names) / sizeof(nikon_compression_names[0]))
+                {
+                    record->image.compression = nikon_compression_names[compression];
+                }
+                break;
+            }
+            case NIKON_TAG_SHUTTER_COUNT:
+            {
+                record->image.shutter_count = entry.value;
+                break;
+            }
+            case NIKON_TAG_FOCUS_MODE:
+            {
+                parse_copy_string(record->image.focus_mode, sizeof(record->image.focus_mode), parse_string(context, &entry, base), entry.count);
+                break;
+            }
+            case NIKON_TAG_QUALITY:
+            {
+                parse_copy_string(record->image.quality, sizeof(record->image.quality), parse_string(context, &entry, base), entry.count);
+                break;
+            }
+            case NIKON_TAG_WHITE_BALANCE:
+            {
+                parse_copy_string(record->image.white_balance, sizeof(record->image.white_balance), parse_string(context, &entry, base), entry.count);
+                break;
+            }
+            case NIKON_TAG_SERIAL_NUMBER:
+            {
+                parse_copy_string(record->camera.serial_number, sizeof(record->camera.serial_number), parse_string(context, &entry, base), entry.count);
+                break;
+            }
+            case NIKON_TAG_ISO_INFO:
+            {
+                uint8_t* iso = parse_value(context, base + entry.value, sizeof(uint8_t));
+
+                if (NULL != iso)
+                {
+                    // Calculate the ISO value
+                    double raw = (double)*iso;
+                    record->image.iso = 100 * pow(2, raw / 12 - 5);
+                    unsigned remainder = record->image.iso % 10;
+                    // Raw ISO value is stored as a single byte.
+                    // Need to round up if value is not divisble by 10.
+                    if (remainder != 0)
+                    {
+                        record->image.iso += 10 - remainder;
+                    }
+                }
+
+                break;
+            }
+            case NIKON_TAG_LENS_TYPE:
+            {
+                // Used as last bye of lens ID composite tag
+                lens_type = entry.value & 0xFF;
+                break;
+            }
+            case NIKON_TAG_LENS_DATA:
+            {
+                // Need shutter count and serial number before processing lens data
+                lens_data = entry;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        if (lens_data.count > 0)
+        {
+            lens_decode(context, parse_value(context, base + lens_data.value, lens_data.count), lens_data.count, lens_type, record);
+        }
+
+        if (record->camera.make[0] == '\0')
+        {
+            parse_copy_string(record->camera.make, sizeof(record->camera.make), NIKON_MAKE, sizeof(NIKON_MAKE));
+        }
+    }
+
+    context->big_endian = big_endian;
+
+    return (NULL != ifd);
 }
 
-/* Main */
-int main(int argc, char** argv)
+/******************************************************************
+*
+* \details
+*   Parse a single raw file into a record. The IFDs shared by the
+*   TIFF based raw formats are parsed here, and the Makernote is
+*   passed to the handler of the format.
+*
+* \param[in] path    : Path of the raw file.
+* \param[out] record : Record receiving the parsed fields.
+*
+* \return
+*   Return true if the file was parsed successfully.
+*
+*******************************************************************/
+static bool parse_image(const char* path, nef_record_t* record)
 {
     bool error = false;
-    FILE* nef_file = NULL;
+    io_file_t file;
     uint8_t* buffer = NULL;
-    long size = 0;
     uint32_t offset = 0;
+    uint32_t ifd0_offset = 0;
+    parse_context_t context;
+    perf_counters_t start;
+    const raw_format_t* format = NULL;
+    scrub_fingerprint_t fingerprint;
+
+    memset(record, 0, sizeof(nef_record_t));
+    memset(&fingerprint, 0, sizeof(scrub_fingerprint_t));
+    record->xmp.rating = XMP_RATING_NONE;
+    // Not every vendor records the metering mode
+    record->image.metering_mode = "Unknown";
+    strncpy_s(record->path, sizeof(record->path), path, sizeof(record->path) - 1);
+    parse_init(&context, record, &parse_limits);
+    trace_file(record->path);
+    alloc_begin(&record->memory);
+
+    char* extension = strrchr(path, '.');
 
-    if (argc < 2)
+    // Select the format by file extension
+    for (unsigned i = 0; (i < sizeof(raw_formats) / sizeof(raw_formats[0])) && (NULL != extension) && (NULL == format); ++i)
     {
-        fprintf(stderr, "Error: Too few input arguments. Please specify a .NEF file to process.\n");
-        error = true;
+        format = (_stricmp(extension + 1, raw_formats[i].extension) == 0) ? &raw_formats[i] : NULL;
     }
 
-    if (!error)
+    if (NULL == format)
     {
-        image_data = malloc(sizeof(image_data_t));
-        camera_data = malloc(sizeof(camera_data_t));
-        printf("%s", banner);
-        char* extension;
-        extension = strrchr(argv[1], '.');
-        // Verify file extension is correct
-        if (strcmp(++extension, "NEF") != 0)
-        {
-            fprintf(stderr, "Error: Unsupported file type .%s. Please specify a .NEF file to process.\n", extension);
-            error = true;
-        }
+        parse_error(&context, NEF_ERROR_UNSUPPORTED_TYPE, 0, 0);
+        error = true;
     }
 
     if (!error)
     {
-        fopen_s(&nef_file, argv[1], "rb");
+        perf_start(&start);
+        bool opened = io_open(&file, path, io_strategy);
+        perf_stop(&record->profile, PERF_STAGE_OPEN, &start);
 
-        if (nef_file == NULL)
+        if (!opened)
         {
-            fprintf(stderr, "Error: Failed to open %s.\n", argv[1]);
+            parse_error(&context, NEF_ERROR_OPEN, 0, 0);
             error = true;
         }
         else
         {
-            // Extract file name from path
-            char* filename = strrchr(argv[1], '\\');
-            printf("%-*s| ", LEFT_JUSTIFY_WIDTH, "File");
+            perf_start(&start);
+            nef_debug_print("Image File Size = %llu bytes\n", (unsigned long long)file.file_size);
 
-            if (NULL != filename)
+            if (!io_read(&file))
             {
-                printf("%s\n", ++filename);
+                parse_error(&context, NEF_ERROR_READ, 0, 0);
+                error = true;
             }
             else
             {
-                printf("%s\n", argv[1]);
-            }
+                perf_stop(&record->profile, PERF_STAGE_READ, &start);
 
-            fseek(nef_file, 0, SEEK_END);
-            size = ftell(nef_file);
-            rewind(nef_file);
-            nef_debug_print("NEF File Size = %d bytes\n", size);
-            buffer = malloc(size);
+                if (NULL != scrubber)
+                {
+                    scrub_read(scrubber, file.data, file.size, &fingerprint);
+                }
 
-            if (buffer == NULL)
-            {
-                fprintf(stderr, "Error: Insufficient memory to allocate buffer.\n");
-                error = true;
-            }
-            else
-            {
-                // Read entire file into buffer
-                fread_s(buffer, size, size, 1, nef_file);
-                nef_header_t* nef_header = (nef_header_t*)buffer;
+                perf_start(&start);
+                buffer = file.data;
 
-                // Validate NEF header
-                if (nef_header->tiff_magic != TIFF_MAGIC ||
-                    nef_header->byte_order != TIFF_LITTLE_ENDIAN)
+                // Validate TIFF header and select the byte order
+                if (!parse_header(&context, buffer, file.size, &ifd0_offset))
                 {
-                    fprintf(stderr, "Error: Invalid NEF.\n");
+                    parse_error(&context, NEF_ERROR_INVALID_HEADER, 0, 0);
                 }
                 else
                 {
-                    nef_debug_print("Valid NEF File.\n");
+                    nef_debug_print("Valid %s File.\n", format->extension);
                     nef_debug_print("Processing IFD0 entries...\n");
-                    struct ifd_t* ifd0 = (struct ifd_t*)&buffer[nef_header->ifd0_offset];
-                    nef_debug_print("IFD0 Entries = %d\n", ifd0->entries);
-                    uint32_t subifd_offset = 0;
+                    struct ifd_t* ifd0 = parse_ifd(&context, ifd0_offset, NEF_IFD_0);
+                    unsigned ifd0_entries = parse_entry_count(&context, ifd0);
+                    nef_debug_print("IFD0 Entries = %d\n", ifd0_entries);
+                    uint32_t subifd_offsets[MAX_SUBIFDS] = { 0 };
+                    uint32_t subifd_count = 0;
                     uint32_t exif_offset = 0;
+                    uint32_t gps_offset = 0;
 
-                    for (unsigned i = 0; i < ifd0->entries; ++i)
+                    for (unsigned i = 0; (i < ifd0_entries) && parse_continue(&context); ++i)
                     {
+                        struct ifd_entry_t entry;
+
+                        parse_entry(&context, ifd0, i, &entry);
 #if NEF_VERBOSE_DEBUG
-                        printf("IFD0 Tag = 0x%04X\n", ifd0->entry[i].tag);
+                        printf("IFD0 Tag = 0x%04X\n", entry.tag);
 #endif                   
-                        switch (ifd0->entry[i].tag)
+                        context.tag = entry.tag;
+
+                        switch (entry.tag)
                         {
                         case EXIF_TAG_EXIF_OFFSET:
                         {
-                            exif_offset = ifd0->entry[i].value;
+                            exif_offset = entry.value;
+                            break;
+                        }
+                        case EXIF_TAG_GPS_OFFSET:
+                        {
+                            gps_offset = entry.value;
+                            break;
+                        }
+                        case EXIF_TAG_XMP:
+                        {
+                            parse_xmp(&context, &entry);
+                            break;
+                        }
+                        case EXIF_TAG_MAKE:
+                        {
+                            parse_copy_string(record->camera.make, sizeof(record->camera.make), parse_string(&context, &entry, 0), entry.count);
                             break;
                         }
                         case EXIF_TAG_MODEL:
                         {
-                            camera_data->model = (char*)&buffer[ifd0->entry[i].value];
+                            parse_copy_string(record->camera.model, sizeof(record->camera.model), parse_string(&context, &entry, 0), entry.count);
                             break;
                         }
                         case EXIF_TAG_SUBIFD_OFFSET:
                         {
-                            // Entry word count determines if value is an offset or the actual value
-                            subifd_offset = (ifd0->entry[i].count > 2) ? *((uint32_t*)&buffer[ifd0->entry[i].value]) : ifd0->entry[i].value;
-                            nef_debug_print("Sub-IFD Offset = 0x%08X\n", subifd_offset);
+                            // A single offset is stored in the value, more are stored at the value offset
+                            subifd_count = min(entry.count, MAX_SUBIFDS);
+                            uint32_t* value = (entry.count > 1)
+                                ? parse_value(&context, entry.value, subifd_count * sizeof(uint32_t)) : &entry.value;
+                            subifd_count = (NULL != value) ? subifd_count : 0;
+
+                            for (unsigned j = 0; j < subifd_count; ++j)
+                            {
+                                subifd_offsets[j] = (entry.count > 1) ? parse_get32(&context, &value[j]) : value[j];
+                                nef_debug_print("Sub-IFD Offset = 0x%08X\n", subifd_offsets[j]);
+                            }
                             break;
                         }
                         case EXIF_TAG_DATE_TIME_ORIGINAL:
                         {
-                            image_data->timestamp = (char*)&buffer[ifd0->entry[i].value];
+                            parse_copy_string(record->image.timestamp, sizeof(record->image.timestamp), parse_string(&context, &entry, 0), entry.count);
+                            record_location(&context, ifd0, i);
+                            break;
+                        }
+                        case EXIF_TAG_DATE_TIME:
+                        case EXIF_TAG_ARTIST:
+                        case EXIF_TAG_COPYRIGHT:
+                        {
+                            record_location(&context, ifd0, i);
                             break;
                         }
                         default:
@@ -445,24 +968,31 @@ int main(int argc, char** argv)
                         }
                     }
 
-                    // Sub-IFD stores the image as a lossy jpeg
-                    // Calculate number of sub-IFD entries
-                    struct ifd_t* subifd = (struct ifd_t*)&buffer[subifd_offset];
-                    nef_debug_print("Sub-IFD Entries = %d\n", subifd->entries);
+                    // Sub-IFDs store the raw image and a jpeg preview. Coolpix NRW
+                    // files may store the raw image in IFD0 instead.
+                    if (NULL != ifd0)
+                    {
+                        parse_image_size(&context, ifd0);
+                    }
 
-                    for (unsigned i = 0; i < subifd->entries; ++i)
+                    for (unsigned i = 0; (i < subifd_count) && parse_continue(&context); ++i)
                     {
-#if NEF_VERBOSE_DEBUG
-                        //TODO: Anything useful to do here?
-                        printf("Sub-IFD Tag = 0x%04X\n", subifd->entry[i].tag);
-#endif
+                        struct ifd_t* subifd = (subifd_offsets[i] != 0) ? parse_ifd(&context, subifd_offsets[i], NEF_IFD_SUB) : NULL;
+                        nef_debug_print("Sub-IFD Entries = %d\n", parse_entry_count(&context, subifd));
+
+                        if (NULL != subifd)
+                        {
+                            parse_image_size(&context, subifd);
+                        }
                     }
 
                     // Next IFD offset is located after the last IFD entry
-                    offset = sizeof(nef_header_t) + sizeof(uint16_t) + (ifd0->entries * sizeof(struct ifd_entry_t));
-                    uint32_t next_ifd_offset = *((uint32_t*)&buffer[offset]);
+                    offset = ifd0_offset + sizeof(uint16_t) + (ifd0_entries * sizeof(struct ifd_entry_t));
+                    context.ifd = NEF_IFD_0;
+                    context.tag = 0;
+                    uint32_t* next_ifd_offset = (NULL != ifd0) ? parse_value(&context, offset, sizeof(uint32_t)) : NULL;
 
-                    if (next_ifd_offset == 0)
+                    if ((NULL == next_ifd_offset) || (parse_get32(&context, next_ifd_offset) == 0))
                     {
                         nef_debug_print("No IFD1 discovered.\n");
                     }
@@ -472,59 +1002,80 @@ int main(int argc, char** argv)
                         //TODO: Process IFD
                     }
 
+                    if (gps_offset != 0)
+                    {
+                        parse_gps(&context, gps_offset);
+                    }
+
+                    perf_stop(&record->profile, PERF_STAGE_IFD0, &start);
+                    perf_start(&start);
+
                     nef_debug_print("Processing IFD0 EXIF data...\n");
-                    struct ifd_t* exif = (struct ifd_t*)&buffer[exif_offset];
-                    nef_debug_print("EXIF IFD Entries = %d\n", exif->entries);
+                    struct ifd_t* exif = (exif_offset != 0) ? parse_ifd(&context, exif_offset, NEF_IFD_EXIF) : NULL;
+                    unsigned exif_entries = parse_entry_count(&context, exif);
+                    nef_debug_print("EXIF IFD Entries = %d\n", exif_entries);
 
-                    for (unsigned i = 0; i < exif->entries; ++i)
+                    for (unsigned i = 0; (i < exif_entries) && parse_continue(&context); ++i)
                     {
+                        struct ifd_entry_t entry;
+
+                        parse_entry(&context, exif, i, &entry);
 #if NEF_VERBOSE_DEBUG
-                        printf("EXIF Tag = 0x%04X\n", exif->entry[i].tag);
+                        printf("EXIF Tag = 0x%04X\n", entry.tag);
 #endif
-                        switch (exif->entry[i].tag)
+                        context.tag = entry.tag;
+
+                        switch (entry.tag)
                         {
                         case EXIF_TAG_MAKERNOTE:
                         {
-                            makernote_offset = exif->entry[i].value;
+                            context.makernote_offset = entry.value;
+                            context.makernote_size = entry.count;
                             break;
                         }
                         case EXIF_TAG_EXPOSURE_TIME:
                         {
-                            image_data->shutter_speed = get_tiff_rational(&exif->entry[i], buffer); 
+                            record->image.shutter_speed = get_tiff_rational(&context, &entry, record->image.exposure_time);
                             break;
                         }
                         case EXIF_TAG_FNUMBER:
                         {
-                            image_data->aperature = get_tiff_rational(&exif->entry[i], buffer);
+                            record->image.aperature = get_tiff_rational(&context, &entry, NULL);
+                            break;
+                        }
+                        case EXIF_TAG_ISO:
+                        {
+                            // Makernotes may refine the ISO value
+                            record->image.iso = entry.value & 0xFFFF;
                             break;
                         }
                         case EXIF_TAG_METERING_MODE:
                         {
-                            switch (exif->entry[i].value)
+                            switch (entry.value)
                             {
                             case 0:
-                                image_data->metering_mode = "Unknown";
+                                record->image.metering_mode = "Unknown";
                                 break;
                             case 1:
-                                image_data->metering_mode = "Average";
+                                record->image.metering_mode = "Average";
                                 break;
                             case 2:
-                                image_data->metering_mode = "Center-Weighted";
+                                record->image.metering_mode = "Center-Weighted";
                                 break;
                             case 3:
-                                image_data->metering_mode = "Spot";
+                                record->image.metering_mode = "Spot";
                                 break;
                             case 4:
-                                image_data->metering_mode = "Multi-Spot";
+                                record->image.metering_mode = "Multi-Spot";
                                 break;
                             case 5:
-                                image_data->metering_mode = "Multi-Segment";
+                                record->image.metering_mode = "Multi-Segment";
                                 break;
                             case 6:
-                                image_data->metering_mode = "Partial";
+                                record->image.metering_mode = "Partial";
                                 break;
                             default:
-                                image_data->metering_mode = "Other";
+                                record->image.metering_mode = "Other";
                                 break;
                             }
 
@@ -532,7 +1083,23 @@ int main(int argc, char** argv)
                         }
                         case EXIF_TAG_FOCAL_LENGTH:
                         {
-                            image_data->focal_length = get_tiff_rational(&exif->entry[i], buffer);
+                            record->image.focal_length = get_tiff_rational(&context, &entry, NULL);
+                            break;
+                        }
+                        case EXIF_TAG_BODY_SERIAL_NUMBER:
+                        {
+                            parse_copy_string(record->camera.serial_number, sizeof(record->camera.serial_number), parse_string(&context, &entry, 0), entry.count);
+                            break;
+                        }
+                        case EXIF_TAG_LENS_MODEL:
+                        {
+                            parse_copy_string(record->camera.lens, sizeof(record->camera.lens), parse_string(&context, &entry, 0), entry.count);
+                            break;
+                        }
+                        case EXIF_TAG_DATE_TIME_ORIGINAL:
+                        case EXIF_TAG_CREATE_DATE:
+                        {
+                            record_location(&context, exif, i);
                             break;
                         }
                         default:
@@ -540,148 +1107,1380 @@ int main(int argc, char** argv)
                         }
                     }
 
-                    nef_debug_print("Processing Nikon Makernote...\n");
-                    struct makernote_header_t* makernote_header = (struct makernote_header_t*)&buffer[makernote_offset];
-                    nef_debug_print("Makernote Magic Value = %s\n", makernote_header->magic_value);
+                    perf_stop(&record->profile, PERF_STAGE_EXIF, &start);
+                    perf_start(&start);
+
+                    // DNG files carry everything of interest in the EXIF IFD
+                    bool makernote_valid = (NULL == format->makernote) ||
+                                           ((context.makernote_offset != 0) && format->makernote(&context));
 
-                    if (strcmp(makernote_header->magic_value, MAKERNOTE_MAGIC) == 0)
+                    if (!makernote_valid && !context.aborted)
                     {
-                        // Limit scope to Makernote processing
-                        struct ifd_entry_t* lens_data = NULL;
-                        uint8_t lens_type = 0;
+                        parse_error(&context, NEF_ERROR_INVALID_MAKERNOTE, context.makernote_offset, 0);
+                    }
 
-                        offset = makernote_offset + sizeof(struct makernote_header_t);
-                        nef_debug_print("Makernote IFD Offset = %d\n", makernote_header->tiff_hdr.ifd0_offset);
-                        struct ifd_t* makernote = (struct ifd_t*)&buffer[offset];
-                        nef_debug_print("Makernote IFD Entries = %d\n", makernote->entries);
-                        tiff_offset = sizeof(struct makernote_header_t) - sizeof(struct tiff_header_t);
+                    if (record->camera.lens[0] == '\0')
+                    {
+                        parse_copy_string(record->camera.lens, sizeof(record->camera.lens), RECORD_UNKNOWN_LENS, sizeof(RECORD_UNKNOWN_LENS));
+                    }
 
-                        for (unsigned i = 0; i < makernote->entries; ++i)
-                        {
-#if NEF_VERBOSE_DEBUG
-                            printf("Makernote Tag = 0x%04X\n", makernote->entry[i].tag);
-#endif
-                            switch (makernote->entry[i].tag)
-                            {
-                            case NIKON_TAG_MAKERNOTE_VERSION:
-                            {
-                                // Makernote version is an undefined type and must be
-                                // handled differently than other EXIF string types.
-                                unsigned size = makernote->entry[i].count + 1;
-                                char* makernote_version = malloc(size);
-
-                                if (NULL != makernote_version)
-                                {
-                                    strncpy_s(makernote_version, size, (char*)&makernote->entry[i].value, makernote->entry[i].count);
-                                    makernote_version[--size] = '\0';
-                                    nef_debug_print("Makernote Version = \"%s\"\n", makernote_version);
-                                    free(makernote_version);
-                                }
+                    // Files that exceeded a limit are rejected
+                    record->valid = (NULL != ifd0) && makernote_valid && !context.aborted;
 
-                                break;
-                            }
-                            case NIKON_TAG_SHUTTER_COUNT:
-                            {
-                                image_data->shutter_count = makernote->entry[i].value;
-                                break;
-                            }
-                            case NIKON_TAG_FOCUS_MODE:
-                            {
-                                image_data->focus_mode = get_makernote_string(&makernote->entry[i], buffer);
-                                break;
-                            }
-                            case NIKON_TAG_QUALITY:
-                            {
-                                image_data->quality = get_makernote_string(&makernote->entry[i], buffer);
-                                break;
-                            }
-                            case NIKON_TAG_WHITE_BALANCE:
-                            {
-                                image_data->white_balance = get_makernote_string(&makernote->entry[i], buffer);
-                                break;
-                            }
-                            case NIKON_TAG_SERIAL_NUMBER:
-                            {
-                                camera_data->serial_number = get_makernote_string(&makernote->entry[i], buffer);
-                                break;
-                            }
-                            case NIKON_TAG_ISO_INFO:
-                            {
-                                offset = makernote_offset + tiff_offset + makernote->entry[i].value;
-                                // Calculate the ISO value
-                                double raw = (double)buffer[offset];
-                                image_data->iso = 100 * pow(2, raw / 12 - 5);
-                                unsigned remainder = image_data->iso % 10;
-                                // Raw ISO value is stored as a single byte.
-                                // Need to round up if value is not divisble by 10.
-                                if (remainder != 0)
-                                {
-                                    image_data->iso += 10 - remainder;
-                                }
+                    perf_stop(&record->profile, PERF_STAGE_MAKERNOTE, &start);
+                }
+            }
+        }
 
-                                break;
-                            }
-                            case NIKON_TAG_LENS_TYPE:
-                            {
-                                // Used as last bye of lens ID composite tag
-                                lens_type = makernote->entry[i].value & 0xFF;
-                                break;
-                            }
-                            case NIKON_TAG_LENS_DATA:
-                            {
-                                // Need shutter count and serial number before processing lens data
-                                lens_data = &makernote->entry[i];
-                                break;
-                            }
-                            default:
-                                break;
-                            }
-                        }
+        // Files that could not be read are checked off too, so the pass can end
+        if (NULL != scrubber)
+        {
+            scrub_verify(scrubber, path, record, file.data, file.size, &fingerprint);
+        }
 
-                        if (NULL != lens_data)
-                        {
-                            char version[5];
-                            offset = makernote_offset + tiff_offset + lens_data->value;
-                            strncpy_s(version, sizeof(version), (char*)&buffer[offset], sizeof(version) - 1);
-                            version[4] = '\0'; // Lens data version is not NULL terminated
-                            uint32_t lens_data_version = atoi(version);
-                            nef_debug_print("Lens Data Version = %u\n", lens_data_version);
-
-                            // Lens data is encrypted if the version is 0201 or greater
-                            if (lens_data_version >= LENS_DATA_0201)
-                            {
-                                nef_debug_print("Nikon lens data is encrypted. Decrypting data...\n");
-                                // Encrypted data begins after version string
-                                decrypt(&buffer[offset + 4], lens_data->count - 4, camera_data->serial_number, image_data->shutter_count);
-                            }
+        io_close(&file);
+        record->io = file.stats;
+    }
+    else if (NULL != scrubber)
+    {
+        scrub_verify(scrubber, path, record, NULL, 0, &fingerprint);
+    }
 
-                            // Construct Lens ID composite tag
-                            // See https://exiftool.org/TagNames/Nikon.html#LensData00
-                            uint8_t lens_id[8];
-                            memcpy_s(lens_id, sizeof(lens_id), &buffer[offset + LENS_ID_OFFSET], sizeof(lens_id) - 1);
-                            lens_id[7] = lens_type;
-                            camera_data->lens = nikon_lens_id_lookup(lens_id);
+    alloc_end(&record->memory);
+    metrics_record_file(record);
 
-                            if (NULL == camera_data->lens)
-                            {
-                                camera_data->lens = "Unknown";
-                            }
-                        }
+    return record->valid;
+}
 
-                        display_data();
-                    }
-                    else
-                    {
-                        fprintf(stderr, "Error: Invalid Makernote.\n");
-                    }
+/******************************************************************
+*
+* \details Display a line of a file, on the console or in the report file.
+*
+* \param[in] output : Report file (NULL = console).
+* \param[in] format : printf format of the line.
+*
+* \return None
+*
+*******************************************************************/
+static void display_print(stream_t* output, const char* format, ...)
+{
+    char line[1024];
+    va_list arguments;
 
-                    free(buffer);
-                }
-            }
+    va_start(arguments, format);
+
+    if (NULL == output)
+    {
+        vprintf(format, arguments);
+    }
+    else
+    {
+        // Longer lines are truncated, like the fields they display
+        _vsnprintf_s(line, sizeof(line), _TRUNCATE, format, arguments);
+        stream_write(output, line, (uint32_t)strlen(line));
+    }
+
+    va_end(arguments);
+}
+
+/******************************************************************
+*
+* \details Helper function to display the formatted image and 
+*          camera information.
+*
+* \param[in] record : Record to be displayed.
+* \param[in] output : Report file (NULL = console).
+*
+* \return
+*   None
+*
+*******************************************************************/
+static void display_data(const nef_record_t* record, stream_t* output)
+{
+    const image_data_t* image_data = &record->image;
+    const camera_data_t* camera_data = &record->camera;
+    // Extract file name from path
+    const char* filename = strrchr(record->path, '\\');
+
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "File", (NULL != filename) ? filename + 1 : record->path);
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Camera Model", camera_data->model);
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Serial Number", camera_data->serial_number);
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Camera Lens", camera_data->lens);
+
+    if (camera_data->lens_info.min_focal_length > 0)
+    {
+        display_print(output, "%-*s| %.0f-%.0f mm f/%.1f-%.1f\n", LEFT_JUSTIFY_WIDTH, "Lens Range",
+            camera_data->lens_info.min_focal_length, camera_data->lens_info.max_focal_length,
+            camera_data->lens_info.max_aperture_min_focal, camera_data->lens_info.max_aperture_max_focal);
+    }
+
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Time Stamp", image_data->timestamp);
+
+    if (image_data->shutter_speed > 0)
+    {
+        // FIXME: Update to account for slow shutter speeds (>= 1s)
+        display_print(output, "%-*s| 1/%.0f second\n", LEFT_JUSTIFY_WIDTH, "Shutter Speed", 1 / image_data->shutter_speed);
+    }
+
+    display_print(output, "%-*s| f/%.1f\n", LEFT_JUSTIFY_WIDTH, "Aperature", image_data->aperature);
+    display_print(output, "%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "ISO", image_data->iso);
+    display_print(output, "%-*s| %.2f mm\n", LEFT_JUSTIFY_WIDTH, "Focal Length", image_data->focal_length);
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "White Balance", image_data->white_balance);
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Quality", image_data->quality);
 
-            fclose(nef_file);
+    if (NULL != image_data->compression)
+    {
+        display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Compression", image_data->compression);
+    }
+
+    if (image_data->width > 0)
+    {
+        display_print(output, "%-*s| %u x %u\n", LEFT_JUSTIFY_WIDTH, "Image Size", image_data->width, image_data->height);
+    }
+
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Focus Mode", image_data->focus_mode);
+    display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "Metering Mode", image_data->metering_mode);
+    display_print(output, "%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Shutter Count", image_data->shutter_count);
+
+    if (record->gps.valid)
+    {
+        display_print(output, "%-*s| %.6f, %.6f\n", LEFT_JUSTIFY_WIDTH, "GPS Position", record->gps.latitude, record->gps.longitude);
+        display_print(output, "%-*s| %.1f m\n", LEFT_JUSTIFY_WIDTH, "GPS Altitude", record->gps.altitude);
+        display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "GPS Time", record->gps.timestamp);
+    }
+
+    for (unsigned i = 0; (i < xmp_property_count) && record->xmp.present; ++i)
+    {
+        if (record->xmp.values[i][0] != '\0')
+        {
+            display_print(output, "%-*s| %s\n", LEFT_JUSTIFY_WIDTH, xmp_properties[i], record->xmp.values[i]);
         }
     }
+}
+
+/******************************************************************
+*
+* \details Spatial query callback displaying a nearby frame.
+*
+* \param[in] record      : Record within the query radius.
+* \param[in] distance_km : Distance from the query position.
+* \param[in] context     : Unused.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+static void display_nearby(const nef_record_t* record, double distance_km, void* context)
+{
+    const char* filename = strrchr(record->path, '\\');
+    printf("%-*s| %.3f km\n", LEFT_JUSTIFY_WIDTH, (NULL != filename) ? filename + 1 : record->path, distance_km);
+}
+
+/******************************************************************
+*
+* \details Batch callback queueing the XMP sidecar of a record.
+*
+* \param[in] record  : Parsed record.
+* \param[in] context : Sidecar writer.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+static void submit_sidecar(nef_record_t* record, void* context)
+{
+    sidecar_writer_submit((sidecar_writer_t*)context, record);
+}
+
+/******************************************************************
+*
+* \details Batch callback queuing a record for the database writer.
+*
+* \param[in] record  : Parsed record.
+* \param[in] context : Database writer.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+static void submit_database(nef_record_t* record, void* context)
+{
+    database_writer_submit((database_writer_t*)context, record);
+}
+
+/******************************************************************
+*
+* \details Batch callback queuing a record for the ring producer.
+*
+* \param[in] record  : Parsed record.
+* \param[in] context : Ring.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+static void submit_ring(nef_record_t* record, void* context)
+{
+    ring_producer_submit((ring_t*)context, record);
+}
+
+/******************************************************************
+*
+* \details Batch callback encoding a record for the record writer.
+*
+* \param[in] record  : Parsed record.
+* \param[in] context : Record writer.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+static void submit_record(nef_record_t* record, void* context)
+{
+    record_writer_submit((record_writer_t*)context, record);
+}
+
+/******************************************************************
+*
+* \details
+*   Batch callback passing a record to the output of the batch,
+*   then reporting its errors. The record is not kept.
+*
+* \param[in] record  : Parsed record.
+* \param[in] context : Record sink.
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+static void submit_sink(nef_record_t* record, void* context)
+{
+    record_sink_t* sink = (record_sink_t*)context;
+
+    if (NULL != sink->callback)
+    {
+        perf_counters_t start;
+
+        perf_start(&start);
+        sink->callback(record, sink->context);
+        perf_stop(&record->profile, PERF_STAGE_OUTPUT, &start);
+    }
+
+    AcquireSRWLockExclusive(&sink->lock);
+    nef_error_print(stderr, record->path, &record->errors);
+    nef_error_summarize(&sink->errors, &record->errors);
+    perf_add(&sink->profile, &record->profile);
+    ReleaseSRWLockExclusive(&sink->lock);
+}
+
+/******************************************************************
+*
+* \details Parse the command line options.
+*
+* \param[in] argc     : Argument count.
+* \param[in] argv     : Argument values.
+* \param[out] options : Parsed options.
+*
+* \return
+*   Return true if the options are valid.
+*
+*******************************************************************/
+static bool parse_options(int argc, char** argv, nef_options_t* options)
+{
+    bool valid = true;
+
+    memset(options, 0, sizeof(nef_options_t));
+    // Files are collected in place at the front of argv
+    options->files = &argv[1];
+    options->ring_slots = RING_DEFAULT_SLOTS;
+    options->cpu_level = cpu_detect();
+    options->interactive_threads = 1;
+    options->sampler.seed = GetTickCount64() ^ ((uint64_t)GetCurrentProcessId() << 32);
+
+    for (int i = 1; (i < argc) && valid; ++i)
+    {
+        if (strcmp(argv[i], "--near") == 0)
+        {
+            // --near <latitude>,<longitude>,<radius km>
+            gps_query_t* query = &options->near[options->near_count];
 
-    return 0;
-}
\ No newline at end of file
+            if ((i + 1 < argc) && (options->near_count < GPS_MAX_QUERIES) &&
+                (sscanf_s(argv[++i], "%lf,%lf,%lf", &query->latitude, &query->longitude, &query->radius_km) == 3))
+            {
+                options->near_count++;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --near expects <latitude>,<longitude>,<radius km>, at most %u times.\n", GPS_MAX_QUERIES);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            // --threads <count>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &options->threads) == 1) &&
+                (options->threads <= BATCH_MAX_THREADS))
+            {
+                nef_debug_print("Worker Threads = %u\n", options->threads);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --threads expects a count between 0 and %u.\n", BATCH_MAX_THREADS);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--sidecar") == 0)
+        {
+            options->sidecar = true;
+        }
+        else if (strcmp(argv[i], "--overwrite") == 0)
+        {
+            options->overwrite = true;
+        }
+        else if (strcmp(argv[i], "--shift-time") == 0)
+        {
+            // --shift-time <[+|-]seconds | [+|-]HH:MM:SS>
+            if ((i + 1 < argc) && patch_parse_shift(argv[++i], &options->patcher.shift_seconds))
+            {
+                options->patcher.shift = true;
+                options->patch = true;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --shift-time expects [+|-]<seconds> or [+|-]<HH:MM:SS>.\n");
+                valid = false;
+            }
+        }
+        else if ((strcmp(argv[i], "--artist") == 0) || (strcmp(argv[i], "--copyright") == 0))
+        {
+            // --artist <text>, --copyright <text>
+            if (i + 1 < argc)
+            {
+                const char** text = (strcmp(argv[i], "--artist") == 0) ? &options->patcher.artist : &options->patcher.copyright;
+                *text = argv[++i];
+                options->patch = true;
+            }
+            else
+            {
+                fprintf(stderr, "Error: %s expects <text>.\n", argv[i]);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--database") == 0)
+        {
+            // --database <file>
+            if (i + 1 < argc)
+            {
+                options->database = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --database expects <file>.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--database-batch") == 0)
+        {
+            // --database-batch <records>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &options->database_batch) == 1) && (options->database_batch > 0))
+            {
+                nef_debug_print("Database Batch = %u\n", options->database_batch);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --database-batch expects a record count greater than 0.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--ring") == 0)
+        {
+            // --ring <name>
+            if (i + 1 < argc)
+            {
+                options->ring = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --ring expects <name>.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--ring-slots") == 0)
+        {
+            // --ring-slots <count>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &options->ring_slots) == 1) &&
+                (options->ring_slots > 0) && ((options->ring_slots & (options->ring_slots - 1)) == 0))
+            {
+                nef_debug_print("Ring Slots = %u\n", options->ring_slots);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --ring-slots expects a power of two.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--records") == 0)
+        {
+            // --records <file>
+            if (i + 1 < argc)
+            {
+                options->records = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --records expects <file>.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            // --output <file>
+            if (i + 1 < argc)
+            {
+                options->output = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --output expects <file>.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--compress") == 0)
+        {
+            // --compress <level>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%d", &options->compression_level) == 1) &&
+                (options->compression_level >= STREAM_MIN_LEVEL) && (options->compression_level <= STREAM_MAX_LEVEL))
+            {
+                nef_debug_print("Compression Level = %d\n", options->compression_level);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --compress expects a level between %d and %d.\n", STREAM_MIN_LEVEL, STREAM_MAX_LEVEL);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--recover") == 0)
+        {
+            options->recover = true;
+        }
+        else if (strcmp(argv[i], "--trace") == 0)
+        {
+            // --trace <file.json>
+            if (i + 1 < argc)
+            {
+                options->trace = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --trace expects a trace file.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--cpu") == 0)
+        {
+            // --cpu <scalar|sse4.2|avx2|avx512>
+            if ((i + 1 < argc) && cpu_parse_level(argv[++i], &options->cpu_level))
+            {
+                nef_debug_print("CPU Kernels = %s\n", cpu_level_name(options->cpu_level));
+            }
+            else
+            {
+                fprintf(stderr, "Error: --cpu expects scalar, sse4.2, avx2 or avx512.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--numa") == 0)
+        {
+            // --numa <auto|on|off>
+            if (!(i + 1 < argc) || !numa_parse_mode(argv[++i], &options->numa))
+            {
+                fprintf(stderr, "Error: --numa expects auto, on or off.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--io") == 0)
+        {
+            // --io <read|map|window|overlapped>
+            if ((i + 1 < argc) && io_parse_strategy(argv[++i], &io_strategy))
+            {
+                nef_debug_print("I/O Strategy = %s\n", io_strategy_name(io_strategy));
+            }
+            else
+            {
+                fprintf(stderr, "Error: --io expects read, map, window or overlapped.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--max-bandwidth") == 0)
+        {
+            // --max-bandwidth <MiB/s>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%llu", &options->max_bandwidth) == 1))
+            {
+                nef_debug_print("Max Bandwidth = %llu MiB/s\n", options->max_bandwidth);
+                options->max_bandwidth *= 1024 * 1024;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-bandwidth expects a rate in MiB/s.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--max-iops") == 0)
+        {
+            // --max-iops <ops/s>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%llu", &options->max_iops) == 1))
+            {
+                nef_debug_print("Max IOPS = %llu\n", options->max_iops);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-iops expects a rate in operations per second.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--control") == 0)
+        {
+            // --control <pipe name>
+            if (i + 1 < argc)
+            {
+                options->control = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --control expects a pipe name.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--metrics") == 0)
+        {
+            // --metrics <port>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%hu", &options->metrics_port) == 1) && (options->metrics_port > 0))
+            {
+                nef_debug_print("Metrics Port = %u\n", options->metrics_port);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --metrics expects a port between 1 and 65535.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--isolate") == 0)
+        {
+            // --isolate <processes>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &options->isolate) == 1) &&
+                (options->isolate > 0) && (options->isolate <= ISOLATE_MAX_PROCESSES))
+            {
+                nef_debug_print("Worker Processes = %u\n", options->isolate);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --isolate expects a count between 1 and %u.\n", ISOLATE_MAX_PROCESSES);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--quarantine") == 0)
+        {
+            // --quarantine <file>
+            if (i + 1 < argc)
+            {
+                options->quarantine = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --quarantine expects a file.\n");
+                valid = false;
+            }
+        }
+        else if ((strcmp(argv[i], ISOLATE_WORKER_OPTION) == 0) && (i + 1 < argc))
+        {
+            // Added by the supervisor to the command line of its workers
+            options->isolate_worker = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scrub") == 0)
+        {
+            // --scrub <catalog>
+            if (i + 1 < argc)
+            {
+                options->scrub = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Error: --scrub expects a catalog file.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--scrub-raw") == 0)
+        {
+            options->scrub_raw = true;
+        }
+        else if (strcmp(argv[i], "--sample") == 0)
+        {
+            // --sample <count | percent%>
+            if ((i + 1 < argc) && sample_parse_size(argv[++i], &options->sampler))
+            {
+                options->sampling = true;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --sample expects a number of files or a percentage (e.g. 5%%).\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--stratify") == 0)
+        {
+            // --stratify <directory | month>
+            if (!((i + 1 < argc) && sample_parse_strata(argv[++i], &options->sampler.strata)))
+            {
+                fprintf(stderr, "Error: --stratify expects directory or month.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            // --seed <number>
+            unsigned long long seed = 0;
+
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%llu", &seed) == 1))
+            {
+                options->sampler.seed = seed;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --seed expects a number.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--estimate") == 0)
+        {
+            // --estimate <field>[<operator><value>]
+            sampler_t* sampler = &options->sampler;
+
+            if ((i + 1 < argc) && (sampler->estimate_count < SAMPLE_MAX_ESTIMATES) &&
+                sample_parse_estimate(argv[++i], &sampler->estimates[sampler->estimate_count]))
+            {
+                sampler->estimate_count++;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --estimate expects a numeric field or <field><operator><value>, at most %u times.\n", SAMPLE_MAX_ESTIMATES);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--serve") == 0)
+        {
+            options->serve = true;
+        }
+        else if (strcmp(argv[i], "--interactive-threads") == 0)
+        {
+            // --interactive-threads <count>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &options->interactive_threads) == 1) &&
+                (options->interactive_threads < BATCH_MAX_THREADS))
+            {
+                nef_debug_print("Interactive Threads = %u\n", options->interactive_threads);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --interactive-threads expects a count between 0 and %u.\n", BATCH_MAX_THREADS - 1);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--max-ifds") == 0)
+        {
+            // --max-ifds <count>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &parse_limits.max_ifds) == 1) &&
+                (parse_limits.max_ifds > 0) && (parse_limits.max_ifds <= PARSE_MAX_IFDS_LIMIT))
+            {
+                nef_debug_print("Max IFDs = %u\n", parse_limits.max_ifds);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-ifds expects a count between 1 and %u.\n", PARSE_MAX_IFDS_LIMIT);
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--max-entries") == 0)
+        {
+            // --max-entries <count>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &parse_limits.max_entries) == 1) && (parse_limits.max_entries > 0))
+            {
+                nef_debug_print("Max IFD Entries = %u\n", parse_limits.max_entries);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-entries expects a count greater than 0.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--max-bytes") == 0)
+        {
+            // --max-bytes <bytes>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &parse_limits.max_bytes) == 1) && (parse_limits.max_bytes > 0))
+            {
+                nef_debug_print("Max Bytes = %u\n", parse_limits.max_bytes);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-bytes expects a size in bytes greater than 0.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--deadline") == 0)
+        {
+            // --deadline <ms>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%u", &parse_limits.deadline_ms) == 1))
+            {
+                nef_debug_print("Deadline = %u ms\n", parse_limits.deadline_ms);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --deadline expects a time in milliseconds.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0)
+        {
+            options->benchmark = true;
+        }
+        else if (strcmp(argv[i], "--memory") == 0)
+        {
+            options->memory = true;
+        }
+        else if (strcmp(argv[i], "--max-file-heap") == 0)
+        {
+            // --max-file-heap <bytes>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%llu", &options->max_file_heap) == 1))
+            {
+                nef_debug_print("Max File Heap = %llu bytes\n", options->max_file_heap);
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-file-heap expects a size in bytes.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--max-rss") == 0)
+        {
+            // --max-rss <MiB>
+            if ((i + 1 < argc) && (sscanf_s(argv[++i], "%llu", &options->max_working_set) == 1))
+            {
+                options->max_working_set *= 1024 * 1024;
+            }
+            else
+            {
+                fprintf(stderr, "Error: --max-rss expects a size in MiB.\n");
+                valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            options->profile = true;
+            perf_enabled = true;
+        }
+        else if (strcmp(argv[i], "--xmp") == 0)
+        {
+            // --xmp <property>[,<property>...]
+            char* context = NULL;
+            char* name = (i + 1 < argc) ? strtok_s(argv[++i], ",", &context) : NULL;
+            xmp_property_count = 0;
+
+            while ((NULL != name) && (xmp_property_count < XMP_MAX_PROPERTIES))
+            {
+                strncpy_s(xmp_property_names[xmp_property_count], XMP_MAX_NAME_LENGTH, name, XMP_MAX_NAME_LENGTH - 1);
+                xmp_properties[xmp_property_count] = xmp_property_names[xmp_property_count];
+                xmp_property_count++;
+                name = strtok_s(NULL, ",", &context);
+            }
+
+            if (xmp_property_count == 0)
+            {
+                fprintf(stderr, "Error: --xmp expects <property>[,<property>...].\n");
+                valid = false;
+            }
+        }
+        else
+        {
+            options->files[options->file_count++] = argv[i];
+        }
+    }
+
+    // Each file is sent to a single output
+    if (valid && ((options->patch || options->recover) + options->sidecar + (NULL != options->database) + (NULL != options->ring) +
+                  (NULL != options->records) + options->benchmark + options->memory + (NULL != options->scrub) > 1))
+    {
+        fprintf(stderr, "Error: Only one of --sidecar, --database, --ring, --records, --benchmark, --memory, --scrub or patching can be selected.\n");
+        valid = false;
+    }
+
+    // Queries run on the records kept for the display
+    if (valid && (options->near_count > 0) &&
+        (options->patch || options->recover || options->sidecar || (NULL != options->database) || (NULL != options->ring) ||
+         (NULL != options->records) || options->benchmark || options->memory || (NULL != options->scrub)))
+    {
+        fprintf(stderr, "Error: --near cannot be combined with --sidecar, --database, --ring, --records, --benchmark, --memory, --scrub or patching.\n");
+        valid = false;
+    }
+
+    if (valid && options->overwrite && !options->sidecar)
+    {
+        fprintf(stderr, "Error: --overwrite requires --sidecar.\n");
+        valid = false;
+    }
+
+    if (valid && options->scrub_raw && (NULL == options->scrub))
+    {
+        fprintf(stderr, "Error: --scrub-raw requires --scrub.\n");
+        valid = false;
+    }
+
+    // Patches only need the tag locations, so the pages holding the pixel
+    // data are never read. The file is closed before it is patched.
+    if (valid && options->patch && (IO_STRATEGY_WINDOW != io_strategy) && (IO_STRATEGY_MAP != io_strategy))
+    {
+        io_strategy = IO_STRATEGY_MAP;
+        nef_debug_print("I/O Strategy = %s\n", io_strategy_name(io_strategy));
+    }
+
+    // Fingerprints cover whole files and are taken in process
+    if (valid && (NULL != options->scrub) && ((IO_STRATEGY_WINDOW == io_strategy) || (options->isolate > 0)))
+    {
+        fprintf(stderr, "Error: --scrub cannot be combined with --io window or --isolate.\n");
+        valid = false;
+    }
+
+    // Estimates without --sample are taken from every file
+    if (valid && (options->sampler.estimate_count > 0) && !options->sampling)
+    {
+        options->sampler.percent = 100.0;
+        options->sampling = true;
+    }
+
+    if (valid && (SAMPLE_STRATA_NONE != options->sampler.strata) && !options->sampling)
+    {
+        fprintf(stderr, "Error: --stratify requires --sample.\n");
+        valid = false;
+    }
+
+    // Samples select the files of a parse batch
+    if (valid && options->sampling && (options->recover || options->benchmark || options->memory || (NULL != options->scrub)))
+    {
+        fprintf(stderr, "Error: --sample and --estimate cannot be combined with --recover, --benchmark, --memory or --scrub.\n");
+        valid = false;
+    }
+
+    if (valid && options->serve && (NULL == options->control))
+    {
+        fprintf(stderr, "Error: --serve requires --control.\n");
+        valid = false;
+    }
+
+    // Interactive requests and the benchmarks parse in process
+    if (valid && (options->isolate > 0) && ((NULL != options->control) || options->benchmark || options->memory))
+    {
+        fprintf(stderr, "Error: --isolate cannot be combined with --control, --benchmark or --memory.\n");
+        valid = false;
+    }
+
+    if (valid && (NULL != options->quarantine) && (options->isolate == 0))
+    {
+        fprintf(stderr, "Error: --quarantine requires --isolate.\n");
+        valid = false;
+    }
+
+    // A service may start without files to backfill
+    if (valid && (options->file_count == 0) && !options->serve)
+    {
+        fprintf(stderr, "Error: Too few input arguments. Please specify a raw image file (.NEF, .NRW, .CR2, .ARW, .PEF, .ORF or .DNG) to process.\n");
+        valid = false;
+    }
+
+    return valid;
+}
+
+/* Main */
+int main(int argc, char** argv)
+{
+    bool error = false;
+    int exit_code = 0;
+    nef_options_t options;
+    nef_record_t* records = NULL;
+    char** files = NULL;
+    unsigned file_count = 0;
+    sidecar_writer_t sidecar_writer;
+    database_writer_t database_writer;
+    ring_t ring;
+    record_writer_t record_writer;
+    scrubber_t scrub_catalog;
+    stream_t report;
+    stream_t* output = NULL;    // Report file of the displayed files (NULL = console)
+
+    if (!parse_options(argc, argv, &options))
+    {
+        error = true;
+    }
+    else if (!cpu_dispatch(options.cpu_level))
+    {
+        fprintf(stderr, "Error: This processor does not support the %s kernels.\n", cpu_level_name(options.cpu_level));
+        error = true;
+    }
+    else if (NULL != options.isolate_worker)
+    {
+        // Worker processes share the caps, rounded up so a cap never becomes unlimited
+        unsigned processes = (options.isolate > 0) ? options.isolate : 1;
+        io_set_limits((options.max_bandwidth + processes - 1) / processes, (options.max_iops + processes - 1) / processes);
+    }
+    else
+    {
+        io_set_limits(options.max_bandwidth, options.max_iops);
+    }
+
+    // Worker processes parse for their supervisor and display nothing
+    if (!error && (NULL != options.isolate_worker))
+    {
+        return isolate_worker(options.isolate_worker, parse_image) ? 0 : 1;
+    }
+
+    if (!error)
+    {
+        printf("%s", banner);
+
+        const char* extensions[sizeof(raw_formats) / sizeof(raw_formats[0])];
+
+        for (unsigned i = 0; i < sizeof(raw_formats) / sizeof(raw_formats[0]); ++i)
+        {
+            extensions[i] = raw_formats[i].extension;
+        }
+
+        // Directories are searched recursively for image files
+        if (!batch_expand_paths(options.files, options.file_count, extensions,
+                                sizeof(extensions) / sizeof(extensions[0]), &files, &file_count))
+        {
+            fprintf(stderr, "Error: Insufficient memory to allocate file list.\n");
+            error = true;
+        }
+    }
+
+    // Records are kept only for the outputs reading them after the file is done:
+    // the display once the batch is done, and the database and ring writer
+    // threads, which queue the records themselves. Files rendered to a sidecar
+    // or record file, patched or scrubbed are passed on one record at a time.
+    bool keep_records = options.sampling || (NULL != options.database) || (NULL != options.ring) ||
+                        !(options.patch || options.recover || options.sidecar || (NULL != options.records) ||
+                          (NULL != options.scrub) || options.benchmark || options.memory);
+
+    if (!error && keep_records)
+    {
+        records = calloc((file_count > 0) ? file_count : 1, sizeof(nef_record_t));
+
+        if (NULL == records)
+        {
+            fprintf(stderr, "Error: Insufficient memory to allocate records.\n");
+            error = true;
+        }
+    }
+
+    // The output and trace files are closed on every path, so they are opened
+    // before any writer is started and a failure leaves no writer running
+    if (!error && (NULL != options.output))
+    {
+        if (stream_open(&report, options.output, options.compression_level,
+                        (options.threads > 0) ? options.threads : batch_default_threads()))
+        {
+            output = &report;
+        }
+        else
+        {
+            fprintf(stderr, "Error: Failed to create output file %s.\n", options.output);
+            error = true;
+        }
+    }
+
+    if (!error && (NULL != options.trace) && !trace_open(options.trace, options.compression_level,
+                                                         (options.threads > 0) ? options.threads : batch_default_threads()))
+    {
+        fprintf(stderr, "Error: Failed to create trace file %s.\n", options.trace);
+        error = true;
+    }
+
+    if (!error && options.sidecar && !sidecar_writer_start(&sidecar_writer, options.overwrite))
+    {
+        fprintf(stderr, "Error: Failed to start sidecar writer.\n");
+        error = true;
+    }
+
+    if (!error && (NULL != options.database) && !database_writer_start(&database_writer, options.database, options.database_batch))
+    {
+        fprintf(stderr, "Error: Failed to start database writer.\n");
+        error = true;
+    }
+
+    if (!error && (NULL != options.ring) && !ring_producer_start(&ring, options.ring, options.ring_slots))
+    {
+        fprintf(stderr, "Error: Failed to create ring.\n");
+        error = true;
+    }
+
+    if (!error && (NULL != options.records) && !record_writer_start(&record_writer, options.records, options.compression_level,
+                                                                       (options.threads > 0) ? options.threads : batch_default_threads()))
+    {
+        fprintf(stderr, "Error: Failed to start record writer.\n");
+        error = true;
+    }
+
+    if (!error && (NULL != options.scrub))
+    {
+        if (scrub_open(&scrub_catalog, options.scrub, options.scrub_raw ? SCRUB_RANGE_RAW : SCRUB_RANGE_FILE))
+        {
+            scrubber = &scrub_catalog;
+        }
+        else
+        {
+            fprintf(stderr, "Error: Failed to read catalog %s.\n", options.scrub);
+            error = true;
+        }
+    }
+
+    if (!error && options.recover)
+    {
+        unsigned recovered = 0;
+        unsigned failed = 0;
+
+        for (unsigned i = 0; i < file_count; ++i)
+        {
+            bool rolled_forward = false;
+            failed += patch_recover(files[i], &rolled_forward) ? 0 : 1;
+            recovered += rolled_forward ? 1 : 0;
+        }
+
+        printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Recovered", recovered);
+        printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Failed", failed);
+    }
+    else if (!error && options.benchmark)
+    {
+        benchmark_t benchmark = {
+            .files = files,
+            .count = file_count,
+            .threads = options.threads,
+            .parse = parse_image,
+            .strategy = &io_strategy,
+        };
+
+        if (!benchmark_run(&benchmark))
+        {
+            error = true;
+        }
+    }
+    else if (!error && options.memory)
+    {
+        benchmark_t benchmark = {
+            .files = files,
+            .count = file_count,
+            .threads = options.threads,
+            .parse = parse_image,
+            .strategy = &io_strategy,
+            .max_file_heap = options.max_file_heap,
+            .max_working_set = options.max_working_set,
+        };
+        bool within_limits = true;
+
+        if (!benchmark_memory(&benchmark, &within_limits))
+        {
+            error = true;
+        }
+
+        // A regression fails the run
+        exit_code = within_limits ? 0 : 1;
+    }
+    else if (!error)
+    {
+        numa_topology_t topology;
+        // Single node systems gain nothing from pinning
+        bool numa = (NUMA_MODE_OFF != options.numa) && numa_discover(&topology) &&
+                    ((topology.count > 1) || (NUMA_MODE_ON == options.numa));
+        batch_t batch = {
+            .files = files,
+            .count = file_count,
+            .records = records,
+            .threads = options.threads,
+            .parse = parse_image,
+            .numa = numa ? &topology : NULL,
+        };
+        nef_error_summary_t errors = { 0 };
+        record_sink_t sink;
+
+        if (options.patch)
+        {
+            batch.callback = patch_record;
+            batch.context = &options.patcher;
+        }
+        else if (options.sidecar)
+        {
+            batch.callback = submit_sidecar;
+            batch.context = &sidecar_writer;
+        }
+        else if (NULL != options.database)
+        {
+            batch.callback = submit_database;
+            batch.context = &database_writer;
+        }
+        else if (NULL != options.ring)
+        {
+            batch.callback = submit_ring;
+            batch.context = &ring;
+        }
+        else if (NULL != options.records)
+        {
+            batch.callback = submit_record;
+            batch.context = &record_writer;
+        }
+
+        if (NULL == records)
+        {
+            memset(&sink, 0, sizeof(record_sink_t));
+            InitializeSRWLock(&sink.lock);
+            sink.callback = batch.callback;
+            sink.context = batch.context;
+            batch.callback = submit_sink;
+            batch.context = &sink;
+        }
+
+        // Files already checked in this pass are skipped
+        if ((NULL != scrubber) && !scrub_pending(scrubber, files, file_count, &batch.count))
+        {
+            fprintf(stderr, "Error: Insufficient memory to list the files in catalog %s.\n", options.scrub);
+            batch.count = 0;
+        }
+
+        // Only the sampled files are parsed
+        if (options.sampling && !sample_select(&options.sampler, files, file_count, &batch.count))
+        {
+            fprintf(stderr, "Error: Insufficient memory to select the sample.\n");
+            batch.count = 0;
+        }
+
+        control_t control = { 0 };
+        metrics_server_t metrics = { INVALID_SOCKET, NULL };
+        batch_lanes_t lanes;
+
+        if ((options.metrics_port > 0) && !metrics_start(&metrics, options.metrics_port))
+        {
+            fprintf(stderr, "Error: Failed to serve metrics on port %u.\n", options.metrics_port);
+        }
+
+        // Interactive requests arrive through the control pipe
+        if ((NULL != options.control) && batch_lanes_init(&lanes, options.serve))
+        {
+            batch.lanes = &lanes;
+            batch.reserved = options.interactive_threads;
+
+            if (!control_start(&control, options.control, &lanes))
+            {
+                fprintf(stderr, "Error: Failed to start the control pipe.\n");
+                batch_lanes_close(&lanes);
+            }
+        }
+
+        if (options.isolate > 0)
+        {
+            isolate_t isolate = {
+                .processes = options.isolate,
+                .quarantine = options.quarantine,
+            };
+
+            if (!isolate_run(&batch, &isolate))
+            {
+                fprintf(stderr, "Error: Failed to start the worker processes.\n");
+            }
+
+            if ((isolate.crashes > 0) || (isolate.skipped > 0))
+            {
+                printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Crashes", (long)isolate.crashes);
+                printf("%-*s| %ld\n\n", LEFT_JUSTIFY_WIDTH, "Quarantined", (long)isolate.skipped);
+            }
+        }
+        else
+        {
+            batch_run(&batch);
+        }
+
+        control_stop(&control);
+        metrics_stop(&metrics);
+        numa_release_pools();
+
+        if (NULL != batch.lanes)
+        {
+            for (unsigned lane = 0; lane < BATCH_LANE_COUNT; ++lane)
+            {
+                batch_lane_summary_t summary;
+
+                batch_lane_summary(batch.lanes, (batch_lane_t)lane, &summary);
+                printf("%-*s| %llu, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", LEFT_JUSTIFY_WIDTH, batch_lane_name((batch_lane_t)lane),
+                       summary.count, summary.p50_ms, summary.p99_ms, summary.max_ms);
+            }
+
+            batch_lanes_free(batch.lanes);
+        }
+
+        // Errors of kept records are formatted once the workers are done
+        if (NULL != records)
+        {
+            for (unsigned i = 0; i < file_count; ++i)
+            {
+                nef_error_print(stderr, records[i].path, &records[i].errors);
+                nef_error_summarize(&errors, &records[i].errors);
+            }
+        }
+        else
+        {
+            errors = sink.errors;
+        }
+
+        if (options.patch)
+        {
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Patched", (long)options.patcher.patched);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Skipped", (long)options.patcher.skipped);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Failed", (long)options.patcher.failed);
+        }
+        else if (options.sidecar)
+        {
+            sidecar_writer_stop(&sidecar_writer);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Sidecars", (long)sidecar_writer.written);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Existing", (long)sidecar_writer.existing);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Failed", (long)sidecar_writer.failed);
+        }
+        else if (NULL != options.database)
+        {
+            database_writer_stop(&database_writer);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Inserted", (long)database_writer.inserted);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Failed", (long)database_writer.failed);
+        }
+        else if (NULL != options.ring)
+        {
+            ring_producer_stop(&ring);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Ring Records", (long)ring.written);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Dropped", (long)ring.dropped);
+        }
+        else if (NULL != options.records)
+        {
+            record_writer_stop(&record_writer);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Records", (long)record_writer.written);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Failed", (long)record_writer.failed);
+        }
+        else if (NULL != scrubber)
+        {
+            printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Pass", scrubber->pass);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Verified", (long)scrubber->verified);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Enrolled", (long)scrubber->enrolled);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Mismatched", (long)scrubber->mismatched);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Malformed", (long)scrubber->malformed);
+            printf("%-*s| %ld\n", LEFT_JUSTIFY_WIDTH, "Unreadable", (long)scrubber->unreadable);
+            printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Skipped", scrubber->skipped);
+
+            if (!scrub_close(scrubber))
+            {
+                fprintf(stderr, "Error: Failed to save catalog %s.\n", options.scrub);
+            }
+        }
+        else if (options.near_count > 0)
+        {
+            gps_index_t index;
+            // Queries share an index, or scan the records if it cannot be allocated
+            bool indexed = (options.near_count >= GPS_INDEX_MIN_QUERIES) && gps_index_build(&index, records, file_count);
+
+            for (unsigned q = 0; q < options.near_count; ++q)
+            {
+                const gps_query_t* query = &options.near[q];
+                uint32_t matches = 0;
+
+                printf("%sFrames within %.3f km of %.6f, %.6f\n", (q > 0) ? "\n" : "", query->radius_km,
+                       query->latitude, query->longitude);
+
+                if (indexed)
+                {
+                    matches = gps_index_query(&index, query->latitude, query->longitude, query->radius_km, display_nearby, NULL);
+                }
+                else
+                {
+                    matches = gps_scan(records, file_count, query->latitude, query->longitude, query->radius_km, display_nearby, NULL);
+                }
+
+                printf("%-*s| %u\n", LEFT_JUSTIFY_WIDTH, "Matches", matches);
+            }
+
+            if (indexed)
+            {
+                gps_index_free(&index);
+            }
+        }
+        else if (0 == options.sampler.estimate_count)
+        {
+            for (unsigned i = 0; i < file_count; ++i)
+            {
+                if (records[i].valid)
+                {
+                    perf_counters_t start;
+
+                    trace_file(records[i].path);
+                    perf_start(&start);
+                    display_data(&records[i], output);
+                    perf_stop(&records[i].profile, PERF_STAGE_OUTPUT, &start);
+                    display_print(output, "\n");
+
+                    if (options.profile)
+                    {
+                        perf_print(&records[i].profile, "Profile");
+                        printf("\n");
+                    }
+                }
+            }
+        }
+
+        // Estimates replace the display of the sampled files
+        if (options.sampling)
+        {
+            sample_report(&options.sampler, records);
+            sample_free(&options.sampler);
+        }
+
+        if (options.profile)
+        {
+            perf_profile_t total = { 0 };
+
+            if (NULL != records)
+            {
+                for (unsigned i = 0; i < file_count; ++i)
+                {
+                    perf_add(&total, &records[i].profile);
+                }
+            }
+            else
+            {
+                total = sink.profile;
+            }
+
+            perf_print(&total, "Profile Summary");
+            printf("\n%-*s| %s\n", LEFT_JUSTIFY_WIDTH, "CPU Kernels", cpu_level_name(cpu_level()));
+        }
+
+        if (errors.files > 0)
+        {
+            printf("\n");
+            nef_error_print_summary(&errors);
+        }
+    }
+
+    if ((NULL != output) && !stream_close(output))
+    {
+        fprintf(stderr, "Error: Failed to write output file %s.\n", options.output);
+    }
+
+    // Spans refer to the record paths
+    if (trace_enabled && !trace_close())
+    {
+        fprintf(stderr, "Error: Failed to write trace file %s.\n", options.trace);
+    }
+
+    free(records);
+    batch_free_paths(files, file_count);
+
+    return exit_code;
+}
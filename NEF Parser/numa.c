@@ -0,0 +1,287 @@
+/**************************************************************//**
+*
+* \file numa.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	NUMA topology, worker placement and node local file buffers.
+*   A worker bound to a node reads its files into buffers committed
+*   on that node, so the parse never crosses the socket
+*   interconnect. Buffers are kept in a pool per node and reused
+*   by the next file parsed on the node.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <string.h>
+#include "numa.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Prefix of each pool buffer. Keeps the contents cache line aligned.
+typedef union
+{
+    struct
+    {
+        size_t capacity;    // Usable bytes after the header
+        uint32_t node;      // Pool the buffer returns to
+    } info;
+    uint8_t align[64];
+} numa_buffer_t;
+
+typedef struct
+{
+    SRWLOCK lock;
+    numa_buffer_t* buffers[NUMA_POOL_BUFFERS];
+    uint32_t count;
+} numa_pool_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static numa_pool_t numa_pools[NUMA_MAX_NODES];
+static USHORT numa_numbers[NUMA_MAX_NODES];   // Node number of each pool
+static DWORD numa_index = TLS_OUT_OF_INDEXES; // Node of the calling thread (index + 1)
+
+static const char* numa_mode_names[NUMA_MODE_COUNT] = {
+    "auto",
+    "on",
+    "off",
+};
+
+/******************************************************************
+*
+* \details
+*   Discover the nodes with processors. Must be called before any
+*   worker thread is bound to a node.
+*
+* \param[out] topology : Nodes of the system.
+*
+* \return
+*   Return true if at least one node was found.
+*
+*******************************************************************/
+bool numa_discover(numa_topology_t* topology)
+{
+    ULONG highest = 0;
+
+    memset(topology, 0, sizeof(numa_topology_t));
+
+    if (TLS_OUT_OF_INDEXES == numa_index)
+    {
+        numa_index = TlsAlloc();
+
+        for (uint32_t i = 0; i < NUMA_MAX_NODES; ++i)
+        {
+            InitializeSRWLock(&numa_pools[i].lock);
+        }
+    }
+
+    if ((TLS_OUT_OF_INDEXES != numa_index) && GetNumaHighestNodeNumber(&highest))
+    {
+        for (ULONG node = 0; (node <= highest) && (topology->count < NUMA_MAX_NODES); ++node)
+        {
+            GROUP_AFFINITY affinity = { 0 };
+
+            if (GetNumaNodeProcessorMaskEx((USHORT)node, &affinity) && (affinity.Mask != 0))
+            {
+                numa_node_t* entry = &topology->nodes[topology->count++];
+                entry->number = (USHORT)node;
+                numa_numbers[topology->count - 1] = (USHORT)node;
+                entry->affinity = affinity;
+
+                for (KAFFINITY mask = affinity.Mask; mask != 0; mask &= mask - 1)
+                {
+                    entry->processors++;
+                }
+
+                topology->processors += entry->processors;
+            }
+        }
+    }
+
+    return (topology->count > 0);
+}
+
+/******************************************************************
+*
+* \details
+*   Pin the calling thread to a core of a node and draw its file
+*   buffers from the pool of that node.
+*
+* \param[in] topology : Nodes of the system.
+* \param[in] node     : Index of the node within the topology.
+* \param[in] core     : Core within the node. Wraps around when the
+*                       node has fewer processors.
+*
+* \return
+*   Return true if the thread was pinned.
+*
+*******************************************************************/
+bool numa_bind_thread(const numa_topology_t* topology, uint32_t node, uint32_t core)
+{
+    bool pinned = false;
+
+    if ((node < topology->count) && (TLS_OUT_OF_INDEXES != numa_index))
+    {
+        const numa_node_t* entry = &topology->nodes[node];
+        GROUP_AFFINITY affinity = entry->affinity;
+        KAFFINITY mask = entry->affinity.Mask;
+
+        // Select the (core % processors)th processor of the node
+        for (uint32_t skip = core % entry->processors; skip > 0; --skip)
+        {
+            mask &= mask - 1;
+        }
+
+        affinity.Mask = mask & (~mask + 1);
+        pinned = (SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != FALSE);
+        TlsSetValue(numa_index, (LPVOID)(uintptr_t)(node + 1));
+    }
+
+    return pinned;
+}
+
+/******************************************************************
+*
+* \details
+*   Acquire a file buffer on the node of the calling thread.
+*
+* \param[in] size : Bytes required.
+*
+* \return
+*   Return the buffer, or NULL if the thread is not bound to a
+*   node or the buffer could not be committed.
+*
+*******************************************************************/
+void* numa_buffer_acquire(size_t size)
+{
+    void* block = NULL;
+    uintptr_t bound = (TLS_OUT_OF_INDEXES != numa_index) ? (uintptr_t)TlsGetValue(numa_index) : 0;
+
+    if (bound != 0)
+    {
+        uint32_t node = (uint32_t)(bound - 1);
+        numa_pool_t* pool = &numa_pools[node];
+        numa_buffer_t* buffer = NULL;
+
+        AcquireSRWLockExclusive(&pool->lock);
+
+        if (pool->count > 0)
+        {
+            buffer = pool->buffers[--pool->count];
+        }
+
+        ReleaseSRWLockExclusive(&pool->lock);
+
+        if ((NULL != buffer) && (buffer->info.capacity < size))
+        {
+            // Too small for this file. Replaced by a larger buffer.
+            VirtualFree(buffer, 0, MEM_RELEASE);
+            buffer = NULL;
+        }
+
+        if (NULL == buffer)
+        {
+            // Commit the pages on the node the thread is pinned to
+            buffer = VirtualAllocExNuma(GetCurrentProcess(), NULL, sizeof(numa_buffer_t) + size,
+                                        MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, numa_numbers[node]);
+
+            if (NULL != buffer)
+            {
+                buffer->info.capacity = size;
+                buffer->info.node = node;
+            }
+        }
+
+        block = (NULL != buffer) ? buffer + 1 : NULL;
+    }
+
+    return block;
+}
+
+/******************************************************************
+*
+* \details Return a buffer to the pool of its node.
+*
+* \param[in] block : Buffer returned by numa_buffer_acquire (may be NULL).
+*
+* \return None
+*
+*******************************************************************/
+void numa_buffer_release(void* block)
+{
+    if (NULL != block)
+    {
+        numa_buffer_t* buffer = (numa_buffer_t*)block - 1;
+        numa_pool_t* pool = &numa_pools[buffer->info.node];
+        bool pooled = false;
+
+        AcquireSRWLockExclusive(&pool->lock);
+
+        if (pool->count < NUMA_POOL_BUFFERS)
+        {
+            pool->buffers[pool->count++] = buffer;
+            pooled = true;
+        }
+
+        ReleaseSRWLockExclusive(&pool->lock);
+
+        if (!pooled)
+        {
+            VirtualFree(buffer, 0, MEM_RELEASE);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Release the pooled buffers once the workers are done.
+*
+*******************************************************************/
+void numa_release_pools(void)
+{
+    for (uint32_t i = 0; i < NUMA_MAX_NODES; ++i)
+    {
+        numa_pool_t* pool = &numa_pools[i];
+
+        AcquireSRWLockExclusive(&pool->lock);
+
+        while (pool->count > 0)
+        {
+            VirtualFree(pool->buffers[--pool->count], 0, MEM_RELEASE);
+        }
+
+        ReleaseSRWLockExclusive(&pool->lock);
+    }
+}
+
+/******************************************************************
+*
+* \details Parse a mode name (auto, on or off).
+*
+* \return
+*   Return true if the name is valid.
+*
+*******************************************************************/
+bool numa_parse_mode(const char* name, numa_mode_t* mode)
+{
+    bool valid = false;
+
+    for (unsigned i = 0; (i < NUMA_MODE_COUNT) && !valid; ++i)
+    {
+        if (_stricmp(name, numa_mode_names[i]) == 0)
+        {
+            *mode = (numa_mode_t)i;
+            valid = true;
+        }
+    }
+
+    return valid;
+}
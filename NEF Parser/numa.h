@@ -0,0 +1,66 @@
+/**************************************************************//**
+*
+* \file numa.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	NUMA topology, worker placement and node local file buffers.
+*
+*******************************************************************/
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define NUMA_MAX_NODES      16
+#define NUMA_POOL_BUFFERS   16  // Free buffers kept per node
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef enum
+{
+    NUMA_MODE_AUTO = 0,     // Group the workers by node on multi node systems
+    NUMA_MODE_ON,           // Group the workers by node even on a single node
+    NUMA_MODE_OFF,
+    NUMA_MODE_COUNT
+} numa_mode_t;
+
+typedef struct
+{
+    USHORT number;              // Node number
+    GROUP_AFFINITY affinity;    // Processors of the node
+    uint32_t processors;        // Processors in the affinity mask
+} numa_node_t;
+
+// Nodes with processors. Memory only nodes are left out.
+typedef struct
+{
+    numa_node_t nodes[NUMA_MAX_NODES];
+    uint32_t count;
+    uint32_t processors;        // Processors of all nodes
+} numa_topology_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool numa_discover(numa_topology_t* topology);
+bool numa_bind_thread(const numa_topology_t* topology, uint32_t node, uint32_t core);
+void* numa_buffer_acquire(size_t size);
+void numa_buffer_release(void* buffer);
+void numa_release_pools(void);
+bool numa_parse_mode(const char* name, numa_mode_t* mode);
+
+#endif /* end numa.h */
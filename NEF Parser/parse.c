@@ -0,0 +1,421 @@
+/**************************************************************//**
+*
+* \file parse.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Bounds checked, byte order aware access to the IFDs and values
+*   of TIFF based raw files. Every read is checked against the file
+*   size and charged to the work budget of the file.
+*
+*   IFDs are used in place within the image file buffer. Entries are
+*   read through parse_entry, which returns them in host byte order.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "parse.h"
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Size of a single value by TIFF type (in bytes)
+static const uint8_t tiff_type_sizes[] = { 0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8, 4 };
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static char* rstrip(char* str);
+
+/******************************************************************
+*
+* \details Prepare the parse context of an image file.
+*
+* \param[out] context : Parse context.
+* \param[in] record   : Record receiving the parsed fields.
+* \param[in] limits   : Work allowed for the file.
+*
+* \return None
+*
+*******************************************************************/
+void parse_init(parse_context_t* context, nef_record_t* record, const parse_limits_t* limits)
+{
+    memset(context, 0, sizeof(parse_context_t));
+    context->record = record;
+    context->limits = limits;
+    context->deadline = (limits->deadline_ms > 0) ? GetTickCount64() + limits->deadline_ms : 0;
+}
+
+/******************************************************************
+*
+* \details
+*   Validate the TIFF header of an image file and select its byte
+*   order. Olympus ORF files use their own magic number in place of
+*   the TIFF one.
+*
+* \param[in,out] context  : Parse context of the image file.
+* \param[in] buffer       : Image file contents.
+* \param[in] size         : Image file size (in bytes).
+* \param[out] ifd0_offset : Offset of IFD0.
+*
+* \return
+*   Return true if the header is valid.
+*
+*******************************************************************/
+bool parse_header(parse_context_t* context, uint8_t* buffer, uint32_t size, uint32_t* ifd0_offset)
+{
+    bool valid = false;
+    struct tiff_header_t* header = (struct tiff_header_t*)buffer;
+
+    context->buffer = buffer;
+    context->size = (long)size;
+
+    if ((size >= sizeof(struct tiff_header_t)) &&
+        ((TIFF_LITTLE_ENDIAN == header->byte_order) || (TIFF_BIG_ENDIAN == header->byte_order)))
+    {
+        context->big_endian = (TIFF_BIG_ENDIAN == header->byte_order);
+        uint16_t magic = parse_get16(context, &header->tiff_magic);
+
+        if ((TIFF_MAGIC == magic) || (ORF_MAGIC == magic) || (ORF_MAGIC_ALT == magic))
+        {
+            *ifd0_offset = parse_get32(context, &header->ifd0_offset);
+            valid = true;
+        }
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details
+*   Check the work budget of the file. Called once per IFD entry so
+*   a file that runs past its deadline is abandoned promptly.
+*
+* \param[in,out] context : Parse context of the image file.
+*
+* \return
+*   Return true if parsing may continue.
+*
+*******************************************************************/
+bool parse_continue(parse_context_t* context)
+{
+    if (!context->aborted && (context->deadline != 0) && (GetTickCount64() > context->deadline))
+    {
+        parse_error(context, NEF_ERROR_DEADLINE, 0, context->limits->deadline_ms);
+        context->aborted = true;
+    }
+
+    return !context->aborted;
+}
+
+/******************************************************************
+*
+* \details
+*   Record an error in the record of the image file, tagged with
+*   the IFD and tag being parsed. Nothing is formatted or printed
+*   until the batch is complete.
+*
+* \param[in,out] context : Parse context of the image file.
+* \param[in] code        : Error kind.
+* \param[in] offset      : Offset within the file.
+* \param[in] value       : Code specific detail.
+*
+* \return None
+*
+*******************************************************************/
+void parse_error(parse_context_t* context, nef_error_code_t code, uint32_t offset, uint32_t value)
+{
+    nef_error_report(&context->record->errors, code, context->ifd, context->tag, offset, value);
+}
+
+/******************************************************************
+*
+* \details Bounds check a value within the image file and charge it
+*          to the byte budget.
+*
+* \param[in,out] context : Parse context of the image file.
+* \param[in] offset      : Offset of the value.
+* \param[in] size        : Size of the value (in bytes).
+*
+* \return
+*   Return a pointer to the value, or NULL if it lies outside the
+*   file or exceeds the byte budget (which aborts the parse).
+*
+*******************************************************************/
+void* parse_value(parse_context_t* context, uint32_t offset, uint32_t size)
+{
+    void* value = NULL;
+
+    if (context->aborted)
+    {
+        // Nothing more is read once a limit is exceeded
+    }
+    else if ((uint64_t)offset + size > (uint64_t)context->size)
+    {
+        parse_error(context, NEF_ERROR_VALUE_RANGE, offset, size);
+    }
+    else if ((uint64_t)context->bytes + size > context->limits->max_bytes)
+    {
+        parse_error(context, NEF_ERROR_BYTE_LIMIT, offset, context->limits->max_bytes);
+        context->aborted = true;
+    }
+    else
+    {
+        context->bytes += size;
+        value = &context->buffer[offset];
+    }
+
+    return value;
+}
+
+/******************************************************************
+*
+* \details
+*   Bounds check an IFD before it is followed. IFDs that were
+*   already visited (a cycle), exceed the IFD or entry limits or
+*   lie outside the file are rejected.
+*
+* \param[in,out] context : Parse context of the image file.
+* \param[in] offset      : Offset of the IFD.
+* \param[in] name        : IFD being followed. Errors are reported
+*                         against it from here on.
+*
+* \return
+*   Return the IFD, or NULL if it was rejected.
+*
+*******************************************************************/
+struct ifd_t* parse_ifd(parse_context_t* context, uint32_t offset, nef_ifd_t name)
+{
+    struct ifd_t* ifd = NULL;
+    bool visited = false;
+
+    context->ifd = name;
+    context->tag = 0;
+
+    for (uint32_t i = 0; (i < context->ifd_count) && !visited; ++i)
+    {
+        visited = (context->ifds[i] == offset);
+    }
+
+    if (context->aborted)
+    {
+        // Nothing more is read once a limit is exceeded
+    }
+    else if (visited)
+    {
+        parse_error(context, NEF_ERROR_IFD_CYCLE, offset, 0);
+        context->aborted = true;
+    }
+    else if (context->ifd_count >= context->limits->max_ifds)
+    {
+        parse_error(context, NEF_ERROR_IFD_LIMIT, offset, context->limits->max_ifds);
+        context->aborted = true;
+    }
+    else
+    {
+        uint16_t* value = parse_value(context, offset, sizeof(uint16_t));
+        uint16_t entries = (NULL != value) ? parse_get16(context, value) : 0;
+
+        if (entries > context->limits->max_entries)
+        {
+            parse_error(context, NEF_ERROR_ENTRY_LIMIT, offset, entries);
+            context->aborted = true;
+        }
+        else if ((NULL != value) && (NULL != parse_value(context, offset + sizeof(uint16_t), entries * sizeof(struct ifd_entry_t))))
+        {
+            context->ifds[context->ifd_count++] = offset;
+            ifd = (struct ifd_t*)value;
+        }
+    }
+
+    return ifd;
+}
+
+/******************************************************************
+*
+* \details Number of entries of an IFD returned by parse_ifd.
+*
+*******************************************************************/
+unsigned parse_entry_count(const parse_context_t* context, const struct ifd_t* ifd)
+{
+    return (NULL != ifd) ? parse_get16(context, &ifd->entries) : 0;
+}
+
+/******************************************************************
+*
+* \details
+*   Read an IFD entry in host byte order. SHORT and LONG values
+*   stored in the entry itself are returned in the value field.
+*   Other values of up to four bytes (strings and bytes) are left
+*   as stored, so they can be read from &entry->value.
+*
+* \param[in] context : Parse context of the image file.
+* \param[in] ifd     : IFD returned by parse_ifd.
+* \param[in] index   : Entry index (less than parse_entry_count).
+* \param[out] entry  : Entry in host byte order.
+*
+* \return None
+*
+*******************************************************************/
+void parse_entry(const parse_context_t* context, const struct ifd_t* ifd, unsigned index, struct ifd_entry_t* entry)
+{
+    const struct ifd_entry_t* stored = &ifd->entry[index];
+
+    if (!context->big_endian)
+    {
+        memcpy(entry, stored, sizeof(struct ifd_entry_t));
+    }
+    else
+    {
+        entry->tag = parse_get16(context, &stored->tag);
+        entry->type = parse_get16(context, &stored->type);
+        entry->count = parse_get32(context, &stored->count);
+        uint8_t size = (entry->type < sizeof(tiff_type_sizes)) ? tiff_type_sizes[entry->type] : 0;
+
+        if ((2 == size) && (entry->count == 1))
+        {
+            entry->value = parse_get16(context, &stored->value);
+        }
+        else if ((1 == size) && (entry->count <= sizeof(uint32_t)))
+        {
+            memcpy(&entry->value, &stored->value, sizeof(uint32_t));
+        }
+        else
+        {
+            entry->value = parse_get32(context, &stored->value);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Get the value of an ASCII entry.
+*
+* \param[in,out] context : Parse context of the image file.
+* \param[in] entry       : Entry read by parse_entry.
+* \param[in] base        : Offset the value offset is relative to.
+*                         Makernotes may use offsets relative to
+*                         their own header.
+*
+* \return
+*   Return a pointer to the string, which is not guaranteed to be
+*   NULL terminated, or NULL if it is not available.
+*
+*******************************************************************/
+char* parse_string(parse_context_t* context, struct ifd_entry_t* entry, uint32_t base)
+{
+    char* str = NULL;
+
+    if (TIFF_TYPE_ASCII != entry->type)
+    {
+        parse_error(context, NEF_ERROR_ENTRY_TYPE, entry->value, entry->type);
+    }
+    else if (entry->count > sizeof(uint32_t))
+    {
+        str = parse_value(context, base + entry->value, entry->count);
+    }
+    else
+    {
+        str = (char*)&entry->value;
+    }
+
+    return str;
+}
+
+/******************************************************************
+*
+* \details Helper function to strip trailing whitespace in a string.
+*
+* \param[in] str  : String to be processed.
+* \param[out] None
+*
+* \return
+*   Return pointer to string.
+*
+*******************************************************************/
+static char* rstrip(char* str)
+{
+    int index;
+
+    if (NULL != str)
+    {
+        index = strlen(str) - 1;
+        while (index > 0 && isspace(str[index])) index--;
+        str[++index] = '\0';
+    }
+
+    return str;
+}
+
+/******************************************************************
+*
+* \details
+*   Helper function to copy a TIFF ASCII string out of the image
+*   file buffer. TIFF strings are padded with trailing whitespace
+*   and are not guaranteed to be NULL terminated.
+*
+* \param[out] destination : Destination string.
+* \param[in] size         : Size of the destination (in bytes).
+* \param[in] source       : Source string. May be NULL.
+* \param[in] count        : Maximum number of characters in the source.
+*
+* \return None
+*
+*******************************************************************/
+void parse_copy_string(char* destination, size_t size, const char* source, size_t count)
+{
+    if ((NULL != destination) && (size > 0))
+    {
+        size_t length = 0;
+
+        if (NULL != source)
+        {
+            while ((length < count) && (length < size - 1) && (source[length] != '\0'))
+            {
+                length++;
+            }
+
+            memcpy_s(destination, size, source, length);
+        }
+
+        destination[length] = '\0';
+        rstrip(destination);
+    }
+}
+
+/******************************************************************
+*
+* \details Read a 16 bit value in the byte order of the file.
+*
+*******************************************************************/
+uint16_t parse_get16(const parse_context_t* context, const void* data)
+{
+    uint16_t value;
+
+    memcpy(&value, data, sizeof(value));
+
+    return context->big_endian ? _byteswap_ushort(value) : value;
+}
+
+/******************************************************************
+*
+* \details Read a 32 bit value in the byte order of the file.
+*
+*******************************************************************/
+uint32_t parse_get32(const parse_context_t* context, const void* data)
+{
+    uint32_t value;
+
+    memcpy(&value, data, sizeof(value));
+
+    return context->big_endian ? _byteswap_ulong(value) : value;
+}
@@ -0,0 +1,86 @@
+/**************************************************************//**
+*
+* \file parse.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Bounds checked, byte order aware access to the IFDs and values
+*   of TIFF based raw files, shared by the IFD walker and the
+*   vendor Makernote handlers.
+*
+*******************************************************************/
+
+#ifndef PARSE_H_
+#define PARSE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "tiff.h"
+#include "record.h"
+#include "error.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Default per file work budget. Well formed files stay far below it.
+#define PARSE_DEFAULT_MAX_IFDS      16
+#define PARSE_DEFAULT_MAX_ENTRIES   512
+#define PARSE_DEFAULT_MAX_BYTES     (1024 * 1024)
+#define PARSE_MAX_IFDS_LIMIT        64  // Upper bound of --max-ifds
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Work allowed per file, so a crafted file cannot stall a worker
+typedef struct
+{
+    uint32_t max_ifds;      // IFDs followed
+    uint32_t max_entries;   // Entries per IFD
+    uint32_t max_bytes;     // Bytes of IFDs and values read
+    uint32_t deadline_ms;   // Parse time (0 = no deadline)
+} parse_limits_t;
+
+// State of the image file currently being parsed
+typedef struct
+{
+    uint8_t* buffer;           // Image file contents
+    long size;                 // Image file size (in bytes)
+    bool big_endian;           // Byte order of the IFDs being parsed ("MM")
+    uint32_t makernote_offset; // Absolute offset of the Makernote
+    uint32_t makernote_size;   // Size of the Makernote (in bytes)
+    uint32_t tiff_offset;      // Offset of the Makernote TIFF header relative to the Makernote
+    nef_record_t* record;      // Record receiving the parsed fields
+    const parse_limits_t* limits;
+    uint32_t ifds[PARSE_MAX_IFDS_LIMIT]; // Offsets of the IFDs visited
+    uint32_t ifd_count;
+    uint32_t bytes;            // Bytes of IFDs and values read
+    ULONGLONG deadline;        // Tick count the parse must finish by (0 = none)
+    bool aborted;              // A limit was exceeded
+    nef_ifd_t ifd;             // IFD being parsed
+    uint16_t tag;              // Tag being parsed
+} parse_context_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+void parse_init(parse_context_t* context, nef_record_t* record, const parse_limits_t* limits);
+bool parse_header(parse_context_t* context, uint8_t* buffer, uint32_t size, uint32_t* ifd0_offset);
+bool parse_continue(parse_context_t* context);
+void parse_error(parse_context_t* context, nef_error_code_t code, uint32_t offset, uint32_t value);
+void* parse_value(parse_context_t* context, uint32_t offset, uint32_t size);
+struct ifd_t* parse_ifd(parse_context_t* context, uint32_t offset, nef_ifd_t name);
+unsigned parse_entry_count(const parse_context_t* context, const struct ifd_t* ifd);
+void parse_entry(const parse_context_t* context, const struct ifd_t* ifd, unsigned index, struct ifd_entry_t* entry);
+char* parse_string(parse_context_t* context, struct ifd_entry_t* entry, uint32_t base);
+void parse_copy_string(char* destination, size_t size, const char* source, size_t count);
+uint16_t parse_get16(const parse_context_t* context, const void* data);
+uint32_t parse_get32(const parse_context_t* context, const void* data);
+
+#endif /* end parse.h */
@@ -0,0 +1,662 @@
+/**************************************************************//**
+*
+* \file patch.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	In-place metadata patching of image files. The date/time,
+*   Artist and Copyright tags are ASCII values with a fixed count,
+*   so they can be rewritten without moving any other data. Only
+*   the bytes that change are written, at the tag locations
+*   recorded by the parser.
+*
+*   Each file is patched through a redo journal. The old and new
+*   bytes of every edit are written to <file>.patch-journal and
+*   flushed before the image file is touched. The journal is
+*   deleted once the edits are flushed to the image file, so a
+*   journal left behind by an interrupted run always describes
+*   a complete set of edits that can be rolled forward.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "patch.h"
+#include "exif.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define PATCH_JOURNAL_MAGIC     0x4A50454E // "NEPJ"
+#define PATCH_FNV_OFFSET_BASIS  0x811C9DC5
+#define PATCH_FNV_PRIME         0x01000193
+#define SECONDS_PER_DAY         86400
+#define SECONDS_PER_HOUR        3600
+#define SECONDS_PER_MINUTE      60
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Replacement of a tag value
+typedef struct
+{
+    uint32_t offset;    // Absolute offset of the value in the image file
+    uint32_t length;    // Number of bytes replaced
+    uint8_t old_value[PATCH_MAX_VALUE_LENGTH];
+    uint8_t new_value[PATCH_MAX_VALUE_LENGTH];
+} patch_edit_t;
+
+// Journal header. Followed by the edits, each stored as offset,
+// length, old value and new value.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t edit_count;
+    uint32_t size;      // Size of the edits (in bytes)
+    uint32_t checksum;  // FNV-1a hash of the edits
+} patch_journal_header_t;
+
+#define PATCH_JOURNAL_MAX_SIZE (sizeof(patch_journal_header_t) + \
+    MAX_TAG_LOCATIONS * (2 * sizeof(uint32_t) + 2 * PATCH_MAX_VALUE_LENGTH))
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static uint32_t fnv1a(const uint8_t* data, uint32_t size);
+static int64_t days_from_civil(int64_t year, unsigned month, unsigned day);
+static void civil_from_days(int64_t days, int64_t* year, unsigned* month, unsigned* day);
+static bool shift_date_time(const uint8_t* value, uint32_t length, int64_t seconds, uint8_t* shifted);
+static bool read_at(HANDLE file, uint32_t offset, void* data, uint32_t length);
+static bool write_at(HANDLE file, uint32_t offset, const void* data, uint32_t length);
+static bool journal_path(const char* path, char* journal, size_t size);
+static bool build_edits(const patcher_t* patcher, const nef_record_t* record, HANDLE file, patch_edit_t* edits, unsigned* edit_count);
+static bool write_journal(const char* path, const patch_edit_t* edits, unsigned edit_count);
+static bool apply_edits(HANDLE file, const patch_edit_t* edits, unsigned edit_count);
+
+/******************************************************************
+*
+* \details FNV-1a hash used to validate journals.
+*
+*******************************************************************/
+static uint32_t fnv1a(const uint8_t* data, uint32_t size)
+{
+    uint32_t hash = PATCH_FNV_OFFSET_BASIS;
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * PATCH_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/******************************************************************
+*
+* \details
+*   Number of days between 1970-01-01 and a proleptic Gregorian
+*   calendar date.
+*   See http://howardhinnant.github.io/date_algorithms.html.
+*
+*******************************************************************/
+static int64_t days_from_civil(int64_t year, unsigned month, unsigned day)
+{
+    year -= (month <= 2);
+    int64_t era = ((year >= 0) ? year : year - 399) / 400;
+    unsigned year_of_era = (unsigned)(year - era * 400);
+    unsigned day_of_year = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * 146097 + (int64_t)day_of_era - 719468;
+}
+
+/******************************************************************
+*
+* \details Inverse of days_from_civil.
+*
+*******************************************************************/
+static void civil_from_days(int64_t days, int64_t* year, unsigned* month, unsigned* day)
+{
+    days += 719468;
+    int64_t era = ((days >= 0) ? days : days - 146096) / 146097;
+    unsigned day_of_era = (unsigned)(days - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned mp = (5 * day_of_year + 2) / 153;
+
+    *day = day_of_year - (153 * mp + 2) / 5 + 1;
+    *month = (mp < 10) ? mp + 3 : mp - 9;
+    *year = (int64_t)year_of_era + era * 400 + (*month <= 2);
+}
+
+/******************************************************************
+*
+* \details Shift an EXIF date/time value ("YYYY:MM:DD HH:MM:SS").
+*
+* \param[in] value   : Current value.
+* \param[in] length  : Length of the value (including NULL).
+* \param[in] seconds : Shift (in seconds).
+* \param[out] shifted : Shifted value. Bytes after the date/time
+*                       are copied unchanged.
+*
+* \return
+*   Return true if the value is a valid date/time.
+*
+*******************************************************************/
+static bool shift_date_time(const uint8_t* value, uint32_t length, int64_t seconds, uint8_t* shifted)
+{
+    bool success = false;
+    char text[TIFF_DATE_TIME_LENGTH];
+    int year = 0;
+    unsigned month = 0, day = 0, hour = 0, minute = 0, second = 0;
+
+    if (length >= TIFF_DATE_TIME_LENGTH)
+    {
+        memcpy_s(text, sizeof(text), value, TIFF_DATE_TIME_LENGTH - 1);
+        text[TIFF_DATE_TIME_LENGTH - 1] = '\0';
+
+        success = (sscanf_s(text, "%4d:%2u:%2u %2u:%2u:%2u", &year, &month, &day, &hour, &minute, &second) == 6) &&
+                  (text[4] == ':') && (text[7] == ':') && (text[10] == ' ') && (text[13] == ':') && (text[16] == ':') &&
+                  (month >= 1) && (month <= 12) && (day >= 1) && (day <= 31) &&
+                  (hour < 24) && (minute < 60) && (second < 60);
+    }
+
+    if (success)
+    {
+        int64_t time = days_from_civil(year, month, day) * SECONDS_PER_DAY +
+                       hour * SECONDS_PER_HOUR + minute * SECONDS_PER_MINUTE + second + seconds;
+        int64_t days = ((time >= 0) ? time : time - (SECONDS_PER_DAY - 1)) / SECONDS_PER_DAY;
+        int64_t time_of_day = time - days * SECONDS_PER_DAY;
+        int64_t shifted_year = 0;
+
+        civil_from_days(days, &shifted_year, &month, &day);
+
+        if ((shifted_year >= 0) && (shifted_year <= 9999))
+        {
+            memcpy_s(shifted, PATCH_MAX_VALUE_LENGTH, value, length);
+            char formatted[32];
+            snprintf(formatted, sizeof(formatted), "%04d:%02u:%02u %02u:%02u:%02u", (int)shifted_year, month, day,
+                     (unsigned)(time_of_day / SECONDS_PER_HOUR),
+                     (unsigned)((time_of_day % SECONDS_PER_HOUR) / SECONDS_PER_MINUTE),
+                     (unsigned)(time_of_day % SECONDS_PER_MINUTE));
+            memcpy_s(shifted, PATCH_MAX_VALUE_LENGTH, formatted, TIFF_DATE_TIME_LENGTH - 1);
+        }
+        else
+        {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Positioned read and write helpers.
+*
+*******************************************************************/
+static bool read_at(HANDLE file, uint32_t offset, void* data, uint32_t length)
+{
+    OVERLAPPED overlapped = { 0 };
+    DWORD transferred = 0;
+
+    overlapped.Offset = offset;
+
+    return ReadFile(file, data, length, &transferred, &overlapped) && (transferred == length);
+}
+
+static bool write_at(HANDLE file, uint32_t offset, const void* data, uint32_t length)
+{
+    OVERLAPPED overlapped = { 0 };
+    DWORD transferred = 0;
+
+    overlapped.Offset = offset;
+
+    return WriteFile(file, data, length, &transferred, &overlapped) && (transferred == length);
+}
+
+/******************************************************************
+*
+* \details Build the journal path of an image file.
+*
+*******************************************************************/
+static bool journal_path(const char* path, char* journal, size_t size)
+{
+    int length = snprintf(journal, size, "%s%s", path, PATCH_JOURNAL_SUFFIX);
+
+    return (length > 0) && ((size_t)length < size);
+}
+
+/******************************************************************
+*
+* \details
+*   Build the edits for a parsed image file. The current values are
+*   read back from the file and edits that would not change any
+*   bytes are dropped.
+*
+* \param[in] patcher  : Patch settings.
+* \param[in] record   : Parsed record holding the tag locations.
+* \param[in] file     : Image file.
+* \param[out] edits      : Edits (MAX_TAG_LOCATIONS entries).
+* \param[out] edit_count : Number of edits.
+*
+* \return
+*   Return true if every requested change can be made in place.
+*
+*******************************************************************/
+static bool build_edits(const patcher_t* patcher, const nef_record_t* record, HANDLE file, patch_edit_t* edits, unsigned* edit_count)
+{
+    bool success = true;
+    bool artist_found = false;
+    bool copyright_found = false;
+
+    *edit_count = 0;
+
+    for (unsigned i = 0; success && (i < record->location_count); ++i)
+    {
+        const struct tag_location_t* location = &record->locations[i];
+        const char* text = NULL;
+        bool duplicate = false;
+
+        for (unsigned j = 0; j < *edit_count; ++j)
+        {
+            duplicate |= (edits[j].offset == location->offset);
+        }
+
+        if (duplicate)
+        {
+            continue;
+        }
+
+        patch_edit_t* edit = &edits[*edit_count];
+        edit->offset = location->offset;
+        edit->length = location->count;
+
+        switch (location->tag)
+        {
+            case EXIF_TAG_DATE_TIME:
+            case EXIF_TAG_DATE_TIME_ORIGINAL:
+            case EXIF_TAG_CREATE_DATE:
+            {
+                if (patcher->shift)
+                {
+                    success = (edit->length <= PATCH_MAX_VALUE_LENGTH) && read_at(file, edit->offset, edit->old_value, edit->length);
+
+                    if (success && !shift_date_time(edit->old_value, edit->length, patcher->shift_seconds, edit->new_value))
+                    {
+                        fprintf(stderr, "Error: %s: Date/time tag 0x%04X is not a valid date/time.\n", record->path, location->tag);
+                        success = false;
+                    }
+                    else if (success)
+                    {
+                        (*edit_count)++;
+                    }
+                }
+                break;
+            }
+            case EXIF_TAG_ARTIST:
+            {
+                artist_found = true;
+                text = patcher->artist;
+                break;
+            }
+            case EXIF_TAG_COPYRIGHT:
+            {
+                copyright_found = true;
+                text = patcher->copyright;
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+
+        if (success && (NULL != text))
+        {
+            // The new value and its NULL terminator must fit in the existing count
+            if ((edit->length <= PATCH_MAX_VALUE_LENGTH) && (strlen(text) < edit->length))
+            {
+                memset(edit->new_value, 0, edit->length);
+                memcpy_s(edit->new_value, PATCH_MAX_VALUE_LENGTH, text, strlen(text));
+                success = read_at(file, edit->offset, edit->old_value, edit->length);
+                (*edit_count) += success ? 1 : 0;
+            }
+            else
+            {
+                fprintf(stderr, "Error: %s: \"%s\" does not fit the %u bytes reserved for tag 0x%04X.\n",
+                        record->path, text, edit->length - 1, location->tag);
+                success = false;
+            }
+        }
+    }
+
+    if (success && (NULL != patcher->artist) && !artist_found)
+    {
+        fprintf(stderr, "Error: %s: Artist tag is absent and cannot be added in place.\n", record->path);
+        success = false;
+    }
+
+    if (success && (NULL != patcher->copyright) && !copyright_found)
+    {
+        fprintf(stderr, "Error: %s: Copyright tag is absent and cannot be added in place.\n", record->path);
+        success = false;
+    }
+
+    // Drop edits that do not change the file
+    for (unsigned i = 0; success && (i < *edit_count);)
+    {
+        if (memcmp(edits[i].old_value, edits[i].new_value, edits[i].length) == 0)
+        {
+            edits[i] = edits[--(*edit_count)];
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Write the journal of an image file and flush it to disk.
+*
+* \return
+*   Return true if the journal was written.
+*
+*******************************************************************/
+static bool write_journal(const char* path, const patch_edit_t* edits, unsigned edit_count)
+{
+    bool success = false;
+    uint8_t journal[PATCH_JOURNAL_MAX_SIZE];
+    patch_journal_header_t header = { PATCH_JOURNAL_MAGIC, edit_count, 0, 0 };
+    uint32_t size = sizeof(header);
+
+    for (unsigned i = 0; i < edit_count; ++i)
+    {
+        memcpy(&journal[size], &edits[i].offset, sizeof(uint32_t));
+        size += sizeof(uint32_t);
+        memcpy(&journal[size], &edits[i].length, sizeof(uint32_t));
+        size += sizeof(uint32_t);
+        memcpy(&journal[size], edits[i].old_value, edits[i].length);
+        size += edits[i].length;
+        memcpy(&journal[size], edits[i].new_value, edits[i].length);
+        size += edits[i].length;
+    }
+
+    header.size = size - sizeof(header);
+    header.checksum = fnv1a(&journal[sizeof(header)], header.size);
+    memcpy(journal, &header, sizeof(header));
+
+    // A journal left by an interrupted run must be recovered first, so never replace one
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_FLAG_WRITE_THROUGH, NULL);
+
+    if (INVALID_HANDLE_VALUE != file)
+    {
+        DWORD written = 0;
+        success = WriteFile(file, journal, size, &written, NULL) && (written == size) && FlushFileBuffers(file);
+        CloseHandle(file);
+
+        if (!success)
+        {
+            DeleteFileA(path);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Write the new values of the edits and flush the file.
+*
+*******************************************************************/
+static bool apply_edits(HANDLE file, const patch_edit_t* edits, unsigned edit_count)
+{
+    bool success = true;
+
+    for (unsigned i = 0; success && (i < edit_count); ++i)
+    {
+        success = write_at(file, edits[i].offset, edits[i].new_value, edits[i].length);
+    }
+
+    return success && FlushFileBuffers(file);
+}
+
+/******************************************************************
+*
+* \details Parse a time shift ("[+|-]seconds" or "[+|-]HH:MM:SS").
+*
+* \param[in] text     : Time shift.
+* \param[out] seconds : Time shift (in seconds).
+*
+* \return
+*   Return true if the time shift is valid.
+*
+*******************************************************************/
+bool patch_parse_shift(const char* text, int64_t* seconds)
+{
+    bool valid = false;
+    int64_t sign = 1;
+    unsigned hours = 0, minutes = 0, secs = 0;
+    long long value = 0;
+    char extra = '\0';
+
+    if ((NULL != text) && ((*text == '+') || (*text == '-')))
+    {
+        sign = (*text == '-') ? -1 : 1;
+        ++text;
+    }
+
+    if ((NULL != text) && (*text != '+') && (*text != '-'))
+    {
+        if (sscanf_s(text, "%u:%2u:%2u%c", &hours, &minutes, &secs, &extra, 1) == 3)
+        {
+            valid = (minutes < 60) && (secs < 60);
+            *seconds = sign * ((int64_t)hours * SECONDS_PER_HOUR + minutes * SECONDS_PER_MINUTE + secs);
+        }
+        else if (sscanf_s(text, "%lld%c", &value, &extra, 1) == 1)
+        {
+            valid = true;
+            *seconds = sign * value;
+        }
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details
+*   Batch callback patching a parsed image file in place.
+*
+* \param[in] record  : Parsed record.
+* \param[in] context : Patcher (patcher_t).
+* \param[out] None
+*
+* \return None
+*
+*******************************************************************/
+void patch_record(nef_record_t* record, void* context)
+{
+    patcher_t* patcher = (patcher_t*)context;
+    patch_edit_t edits[MAX_TAG_LOCATIONS];
+    unsigned edit_count = 0;
+    char journal[MAX_RECORD_PATH_LENGTH + sizeof(PATCH_JOURNAL_SUFFIX)];
+    bool success = false;
+    HANDLE file = INVALID_HANDLE_VALUE;
+
+    if (!record->valid)
+    {
+        InterlockedIncrement(&patcher->failed);
+    }
+    else if (!journal_path(record->path, journal, sizeof(journal)))
+    {
+        fprintf(stderr, "Error: %s: Path is too long.\n", record->path);
+        InterlockedIncrement(&patcher->failed);
+    }
+    else if (INVALID_FILE_ATTRIBUTES != GetFileAttributesA(journal))
+    {
+        fprintf(stderr, "Error: %s: An interrupted patch was found. Run with --recover first.\n", record->path);
+        InterlockedIncrement(&patcher->failed);
+    }
+    else
+    {
+        file = CreateFileA(record->path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (INVALID_HANDLE_VALUE == file)
+        {
+            fprintf(stderr, "Error: %s: Unable to open file for writing.\n", record->path);
+            InterlockedIncrement(&patcher->failed);
+        }
+        else if (!build_edits(patcher, record, file, edits, &edit_count))
+        {
+            InterlockedIncrement(&patcher->failed);
+        }
+        else if (edit_count == 0)
+        {
+            InterlockedIncrement(&patcher->skipped);
+        }
+        else if (!write_journal(journal, edits, edit_count))
+        {
+            fprintf(stderr, "Error: %s: Unable to write journal.\n", record->path);
+            InterlockedIncrement(&patcher->failed);
+        }
+        else
+        {
+            success = apply_edits(file, edits, edit_count);
+
+            if (success)
+            {
+                DeleteFileA(journal);
+                InterlockedIncrement(&patcher->patched);
+            }
+            else
+            {
+                // The journal is kept so the edits can be rolled forward with --recover
+                fprintf(stderr, "Error: %s: Write failed. Run with --recover to complete the patch.\n", record->path);
+                InterlockedIncrement(&patcher->failed);
+            }
+        }
+
+        if (INVALID_HANDLE_VALUE != file)
+        {
+            CloseHandle(file);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Complete an interrupted patch of an image file. A valid journal
+*   is rolled forward. A journal that is incomplete was never
+*   applied, so it is deleted.
+*
+* \param[in] path       : Image file.
+* \param[out] recovered : Set if a journal was rolled forward.
+*
+* \return
+*   Return false if a journal exists and could not be resolved.
+*
+*******************************************************************/
+bool patch_recover(const char* path, bool* recovered)
+{
+    bool success = true;
+    char journal_file[MAX_RECORD_PATH_LENGTH + sizeof(PATCH_JOURNAL_SUFFIX)];
+    uint8_t journal[PATCH_JOURNAL_MAX_SIZE];
+    patch_edit_t edits[MAX_TAG_LOCATIONS];
+    patch_journal_header_t header = { 0 };
+    unsigned edit_count = 0;
+    DWORD size = 0;
+    bool valid = false;
+
+    *recovered = false;
+
+    if (journal_path(path, journal_file, sizeof(journal_file)) && (INVALID_FILE_ATTRIBUTES != GetFileAttributesA(journal_file)))
+    {
+        HANDLE file = CreateFileA(journal_file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (INVALID_HANDLE_VALUE != file)
+        {
+            ReadFile(file, journal, sizeof(journal), &size, NULL);
+            CloseHandle(file);
+        }
+
+        if (size >= sizeof(header))
+        {
+            memcpy(&header, journal, sizeof(header));
+            valid = (PATCH_JOURNAL_MAGIC == header.magic) && (header.edit_count <= MAX_TAG_LOCATIONS) &&
+                    (header.size == size - sizeof(header)) && (fnv1a(&journal[sizeof(header)], header.size) == header.checksum);
+        }
+
+        for (uint32_t offset = sizeof(header); valid && (edit_count < header.edit_count); ++edit_count)
+        {
+            patch_edit_t* edit = &edits[edit_count];
+
+            valid = (offset + 2 * sizeof(uint32_t) <= size);
+
+            if (valid)
+            {
+                memcpy(&edit->offset, &journal[offset], sizeof(uint32_t));
+                memcpy(&edit->length, &journal[offset + sizeof(uint32_t)], sizeof(uint32_t));
+                offset += 2 * sizeof(uint32_t);
+                valid = (edit->length <= PATCH_MAX_VALUE_LENGTH) && (offset + 2 * edit->length <= size);
+            }
+
+            if (valid)
+            {
+                memcpy(edit->old_value, &journal[offset], edit->length);
+                memcpy(edit->new_value, &journal[offset + edit->length], edit->length);
+                offset += 2 * edit->length;
+            }
+        }
+
+        if (valid)
+        {
+            HANDLE image = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            uint8_t current[PATCH_MAX_VALUE_LENGTH];
+
+            success = (INVALID_HANDLE_VALUE != image);
+
+            // Every value must still hold either the old or the new bytes
+            for (unsigned i = 0; success && (i < edit_count); ++i)
+            {
+                success = read_at(image, edits[i].offset, current, edits[i].length) &&
+                          ((memcmp(current, edits[i].old_value, edits[i].length) == 0) ||
+                           (memcmp(current, edits[i].new_value, edits[i].length) == 0));
+            }
+
+            success = success && apply_edits(image, edits, edit_count);
+
+            if (INVALID_HANDLE_VALUE != image)
+            {
+                CloseHandle(image);
+            }
+
+            if (success)
+            {
+                *recovered = true;
+            }
+            else
+            {
+                fprintf(stderr, "Error: %s: Unable to roll forward journal. The file has changed since it was written.\n", path);
+            }
+        }
+
+        if (success)
+        {
+            DeleteFileA(journal_file);
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,54 @@
+/**************************************************************//**
+*
+* \file patch.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	In-place metadata patching of image files.
+*
+*******************************************************************/
+
+#ifndef PATCH_H_
+#define PATCH_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Suffix of the redo journal written next to an image file while it is patched
+#define PATCH_JOURNAL_SUFFIX    ".patch-journal"
+// Longest tag value that can be patched (in bytes)
+#define PATCH_MAX_VALUE_LENGTH  256
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    bool shift;                 // Shift the date/time tags by shift_seconds
+    int64_t shift_seconds;
+    const char* artist;         // Optional. Replaces the Artist tag.
+    const char* copyright;      // Optional. Replaces the Copyright tag.
+    volatile LONG patched;      // Number of files patched
+    volatile LONG failed;       // Number of files that could not be patched
+    volatile LONG skipped;      // Number of files already holding the new values
+} patcher_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool patch_parse_shift(const char* text, int64_t* seconds);
+void patch_record(nef_record_t* record, void* context);
+bool patch_recover(const char* path, bool* recovered);
+
+#endif /* end patch.h */
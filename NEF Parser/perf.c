@@ -0,0 +1,169 @@
+/**************************************************************//**
+*
+* \file perf.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Per-stage parse profiling. Each stage is charged the CPU cycles
+*   of the calling thread (QueryThreadCycleTime) and the elapsed
+*   time (QueryPerformanceCounter). Thread cycles exclude time the
+*   thread spends blocked or preempted, so comparing the two shows
+*   whether a stage is CPU or I/O bound. Stages are also recorded as
+*   trace spans when tracing is enabled.
+*
+*   Only cycles and time are profiled. Hardware counters such as
+*   instructions, cache misses and branch misses cannot be read by
+*   a thread on Windows; ETW PMC sampling needs an elevated kernel
+*   session and attributes counts to context switches rather than
+*   to the stages of a parse.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "perf.h"
+#include "trace.h"
+#include "metrics.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define PERF_NAME_WIDTH 14
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+bool perf_enabled = false;
+
+static const char* perf_stage_names[PERF_STAGE_COUNT] = {
+    "Open",
+    "Read",
+    "IFD0",
+    "EXIF",
+    "Makernote",
+    "Decrypt",
+    "Lens Lookup",
+    "Output",
+};
+
+/******************************************************************
+*
+* \details Read the thread cycles and the time at the start of a
+*          stage.
+*
+* \param[out] start : Cycles and time at the start of the stage.
+*
+* \return None
+*
+*******************************************************************/
+void perf_start(perf_counters_t* start)
+{
+    if (perf_enabled || trace_enabled || metrics_enabled)
+    {
+        LARGE_INTEGER ticks;
+        ULONG64 cycles = 0;
+
+        QueryThreadCycleTime(GetCurrentThread(), &cycles);
+        QueryPerformanceCounter(&ticks);
+        start->cycles = cycles;
+        start->ticks = (uint64_t)ticks.QuadPart;
+    }
+}
+
+/******************************************************************
+*
+* \details Charge the cycles and time since perf_start to a stage.
+*
+* \param[in,out] profile : Profile of the file being parsed.
+* \param[in] stage       : Stage that finished.
+* \param[in] start       : Counters sampled by perf_start.
+*
+* \return None
+*
+*******************************************************************/
+void perf_stop(perf_profile_t* profile, perf_stage_t stage, const perf_counters_t* start)
+{
+    if (perf_enabled || trace_enabled || metrics_enabled)
+    {
+        LARGE_INTEGER ticks;
+        ULONG64 cycles = 0;
+
+        QueryPerformanceCounter(&ticks);
+        QueryThreadCycleTime(GetCurrentThread(), &cycles);
+
+        if (perf_enabled)
+        {
+            profile->stages[stage].cycles += cycles - start->cycles;
+            profile->stages[stage].ticks += (uint64_t)ticks.QuadPart - start->ticks;
+            profile->samples[stage]++;
+        }
+
+        trace_span(stage, start->ticks, (uint64_t)ticks.QuadPart);
+        metrics_observe(stage, (uint64_t)ticks.QuadPart - start->ticks);
+    }
+}
+
+/******************************************************************
+*
+* \details Display name of a stage.
+*
+*******************************************************************/
+const char* perf_stage_name(perf_stage_t stage)
+{
+    return (stage < PERF_STAGE_COUNT) ? perf_stage_names[stage] : "Unknown";
+}
+
+/******************************************************************
+*
+* \details Add the profile of a file to a total.
+*
+*******************************************************************/
+void perf_add(perf_profile_t* total, const perf_profile_t* profile)
+{
+    for (unsigned i = 0; i < PERF_STAGE_COUNT; ++i)
+    {
+        total->stages[i].cycles += profile->stages[i].cycles;
+        total->stages[i].ticks += profile->stages[i].ticks;
+        total->samples[i] += profile->samples[i];
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Display a profile. Means are per stage sample, so a total over
+*   many files shows the typical cost of each stage.
+*
+* \param[in] profile : Profile of a file or a total.
+* \param[in] title   : Heading.
+*
+* \return None
+*
+*******************************************************************/
+void perf_print(const perf_profile_t* profile, const char* title)
+{
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceFrequency(&frequency);
+    printf("%s\n", title);
+    printf("%-*s| %8s | %14s | %12s | %12s\n", PERF_NAME_WIDTH, "Stage", "Samples", "Thread Cycles", "Cycles/Op", "us/Op");
+
+    for (unsigned i = 0; i < PERF_STAGE_COUNT; ++i)
+    {
+        uint32_t samples = profile->samples[i];
+
+        if (samples > 0)
+        {
+            printf("%-*s| %8u | %14llu | %12llu | %12.2f\n", PERF_NAME_WIDTH, perf_stage_names[i], samples,
+                   (unsigned long long)profile->stages[i].cycles,
+                   (unsigned long long)(profile->stages[i].cycles / samples),
+                   (double)profile->stages[i].ticks * 1e6 / (double)frequency.QuadPart / samples);
+        }
+    }
+}
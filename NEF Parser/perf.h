@@ -0,0 +1,68 @@
+/**************************************************************//**
+*
+* \file perf.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Per-stage parse profiling of thread cycles and elapsed time.
+*
+*******************************************************************/
+
+#ifndef PERF_H_
+#define PERF_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Profiled stages. Makernote includes Decrypt and Lens Lookup.
+typedef enum
+{
+    PERF_STAGE_OPEN = 0,
+    PERF_STAGE_READ,
+    PERF_STAGE_IFD0,
+    PERF_STAGE_EXIF,
+    PERF_STAGE_MAKERNOTE,
+    PERF_STAGE_DECRYPT,
+    PERF_STAGE_LENS_LOOKUP,
+    PERF_STAGE_OUTPUT,
+    PERF_STAGE_COUNT
+} perf_stage_t;
+
+typedef struct
+{
+    uint64_t cycles;    // CPU cycles charged to the thread
+    uint64_t ticks;     // Elapsed performance counter ticks
+} perf_counters_t;
+
+typedef struct
+{
+    perf_counters_t stages[PERF_STAGE_COUNT];
+    uint32_t samples[PERF_STAGE_COUNT];
+} perf_profile_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Set before any parsing starts. Profiling is skipped when clear.
+extern bool perf_enabled;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+void perf_start(perf_counters_t* start);
+void perf_stop(perf_profile_t* profile, perf_stage_t stage, const perf_counters_t* start);
+const char* perf_stage_name(perf_stage_t stage);
+void perf_add(perf_profile_t* total, const perf_profile_t* profile);
+void perf_print(const perf_profile_t* profile, const char* title);
+
+#endif /* end perf.h */
@@ -0,0 +1,188 @@
+/**************************************************************//**
+*
+* \file queue.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Bounded blocking queue. Producers block while the queue is
+*   full and consumers block while it is empty. Consumers pop
+*   items in batches to amortize wakeups.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdlib.h>
+#include "queue.h"
+
+/******************************************************************
+*
+* \details Initialize a queue.
+*
+* \param[out] queue   : Queue to be initialized.
+* \param[in] capacity : Maximum number of queued items.
+*
+* \return
+*   Return true if the queue was initialized.
+*
+*******************************************************************/
+bool queue_init(queue_t* queue, uint32_t capacity)
+{
+    queue->items = malloc(capacity * sizeof(void*));
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = false;
+    InitializeSRWLock(&queue->lock);
+    InitializeConditionVariable(&queue->not_empty);
+    InitializeConditionVariable(&queue->not_full);
+
+    return (NULL != queue->items);
+}
+
+/******************************************************************
+*
+* \details Release memory owned by a queue. Queued items are not freed.
+*
+*******************************************************************/
+void queue_free(queue_t* queue)
+{
+    free(queue->items);
+    queue->items = NULL;
+}
+
+/******************************************************************
+*
+* \details Push an item, blocking while the queue is full.
+*
+* \param[in] queue : Queue.
+* \param[in] item  : Item to be queued.
+*
+* \return
+*   Return false if the queue has been closed.
+*
+*******************************************************************/
+bool queue_push(queue_t* queue, void* item)
+{
+    bool pushed = false;
+
+    AcquireSRWLockExclusive(&queue->lock);
+
+    while ((queue->count == queue->capacity) && !queue->closed)
+    {
+        SleepConditionVariableSRW(&queue->not_full, &queue->lock, INFINITE, 0);
+    }
+
+    if (!queue->closed)
+    {
+        queue->items[(queue->head + queue->count) % queue->capacity] = item;
+        queue->count++;
+        pushed = true;
+    }
+
+    ReleaseSRWLockExclusive(&queue->lock);
+
+    if (pushed)
+    {
+        WakeConditionVariable(&queue->not_empty);
+    }
+
+    return pushed;
+}
+
+/******************************************************************
+*
+* \details
+*   Pop up to max_items items, blocking until at least one item
+*   is available or the queue is closed.
+*
+* \param[in] queue     : Queue.
+* \param[out] items    : Popped items.
+* \param[in] max_items : Maximum number of items to pop.
+*
+* \return
+*   Return the number of popped items. Zero indicates the queue
+*   is closed and drained.
+*
+*******************************************************************/
+uint32_t queue_pop_batch(queue_t* queue, void** items, uint32_t max_items)
+{
+    uint32_t popped = 0;
+
+    AcquireSRWLockExclusive(&queue->lock);
+
+    while ((queue->count == 0) && !queue->closed)
+    {
+        SleepConditionVariableSRW(&queue->not_empty, &queue->lock, INFINITE, 0);
+    }
+
+    while ((popped < max_items) && (queue->count > 0))
+    {
+        items[popped++] = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+
+    ReleaseSRWLockExclusive(&queue->lock);
+
+    if (popped > 0)
+    {
+        WakeAllConditionVariable(&queue->not_full);
+    }
+
+    return popped;
+}
+
+/******************************************************************
+*
+* \details Pop up to max_items items without blocking.
+*
+* \param[in] queue     : Queue.
+* \param[out] items    : Popped items.
+* \param[in] max_items : Maximum number of items to pop.
+*
+* \return
+*   Return the number of popped items (zero if the queue is empty).
+*
+*******************************************************************/
+uint32_t queue_try_pop_batch(queue_t* queue, void** items, uint32_t max_items)
+{
+    uint32_t popped = 0;
+
+    AcquireSRWLockExclusive(&queue->lock);
+
+    while ((popped < max_items) && (queue->count > 0))
+    {
+        items[popped++] = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+
+    ReleaseSRWLockExclusive(&queue->lock);
+
+    if (popped > 0)
+    {
+        WakeAllConditionVariable(&queue->not_full);
+    }
+
+    return popped;
+}
+
+/******************************************************************
+*
+* \details Close a queue. Blocked producers and consumers are woken
+*          and consumers drain the remaining items.
+*
+*******************************************************************/
+void queue_close(queue_t* queue)
+{
+    AcquireSRWLockExclusive(&queue->lock);
+    queue->closed = true;
+    ReleaseSRWLockExclusive(&queue->lock);
+    WakeAllConditionVariable(&queue->not_empty);
+    WakeAllConditionVariable(&queue->not_full);
+}
@@ -0,0 +1,49 @@
+/**************************************************************//**
+*
+* \file queue.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Bounded blocking queue used to hand items between threads.
+*
+*******************************************************************/
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    void** items;
+    uint32_t capacity;
+    uint32_t head;  // Position of the next item to pop
+    uint32_t count; // Number of queued items
+    bool closed;    // No further items will be pushed
+    SRWLOCK lock;
+    CONDITION_VARIABLE not_empty;
+    CONDITION_VARIABLE not_full;
+} queue_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool queue_init(queue_t* queue, uint32_t capacity);
+void queue_free(queue_t* queue);
+bool queue_push(queue_t* queue, void* item);
+uint32_t queue_pop_batch(queue_t* queue, void** items, uint32_t max_items);
+uint32_t queue_try_pop_batch(queue_t* queue, void** items, uint32_t max_items);
+void queue_close(queue_t* queue);
+
+#endif /* end queue.h */
@@ -0,0 +1,156 @@
+/**************************************************************//**
+*
+* \file rate.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Token bucket rate limiter, implemented as a generic cell rate
+*   algorithm (GCRA). The bucket is a single theoretical arrival
+*   time, advanced with a compare exchange by each request, so no
+*   lock is taken. Requests reserve their slot before they wait,
+*   so waiting threads are served in arrival order and share the
+*   rate fairly.
+*
+*   The rate may be changed at any time by another thread.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include "rate.h"
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static LONG64 rate_now(void);
+
+/******************************************************************
+*
+* \details Current performance counter ticks.
+*
+*******************************************************************/
+static LONG64 rate_now(void)
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+
+    return now.QuadPart;
+}
+
+/******************************************************************
+*
+* \details Prepare a limiter.
+*
+* \param[out] limiter : Limiter.
+* \param[in] rate     : Units per second (0 = unlimited).
+*
+* \return None
+*
+*******************************************************************/
+void rate_init(rate_limiter_t* limiter, uint64_t rate)
+{
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceFrequency(&frequency);
+    limiter->frequency = frequency.QuadPart;
+    limiter->tat = rate_now();
+    limiter->waited = 0;
+    limiter->rate = (LONG64)rate;
+}
+
+/******************************************************************
+*
+* \details
+*   Change the rate of a limiter. Work reserved at the old rate is
+*   not rescheduled, but a faster rate applies to the next request
+*   immediately.
+*
+* \param[in,out] limiter : Limiter.
+* \param[in] rate        : Units per second (0 = unlimited).
+*
+* \return None
+*
+*******************************************************************/
+void rate_set(rate_limiter_t* limiter, uint64_t rate)
+{
+    LONG64 now = rate_now();
+    LONG64 tat = limiter->tat;
+
+    InterlockedExchange64(&limiter->rate, (LONG64)rate);
+
+    // Drop the backlog scheduled at the old rate
+    while ((tat > now) && (InterlockedCompareExchange64(&limiter->tat, now, tat) != tat))
+    {
+        tat = limiter->tat;
+    }
+}
+
+/******************************************************************
+*
+* \details Units per second of a limiter (0 = unlimited).
+*
+*******************************************************************/
+uint64_t rate_get(const rate_limiter_t* limiter)
+{
+    return (uint64_t)limiter->rate;
+}
+
+/******************************************************************
+*
+* \details
+*   Wait until units may be consumed at the rate of the limiter.
+*   Up to RATE_BURST_MS of work may run ahead of the rate.
+*
+* \param[in,out] limiter : Limiter.
+* \param[in] units       : Units consumed (bytes, operations, ...).
+*
+* \return None
+*
+*******************************************************************/
+void rate_acquire(rate_limiter_t* limiter, uint64_t units)
+{
+    LONG64 rate = limiter->rate;
+
+    if ((rate > 0) && (units > 0))
+    {
+        LONG64 cost = (LONG64)((double)units * limiter->frequency / rate);
+        LONG64 burst = limiter->frequency * RATE_BURST_MS / 1000;
+        LONG64 now = rate_now();
+        LONG64 tat = limiter->tat;
+        LONG64 start = now;
+        bool reserved = false;
+
+        // Reserve the next slot. An idle limiter starts from now, so
+        // unused rate is not saved up beyond the burst.
+        while (!reserved)
+        {
+            start = (tat > now) ? tat : now;
+            LONG64 previous = InterlockedCompareExchange64(&limiter->tat, start + cost, tat);
+            reserved = (previous == tat);
+            tat = previous;
+        }
+
+        LONG64 delay = start + cost - burst - now;
+
+        if (delay > 0)
+        {
+            InterlockedAdd64(&limiter->waited, delay);
+            Sleep((DWORD)((delay * 1000 + limiter->frequency - 1) / limiter->frequency));
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Time spent waiting on a limiter (in seconds).
+*
+*******************************************************************/
+double rate_waited_seconds(const rate_limiter_t* limiter)
+{
+    return (limiter->frequency > 0) ? (double)limiter->waited / limiter->frequency : 0.0;
+}
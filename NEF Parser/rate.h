@@ -0,0 +1,49 @@
+/**************************************************************//**
+*
+* \file rate.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Thread safe rate limiter shared by the worker threads.
+*
+*******************************************************************/
+
+#ifndef RATE_H_
+#define RATE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define RATE_BURST_MS   100 // Work allowed ahead of the rate
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    volatile LONG64 rate;       // Units per second (0 = unlimited)
+    volatile LONG64 tat;        // Theoretical arrival time of the next unit (performance counter ticks)
+    volatile LONG64 waited;     // Ticks spent waiting
+    LONG64 frequency;           // Performance counter ticks per second
+} rate_limiter_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+void rate_init(rate_limiter_t* limiter, uint64_t rate);
+void rate_set(rate_limiter_t* limiter, uint64_t rate);
+uint64_t rate_get(const rate_limiter_t* limiter);
+void rate_acquire(rate_limiter_t* limiter, uint64_t units);
+double rate_waited_seconds(const rate_limiter_t* limiter);
+
+#endif /* end rate.h */
@@ -0,0 +1,72 @@
+/**************************************************************//**
+*
+* \file record.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Parsed image file record definitions. A record owns copies of
+*   all extracted fields and remains valid after the image file
+*   buffer is released.
+*
+*******************************************************************/
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "tiff.h"
+#include "exif.h"
+#include "xmp.h"
+#include "perf.h"
+#include "io.h"
+#include "alloc.h"
+#include "error.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define MAX_RECORD_PATH_LENGTH 260
+#define MAX_TAG_LOCATIONS      8
+// Lens of files whose lens could not be identified
+#define RECORD_UNKNOWN_LENS    "Unknown"
+
+/******************************************************************
+                        Structures
+*******************************************************************/
+// Location of a fixed size ASCII tag value within the image file
+struct tag_location_t
+{
+    uint16_t tag;    // Tag identifier
+    uint32_t offset; // Absolute offset of the value
+    uint32_t count;  // Size of the value (in bytes, including NULL)
+};
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Metadata extracted from a single image file
+typedef struct
+{
+    char path[MAX_RECORD_PATH_LENGTH];
+    bool valid; // Record was parsed successfully
+    image_data_t image;
+    camera_data_t camera;
+    gps_data_t gps;
+    xmp_data_t xmp;
+    // Patchable tag values (date/time, artist and copyright)
+    struct tag_location_t locations[MAX_TAG_LOCATIONS];
+    uint8_t location_count;
+    perf_profile_t profile; // Filled when profiling is enabled
+    io_stats_t io;          // Bytes read and file system calls made reading the file
+    alloc_profile_t memory; // Filled when allocation profiles are enabled
+    nef_error_list_t errors; // Errors found parsing the file
+} nef_record_t;
+
+#endif /* end record.h */
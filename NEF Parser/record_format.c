@@ -0,0 +1,513 @@
+/**************************************************************//**
+*
+* \file record_format.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Binary record format read in place by consumers. Each record
+*   starts with a table of field offsets, so a reader locates a
+*   field with two loads and reads it directly from the file
+*   contents (e.g. a mapped view) without a deserialization pass.
+*
+*   Records are encoded on the batch worker threads and a single
+*   writer thread appends them to the output stream.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "record_format.h"
+#include "alloc.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Maximum number of records written per writer thread wakeup
+#define RECORD_WRITE_BATCH  64
+// Size of the record header (size, field count and vtable)
+#define RECORD_HEADER_SIZE(field_count) (sizeof(uint32_t) + sizeof(uint16_t) + (field_count) * sizeof(uint16_t))
+
+#define ALIGN(x, alignment) (((x) + (alignment) - 1) & ~((alignment) - 1))
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+const record_schema_t record_schema[RECORD_FIELD_COUNT] = {
+    { RECORD_FIELD_PATH,               RECORD_TYPE_STRING, "path" },
+    { RECORD_FIELD_MODEL,              RECORD_TYPE_STRING, "model" },
+    { RECORD_FIELD_SERIAL_NUMBER,      RECORD_TYPE_STRING, "serial_number" },
+    { RECORD_FIELD_LENS,               RECORD_TYPE_STRING, "lens" },
+    { RECORD_FIELD_DATE_TIME_ORIGINAL, RECORD_TYPE_STRING, "date_time_original" },
+    { RECORD_FIELD_SHUTTER_COUNT,      RECORD_TYPE_UINT32, "shutter_count" },
+    { RECORD_FIELD_ISO,                RECORD_TYPE_UINT32, "iso" },
+    { RECORD_FIELD_EXPOSURE_TIME,      RECORD_TYPE_FLOAT,  "exposure_time" },
+    { RECORD_FIELD_FNUMBER,            RECORD_TYPE_FLOAT,  "fnumber" },
+    { RECORD_FIELD_FOCAL_LENGTH,       RECORD_TYPE_FLOAT,  "focal_length" },
+    { RECORD_FIELD_LATITUDE,           RECORD_TYPE_DOUBLE, "latitude" },
+    { RECORD_FIELD_LONGITUDE,          RECORD_TYPE_DOUBLE, "longitude" },
+    { RECORD_FIELD_ALTITUDE,           RECORD_TYPE_DOUBLE, "altitude" },
+    { RECORD_FIELD_RATING,             RECORD_TYPE_INT32,  "rating" },
+    { RECORD_FIELD_QUALITY,            RECORD_TYPE_STRING, "quality" },
+    { RECORD_FIELD_WHITE_BALANCE,      RECORD_TYPE_STRING, "white_balance" },
+    { RECORD_FIELD_FOCUS_MODE,         RECORD_TYPE_STRING, "focus_mode" },
+    { RECORD_FIELD_METERING_MODE,      RECORD_TYPE_STRING, "metering_mode" },
+    { RECORD_FIELD_COMPRESSION,        RECORD_TYPE_STRING, "compression" },
+    { RECORD_FIELD_WIDTH,              RECORD_TYPE_UINT32, "width" },
+    { RECORD_FIELD_HEIGHT,             RECORD_TYPE_UINT32, "height" },
+    { RECORD_FIELD_MAKE,               RECORD_TYPE_STRING, "make" },
+};
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool put_value(uint8_t* data, uint32_t size, uint32_t* offset, record_field_t field, const void* value, uint32_t length);
+static bool put_string(uint8_t* data, uint32_t size, uint32_t* offset, record_field_t field, const char* text);
+static const uint8_t* get_field(const uint8_t* record, record_field_t field, uint32_t length);
+static DWORD WINAPI record_writer_thread(LPVOID parameter);
+
+/******************************************************************
+*
+* \details Append a scalar field, aligned to its size.
+*
+*******************************************************************/
+static bool put_value(uint8_t* data, uint32_t size, uint32_t* offset, record_field_t field, const void* value, uint32_t length)
+{
+    uint32_t position = ALIGN(*offset, length);
+    bool success = (position + length <= size);
+
+    if (success)
+    {
+        uint16_t vtable_offset = (uint16_t)position;
+        memcpy(&data[position], value, length);
+        memcpy(&data[RECORD_HEADER_SIZE(field)], &vtable_offset, sizeof(uint16_t));
+        *offset = position + length;
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Append a string field. Empty strings are left absent.
+*
+*******************************************************************/
+static bool put_string(uint8_t* data, uint32_t size, uint32_t* offset, record_field_t field, const char* text)
+{
+    bool success = true;
+    size_t length = (NULL != text) ? strlen(text) : 0;
+
+    if (length > 0)
+    {
+        uint16_t prefix = (uint16_t)length;
+        success = put_value(data, size, offset, field, &prefix, sizeof(prefix)) && (*offset + length + 1 <= size);
+
+        if (success)
+        {
+            memcpy(&data[*offset], text, length + 1);
+            *offset += (uint32_t)length + 1;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Encode a record.
+*
+* \param[in] record : Parsed record.
+* \param[out] data  : Encoded record.
+* \param[in] size   : Size of the data buffer (in bytes).
+*
+* \return
+*   Return the size of the encoded record, or 0 if it does not fit.
+*
+*******************************************************************/
+uint32_t record_encode(const nef_record_t* record, uint8_t* data, uint32_t size)
+{
+    const uint16_t field_count = RECORD_FIELD_COUNT;
+    uint32_t offset = ALIGN((uint32_t)RECORD_HEADER_SIZE(RECORD_FIELD_COUNT), RECORD_ALIGNMENT);
+    bool success = (offset <= size);
+
+    if (success)
+    {
+        // Padding and absent fields are zero
+        memset(data, 0, size);
+        memcpy(&data[sizeof(uint32_t)], &field_count, sizeof(field_count));
+
+        success = put_string(data, size, &offset, RECORD_FIELD_PATH, record->path) &&
+                  put_string(data, size, &offset, RECORD_FIELD_MODEL, record->camera.model) &&
+                  put_string(data, size, &offset, RECORD_FIELD_SERIAL_NUMBER, record->camera.serial_number) &&
+                  put_string(data, size, &offset, RECORD_FIELD_LENS, record->camera.lens) &&
+                  put_string(data, size, &offset, RECORD_FIELD_DATE_TIME_ORIGINAL, record->image.timestamp) &&
+                  put_value(data, size, &offset, RECORD_FIELD_SHUTTER_COUNT, &record->image.shutter_count, sizeof(uint32_t)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_ISO, &record->image.iso, sizeof(uint32_t)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_EXPOSURE_TIME, &record->image.shutter_speed, sizeof(float)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_FNUMBER, &record->image.aperature, sizeof(float)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_FOCAL_LENGTH, &record->image.focal_length, sizeof(float)) &&
+                  put_string(data, size, &offset, RECORD_FIELD_QUALITY, record->image.quality) &&
+                  put_string(data, size, &offset, RECORD_FIELD_WHITE_BALANCE, record->image.white_balance) &&
+                  put_string(data, size, &offset, RECORD_FIELD_FOCUS_MODE, record->image.focus_mode) &&
+                  put_string(data, size, &offset, RECORD_FIELD_METERING_MODE, record->image.metering_mode) &&
+                  put_string(data, size, &offset, RECORD_FIELD_COMPRESSION, record->image.compression) &&
+                  put_value(data, size, &offset, RECORD_FIELD_WIDTH, &record->image.width, sizeof(uint32_t)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_HEIGHT, &record->image.height, sizeof(uint32_t)) &&
+                  put_string(data, size, &offset, RECORD_FIELD_MAKE, record->camera.make);
+    }
+
+    if (success && record->gps.valid)
+    {
+        success = put_value(data, size, &offset, RECORD_FIELD_LATITUDE, &record->gps.latitude, sizeof(double)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_LONGITUDE, &record->gps.longitude, sizeof(double)) &&
+                  put_value(data, size, &offset, RECORD_FIELD_ALTITUDE, &record->gps.altitude, sizeof(double));
+    }
+
+    if (success && record->xmp.present && (XMP_RATING_NONE != record->xmp.rating))
+    {
+        int32_t rating = record->xmp.rating;
+        success = put_value(data, size, &offset, RECORD_FIELD_RATING, &rating, sizeof(int32_t));
+    }
+
+    offset = ALIGN(offset, RECORD_ALIGNMENT);
+
+    if (success && (offset <= size))
+    {
+        memcpy(data, &offset, sizeof(uint32_t));
+    }
+    else
+    {
+        offset = 0;
+    }
+
+    return offset;
+}
+
+/******************************************************************
+*
+* \details Writer thread appending encoded records to the stream.
+*
+*******************************************************************/
+static DWORD WINAPI record_writer_thread(LPVOID parameter)
+{
+    record_writer_t* writer = (record_writer_t*)parameter;
+    void* batch[RECORD_WRITE_BATCH];
+    uint32_t count;
+
+    while ((count = queue_pop_batch(&writer->queue, batch, RECORD_WRITE_BATCH)) > 0)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            encoded_record_t* encoded = (encoded_record_t*)batch[i];
+
+            if (stream_write(&writer->stream, encoded->data, encoded->size))
+            {
+                InterlockedIncrement(&writer->written);
+            }
+            else
+            {
+                InterlockedIncrement(&writer->failed);
+            }
+
+            nef_free(encoded);
+        }
+    }
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details Create the record file and start the writer thread.
+*
+* \param[out] writer : Record writer.
+* \param[in] path    : Record file. Replaced if it exists.
+* \param[in] level   : zstd compression level, or 0 for no compression.
+* \param[in] threads : Compression threads.
+*
+* \return
+*   Return true if the writer was started.
+*
+*******************************************************************/
+bool record_writer_start(record_writer_t* writer, const char* path, int level, unsigned threads)
+{
+    bool success = false;
+    bool opened = false;
+    record_file_header_t header = { RECORD_FILE_MAGIC, RECORD_FORMAT_VERSION, RECORD_FIELD_COUNT, 0 };
+
+    memset(writer, 0, sizeof(record_writer_t));
+    opened = stream_open(&writer->stream, path, level, threads);
+
+    if (opened && stream_write(&writer->stream, &header, sizeof(header)) && queue_init(&writer->queue, RECORD_QUEUE_CAPACITY))
+    {
+        writer->thread = CreateThread(NULL, 0, record_writer_thread, writer, 0, NULL);
+        success = (NULL != writer->thread);
+
+        if (!success)
+        {
+            queue_free(&writer->queue);
+        }
+    }
+
+    if (!success && opened)
+    {
+        stream_close(&writer->stream);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Encode a record and queue it for the writer thread.
+*          Called from the batch worker threads.
+*
+* \param[in] writer : Record writer.
+* \param[in] record : Parsed record.
+*
+* \return None
+*
+*******************************************************************/
+void record_writer_submit(record_writer_t* writer, const nef_record_t* record)
+{
+    if (record->valid)
+    {
+        encoded_record_t* encoded = nef_malloc(sizeof(encoded_record_t), PERF_STAGE_OUTPUT);
+
+        if ((NULL == encoded) || ((encoded->size = record_encode(record, encoded->data, RECORD_MAX_SIZE)) == 0) ||
+            !queue_push(&writer->queue, encoded))
+        {
+            fprintf(stderr, "Error: Failed to encode record for %s.\n", record->path);
+            InterlockedIncrement(&writer->failed);
+            nef_free(encoded);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Write the remaining records and close the file.
+*
+* \param[in] writer : Record writer.
+*
+* \return None
+*
+*******************************************************************/
+void record_writer_stop(record_writer_t* writer)
+{
+    if (NULL != writer->thread)
+    {
+        queue_close(&writer->queue);
+        WaitForSingleObject(writer->thread, INFINITE);
+        CloseHandle(writer->thread);
+        writer->thread = NULL;
+        queue_free(&writer->queue);
+
+        if (!stream_close(&writer->stream))
+        {
+            fprintf(stderr, "Error: Failed to write records.\n");
+            writer->written = 0;
+            InterlockedIncrement(&writer->failed);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Locate the first record of a record file.
+*
+* \param[in] data : Record file contents.
+* \param[in] size : Size of the contents (in bytes).
+*
+* \return
+*   Return the first record, or NULL if the file is empty or not
+*   a record file.
+*
+*******************************************************************/
+const uint8_t* record_first(const uint8_t* data, size_t size)
+{
+    const uint8_t* record = NULL;
+    record_file_header_t header;
+
+    if ((NULL != data) && (size >= sizeof(header)))
+    {
+        memcpy(&header, data, sizeof(header));
+
+        if ((RECORD_FILE_MAGIC == header.magic) && (RECORD_FORMAT_VERSION == header.version))
+        {
+            record = record_next(data, size, NULL);
+        }
+    }
+
+    return record;
+}
+
+/******************************************************************
+*
+* \details
+*   Locate the record following another. The record size and
+*   vtable are validated, so the getters can be used on the
+*   returned record without further bounds checks.
+*
+* \param[in] data   : Record file contents.
+* \param[in] size   : Size of the contents (in bytes).
+* \param[in] record : Current record, or NULL for the first record.
+*
+* \return
+*   Return the next record, or NULL at the end of the file.
+*
+*******************************************************************/
+const uint8_t* record_next(const uint8_t* data, size_t size, const uint8_t* record)
+{
+    const uint8_t* next = NULL;
+    size_t offset = sizeof(record_file_header_t);
+    uint32_t record_size = 0;
+    uint16_t field_count = 0;
+
+    if (NULL != record)
+    {
+        memcpy(&record_size, record, sizeof(uint32_t));
+        offset = (size_t)(record - data) + record_size;
+    }
+
+    if (offset + RECORD_HEADER_SIZE(0) <= size)
+    {
+        next = &data[offset];
+        memcpy(&record_size, next, sizeof(uint32_t));
+        memcpy(&field_count, &next[sizeof(uint32_t)], sizeof(uint16_t));
+
+        if ((record_size < RECORD_HEADER_SIZE(field_count)) || ((record_size % RECORD_ALIGNMENT) != 0) ||
+            (offset + record_size > size))
+        {
+            fprintf(stderr, "Error: Record at offset %zu is corrupt.\n", offset);
+            next = NULL;
+        }
+    }
+
+    return next;
+}
+
+/******************************************************************
+*
+* \details Locate a field in a record.
+*
+* \return
+*   Return a pointer to the field, or NULL if it is absent.
+*
+*******************************************************************/
+static const uint8_t* get_field(const uint8_t* record, record_field_t field, uint32_t length)
+{
+    const uint8_t* value = NULL;
+    uint32_t record_size = 0;
+    uint16_t field_count = 0;
+    uint16_t offset = 0;
+
+    memcpy(&record_size, record, sizeof(uint32_t));
+    memcpy(&field_count, &record[sizeof(uint32_t)], sizeof(uint16_t));
+
+    if ((uint32_t)field < field_count)
+    {
+        memcpy(&offset, &record[RECORD_HEADER_SIZE(field)], sizeof(uint16_t));
+
+        if ((offset != 0) && (offset + length <= record_size))
+        {
+            value = &record[offset];
+        }
+    }
+
+    return value;
+}
+
+/******************************************************************
+*
+* \details
+*   Field getters. Scalar getters return the given default value
+*   if the field is absent.
+*   The string getter returns NULL if the field is absent or its
+*   text is not NULL terminated at its length.
+*
+*******************************************************************/
+const char* record_get_string(const uint8_t* record, record_field_t field, uint16_t* length)
+{
+    const char* text = NULL;
+    const uint8_t* value = get_field(record, field, sizeof(uint16_t));
+    uint32_t record_size = 0;
+    uint16_t text_length = 0;
+
+    memcpy(&record_size, record, sizeof(uint32_t));
+
+    if (NULL != value)
+    {
+        memcpy(&text_length, value, sizeof(uint16_t));
+
+        // Text must fit the record and be NULL terminated at its length, with no
+        // earlier NULL, so the text and length agree
+        if (((uint32_t)(value - record) + sizeof(uint16_t) + text_length < record_size) &&
+            (value[sizeof(uint16_t) + text_length] == '\0') &&
+            (NULL == memchr(&value[sizeof(uint16_t)], '\0', text_length)))
+        {
+            text = (const char*)&value[sizeof(uint16_t)];
+        }
+    }
+
+    if (NULL != length)
+    {
+        *length = (NULL != text) ? text_length : 0;
+    }
+
+    return text;
+}
+
+uint32_t record_get_uint32(const uint8_t* record, record_field_t field, uint32_t value)
+{
+    const uint8_t* field_value = get_field(record, field, sizeof(uint32_t));
+
+    if (NULL != field_value)
+    {
+        memcpy(&value, field_value, sizeof(uint32_t));
+    }
+
+    return value;
+}
+
+int32_t record_get_int32(const uint8_t* record, record_field_t field, int32_t value)
+{
+    const uint8_t* field_value = get_field(record, field, sizeof(int32_t));
+
+    if (NULL != field_value)
+    {
+        memcpy(&value, field_value, sizeof(int32_t));
+    }
+
+    return value;
+}
+
+float record_get_float(const uint8_t* record, record_field_t field, float value)
+{
+    const uint8_t* field_value = get_field(record, field, sizeof(float));
+
+    if (NULL != field_value)
+    {
+        memcpy(&value, field_value, sizeof(float));
+    }
+
+    return value;
+}
+
+double record_get_double(const uint8_t* record, record_field_t field, double value)
+{
+    const uint8_t* field_value = get_field(record, field, sizeof(double));
+
+    if (NULL != field_value)
+    {
+        memcpy(&value, field_value, sizeof(double));
+    }
+
+    return value;
+}
@@ -0,0 +1,148 @@
+/**************************************************************//**
+*
+* \file record_format.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Binary record format read in place by consumers.
+*
+*   File layout:
+*       record_file_header_t
+*       Records, each aligned to RECORD_ALIGNMENT:
+*           uint32_t size         : Record size (in bytes, multiple of RECORD_ALIGNMENT)
+*           uint16_t field_count  : Number of vtable entries
+*           uint16_t vtable[]     : Field offsets from the record start (0 = absent)
+*           Field data            : Scalars aligned to their size. Strings are a
+*                                   uint16_t length followed by NULL terminated text.
+*
+*   Compressed record files are a sequence of zstd frames holding
+*   whole records, and they must be decompressed before reading.
+*
+*   Schema evolution: field identifiers are never reused or reordered
+*   and new fields are appended to record_field_t. Readers return the
+*   default value of fields beyond the record's field_count and skip
+*   vtable entries they do not know.
+*
+*******************************************************************/
+
+#ifndef RECORD_FORMAT_H_
+#define RECORD_FORMAT_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "queue.h"
+#include "stream.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define RECORD_FILE_MAGIC       0x5246454E // "NEFR"
+#define RECORD_FORMAT_VERSION   1
+#define RECORD_ALIGNMENT        8
+#define RECORD_MAX_SIZE         2048
+#define RECORD_QUEUE_CAPACITY   1024
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Field identifiers. Append only.
+typedef enum
+{
+    RECORD_FIELD_PATH = 0,           // string
+    RECORD_FIELD_MODEL,              // string
+    RECORD_FIELD_SERIAL_NUMBER,      // string
+    RECORD_FIELD_LENS,               // string
+    RECORD_FIELD_DATE_TIME_ORIGINAL, // string
+    RECORD_FIELD_SHUTTER_COUNT,      // uint32
+    RECORD_FIELD_ISO,                // uint32
+    RECORD_FIELD_EXPOSURE_TIME,      // float
+    RECORD_FIELD_FNUMBER,            // float
+    RECORD_FIELD_FOCAL_LENGTH,       // float
+    RECORD_FIELD_LATITUDE,           // double
+    RECORD_FIELD_LONGITUDE,          // double
+    RECORD_FIELD_ALTITUDE,           // double
+    RECORD_FIELD_RATING,             // int32
+    RECORD_FIELD_QUALITY,            // string
+    RECORD_FIELD_WHITE_BALANCE,      // string
+    RECORD_FIELD_FOCUS_MODE,         // string
+    RECORD_FIELD_METERING_MODE,      // string
+    RECORD_FIELD_COMPRESSION,        // string
+    RECORD_FIELD_WIDTH,              // uint32
+    RECORD_FIELD_HEIGHT,             // uint32
+    RECORD_FIELD_MAKE,               // string
+    RECORD_FIELD_COUNT
+} record_field_t;
+
+typedef enum
+{
+    RECORD_TYPE_STRING = 0,
+    RECORD_TYPE_UINT32,
+    RECORD_TYPE_INT32,
+    RECORD_TYPE_FLOAT,
+    RECORD_TYPE_DOUBLE
+} record_type_t;
+
+// Schema entry describing a field
+typedef struct
+{
+    record_field_t field;
+    record_type_t type;
+    const char* name;
+} record_schema_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;       // RECORD_FORMAT_VERSION
+    uint16_t field_count;   // Fields known by the writer
+    uint64_t reserved;
+} record_file_header_t;
+
+// Encoded record waiting to be written
+typedef struct
+{
+    uint32_t size;
+    uint8_t data[RECORD_MAX_SIZE];
+} encoded_record_t;
+
+typedef struct
+{
+    queue_t queue;          // Encoded records
+    HANDLE thread;          // Writer thread
+    stream_t stream;        // Record file
+    volatile LONG written;  // Number of records written
+    volatile LONG failed;   // Number of records that could not be encoded or written
+} record_writer_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+extern const record_schema_t record_schema[RECORD_FIELD_COUNT];
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+// Writer
+uint32_t record_encode(const nef_record_t* record, uint8_t* data, uint32_t size);
+bool record_writer_start(record_writer_t* writer, const char* path, int level, unsigned threads);
+void record_writer_submit(record_writer_t* writer, const nef_record_t* record);
+void record_writer_stop(record_writer_t* writer);
+
+// Reader. Records are read in place from the file contents.
+const uint8_t* record_first(const uint8_t* data, size_t size);
+const uint8_t* record_next(const uint8_t* data, size_t size, const uint8_t* record);
+const char* record_get_string(const uint8_t* record, record_field_t field, uint16_t* length);
+uint32_t record_get_uint32(const uint8_t* record, record_field_t field, uint32_t value);
+int32_t record_get_int32(const uint8_t* record, record_field_t field, int32_t value);
+float record_get_float(const uint8_t* record, record_field_t field, float value);
+double record_get_double(const uint8_t* record, record_field_t field, double value);
+
+#endif /* end record_format.h */
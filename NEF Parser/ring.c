@@ -0,0 +1,509 @@
+/**************************************************************//**
+*
+* \file ring.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Shared memory ring buffer of fixed layout records. The batch
+*   worker threads queue their records and a single producer
+*   thread converts them directly into the ring slots, so the
+*   consumer process reads the records in place.
+*
+*   The producer publishes the head position once per batch of
+*   records and the consumer releases slots once per read. The
+*   named events are only set when the other side has flagged
+*   that it is waiting, so a busy ring runs without system calls.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ring.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+// Maximum number of records written per producer thread wakeup
+#define RING_WRITE_BATCH    256
+// Waits are bounded so a missed event only delays, never stalls, the ring
+#define RING_WAIT_MS        100
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool open_objects(ring_t* ring, const char* name, bool create, uint32_t slot_count);
+static void close_objects(ring_t* ring);
+static void publish(ring_t* ring, LONG64 head);
+static bool wait_for_space(ring_t* ring, LONG64 head);
+static void write_slot(ring_record_t* slot, const nef_record_t* record);
+static DWORD WINAPI ring_producer_thread(LPVOID parameter);
+
+/******************************************************************
+*
+* \details
+*   Create or open the shared memory and named events of a ring.
+*
+* \param[out] ring      : Ring.
+* \param[in] name       : Mapping name.
+* \param[in] create     : Create the ring (producer) or open it (consumer).
+* \param[in] slot_count : Number of slots. Used when creating the ring.
+*
+* \return
+*   Return true if the ring was opened.
+*
+*******************************************************************/
+static bool open_objects(ring_t* ring, const char* name, bool create, uint32_t slot_count)
+{
+    bool success = false;
+    char event_name[RING_MAX_NAME_LENGTH + sizeof(RING_SPACE_EVENT_SUFFIX)];
+    uint64_t size = sizeof(ring_header_t) + (uint64_t)slot_count * sizeof(ring_record_t);
+
+    if (strlen(name) >= RING_MAX_NAME_LENGTH)
+    {
+        fprintf(stderr, "Error: Ring name is too long.\n");
+    }
+    else
+    {
+        ring->mapping = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, name)
+                               : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+
+        if (NULL != ring->mapping)
+        {
+            ring->header = (ring_header_t*)MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        }
+
+        snprintf(event_name, sizeof(event_name), "%s%s", name, RING_DATA_EVENT_SUFFIX);
+        ring->data_event = CreateEventA(NULL, FALSE, FALSE, event_name);
+        snprintf(event_name, sizeof(event_name), "%s%s", name, RING_SPACE_EVENT_SUFFIX);
+        ring->space_event = CreateEventA(NULL, FALSE, FALSE, event_name);
+
+        success = (NULL != ring->header) && (NULL != ring->data_event) && (NULL != ring->space_event);
+    }
+
+    if (success)
+    {
+        ring->slots = (ring_record_t*)(ring->header + 1);
+
+        if (create)
+        {
+            memset(ring->header, 0, sizeof(ring_header_t));
+            ring->header->record_size = sizeof(ring_record_t);
+            ring->header->slot_count = slot_count;
+            ring->header->version = RING_VERSION;
+            // Published last. The consumer checks it before using the header.
+            InterlockedExchange((volatile LONG*)&ring->header->magic, RING_MAGIC);
+        }
+        else if ((RING_MAGIC != ReadAcquire((volatile LONG*)&ring->header->magic)) ||
+                 (RING_VERSION != ring->header->version) || (sizeof(ring_record_t) != ring->header->record_size))
+        {
+            fprintf(stderr, "Error: Ring %s is not compatible with this build.\n", name);
+            success = false;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Error: Unable to open ring %s.\n", name);
+    }
+
+    if (!success)
+    {
+        close_objects(ring);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Unmap the shared memory and close the named events.
+*
+*******************************************************************/
+static void close_objects(ring_t* ring)
+{
+    if (NULL != ring->header)
+    {
+        UnmapViewOfFile(ring->header);
+        ring->header = NULL;
+        ring->slots = NULL;
+    }
+
+    if (NULL != ring->mapping)
+    {
+        CloseHandle(ring->mapping);
+        ring->mapping = NULL;
+    }
+
+    if (NULL != ring->data_event)
+    {
+        CloseHandle(ring->data_event);
+        ring->data_event = NULL;
+    }
+
+    if (NULL != ring->space_event)
+    {
+        CloseHandle(ring->space_event);
+        ring->space_event = NULL;
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Publish the records written up to head and wake the consumer
+*   if it is waiting. The interlocked exchange orders the slot
+*   writes before the head update and the head update before the
+*   waiting flag is read.
+*
+*******************************************************************/
+static void publish(ring_t* ring, LONG64 head)
+{
+    InterlockedExchange64(&ring->header->head, head);
+
+    if (ReadAcquire(&ring->header->consumer_waiting))
+    {
+        SetEvent(ring->data_event);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Block until the consumer releases a slot. Without a consumer, or
+*   with one that stopped reading, a full ring would hold up the
+*   batch forever, so the wait ends once no slot has been released
+*   for RING_STALL_TIMEOUT_MS.
+*
+* \return
+*   Return true if a slot is free.
+*
+*******************************************************************/
+static bool wait_for_space(ring_t* ring, LONG64 head)
+{
+    LONG64 tail = ReadAcquire64(&ring->header->tail);
+    ULONGLONG progress = GetTickCount64();  // Time the tail last moved
+
+    publish(ring, head);
+
+    while (((uint64_t)(head - tail) >= ring->header->slot_count) && (GetTickCount64() - progress < RING_STALL_TIMEOUT_MS))
+    {
+        InterlockedExchange(&ring->header->producer_waiting, 1);
+
+        if ((uint64_t)(head - ReadAcquire64(&ring->header->tail)) >= ring->header->slot_count)
+        {
+            WaitForSingleObject(ring->space_event, RING_WAIT_MS);
+        }
+
+        InterlockedExchange(&ring->header->producer_waiting, 0);
+
+        if (ReadAcquire64(&ring->header->tail) != tail)
+        {
+            tail = ReadAcquire64(&ring->header->tail);
+            progress = GetTickCount64();
+        }
+    }
+
+    return ((uint64_t)(head - tail) < ring->header->slot_count);
+}
+
+/******************************************************************
+*
+* \details Convert a record into a ring slot.
+*
+*******************************************************************/
+static void write_slot(ring_record_t* slot, const nef_record_t* record)
+{
+    slot->latitude = record->gps.latitude;
+    slot->longitude = record->gps.longitude;
+    slot->altitude = record->gps.altitude;
+    slot->exposure_time = record->image.shutter_speed;
+    slot->fnumber = record->image.aperature;
+    slot->focal_length = record->image.focal_length;
+    slot->iso = record->image.iso;
+    slot->shutter_count = record->image.shutter_count;
+    slot->rating = record->xmp.present ? record->xmp.rating : XMP_RATING_NONE;
+    slot->gps_valid = record->gps.valid;
+    memcpy(slot->date_time_original, record->image.timestamp, sizeof(slot->date_time_original));
+    memcpy(slot->model, record->camera.model, sizeof(slot->model));
+    memcpy(slot->serial_number, record->camera.serial_number, sizeof(slot->serial_number));
+    memcpy(slot->lens, record->camera.lens, sizeof(slot->lens));
+    memcpy(slot->path, record->path, sizeof(slot->path));
+}
+
+/******************************************************************
+*
+* \details
+*   Producer thread. Moves queued records into the ring. Once the
+*   consumer has stalled, the remaining records are discarded so
+*   the batch can finish.
+*
+*******************************************************************/
+static DWORD WINAPI ring_producer_thread(LPVOID parameter)
+{
+    ring_t* ring = (ring_t*)parameter;
+    void* records[RING_WRITE_BATCH];
+    uint32_t count = 0;
+    uint32_t mask = ring->header->slot_count - 1;
+    LONG64 head = ring->header->head;
+
+    while ((count = queue_pop_batch(&ring->queue, records, RING_WRITE_BATCH)) > 0)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!ring->stalled && ((uint64_t)(head - ReadAcquire64(&ring->header->tail)) >= ring->header->slot_count) &&
+                !wait_for_space(ring, head))
+            {
+                fprintf(stderr, "Error: No ring slot was released within %u seconds. The remaining records are discarded.\n",
+                        RING_STALL_TIMEOUT_MS / 1000);
+                ring->stalled = true;
+            }
+
+            if (ring->stalled)
+            {
+                InterlockedIncrement(&ring->dropped);
+            }
+            else
+            {
+                write_slot(&ring->slots[head & mask], (nef_record_t*)records[i]);
+                head++;
+                InterlockedIncrement(&ring->written);
+            }
+        }
+
+        publish(ring, head);
+    }
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details Create the ring and start the producer thread.
+*
+* \param[out] ring      : Ring.
+* \param[in] name       : Name of the shared memory mapping.
+* \param[in] slot_count : Number of slots (power of two).
+*
+* \return
+*   Return true if the producer was started.
+*
+*******************************************************************/
+bool ring_producer_start(ring_t* ring, const char* name, uint32_t slot_count)
+{
+    bool success = false;
+
+    memset(ring, 0, sizeof(ring_t));
+
+    if ((slot_count == 0) || ((slot_count & (slot_count - 1)) != 0))
+    {
+        fprintf(stderr, "Error: Ring slot count must be a power of two.\n");
+    }
+    else if (open_objects(ring, name, true, slot_count))
+    {
+        success = queue_init(&ring->queue, RING_QUEUE_CAPACITY);
+
+        if (success)
+        {
+            ring->thread = CreateThread(NULL, 0, ring_producer_thread, ring, 0, NULL);
+
+            if (NULL == ring->thread)
+            {
+                queue_free(&ring->queue);
+                success = false;
+            }
+        }
+
+        if (!success)
+        {
+            close_objects(ring);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Queue a record for the ring. Called from the batch worker
+*   threads. The record must remain valid until the producer is
+*   stopped.
+*
+* \param[in] ring   : Ring.
+* \param[in] record : Parsed record.
+*
+* \return None
+*
+*******************************************************************/
+void ring_producer_submit(ring_t* ring, nef_record_t* record)
+{
+    if (record->valid)
+    {
+        queue_push(&ring->queue, record);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Write the remaining records, mark the ring closed and release
+*   the producer's view. The shared memory remains available until
+*   the consumer closes it. It is destroyed with the last handle, so
+*   if records are unread and no consumer has the ring open, the
+*   producer waits up to RING_STALL_TIMEOUT_MS for one to open it
+*   before reporting the records as lost.
+*
+* \param[in] ring : Ring.
+*
+* \return None
+*
+*******************************************************************/
+void ring_producer_stop(ring_t* ring)
+{
+    if (NULL != ring->thread)
+    {
+        queue_close(&ring->queue);
+        WaitForSingleObject(ring->thread, INFINITE);
+        CloseHandle(ring->thread);
+        ring->thread = NULL;
+        queue_free(&ring->queue);
+
+        InterlockedExchange(&ring->header->closed, 1);
+        SetEvent(ring->data_event);
+
+        ULONGLONG start = GetTickCount64();
+        LONG64 unread = ReadAcquire64(&ring->header->head) - ReadAcquire64(&ring->header->tail);
+
+        while ((unread > 0) && (0 == ReadAcquire(&ring->header->consumers)) && (GetTickCount64() - start < RING_STALL_TIMEOUT_MS))
+        {
+            Sleep(RING_WAIT_MS);
+            unread = ReadAcquire64(&ring->header->head) - ReadAcquire64(&ring->header->tail);
+        }
+
+        if ((unread > 0) && (0 == ReadAcquire(&ring->header->consumers)))
+        {
+            fprintf(stderr, "Error: No consumer opened the ring. %lld records were not read.\n", (long long)unread);
+        }
+
+        close_objects(ring);
+    }
+}
+
+/******************************************************************
+*
+* \details Open a ring created by a producer process.
+*
+* \param[out] ring : Ring.
+* \param[in] name  : Name of the shared memory mapping.
+*
+* \return
+*   Return true if the ring was opened.
+*
+*******************************************************************/
+bool ring_consumer_open(ring_t* ring, const char* name)
+{
+    bool success;
+
+    memset(ring, 0, sizeof(ring_t));
+    success = open_objects(ring, name, false, 0);
+
+    if (success)
+    {
+        // Keeps a producer that is stopping from reporting the records as lost
+        InterlockedIncrement(&ring->header->consumers);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Wait for records. The records are read in place and remain
+*   valid until released with ring_consumer_release.
+*
+* \param[in] ring   : Ring.
+* \param[out] count : Number of contiguous records available.
+*
+* \return
+*   Return the first available record, or NULL once the producer
+*   has stopped and every record has been read.
+*
+*******************************************************************/
+const ring_record_t* ring_consumer_peek(ring_t* ring, uint32_t* count)
+{
+    const ring_record_t* records = NULL;
+    ring_header_t* header = ring->header;
+    LONG64 tail = header->tail;
+    bool done = false;
+
+    *count = 0;
+
+    while ((NULL == records) && !done)
+    {
+        // Read closed before head so the last records are not missed
+        bool closed = ReadAcquire(&header->closed) != 0;
+        LONG64 head = ReadAcquire64(&header->head);
+
+        if (head != tail)
+        {
+            uint32_t index = (uint32_t)(tail & (header->slot_count - 1));
+            uint64_t available = (uint64_t)(head - tail);
+            *count = (uint32_t)min(available, (uint64_t)(header->slot_count - index));
+            records = &ring->slots[index];
+        }
+        else if (closed)
+        {
+            done = true;
+        }
+        else
+        {
+            InterlockedExchange(&header->consumer_waiting, 1);
+
+            if ((ReadAcquire64(&header->head) == tail) && !ReadAcquire(&header->closed))
+            {
+                WaitForSingleObject(ring->data_event, RING_WAIT_MS);
+            }
+
+            InterlockedExchange(&header->consumer_waiting, 0);
+        }
+    }
+
+    return records;
+}
+
+/******************************************************************
+*
+* \details Release records returned by ring_consumer_peek.
+*
+*******************************************************************/
+void ring_consumer_release(ring_t* ring, uint32_t count)
+{
+    InterlockedExchange64(&ring->header->tail, ring->header->tail + count);
+
+    if (ReadAcquire(&ring->header->producer_waiting))
+    {
+        SetEvent(ring->space_event);
+    }
+}
+
+/******************************************************************
+*
+* \details Close a ring opened with ring_consumer_open.
+*
+*******************************************************************/
+void ring_consumer_close(ring_t* ring)
+{
+    if (NULL != ring->header)
+    {
+        InterlockedDecrement(&ring->header->consumers);
+    }
+
+    close_objects(ring);
+}
@@ -0,0 +1,119 @@
+/**************************************************************//**
+*
+* \file ring.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Shared memory ring buffer of fixed layout records for a consumer
+*   process on the same host. The ring has a single producer and a
+*   single consumer.
+*
+*******************************************************************/
+
+#ifndef RING_H_
+#define RING_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "queue.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define RING_MAGIC              0x474E4952 // "RING"
+#define RING_VERSION            2
+#define RING_DEFAULT_SLOTS      4096
+#define RING_CACHE_LINE         64
+#define RING_QUEUE_CAPACITY     1024
+// Named events are the mapping name followed by these suffixes
+#define RING_DATA_EVENT_SUFFIX  "_data"
+#define RING_SPACE_EVENT_SUFFIX "_space"
+#define RING_MAX_NAME_LENGTH    128
+// Longest wait for the consumer to release a slot, or to open the
+// ring once the producer stops with records still unread
+#define RING_STALL_TIMEOUT_MS   30000
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Record as stored in a ring slot. Fields are ordered by size, and
+// the padding the compiler would add to align the record to its
+// doubles is explicit, so the layout has no hidden bytes.
+typedef struct
+{
+    double latitude;        // Valid if gps_valid is set
+    double longitude;
+    double altitude;
+    float exposure_time;
+    float fnumber;
+    float focal_length;
+    uint32_t iso;
+    uint32_t shutter_count;
+    int32_t rating;         // XMP_RATING_NONE if the file has no rating
+    uint8_t gps_valid;
+    uint8_t reserved[3];
+    char date_time_original[TIFF_DATE_TIME_LENGTH];
+    char model[TIFF_MAX_STRING_LENGTH];
+    char serial_number[TIFF_MAX_STRING_LENGTH];
+    char lens[TIFF_MAX_STRING_LENGTH];
+    char path[MAX_RECORD_PATH_LENGTH];
+    uint8_t padding[4];     // Rounds the record up to a multiple of 8 bytes
+} ring_record_t;
+
+// Consumers map the slots with this layout
+C_ASSERT(sizeof(ring_record_t) == 624);
+
+// Start of the shared memory. The producer and consumer positions are
+// kept on separate cache lines. Slots follow the header.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;            // sizeof(ring_record_t)
+    uint32_t slot_count;             // Power of two
+    volatile LONG closed;            // Producer has stopped
+    volatile LONG consumer_waiting;  // Consumer is waiting for the data event
+    volatile LONG producer_waiting;  // Producer is waiting for the space event
+    volatile LONG consumers;         // Consumers that opened the ring and have not closed it
+    uint8_t reserved[RING_CACHE_LINE - 8 * sizeof(uint32_t)];
+    volatile LONG64 head;            // Records written. Updated by the producer.
+    uint8_t head_padding[RING_CACHE_LINE - sizeof(LONG64)];
+    volatile LONG64 tail;            // Records read. Updated by the consumer.
+    uint8_t tail_padding[RING_CACHE_LINE - sizeof(LONG64)];
+} ring_header_t;
+
+typedef struct
+{
+    HANDLE mapping;
+    HANDLE data_event;      // Set by the producer when records are published
+    HANDLE space_event;     // Set by the consumer when slots are released
+    ring_header_t* header;
+    ring_record_t* slots;
+    // Producer only
+    queue_t queue;          // Records waiting to be written
+    HANDLE thread;          // Producer thread
+    volatile LONG written;  // Number of records written
+    volatile LONG dropped;  // Records discarded once the consumer stalled
+    bool stalled;           // No slot was released within RING_STALL_TIMEOUT_MS
+} ring_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool ring_producer_start(ring_t* ring, const char* name, uint32_t slot_count);
+void ring_producer_submit(ring_t* ring, nef_record_t* record);
+void ring_producer_stop(ring_t* ring);
+bool ring_consumer_open(ring_t* ring, const char* name);
+const ring_record_t* ring_consumer_peek(ring_t* ring, uint32_t* count);
+void ring_consumer_release(ring_t* ring, uint32_t count);
+void ring_consumer_close(ring_t* ring);
+
+#endif /* end ring.h */
@@ -0,0 +1,848 @@
+/**************************************************************//**
+*
+* \file sample.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Statistical sampling of an archive. A seeded random sample of
+*   the files is parsed instead of every file, and the requested
+*   fields are estimated for the whole archive with a 95%
+*   confidence interval.
+*
+*   Stratified samples split the files by directory or by month of
+*   last modification and sample each stratum in proportion to its
+*   size. The estimate combines the stratum means weighted by the
+*   stratum sizes:
+*
+*       y = sum(N_h * y_h) / N
+*       var(y) = sum((N_h / N)^2 * (1 - n_h / N_h) * s_h^2 / n_h)
+*
+*   A uniform sample is the single stratum case. Strata sampled
+*   too thinly for a variance use the pooled variance of the
+*   sample, and strata without values are left out of N.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include "sample.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SAMPLE_NAME_WIDTH       14
+#define SAMPLE_MONTH_LENGTH     8   // "YYYY-MM"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef enum
+{
+    SAMPLE_TYPE_TEXT = 0,   // char[], absent when empty
+    SAMPLE_TYPE_NAME,       // const char*, absent when NULL
+    SAMPLE_TYPE_UINT16,     // Absent when 0
+    SAMPLE_TYPE_UINT32,     // Absent when 0
+    SAMPLE_TYPE_FLOAT,      // Absent when 0
+    SAMPLE_TYPE_GPS,        // double, absent without a position
+    SAMPLE_TYPE_RATING,     // int, absent when XMP_RATING_NONE
+    SAMPLE_TYPE_BOOL        // Always present
+} sample_type_t;
+
+// Record field that can be estimated
+typedef struct
+{
+    const char* name;
+    sample_type_t type;
+    size_t offset;      // Within nef_record_t
+} sample_field_t;
+
+// Stratum of a file, sorted to group the strata
+typedef struct
+{
+    unsigned index;                     // Of the file
+    const char* key;                    // Directory, or NULL to use month
+    unsigned length;
+    char month[SAMPLE_MONTH_LENGTH];
+} sample_key_t;
+
+// Sums of the values of a stratum
+typedef struct
+{
+    unsigned count;
+    double sum;
+    double squares;
+} sample_sums_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static uint64_t sample_next(uint64_t* state);
+static unsigned sample_below(uint64_t* state, unsigned bound);
+static int sample_key_compare(const void* a, const void* b);
+static int sample_index_compare(const void* a, const void* b);
+static bool sample_same_stratum(const sample_key_t* a, const sample_key_t* b);
+static void sample_key(sample_strata_t strata, const char* path, unsigned index, sample_key_t* key);
+static bool sample_value(const nef_record_t* record, const sample_field_t* field, double* number, const char** text);
+static bool sample_evaluate(const sample_estimate_t* estimate, const nef_record_t* record, double* y);
+static void sample_print_estimate(const sampler_t* sampler, const sample_estimate_t* estimate, const nef_record_t* records, int width);
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Field names match the record file schema
+static const sample_field_t sample_fields[] = {
+    { "make",               SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, camera.make) },
+    { "model",              SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, camera.model) },
+    { "serial_number",      SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, camera.serial_number) },
+    { "lens",               SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, camera.lens) },
+    { "lens_data_version",  SAMPLE_TYPE_UINT16, offsetof(nef_record_t, camera.lens_info.data_version) },
+    { "z_lens_id",          SAMPLE_TYPE_UINT16, offsetof(nef_record_t, camera.lens_info.z_lens_id) },
+    { "date_time_original", SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, image.timestamp) },
+    { "shutter_count",      SAMPLE_TYPE_UINT32, offsetof(nef_record_t, image.shutter_count) },
+    { "iso",                SAMPLE_TYPE_UINT32, offsetof(nef_record_t, image.iso) },
+    { "exposure_time",      SAMPLE_TYPE_FLOAT,  offsetof(nef_record_t, image.shutter_speed) },
+    { "fnumber",            SAMPLE_TYPE_FLOAT,  offsetof(nef_record_t, image.aperature) },
+    { "focal_length",       SAMPLE_TYPE_FLOAT,  offsetof(nef_record_t, image.focal_length) },
+    { "gps",                SAMPLE_TYPE_BOOL,   offsetof(nef_record_t, gps.valid) },
+    { "latitude",           SAMPLE_TYPE_GPS,    offsetof(nef_record_t, gps.latitude) },
+    { "longitude",          SAMPLE_TYPE_GPS,    offsetof(nef_record_t, gps.longitude) },
+    { "altitude",           SAMPLE_TYPE_GPS,    offsetof(nef_record_t, gps.altitude) },
+    { "rating",             SAMPLE_TYPE_RATING, offsetof(nef_record_t, xmp.rating) },
+    { "quality",            SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, image.quality) },
+    { "white_balance",      SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, image.white_balance) },
+    { "focus_mode",         SAMPLE_TYPE_TEXT,   offsetof(nef_record_t, image.focus_mode) },
+    { "metering_mode",      SAMPLE_TYPE_NAME,   offsetof(nef_record_t, image.metering_mode) },
+    { "compression",        SAMPLE_TYPE_NAME,   offsetof(nef_record_t, image.compression) },
+    { "width",              SAMPLE_TYPE_UINT32, offsetof(nef_record_t, image.width) },
+    { "height",             SAMPLE_TYPE_UINT32, offsetof(nef_record_t, image.height) },
+};
+
+static const char* sample_strata_names[SAMPLE_STRATA_COUNT] = {
+    "none",
+    "directory",
+    "month",
+};
+
+// Longest operators first
+static const struct
+{
+    const char* text;
+    sample_op_t op;
+} sample_ops[] = {
+    { ">=", SAMPLE_OP_GREATER_EQUAL },
+    { "<=", SAMPLE_OP_LESS_EQUAL },
+    { "!=", SAMPLE_OP_NOT_EQUAL },
+    { "==", SAMPLE_OP_EQUAL },
+    { "=",  SAMPLE_OP_EQUAL },
+    { ">",  SAMPLE_OP_GREATER },
+    { "<",  SAMPLE_OP_LESS },
+};
+
+/******************************************************************
+*
+* \details Next value of the splitmix64 generator.
+*
+*******************************************************************/
+static uint64_t sample_next(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+/******************************************************************
+*
+* \details Uniform random number below bound, without modulo bias.
+*
+*******************************************************************/
+static unsigned sample_below(uint64_t* state, unsigned bound)
+{
+    uint64_t limit = UINT64_MAX - (UINT64_MAX % bound);
+    uint64_t value = sample_next(state);
+
+    while (value >= limit)
+    {
+        value = sample_next(state);
+    }
+
+    return (unsigned)(value % bound);
+}
+
+/******************************************************************
+*
+* \details Order files by stratum, then by position in the batch.
+*
+*******************************************************************/
+static int sample_key_compare(const void* a, const void* b)
+{
+    const sample_key_t* key_a = (const sample_key_t*)a;
+    const sample_key_t* key_b = (const sample_key_t*)b;
+    int order = 0;
+
+    if (NULL != key_a->key)
+    {
+        unsigned length = (key_a->length < key_b->length) ? key_a->length : key_b->length;
+
+        order = _strnicmp(key_a->key, key_b->key, length);
+        order = (order != 0) ? order : (int)key_a->length - (int)key_b->length;
+    }
+    else
+    {
+        order = strcmp(key_a->month, key_b->month);
+    }
+
+    return (order != 0) ? order : ((key_a->index < key_b->index) ? -1 : (key_a->index > key_b->index));
+}
+
+/******************************************************************
+*
+* \details Determine whether two files share a stratum.
+*
+*******************************************************************/
+static bool sample_same_stratum(const sample_key_t* a, const sample_key_t* b)
+{
+    sample_key_t key = *a;
+
+    key.index = b->index;
+
+    return (sample_key_compare(&key, b) == 0);
+}
+
+/******************************************************************
+*
+* \details Order file indexes.
+*
+*******************************************************************/
+static int sample_index_compare(const void* a, const void* b)
+{
+    unsigned index_a = *(const unsigned*)a;
+    unsigned index_b = *(const unsigned*)b;
+
+    return (index_a < index_b) ? -1 : (index_a > index_b);
+}
+
+/******************************************************************
+*
+* \details Determine the stratum of a file. Files whose last
+*   modification time cannot be read share an empty month.
+*
+*******************************************************************/
+static void sample_key(sample_strata_t strata, const char* path, unsigned index, sample_key_t* key)
+{
+    memset(key, 0, sizeof(sample_key_t));
+    key->index = index;
+
+    if (SAMPLE_STRATA_DIRECTORY == strata)
+    {
+        const char* backslash = strrchr(path, '\\');
+        const char* slash = strrchr(path, '/');
+        const char* separator = (backslash > slash) ? backslash : slash;
+
+        key->key = path;
+        key->length = (NULL != separator) ? (unsigned)(separator - path) : 0;
+    }
+    else if (SAMPLE_STRATA_MONTH == strata)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        SYSTEMTIME time;
+
+        if (GetFileAttributesExA(path, GetFileExInfoStandard, &attributes) &&
+            FileTimeToSystemTime(&attributes.ftLastWriteTime, &time))
+        {
+            sprintf_s(key->month, sizeof(key->month), "%04u-%02u", (unsigned)time.wYear, (unsigned)time.wMonth);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Read a field of a record.
+*
+* \param[in] record  : Parsed record.
+* \param[in] field   : Field to read.
+* \param[out] number : Value of a numeric field.
+* \param[out] text   : Value of a text field.
+*
+* \return
+*   Return true if the record has a value for the field.
+*
+*******************************************************************/
+static bool sample_value(const nef_record_t* record, const sample_field_t* field, double* number, const char** text)
+{
+    const uint8_t* base = (const uint8_t*)record + field->offset;
+    bool present = false;
+
+    *number = 0.0;
+    *text = NULL;
+
+    switch (field->type)
+    {
+        case SAMPLE_TYPE_TEXT:
+            *text = (const char*)base;
+            present = ((*text)[0] != '\0');
+            break;
+        case SAMPLE_TYPE_NAME:
+            *text = *(const char* const*)base;
+            present = (NULL != *text);
+            break;
+        case SAMPLE_TYPE_UINT16:
+            *number = *(const uint16_t*)base;
+            present = (*number != 0.0);
+            break;
+        case SAMPLE_TYPE_UINT32:
+            *number = *(const uint32_t*)base;
+            present = (*number != 0.0);
+            break;
+        case SAMPLE_TYPE_FLOAT:
+            *number = *(const float*)base;
+            present = (*number != 0.0);
+            break;
+        case SAMPLE_TYPE_GPS:
+            *number = *(const double*)base;
+            present = record->gps.valid;
+            break;
+        case SAMPLE_TYPE_RATING:
+            *number = *(const int*)base;
+            present = (*(const int*)base != XMP_RATING_NONE);
+            break;
+        case SAMPLE_TYPE_BOOL:
+            *number = *(const bool*)base ? 1.0 : 0.0;
+            present = true;
+            break;
+        default:
+            break;
+    }
+
+    return present;
+}
+
+/******************************************************************
+*
+* \details Evaluate an estimate for a parsed record. Proportions
+*   count every parsed file, and a file without a value does not
+*   match. Means count only the files with a value.
+*
+* \param[in] estimate : Quantity estimated.
+* \param[in] record   : Parsed record.
+* \param[out] y       : Value of the file (1 or 0 for a proportion).
+*
+* \return
+*   Return true if the file counts towards the estimate.
+*
+*******************************************************************/
+static bool sample_evaluate(const sample_estimate_t* estimate, const nef_record_t* record, double* y)
+{
+    const sample_field_t* field = &sample_fields[estimate->field];
+    double number = 0.0;
+    const char* text = NULL;
+    bool present = sample_value(record, field, &number, &text);
+    bool counted = true;
+
+    if (SAMPLE_OP_MEAN == estimate->op)
+    {
+        *y = number;
+        counted = present;
+    }
+    else
+    {
+        int order = 0;
+        bool match = false;
+
+        if (NULL != text)
+        {
+            order = strcmp(text, estimate->value);
+        }
+        else
+        {
+            order = (number < estimate->number) ? -1 : (number > estimate->number);
+        }
+
+        switch (estimate->op)
+        {
+            case SAMPLE_OP_EQUAL:         match = (order == 0); break;
+            case SAMPLE_OP_NOT_EQUAL:     match = (order != 0); break;
+            case SAMPLE_OP_LESS:          match = (order < 0);  break;
+            case SAMPLE_OP_LESS_EQUAL:    match = (order <= 0); break;
+            case SAMPLE_OP_GREATER:       match = (order > 0);  break;
+            case SAMPLE_OP_GREATER_EQUAL: match = (order >= 0); break;
+            default:                                            break;
+        }
+
+        *y = (present && match) ? 1.0 : 0.0;
+    }
+
+    return counted;
+}
+
+/******************************************************************
+*
+* \details Display an estimate with its 95% confidence interval.
+*
+*******************************************************************/
+static void sample_print_estimate(const sampler_t* sampler, const sample_estimate_t* estimate, const nef_record_t* records, int width)
+{
+    sample_result_t result;
+
+    if (!sample_estimate(sampler, estimate, records, &result))
+    {
+        fprintf(stderr, "Error: Insufficient memory to estimate %s.\n", estimate->text);
+    }
+    else if (result.count == 0)
+    {
+        printf("%-*s| no values\n", width, estimate->text);
+    }
+    else
+    {
+        if (SAMPLE_OP_MEAN == estimate->op)
+        {
+            printf("%-*s| %.4g +/- %.4g (%.4g to %.4g), %u files with a value", width, estimate->text,
+                   result.value, result.margin, result.value - result.margin, result.value + result.margin, result.count);
+        }
+        else
+        {
+            double low = (result.value - result.margin > 0.0) ? result.value - result.margin : 0.0;
+            double high = (result.value + result.margin < 1.0) ? result.value + result.margin : 1.0;
+
+            printf("%-*s| %.1f%% +/- %.1f%% (%.1f%% to %.1f%%), about %.0f of %u files", width, estimate->text,
+                   100.0 * result.value, 100.0 * result.margin, 100.0 * low, 100.0 * high,
+                   result.value * result.population, result.population);
+        }
+
+        // The estimate only covers strata with a sampled value
+        if (result.population < sampler->population)
+        {
+            printf(" (%u of %u files not covered)", sampler->population - result.population, sampler->population);
+        }
+
+        printf("\n");
+    }
+}
+
+/******************************************************************
+*
+* \details Parse a sample size, either a number of files or a
+*   percentage of the files ("5%").
+*
+* \return
+*   Return true if the size is valid.
+*
+*******************************************************************/
+bool sample_parse_size(const char* text, sampler_t* sampler)
+{
+    bool valid = false;
+    char* end = NULL;
+    double number = strtod(text, &end);
+
+    if ((end != text) && (strcmp(end, "%") == 0))
+    {
+        valid = (number > 0.0) && (number <= 100.0);
+        sampler->percent = number;
+        sampler->size = 0;
+    }
+    else if ((end != text) && (*end == '\0'))
+    {
+        valid = (number >= 1.0) && (number <= UINT32_MAX) && (number == floor(number));
+        sampler->size = valid ? (unsigned)number : 0;
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details Parse the name of a stratification.
+*
+* \return
+*   Return true if the name is known.
+*
+*******************************************************************/
+bool sample_parse_strata(const char* text, sample_strata_t* strata)
+{
+    bool valid = false;
+
+    for (unsigned i = 0; (i < SAMPLE_STRATA_COUNT) && !valid; ++i)
+    {
+        if (_stricmp(text, sample_strata_names[i]) == 0)
+        {
+            *strata = (sample_strata_t)i;
+            valid = true;
+        }
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details Parse an estimate, either a numeric field whose mean is
+*   estimated ("iso") or a comparison whose proportion is
+*   estimated ("lens_data_version>=0201", "model=NIKON D850").
+*   Text fields are compared as strings, so dates compare in
+*   order.
+*
+* \param[in] text      : Estimate as given on the command line.
+* \param[out] estimate : Parsed estimate, referring to text.
+*
+* \return
+*   Return true if the estimate is valid.
+*
+*******************************************************************/
+bool sample_parse_estimate(const char* text, sample_estimate_t* estimate)
+{
+    bool valid = false;
+    size_t length = strcspn(text, "=!<>");
+
+    memset(estimate, 0, sizeof(sample_estimate_t));
+    estimate->text = text;
+
+    for (unsigned i = 0; (i < sizeof(sample_fields) / sizeof(sample_fields[0])) && !valid; ++i)
+    {
+        if ((strlen(sample_fields[i].name) == length) && (strncmp(text, sample_fields[i].name, length) == 0))
+        {
+            estimate->field = i;
+            valid = true;
+        }
+    }
+
+    if (valid)
+    {
+        const sample_field_t* field = &sample_fields[estimate->field];
+        bool numeric = (SAMPLE_TYPE_TEXT != field->type) && (SAMPLE_TYPE_NAME != field->type);
+        const char* value = NULL;
+
+        if (text[length] == '\0')
+        {
+            // Means exist only for numbers
+            estimate->op = SAMPLE_OP_MEAN;
+            valid = numeric;
+        }
+        else
+        {
+            for (unsigned i = 0; (i < sizeof(sample_ops) / sizeof(sample_ops[0])) && (NULL == value); ++i)
+            {
+                size_t op_length = strlen(sample_ops[i].text);
+
+                if (strncmp(&text[length], sample_ops[i].text, op_length) == 0)
+                {
+                    estimate->op = sample_ops[i].op;
+                    value = &text[length + op_length];
+                }
+            }
+
+            valid = (NULL != value) && (value[0] != '\0') && (strlen(value) < SAMPLE_MAX_VALUE_LENGTH);
+        }
+
+        if (valid && (NULL != value))
+        {
+            strncpy_s(estimate->value, sizeof(estimate->value), value, sizeof(estimate->value) - 1);
+
+            if (numeric)
+            {
+                char* end = NULL;
+
+                // Leading zeros allowed, so LensData versions read as written ("0201")
+                estimate->number = strtod(value, &end);
+                valid = (end != value) && (*end == '\0');
+            }
+        }
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details Select a random sample of the files. The sampled files
+*   are moved to the front of the list, grouped by stratum and in
+*   their original order within a stratum, followed by the files
+*   not sampled.
+*
+* \param[in,out] sampler : Sample size, strata and seed. Receives
+*                          the strata of the sample.
+* \param[in,out] files   : Files of the batch, reordered.
+* \param[in] count       : Number of files.
+* \param[out] selected   : Number of files sampled.
+*
+* \return
+*   Return true if the sample was selected.
+*
+*******************************************************************/
+bool sample_select(sampler_t* sampler, char** files, unsigned count, unsigned* selected)
+{
+    bool success = false;
+    sample_key_t* keys = malloc(((size_t)count + 1) * sizeof(sample_key_t));
+    unsigned* chosen = malloc(((size_t)count + 1) * sizeof(unsigned));
+    char** order = malloc(((size_t)count + 1) * sizeof(char*));
+    bool* sampled = calloc((size_t)count + 1, sizeof(bool));
+    uint64_t state = sampler->seed;
+    unsigned size = sampler->size;
+
+    sample_free(sampler);
+    sampler->population = count;
+    *selected = 0;
+
+    if (0 == size)
+    {
+        size = (unsigned)ceil(count * sampler->percent / 100.0);
+    }
+
+    size = (size < count) ? size : count;
+
+    if ((NULL != keys) && (NULL != chosen) && (NULL != order) && (NULL != sampled))
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            sample_key(sampler->strata, files[i], i, &keys[i]);
+        }
+
+        qsort(keys, count, sizeof(sample_key_t), sample_key_compare);
+
+        // A stratum per key
+        unsigned strata = (count > 0) ? 1 : 0;
+
+        for (unsigned i = 1; i < count; ++i)
+        {
+            strata += sample_same_stratum(&keys[i - 1], &keys[i]) ? 0 : 1;
+        }
+
+        sampler->strata_list = calloc((strata > 0) ? strata : 1, sizeof(sample_stratum_t));
+        success = (NULL != sampler->strata_list);
+    }
+
+    if (success)
+    {
+        unsigned start = 0;
+        unsigned cumulative = 0;
+
+        while (start < count)
+        {
+            sample_stratum_t* stratum = &sampler->strata_list[sampler->stratum_count++];
+            unsigned end = start + 1;
+
+            while ((end < count) && sample_same_stratum(&keys[end - 1], &keys[end]))
+            {
+                end++;
+            }
+
+            // Proportional allocation, rounded cumulatively so the strata add up to the sample size
+            unsigned before = (unsigned)(((uint64_t)size * cumulative + count / 2) / count);
+
+            cumulative += end - start;
+            stratum->population = end - start;
+            stratum->sampled = (unsigned)(((uint64_t)size * cumulative + count / 2) / count) - before;
+            stratum->first = *selected;
+
+            // Partial Fisher-Yates shuffle of the stratum
+            for (unsigned i = 0; i < end - start; ++i)
+            {
+                chosen[i] = keys[start + i].index;
+            }
+
+            for (unsigned i = 0; i < stratum->sampled; ++i)
+            {
+                unsigned j = i + sample_below(&state, stratum->population - i);
+                unsigned swap = chosen[i];
+
+                chosen[i] = chosen[j];
+                chosen[j] = swap;
+            }
+
+            qsort(chosen, stratum->sampled, sizeof(unsigned), sample_index_compare);
+
+            for (unsigned i = 0; i < stratum->sampled; ++i)
+            {
+                order[(*selected)++] = files[chosen[i]];
+                sampled[chosen[i]] = true;
+            }
+
+            start = end;
+        }
+
+        // Files not sampled follow, in their original order
+        unsigned next = *selected;
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (!sampled[i])
+            {
+                order[next++] = files[i];
+            }
+        }
+
+        memcpy(files, order, count * sizeof(char*));
+        sampler->sampled = *selected;
+    }
+
+    free(keys);
+    free(chosen);
+    free(order);
+    free(sampled);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Estimate a quantity for the archive from the sample.
+*
+* \param[in] sampler  : Sample selected by sample_select.
+* \param[in] estimate : Quantity estimated.
+* \param[in] records  : Records of the files, in the order of
+*                       sample_select.
+* \param[out] result  : Estimate and the half width of its 95%
+*                       confidence interval. A count of 0 means no
+*                       sampled file had a value. Strata without a
+*                       sampled value are left out of the population
+*                       the estimate covers.
+*
+* \return
+*   Return true unless memory ran out.
+*
+*******************************************************************/
+bool sample_estimate(const sampler_t* sampler, const sample_estimate_t* estimate, const nef_record_t* records, sample_result_t* result)
+{
+    sample_sums_t* sums = calloc((sampler->stratum_count > 0) ? sampler->stratum_count : 1, sizeof(sample_sums_t));
+    sample_sums_t pooled = { 0 };
+    double population = 0.0;
+
+    memset(result, 0, sizeof(sample_result_t));
+
+    if (NULL == sums)
+    {
+        return false;
+    }
+
+    for (unsigned h = 0; h < sampler->stratum_count; ++h)
+    {
+        const sample_stratum_t* stratum = &sampler->strata_list[h];
+
+        for (unsigned i = stratum->first; i < stratum->first + stratum->sampled; ++i)
+        {
+            double y = 0.0;
+
+            if (records[i].valid && sample_evaluate(estimate, &records[i], &y))
+            {
+                sums[h].count++;
+                sums[h].sum += y;
+                sums[h].squares += y * y;
+            }
+        }
+
+        pooled.count += sums[h].count;
+        pooled.sum += sums[h].sum;
+        pooled.squares += sums[h].squares;
+        population += (sums[h].count > 0) ? stratum->population : 0;
+    }
+
+    if (pooled.count > 0)
+    {
+        double pooled_variance = (pooled.count > 1) ?
+            (pooled.squares - pooled.sum * pooled.sum / pooled.count) / (pooled.count - 1) : 0.0;
+        double variance = 0.0;
+
+        for (unsigned h = 0; h < sampler->stratum_count; ++h)
+        {
+            if (sums[h].count > 0)
+            {
+                const sample_stratum_t* stratum = &sampler->strata_list[h];
+                double weight = stratum->population / population;
+                double mean = sums[h].sum / sums[h].count;
+                double s2 = (sums[h].count >= SAMPLE_MIN_PER_STRATUM) ?
+                    (sums[h].squares - sums[h].sum * mean) / (sums[h].count - 1) : pooled_variance;
+                double unsampled = 1.0 - (double)stratum->sampled / stratum->population;
+
+                result->value += weight * mean;
+                variance += weight * weight * unsampled * ((s2 > 0.0) ? s2 : 0.0) / sums[h].count;
+            }
+        }
+
+        result->margin = SAMPLE_Z_95 * sqrt(variance);
+        result->count = pooled.count;
+        result->population = (unsigned)population;
+    }
+
+    free(sums);
+
+    return true;
+}
+
+/******************************************************************
+*
+* \details Display the sample and its estimates.
+*
+* \param[in] sampler : Sample selected by sample_select.
+* \param[in] records : Records of the files, in the order of
+*                      sample_select.
+*
+*******************************************************************/
+void sample_report(const sampler_t* sampler, const nef_record_t* records)
+{
+    int width = SAMPLE_NAME_WIDTH;
+    unsigned parsed = 0;
+
+    for (unsigned i = 0; i < sampler->sampled; ++i)
+    {
+        parsed += records[i].valid ? 1 : 0;
+    }
+
+    for (unsigned i = 0; i < sampler->estimate_count; ++i)
+    {
+        int length = (int)strlen(sampler->estimates[i].text) + 1;
+        width = (length > width) ? length : width;
+    }
+
+    printf("%-*s| %u files\n", width, "Population", sampler->population);
+
+    if (SAMPLE_STRATA_NONE != sampler->strata)
+    {
+        printf("%-*s| %u by %s\n", width, "Strata", sampler->stratum_count, sample_strata_name(sampler->strata));
+    }
+
+    printf("%-*s| %u files, seed %llu\n", width, "Sample", sampler->sampled, (unsigned long long)sampler->seed);
+    printf("%-*s| %u\n", width, "Parsed", parsed);
+
+    if (sampler->estimate_count > 0)
+    {
+        printf("\nEstimates (95%% confidence)\n");
+
+        for (unsigned i = 0; i < sampler->estimate_count; ++i)
+        {
+            sample_print_estimate(sampler, &sampler->estimates[i], records, width);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Release the strata of a sample.
+*
+*******************************************************************/
+void sample_free(sampler_t* sampler)
+{
+    free(sampler->strata_list);
+    sampler->strata_list = NULL;
+    sampler->stratum_count = 0;
+    sampler->sampled = 0;
+}
+
+/******************************************************************
+*
+* \details Name of a stratification.
+*
+*******************************************************************/
+const char* sample_strata_name(sample_strata_t strata)
+{
+    return (strata < SAMPLE_STRATA_COUNT) ? sample_strata_names[strata] : "unknown";
+}
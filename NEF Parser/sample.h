@@ -0,0 +1,109 @@
+/**************************************************************//**
+*
+* \file sample.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Random sampling of the files of a batch, and estimates with
+*   confidence intervals of the archive the sample was drawn from.
+*
+*******************************************************************/
+
+#ifndef SAMPLE_H_
+#define SAMPLE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SAMPLE_MAX_ESTIMATES    8
+#define SAMPLE_MAX_VALUE_LENGTH 64
+#define SAMPLE_MIN_PER_STRATUM  2       // Smallest sample of a stratum with a variance estimate
+#define SAMPLE_Z_95             1.96    // Normal quantile of a 95% confidence interval
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef enum
+{
+    SAMPLE_STRATA_NONE = 0,     // Uniform sample of all files
+    SAMPLE_STRATA_DIRECTORY,    // Proportional sample of each directory
+    SAMPLE_STRATA_MONTH,        // Proportional sample of each month of last modification
+    SAMPLE_STRATA_COUNT
+} sample_strata_t;
+
+typedef enum
+{
+    SAMPLE_OP_MEAN = 0,     // Mean of a numeric field
+    SAMPLE_OP_EQUAL,        // Proportion of files matching the value
+    SAMPLE_OP_NOT_EQUAL,
+    SAMPLE_OP_LESS,
+    SAMPLE_OP_LESS_EQUAL,
+    SAMPLE_OP_GREATER,
+    SAMPLE_OP_GREATER_EQUAL
+} sample_op_t;
+
+// Quantity estimated from the sample, e.g. "iso" or "lens_data_version>=0201"
+typedef struct
+{
+    const char* text;   // As given on the command line
+    unsigned field;     // Index of the field
+    sample_op_t op;
+    char value[SAMPLE_MAX_VALUE_LENGTH];
+    double number;      // Value of a numeric field
+} sample_estimate_t;
+
+// Estimate of a quantity for the archive
+typedef struct
+{
+    double value;       // Mean, or proportion of the files matching
+    double margin;      // Half width of the 95% confidence interval
+    unsigned count;     // Sampled files with a value (0 = no estimate)
+    unsigned population; // Files of the strata with a sampled value, which the estimate covers
+} sample_result_t;
+
+// Files sharing a directory or month
+typedef struct
+{
+    unsigned first;     // Index of the first sampled file
+    unsigned population;
+    unsigned sampled;
+} sample_stratum_t;
+
+typedef struct
+{
+    unsigned size;              // Files sampled (0 selects percent)
+    double percent;             // Of the files, when size is 0
+    sample_strata_t strata;
+    uint64_t seed;              // Same seed and files select the same sample
+    sample_estimate_t estimates[SAMPLE_MAX_ESTIMATES];
+    unsigned estimate_count;
+    sample_stratum_t* strata_list;  // Filled by sample_select
+    unsigned stratum_count;
+    unsigned population;
+    unsigned sampled;
+} sampler_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool sample_parse_size(const char* text, sampler_t* sampler);
+bool sample_parse_strata(const char* text, sample_strata_t* strata);
+bool sample_parse_estimate(const char* text, sample_estimate_t* estimate);
+bool sample_select(sampler_t* sampler, char** files, unsigned count, unsigned* selected);
+bool sample_estimate(const sampler_t* sampler, const sample_estimate_t* estimate, const nef_record_t* records, sample_result_t* result);
+void sample_report(const sampler_t* sampler, const nef_record_t* records);
+void sample_free(sampler_t* sampler);
+const char* sample_strata_name(sample_strata_t strata);
+
+#endif /* end sample.h */
@@ -0,0 +1,614 @@
+/**************************************************************//**
+*
+* \file scrub.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Bit rot scrub of archived image files. Each file read by the
+*   parser is fingerprinted with SHA-256 and compared against the
+*   catalog. Files new to the catalog are enrolled, files that no
+*   longer match are reported with a NEF_ERROR_FINGERPRINT error,
+*   and the parse itself checks the structure of the file.
+*
+*   The catalog is a text file, saved atomically at most every
+*   SCRUB_CHECKPOINT_MS and at the end of the run:
+*
+*       # NEF Parser scrub catalog
+*       range <file | raw>
+*       pass <number>
+*       <SHA-256 hex> <bytes> <pass> <path>
+*
+*   Files checked without a fingerprint, because they could not
+*   be read, have "-" in place of the SHA-256 until they are.
+*   Each file records the pass that last checked it, so a scrub
+*   that is interrupted resumes with the files not yet checked in
+*   the current pass. Once every file was checked, the next run
+*   starts a new pass.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scrub.h"
+#include "error.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SCRUB_CATALOG_HEADER    "# NEF Parser scrub catalog"
+#define SCRUB_TEMP_SUFFIX       ".tmp"
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static int scrub_compare(const void* a, const void* b);
+static scrub_entry_t* scrub_find(const scrubber_t* scrubber, const char* path);
+static int scrub_nibble(char c);
+static bool scrub_parse_entry(char* line, scrub_entry_t* entry);
+static bool scrub_load(scrubber_t* scrubber);
+static bool scrub_save(scrubber_t* scrubber);
+static bool scrub_digest(scrubber_t* scrubber, const uint8_t* data, uint32_t size, uint8_t* digest);
+static void scrub_free(scrubber_t* scrubber);
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static const char* scrub_range_names[SCRUB_RANGE_COUNT] = {
+    "file",
+    "raw",
+};
+
+/******************************************************************
+*
+* \details Order catalog entries by path.
+*
+*******************************************************************/
+static int scrub_compare(const void* a, const void* b)
+{
+    return _stricmp(((const scrub_entry_t*)a)->path, ((const scrub_entry_t*)b)->path);
+}
+
+/******************************************************************
+*
+* \details Catalog entry of a file (NULL if not listed).
+*
+*******************************************************************/
+static scrub_entry_t* scrub_find(const scrubber_t* scrubber, const char* path)
+{
+    scrub_entry_t key;
+
+    key.path = (char*)path;
+
+    return (scrubber->count > 0) ? bsearch(&key, scrubber->entries, scrubber->count, sizeof(scrub_entry_t), scrub_compare) : NULL;
+}
+
+/******************************************************************
+*
+* \details Value of a hexadecimal digit (-1 if not a digit).
+*
+*******************************************************************/
+static int scrub_nibble(char c)
+{
+    int value = -1;
+
+    if ((c >= '0') && (c <= '9'))
+    {
+        value = c - '0';
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+        value = c - 'a' + 10;
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+        value = c - 'A' + 10;
+    }
+
+    return value;
+}
+
+/******************************************************************
+*
+* \details Parse a catalog line "<SHA-256 hex> <bytes> <pass> <path>".
+*
+* \param[in,out] line : Line, without the line break.
+* \param[out] entry   : Entry. The path points into the line.
+*
+* \return
+*   Return true if the line holds an entry.
+*
+*******************************************************************/
+static bool scrub_parse_entry(char* line, scrub_entry_t* entry)
+{
+    bool valid = false;
+    char* cursor = NULL;
+
+    memset(entry, 0, sizeof(scrub_entry_t));
+    entry->fingerprinted = (line[0] != '-');
+
+    if (entry->fingerprinted)
+    {
+        valid = (strlen(line) > SCRUB_DIGEST_SIZE * 2) && (line[SCRUB_DIGEST_SIZE * 2] == ' ');
+        cursor = &line[SCRUB_DIGEST_SIZE * 2];
+    }
+    else
+    {
+        valid = (line[1] == ' ');
+        cursor = &line[1];
+    }
+
+    for (unsigned i = 0; (i < SCRUB_DIGEST_SIZE) && valid && entry->fingerprinted; ++i)
+    {
+        int high = scrub_nibble(line[i * 2]);
+        int low = scrub_nibble(line[i * 2 + 1]);
+
+        valid = (high >= 0) && (low >= 0);
+        entry->digest[i] = (uint8_t)((high << 4) | low);
+    }
+
+    if (valid)
+    {
+        entry->bytes = strtoull(cursor, &cursor, 10);
+        valid = (*cursor == ' ');
+    }
+
+    if (valid)
+    {
+        entry->pass = strtoul(cursor, &cursor, 10);
+        valid = (entry->pass > 0) && (*cursor == ' ') && (cursor[1] != '\0');
+        entry->path = cursor + 1;
+    }
+
+    return valid;
+}
+
+/******************************************************************
+*
+* \details
+*   Read the catalog. A missing catalog starts the first pass with
+*   no files.
+*
+* \param[in,out] scrubber : Scrubber.
+*
+* \return
+*   Return true if the catalog was read.
+*
+*******************************************************************/
+static bool scrub_load(scrubber_t* scrubber)
+{
+    bool success = true;
+    FILE* file = NULL;
+    unsigned capacity = 0;
+
+    scrubber->pass = 1;
+
+    if (fopen_s(&file, scrubber->catalog, "r") == 0)
+    {
+        char* line = malloc(SCRUB_MAX_LINE);
+        unsigned number = 0;
+
+        success = (NULL != line);
+
+        while (success && (NULL != fgets(line, SCRUB_MAX_LINE, file)))
+        {
+            scrub_entry_t entry;
+
+            line[strcspn(line, "\r\n")] = '\0';
+            number++;
+
+            if ((line[0] == '\0') || (line[0] == '#'))
+            {
+                // Comment
+            }
+            else if (strncmp(line, "range ", 6) == 0)
+            {
+                // Fingerprints of another range cannot be compared
+                success = (strcmp(&line[6], scrub_range_names[scrubber->range]) == 0);
+
+                if (!success)
+                {
+                    fprintf(stderr, "Error: Catalog %s holds %s fingerprints.\n", scrubber->catalog, &line[6]);
+                }
+            }
+            else if (strncmp(line, "pass ", 5) == 0)
+            {
+                scrubber->pass = strtoul(&line[5], NULL, 10);
+                scrubber->pass = (scrubber->pass > 0) ? scrubber->pass : 1;
+            }
+            else if (!scrub_parse_entry(line, &entry))
+            {
+                fprintf(stderr, "Error: Invalid entry on line %u of catalog %s.\n", number, scrubber->catalog);
+                success = false;
+            }
+            else
+            {
+                if (scrubber->count == capacity)
+                {
+                    unsigned grown_capacity = (capacity > 0) ? capacity * 2 : 256;
+                    scrub_entry_t* grown = realloc(scrubber->entries, grown_capacity * sizeof(scrub_entry_t));
+
+                    if (NULL != grown)
+                    {
+                        scrubber->entries = grown;
+                        capacity = grown_capacity;
+                    }
+                }
+
+                entry.path = (scrubber->count < capacity) ? _strdup(entry.path) : NULL;
+
+                if (NULL != entry.path)
+                {
+                    scrubber->entries[scrubber->count++] = entry;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: Insufficient memory to read catalog %s.\n", scrubber->catalog);
+                    success = false;
+                }
+            }
+        }
+
+        free(line);
+        fclose(file);
+
+        if (scrubber->count > 0)
+        {
+            qsort(scrubber->entries, scrubber->count, sizeof(scrub_entry_t), scrub_compare);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Save the catalog. It is written beside the catalog and moved
+*   over it, so an interrupted save keeps the previous catalog.
+*   The caller holds the lock or is the only thread.
+*
+* \param[in,out] scrubber : Scrubber.
+*
+* \return
+*   Return true if the catalog was saved.
+*
+*******************************************************************/
+static bool scrub_save(scrubber_t* scrubber)
+{
+    bool success = false;
+    size_t size = strlen(scrubber->catalog) + sizeof(SCRUB_TEMP_SUFFIX);
+    char* temp = malloc(size);
+    FILE* file = NULL;
+
+    if ((NULL != temp) && (sprintf_s(temp, size, "%s" SCRUB_TEMP_SUFFIX, scrubber->catalog) > 0) &&
+        (fopen_s(&file, temp, "w") == 0))
+    {
+        success = (fprintf(file, SCRUB_CATALOG_HEADER "\nrange %s\npass %u\n", scrub_range_names[scrubber->range], scrubber->pass) > 0);
+
+        // Files never checked are left out
+        for (unsigned i = 0; (i < scrubber->count) && success; ++i)
+        {
+            const scrub_entry_t* entry = &scrubber->entries[i];
+
+            if (entry->pass > 0)
+            {
+                for (unsigned j = 0; (j < SCRUB_DIGEST_SIZE) && entry->fingerprinted; ++j)
+                {
+                    fprintf(file, "%02x", entry->digest[j]);
+                }
+
+                fprintf(file, "%s", entry->fingerprinted ? "" : "-");
+
+                success = (fprintf(file, " %llu %u %s\n", (unsigned long long)entry->bytes, entry->pass, entry->path) > 0);
+            }
+        }
+
+        success = (fclose(file) == 0) && success &&
+                  MoveFileExA(temp, scrubber->catalog, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    }
+
+    scrubber->saved = GetTickCount64();
+    free(temp);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details SHA-256 of a range of bytes.
+*
+*******************************************************************/
+static bool scrub_digest(scrubber_t* scrubber, const uint8_t* data, uint32_t size, uint8_t* digest)
+{
+    bool success = false;
+    BCRYPT_HASH_HANDLE hash = NULL;
+
+    if (BCRYPT_SUCCESS(BCryptCreateHash(scrubber->algorithm, &hash, NULL, 0, NULL, 0, 0)))
+    {
+        success = BCRYPT_SUCCESS(BCryptHashData(hash, (PUCHAR)data, size, 0)) &&
+                  BCRYPT_SUCCESS(BCryptFinishHash(hash, digest, SCRUB_DIGEST_SIZE, 0));
+        BCryptDestroyHash(hash);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Prepare a scrub against a catalog.
+*
+* \param[out] scrubber : Scrubber.
+* \param[in] catalog   : Catalog file. Created by the first scrub.
+* \param[in] range     : Bytes fingerprinted.
+*
+* \return
+*   Return true if the scrub may start.
+*
+*******************************************************************/
+bool scrub_open(scrubber_t* scrubber, const char* catalog, scrub_range_t range)
+{
+    bool success = false;
+
+    memset(scrubber, 0, sizeof(scrubber_t));
+    scrubber->catalog = catalog;
+    scrubber->range = range;
+    InitializeSRWLock(&scrubber->lock);
+    scrubber->saved = GetTickCount64();
+
+    if (BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&scrubber->algorithm, BCRYPT_SHA256_ALGORITHM, NULL, 0)))
+    {
+        success = scrub_load(scrubber);
+    }
+
+    // The catalog is left as it was
+    if (!success)
+    {
+        scrub_free(scrubber);
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   List the files of a run in the catalog and move those not yet
+*   checked in the current pass to the front. Once every file was
+*   checked, a new pass starts with all of them.
+*
+* \param[in,out] scrubber : Scrubber.
+* \param[in,out] files    : Files of the run. Reordered in place.
+* \param[in] count        : Number of files.
+* \param[out] pending     : Files to check, at the front of files.
+*
+* \return
+*   Return true unless memory ran out.
+*
+*******************************************************************/
+bool scrub_pending(scrubber_t* scrubber, char** files, unsigned count, unsigned* pending)
+{
+    bool success = false;
+    scrub_entry_t* grown = realloc(scrubber->entries, ((size_t)scrubber->count + count + 1) * sizeof(scrub_entry_t));
+    char** order = malloc(((size_t)count + 1) * sizeof(char*));
+    unsigned added = 0;
+    unsigned next = 0;
+
+    *pending = 0;
+
+    if ((NULL != grown) && (NULL != order))
+    {
+        scrubber->entries = grown;
+        success = true;
+
+        // Files new to the catalog are listed without a fingerprint
+        for (unsigned i = 0; (i < count) && success; ++i)
+        {
+            if (NULL == scrub_find(scrubber, files[i]))
+            {
+                scrub_entry_t* entry = &scrubber->entries[scrubber->count + added];
+
+                memset(entry, 0, sizeof(scrub_entry_t));
+                entry->path = _strdup(files[i]);
+                success = (NULL != entry->path);
+                added += success ? 1 : 0;
+            }
+        }
+
+        scrubber->count += added;
+        qsort(scrubber->entries, scrubber->count, sizeof(scrub_entry_t), scrub_compare);
+    }
+
+    if (success)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            *pending += (scrub_find(scrubber, files[i])->pass != scrubber->pass) ? 1 : 0;
+        }
+
+        if ((*pending == 0) && (count > 0))
+        {
+            scrubber->pass++;
+            *pending = count;
+        }
+
+        // Pending files first, each group in its original order
+        for (unsigned skip = 0; skip < 2; ++skip)
+        {
+            for (unsigned i = 0; i < count; ++i)
+            {
+                if ((scrub_find(scrubber, files[i])->pass == scrubber->pass) == (skip == 1))
+                {
+                    order[next++] = files[i];
+                }
+            }
+        }
+
+        memcpy(files, order, count * sizeof(char*));
+        scrubber->skipped = count - *pending;
+    }
+
+    free(order);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Fingerprint a whole file once it is read. The parser decrypts
+*   Makernote fields in place, so this comes before the parse.
+*
+* \param[in,out] scrubber : Scrubber.
+* \param[in] data         : Bytes read.
+* \param[in] size         : Number of bytes read.
+* \param[out] fingerprint : Fingerprint of the file.
+*
+* \return None
+*
+*******************************************************************/
+void scrub_read(scrubber_t* scrubber, const uint8_t* data, uint32_t size, scrub_fingerprint_t* fingerprint)
+{
+    memset(fingerprint, 0, sizeof(scrub_fingerprint_t));
+    fingerprint->read = true;
+
+    if (SCRUB_RANGE_FILE == scrubber->range)
+    {
+        fingerprint->bytes = size;
+        fingerprint->taken = scrub_digest(scrubber, data, size, fingerprint->digest);
+    }
+}
+
+/******************************************************************
+*
+* \details
+*   Check a file against its fingerprint once it is parsed, while
+*   its bytes are still in memory. Raw image data is located by the
+*   parse, and not changed by it, so it is fingerprinted here.
+*   Files that cannot be fingerprinted are counted as unreadable
+*   and still checked off for the pass, so the pass can end.
+*
+* \param[in,out] scrubber    : Scrubber.
+* \param[in] path            : File.
+* \param[in,out] record      : Record of the file. Receives the errors.
+* \param[in] data            : Bytes read (NULL if the file was not read).
+* \param[in] size            : Number of bytes read.
+* \param[in,out] fingerprint : Fingerprint from scrub_read, or cleared
+*                              if the file was not read.
+*
+* \return None
+*
+*******************************************************************/
+void scrub_verify(scrubber_t* scrubber, const char* path, nef_record_t* record, const uint8_t* data, uint32_t size, scrub_fingerprint_t* fingerprint)
+{
+    scrub_entry_t* entry = scrub_find(scrubber, path);
+
+    if ((SCRUB_RANGE_RAW == scrubber->range) && fingerprint->read)
+    {
+        fingerprint->offset = record->image.raw_offset;
+        fingerprint->bytes = record->image.raw_bytes;
+
+        if ((fingerprint->bytes == 0) || ((uint64_t)fingerprint->offset + fingerprint->bytes > size))
+        {
+            nef_error_report(&record->errors, NEF_ERROR_RAW_RANGE, NEF_IFD_NONE, 0, fingerprint->offset, fingerprint->bytes);
+        }
+        else
+        {
+            fingerprint->taken = scrub_digest(scrubber, &data[fingerprint->offset], fingerprint->bytes, fingerprint->digest);
+        }
+    }
+
+    // Files outside the run (interactive requests) are not checked
+    if (NULL != entry)
+    {
+        if (!fingerprint->taken)
+        {
+            InterlockedIncrement(&scrubber->unreadable);
+        }
+
+        if (!record->valid && fingerprint->read)
+        {
+            InterlockedIncrement(&scrubber->malformed);
+        }
+
+        AcquireSRWLockExclusive(&scrubber->lock);
+
+        if (fingerprint->taken)
+        {
+            if (!entry->fingerprinted)
+            {
+                memcpy(entry->digest, fingerprint->digest, SCRUB_DIGEST_SIZE);
+                entry->bytes = fingerprint->bytes;
+                entry->fingerprinted = true;
+                InterlockedIncrement(&scrubber->enrolled);
+            }
+            else if ((entry->bytes == fingerprint->bytes) && (memcmp(entry->digest, fingerprint->digest, SCRUB_DIGEST_SIZE) == 0))
+            {
+                InterlockedIncrement(&scrubber->verified);
+            }
+            else
+            {
+                // The catalog keeps the original fingerprint
+                nef_error_report(&record->errors, NEF_ERROR_FINGERPRINT, NEF_IFD_NONE, 0, 0, 0);
+                InterlockedIncrement(&scrubber->mismatched);
+            }
+        }
+
+        entry->pass = scrubber->pass;
+
+        if ((GetTickCount64() - scrubber->saved >= SCRUB_CHECKPOINT_MS) && !scrub_save(scrubber))
+        {
+            fprintf(stderr, "Error: Failed to save catalog %s.\n", scrubber->catalog);
+        }
+
+        ReleaseSRWLockExclusive(&scrubber->lock);
+    }
+}
+
+/******************************************************************
+*
+* \details Save the catalog and release the scrubber.
+*
+* \param[in,out] scrubber : Scrubber.
+*
+* \return
+*   Return true if the catalog was saved.
+*
+*******************************************************************/
+bool scrub_close(scrubber_t* scrubber)
+{
+    bool success = (NULL != scrubber->algorithm) && scrub_save(scrubber);
+
+    scrub_free(scrubber);
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Release the scrubber without saving the catalog.
+*
+*******************************************************************/
+static void scrub_free(scrubber_t* scrubber)
+{
+    for (unsigned i = 0; i < scrubber->count; ++i)
+    {
+        free(scrubber->entries[i].path);
+    }
+
+    free(scrubber->entries);
+    scrubber->entries = NULL;
+    scrubber->count = 0;
+
+    if (NULL != scrubber->algorithm)
+    {
+        BCryptCloseAlgorithmProvider(scrubber->algorithm, 0);
+        scrubber->algorithm = NULL;
+    }
+}
@@ -0,0 +1,90 @@
+/**************************************************************//**
+*
+* \file scrub.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Verification of archived image files against the fingerprints
+*   of a catalog.
+*
+*******************************************************************/
+
+#ifndef SCRUB_H_
+#define SCRUB_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <bcrypt.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SCRUB_DIGEST_SIZE       32      // SHA-256
+#define SCRUB_CHECKPOINT_MS     30000   // Catalog saved at most this often during a scrub
+#define SCRUB_MAX_LINE          4096    // Longest catalog line
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef enum
+{
+    SCRUB_RANGE_FILE = 0,   // Whole file
+    SCRUB_RANGE_RAW,        // Full resolution image data only, so metadata edits are not reported
+    SCRUB_RANGE_COUNT
+} scrub_range_t;
+
+typedef struct
+{
+    char* path;
+    uint8_t digest[SCRUB_DIGEST_SIZE];
+    uint64_t bytes;     // Bytes fingerprinted
+    uint32_t pass;      // Pass that last checked the file (0 = never checked)
+    bool fingerprinted; // The file was read and enrolled
+} scrub_entry_t;
+
+// Fingerprint of a file being parsed
+typedef struct
+{
+    uint8_t digest[SCRUB_DIGEST_SIZE];
+    uint32_t offset;    // Range fingerprinted
+    uint32_t bytes;
+    bool read;          // The file was read (set by scrub_read)
+    bool taken;
+} scrub_fingerprint_t;
+
+typedef struct
+{
+    const char* catalog;            // Catalog file
+    scrub_range_t range;
+    uint32_t pass;                  // Current pass. A pass ends once every file was checked.
+    scrub_entry_t* entries;         // Sorted by path
+    unsigned count;
+    SRWLOCK lock;                   // Entries and catalog saves
+    ULONGLONG saved;                // Tick count of the last save
+    BCRYPT_ALG_HANDLE algorithm;    // SHA-256 provider shared by the workers
+    volatile LONG verified;         // Files matching their fingerprint
+    volatile LONG enrolled;         // Files fingerprinted for the first time
+    volatile LONG mismatched;       // Files not matching their fingerprint
+    volatile LONG malformed;        // Files whose structure failed to parse
+    volatile LONG unreadable;       // Files that could not be read, or whose raw image data was not located
+    unsigned skipped;               // Files checked earlier in the pass
+} scrubber_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool scrub_open(scrubber_t* scrubber, const char* catalog, scrub_range_t range);
+bool scrub_pending(scrubber_t* scrubber, char** files, unsigned count, unsigned* pending);
+void scrub_read(scrubber_t* scrubber, const uint8_t* data, uint32_t size, scrub_fingerprint_t* fingerprint);
+void scrub_verify(scrubber_t* scrubber, const char* path, nef_record_t* record, const uint8_t* data, uint32_t size, scrub_fingerprint_t* fingerprint);
+bool scrub_close(scrubber_t* scrubber);
+
+#endif /* end scrub.h */
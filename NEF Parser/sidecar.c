@@ -0,0 +1,506 @@
+/**************************************************************//**
+*
+* \file sidecar.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	XMP sidecar file generation. The sidecar template is compiled
+*   once into literal segments and field slots, so rendering a
+*   sidecar is a sequence of copies. Rendering happens on the
+*   batch worker threads and a single writer thread creates the
+*   files, draining the queue in batches.
+*
+*   See https://www.adobe.com/devnet/xmp.html for the namespaces.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sidecar.h"
+#include "alloc.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SIDECAR_MAX_SEGMENTS    32
+#define SIDECAR_FIELD_OPEN      "{{"
+#define SIDECAR_FIELD_CLOSE     "}}"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Record fields available to the template
+typedef enum
+{
+    SIDECAR_FIELD_NONE = 0,
+    SIDECAR_FIELD_MAKE,
+    SIDECAR_FIELD_MODEL,
+    SIDECAR_FIELD_SERIAL_NUMBER,
+    SIDECAR_FIELD_LENS,
+    SIDECAR_FIELD_SHUTTER_COUNT,
+    SIDECAR_FIELD_DATE_TIME_ORIGINAL,
+    SIDECAR_FIELD_EXPOSURE_TIME,
+    SIDECAR_FIELD_FNUMBER,
+    SIDECAR_FIELD_ISO,
+    SIDECAR_FIELD_FOCAL_LENGTH
+} sidecar_field_t;
+
+// Template literal followed by an optional field
+typedef struct
+{
+    const char* text;
+    uint32_t length;
+    sidecar_field_t field;
+} sidecar_segment_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Properties are elements, each on its own line, so the line of an
+// absent field is left out.
+static const char sidecar_template[] =
+    "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n"
+    "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">\n"
+    " <rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n"
+    "  <rdf:Description rdf:about=\"\"\n"
+    "    xmlns:tiff=\"http://ns.adobe.com/tiff/1.0/\"\n"
+    "    xmlns:exif=\"http://ns.adobe.com/exif/1.0/\"\n"
+    "    xmlns:aux=\"http://ns.adobe.com/exif/1.0/aux/\">\n"
+    "   <tiff:Make>{{make}}</tiff:Make>\n"
+    "   <tiff:Model>{{model}}</tiff:Model>\n"
+    "   <exif:DateTimeOriginal>{{date_time_original}}</exif:DateTimeOriginal>\n"
+    "   <exif:ExposureTime>{{exposure_time}}</exif:ExposureTime>\n"
+    "   <exif:FNumber>{{fnumber}}</exif:FNumber>\n"
+    "   <exif:FocalLength>{{focal_length}}</exif:FocalLength>\n"
+    "   <exif:ISOSpeedRatings><rdf:Seq><rdf:li>{{iso}}</rdf:li></rdf:Seq></exif:ISOSpeedRatings>\n"
+    "   <aux:SerialNumber>{{serial_number}}</aux:SerialNumber>\n"
+    "   <aux:Lens>{{lens}}</aux:Lens>\n"
+    "   <aux:ImageNumber>{{shutter_count}}</aux:ImageNumber>\n"
+    "  </rdf:Description>\n"
+    " </rdf:RDF>\n"
+    "</x:xmpmeta>\n"
+    "<?xpacket end=\"w\"?>\n";
+
+static const struct { const char* name; sidecar_field_t field; } sidecar_field_names[] = {
+    { "make",               SIDECAR_FIELD_MAKE },
+    { "model",              SIDECAR_FIELD_MODEL },
+    { "serial_number",      SIDECAR_FIELD_SERIAL_NUMBER },
+    { "lens",               SIDECAR_FIELD_LENS },
+    { "shutter_count",      SIDECAR_FIELD_SHUTTER_COUNT },
+    { "date_time_original", SIDECAR_FIELD_DATE_TIME_ORIGINAL },
+    { "exposure_time",      SIDECAR_FIELD_EXPOSURE_TIME },
+    { "fnumber",            SIDECAR_FIELD_FNUMBER },
+    { "iso",                SIDECAR_FIELD_ISO },
+    { "focal_length",       SIDECAR_FIELD_FOCAL_LENGTH },
+};
+
+// Compiled template. Written once by sidecar_writer_start before any rendering.
+static sidecar_segment_t sidecar_segments[SIDECAR_MAX_SEGMENTS];
+static unsigned sidecar_segment_count = 0;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool compile_template(void);
+static uint32_t format_field(const nef_record_t* record, sidecar_field_t field, char* value, size_t size);
+static bool append(sidecar_t* sidecar, const char* text, uint32_t length, bool escape);
+static bool render(const nef_record_t* record, sidecar_t* sidecar);
+static DWORD WINAPI sidecar_writer_thread(LPVOID parameter);
+
+/******************************************************************
+*
+* \details Split the template into literal segments and field slots.
+*
+* \return
+*   Return true if every field name in the template is known.
+*
+*******************************************************************/
+static bool compile_template(void)
+{
+    bool success = true;
+    const char* text = sidecar_template;
+
+    sidecar_segment_count = 0;
+
+    while (success && (sidecar_segment_count < SIDECAR_MAX_SEGMENTS))
+    {
+        sidecar_segment_t* segment = &sidecar_segments[sidecar_segment_count++];
+        const char* open = strstr(text, SIDECAR_FIELD_OPEN);
+
+        segment->text = text;
+        segment->field = SIDECAR_FIELD_NONE;
+
+        if (NULL == open)
+        {
+            segment->length = (uint32_t)strlen(text);
+            break;
+        }
+
+        const char* name = open + sizeof(SIDECAR_FIELD_OPEN) - 1;
+        const char* close = strstr(name, SIDECAR_FIELD_CLOSE);
+        segment->length = (uint32_t)(open - text);
+        success = false;
+
+        for (unsigned i = 0; (NULL != close) && (i < sizeof(sidecar_field_names) / sizeof(sidecar_field_names[0])); ++i)
+        {
+            if ((strlen(sidecar_field_names[i].name) == (size_t)(close - name)) &&
+                (strncmp(name, sidecar_field_names[i].name, close - name) == 0))
+            {
+                segment->field = sidecar_field_names[i].field;
+                text = close + sizeof(SIDECAR_FIELD_CLOSE) - 1;
+                success = true;
+                break;
+            }
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Format a record field as an XMP value.
+*
+* \return
+*   Return the length of the formatted value, or 0 if the record
+*   does not hold the field.
+*
+*******************************************************************/
+static uint32_t format_field(const nef_record_t* record, sidecar_field_t field, char* value, size_t size)
+{
+    int length = 0;
+
+    switch (field)
+    {
+    case SIDECAR_FIELD_MAKE:
+        length = snprintf(value, size, "%s", record->camera.make);
+        break;
+    case SIDECAR_FIELD_MODEL:
+        length = snprintf(value, size, "%s", record->camera.model);
+        break;
+    case SIDECAR_FIELD_SERIAL_NUMBER:
+        length = snprintf(value, size, "%s", record->camera.serial_number);
+        break;
+    case SIDECAR_FIELD_LENS:
+        if (strcmp(record->camera.lens, RECORD_UNKNOWN_LENS) != 0)
+        {
+            length = snprintf(value, size, "%s", record->camera.lens);
+        }
+        break;
+    case SIDECAR_FIELD_SHUTTER_COUNT:
+        if (record->image.shutter_count > 0)
+        {
+            length = snprintf(value, size, "%u", record->image.shutter_count);
+        }
+        break;
+    case SIDECAR_FIELD_DATE_TIME_ORIGINAL:
+    {
+        // "YYYY:MM:DD HH:MM:SS" to ISO 8601 "YYYY-MM-DDTHH:MM:SS"
+        length = snprintf(value, size, "%s", record->image.timestamp);
+
+        if (length == TIFF_DATE_TIME_LENGTH - 1)
+        {
+            value[4] = '-';
+            value[7] = '-';
+            value[10] = 'T';
+        }
+
+        break;
+    }
+    case SIDECAR_FIELD_EXPOSURE_TIME:
+    {
+        // XMP rationals are written as "numerator/denominator". The EXIF
+        // rational is kept as stored, so exposures of a second or longer
+        // (e.g. 13/10) and non-reciprocal exposures are written exactly.
+        if ((record->image.exposure_time[0] > 0) && (record->image.exposure_time[1] > 0))
+        {
+            length = snprintf(value, size, "%u/%u", record->image.exposure_time[0], record->image.exposure_time[1]);
+        }
+        break;
+    }
+    case SIDECAR_FIELD_FNUMBER:
+        if (record->image.aperature > 0)
+        {
+            length = snprintf(value, size, "%.0f/10", record->image.aperature * 10);
+        }
+        break;
+    case SIDECAR_FIELD_ISO:
+        if (record->image.iso > 0)
+        {
+            length = snprintf(value, size, "%u", record->image.iso);
+        }
+        break;
+    case SIDECAR_FIELD_FOCAL_LENGTH:
+        if (record->image.focal_length > 0)
+        {
+            length = snprintf(value, size, "%.0f/10", record->image.focal_length * 10);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return (length > 0) ? (uint32_t)length : 0;
+}
+
+/******************************************************************
+*
+* \details Append text to a sidecar, optionally escaping XML markup.
+*
+* \return
+*   Return false if the sidecar is full.
+*
+*******************************************************************/
+static bool append(sidecar_t* sidecar, const char* text, uint32_t length, bool escape)
+{
+    bool success = true;
+
+    if (!escape)
+    {
+        success = (sidecar->length + length <= SIDECAR_MAX_SIZE);
+
+        if (success)
+        {
+            memcpy(&sidecar->data[sidecar->length], text, length);
+            sidecar->length += length;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; (i < length) && success; ++i)
+        {
+            const char* entity = NULL;
+
+            switch (text[i])
+            {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = "&quot;"; break;
+            default: break;
+            }
+
+            success = (NULL != entity) ? append(sidecar, entity, (uint32_t)strlen(entity), false)
+                                       : append(sidecar, &text[i], 1, false);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Render the sidecar of a record from the compiled template.
+*   The template line of a field the record does not hold is left
+*   out, so absent values are not written as empty or zero values.
+*
+* \return
+*   Return true if the sidecar was rendered.
+*
+*******************************************************************/
+static bool render(const nef_record_t* record, sidecar_t* sidecar)
+{
+    bool success = true;
+    bool skip_line = false;
+    char value[TIFF_MAX_STRING_LENGTH];
+    char* extension;
+
+    // Sidecar replaces the image file extension
+    strncpy_s(sidecar->path, sizeof(sidecar->path), record->path, sizeof(sidecar->path) - 1);
+    extension = strrchr(sidecar->path, '.');
+    success = (NULL != extension) && ((size_t)(extension - sidecar->path) + sizeof(SIDECAR_EXTENSION) + 1 <= sizeof(sidecar->path));
+
+    if (success)
+    {
+        strcpy_s(extension + 1, sizeof(SIDECAR_EXTENSION), SIDECAR_EXTENSION);
+    }
+
+    sidecar->length = 0;
+
+    for (unsigned i = 0; (i < sidecar_segment_count) && success; ++i)
+    {
+        const char* text = sidecar_segments[i].text;
+        uint32_t length = sidecar_segments[i].length;
+
+        if (skip_line)
+        {
+            // Drop the rest of the line of the absent field
+            const char* end = memchr(text, '\n', length);
+
+            skip_line = (NULL == end);
+            length = (NULL != end) ? length - (uint32_t)(end + 1 - text) : 0;
+            text = (NULL != end) ? end + 1 : text;
+        }
+
+        success = append(sidecar, text, length, false);
+
+        if (success && !skip_line && (SIDECAR_FIELD_NONE != sidecar_segments[i].field))
+        {
+            length = format_field(record, sidecar_segments[i].field, value, sizeof(value));
+
+            if (length > 0)
+            {
+                success = append(sidecar, value, (length < sizeof(value)) ? length : sizeof(value) - 1, true);
+            }
+            else
+            {
+                // Drop the start of the line of the absent field
+                while ((sidecar->length > 0) && (sidecar->data[sidecar->length - 1] != '\n'))
+                {
+                    sidecar->length--;
+                }
+
+                skip_line = true;
+            }
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Writer thread creating the rendered sidecar files.
+*
+* \param[in] parameter : Sidecar writer.
+*
+* \return Thread exit code.
+*
+*******************************************************************/
+static DWORD WINAPI sidecar_writer_thread(LPVOID parameter)
+{
+    sidecar_writer_t* writer = (sidecar_writer_t*)parameter;
+    void* batch[SIDECAR_WRITE_BATCH];
+    uint32_t count;
+
+    while ((count = queue_pop_batch(&writer->queue, batch, SIDECAR_WRITE_BATCH)) > 0)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            sidecar_t* sidecar = (sidecar_t*)batch[i];
+            // Existing sidecars may hold edits from other applications
+            HANDLE file = CreateFileA(sidecar->path, GENERIC_WRITE, 0, NULL, writer->overwrite ? CREATE_ALWAYS : CREATE_NEW,
+                                      FILE_ATTRIBUTE_NORMAL, NULL);
+            DWORD written = 0;
+
+            if ((INVALID_HANDLE_VALUE == file) && (GetLastError() == ERROR_FILE_EXISTS))
+            {
+                InterlockedIncrement(&writer->existing);
+            }
+            else if ((INVALID_HANDLE_VALUE != file) && WriteFile(file, sidecar->data, sidecar->length, &written, NULL) &&
+                     (written == sidecar->length))
+            {
+                InterlockedIncrement(&writer->written);
+            }
+            else
+            {
+                fprintf(stderr, "Error: Failed to write %s.\n", sidecar->path);
+                InterlockedIncrement(&writer->failed);
+            }
+
+            if (INVALID_HANDLE_VALUE != file)
+            {
+                CloseHandle(file);
+            }
+
+            nef_free(sidecar);
+        }
+    }
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details Compile the template and start the writer thread.
+*
+* \param[out] writer : Sidecar writer to be started.
+* \param[in] overwrite : Replace existing sidecars instead of
+*                       leaving them in place.
+*
+* \return
+*   Return true if the writer was started.
+*
+*******************************************************************/
+bool sidecar_writer_start(sidecar_writer_t* writer, bool overwrite)
+{
+    bool success = false;
+
+    writer->overwrite = overwrite;
+    writer->written = 0;
+    writer->existing = 0;
+    writer->failed = 0;
+    writer->thread = NULL;
+
+    if (!compile_template())
+    {
+        fprintf(stderr, "Error: Invalid sidecar template.\n");
+    }
+    else if (queue_init(&writer->queue, SIDECAR_QUEUE_CAPACITY))
+    {
+        writer->thread = CreateThread(NULL, 0, sidecar_writer_thread, writer, 0, NULL);
+        success = (NULL != writer->thread);
+
+        if (!success)
+        {
+            queue_free(&writer->queue);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Render the sidecar of a record and queue it for writing.
+*   Called from batch worker threads.
+*
+* \param[in] writer : Sidecar writer.
+* \param[in] record : Parsed record.
+*
+* \return None
+*
+*******************************************************************/
+void sidecar_writer_submit(sidecar_writer_t* writer, const nef_record_t* record)
+{
+    if (record->valid)
+    {
+        sidecar_t* sidecar = nef_malloc(sizeof(sidecar_t), PERF_STAGE_OUTPUT);
+
+        if ((NULL == sidecar) || !render(record, sidecar) || !queue_push(&writer->queue, sidecar))
+        {
+            fprintf(stderr, "Error: Failed to render sidecar for %s.\n", record->path);
+            InterlockedIncrement(&writer->failed);
+            nef_free(sidecar);
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Write the remaining sidecars and stop the writer thread.
+*
+* \param[in] writer : Sidecar writer.
+*
+* \return None
+*
+*******************************************************************/
+void sidecar_writer_stop(sidecar_writer_t* writer)
+{
+    if (NULL != writer->thread)
+    {
+        queue_close(&writer->queue);
+        WaitForSingleObject(writer->thread, INFINITE);
+        CloseHandle(writer->thread);
+        writer->thread = NULL;
+        queue_free(&writer->queue);
+    }
+}
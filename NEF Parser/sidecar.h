@@ -0,0 +1,63 @@
+/**************************************************************//**
+*
+* \file sidecar.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	XMP sidecar file generation.
+*
+*******************************************************************/
+
+#ifndef SIDECAR_H_
+#define SIDECAR_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "record.h"
+#include "queue.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define SIDECAR_EXTENSION       "xmp"
+#define SIDECAR_MAX_SIZE        4096
+#define SIDECAR_QUEUE_CAPACITY  1024
+// Maximum number of sidecars written per writer thread wakeup
+#define SIDECAR_WRITE_BATCH     64
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// Rendered sidecar waiting to be written
+typedef struct
+{
+    char path[MAX_RECORD_PATH_LENGTH];
+    uint32_t length;
+    char data[SIDECAR_MAX_SIZE];
+} sidecar_t;
+
+typedef struct
+{
+    queue_t queue;          // Rendered sidecars
+    HANDLE thread;          // Writer thread
+    bool overwrite;         // Replace existing sidecars (which may hold edits from other applications)
+    volatile LONG written;  // Number of sidecars written
+    volatile LONG existing; // Number of sidecars left in place because the file already exists
+    volatile LONG failed;   // Number of sidecars that could not be rendered or written
+} sidecar_writer_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool sidecar_writer_start(sidecar_writer_t* writer, bool overwrite);
+void sidecar_writer_submit(sidecar_writer_t* writer, const nef_record_t* record);
+void sidecar_writer_stop(sidecar_writer_t* writer);
+
+#endif /* end sidecar.h */
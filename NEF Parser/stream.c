@@ -0,0 +1,464 @@
+/**************************************************************//**
+*
+* \file stream.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Buffered output file with optional zstd compression. Output is
+*   collected into blocks that are compressed in parallel as
+*   independent frames and written in order. A write never spans
+*   two blocks, so each frame holds whole writes: whole records of
+*   a record file, but single lines of a report, which is written
+*   line by line.
+*
+*   The frames are followed by a seek table in the zstd seekable
+*   format, so readers can decompress any frame on its own. Other
+*   zstd readers skip the table.
+*   See https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md.
+*
+*   zstd is loaded at run time (libzstd.dll), so compression is only
+*   unavailable, rather than the application, when the library is
+*   missing.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define STREAM_SKIPPABLE_MAGIC  0x184D2A5E
+#define STREAM_SEEKABLE_MAGIC   0x8F92EAB1
+// Blocks queued per compression thread
+#define STREAM_QUEUE_DEPTH      2
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+struct stream_block_t
+{
+    uint64_t sequence;  // Position of the block in the output
+    uint32_t size;      // Uncompressed size (in bytes)
+    uint8_t data[STREAM_BLOCK_SIZE];
+};
+
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+
+// zstd functions used for compression
+typedef struct
+{
+    size_t (*compressBound)(size_t size);
+    ZSTD_CCtx* (*createCCtx)(void);
+    size_t (*freeCCtx)(ZSTD_CCtx* context);
+    size_t (*compressCCtx)(ZSTD_CCtx* context, void* destination, size_t capacity, const void* source, size_t size, int level);
+    unsigned (*isError)(size_t code);
+} zstd_api_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+static zstd_api_t zstd;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static bool load_zstd(HMODULE library);
+static bool write_all(HANDLE file, const void* data, uint32_t size);
+static bool submit_block(stream_t* stream);
+static void write_frame(stream_t* stream, const stream_block_t* block, const void* data, uint32_t size);
+static bool write_seek_table(stream_t* stream);
+static DWORD WINAPI stream_thread(LPVOID parameter);
+
+/******************************************************************
+*
+* \details Resolve the zstd functions used for compression.
+*
+*******************************************************************/
+static bool load_zstd(HMODULE library)
+{
+    bool success = true;
+    const struct { const char* name; void** function; } functions[] = {
+        { "ZSTD_compressBound", (void**)&zstd.compressBound },
+        { "ZSTD_createCCtx",    (void**)&zstd.createCCtx },
+        { "ZSTD_freeCCtx",      (void**)&zstd.freeCCtx },
+        { "ZSTD_compressCCtx",  (void**)&zstd.compressCCtx },
+        { "ZSTD_isError",       (void**)&zstd.isError },
+    };
+
+    for (unsigned i = 0; success && (i < sizeof(functions) / sizeof(functions[0])); ++i)
+    {
+        *functions[i].function = (void*)GetProcAddress(library, functions[i].name);
+
+        if (NULL == *functions[i].function)
+        {
+            fprintf(stderr, "Error: %s not found in %s.\n", functions[i].name, STREAM_LIBRARY);
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Write data to a file.
+*
+*******************************************************************/
+static bool write_all(HANDLE file, const void* data, uint32_t size)
+{
+    DWORD written = 0;
+
+    return WriteFile(file, data, size, &written, NULL) && (written == size);
+}
+
+/******************************************************************
+*
+* \details
+*   Hand the current block over for writing. Uncompressed blocks
+*   are written directly and the block is reused.
+*
+*******************************************************************/
+static bool submit_block(stream_t* stream)
+{
+    bool success = true;
+    stream_block_t* block = stream->block;
+
+    if ((NULL != block) && (block->size > 0))
+    {
+        if (stream->level == 0)
+        {
+            success = write_all(stream->file, block->data, block->size);
+            block->size = 0;
+        }
+        else
+        {
+            block->sequence = stream->next_sequence++;
+            success = queue_push(&stream->queue, block);
+            stream->block = NULL;
+
+            if (!success)
+            {
+                free(block);
+            }
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Write a compressed frame once every earlier block has been
+*   written. Called from the compression threads.
+*
+* \param[in] stream : Stream.
+* \param[in] block  : Uncompressed block.
+* \param[in] data   : Compressed frame, or NULL if compression failed.
+* \param[in] size   : Size of the compressed frame (in bytes).
+*
+* \return None
+*
+*******************************************************************/
+static void write_frame(stream_t* stream, const stream_block_t* block, const void* data, uint32_t size)
+{
+    AcquireSRWLockExclusive(&stream->lock);
+
+    while (stream->write_sequence != block->sequence)
+    {
+        SleepConditionVariableSRW(&stream->written, &stream->lock, INFINITE, 0);
+    }
+
+    if ((NULL == data) || stream->error || !write_all(stream->file, data, size))
+    {
+        stream->error = true;
+    }
+    else
+    {
+        if (stream->frame_count == stream->frame_capacity)
+        {
+            uint64_t capacity = (stream->frame_capacity > 0) ? stream->frame_capacity * 2 : 256;
+            uint32_t* frame_sizes = realloc(stream->frame_sizes, (size_t)capacity * 2 * sizeof(uint32_t));
+
+            if (NULL != frame_sizes)
+            {
+                stream->frame_sizes = frame_sizes;
+                stream->frame_capacity = capacity;
+            }
+        }
+
+        if (stream->frame_count < stream->frame_capacity)
+        {
+            stream->frame_sizes[stream->frame_count * 2] = size;
+            stream->frame_sizes[stream->frame_count * 2 + 1] = block->size;
+            stream->frame_count++;
+        }
+        else
+        {
+            stream->error = true;
+        }
+    }
+
+    stream->write_sequence++;
+    ReleaseSRWLockExclusive(&stream->lock);
+    WakeAllConditionVariable(&stream->written);
+}
+
+/******************************************************************
+*
+* \details Append the seek table after the last frame.
+*
+*******************************************************************/
+static bool write_seek_table(stream_t* stream)
+{
+    bool success = true;
+    uint32_t header[2] = { STREAM_SKIPPABLE_MAGIC, (uint32_t)(stream->frame_count * 2 * sizeof(uint32_t) + 9) };
+    uint8_t footer[9];
+    uint32_t frame_count = (uint32_t)stream->frame_count;
+    uint32_t magic = STREAM_SEEKABLE_MAGIC;
+
+    // Number of frames, descriptor (no checksums) and seekable magic number
+    memcpy(&footer[0], &frame_count, sizeof(uint32_t));
+    footer[4] = 0;
+    memcpy(&footer[5], &magic, sizeof(uint32_t));
+
+    success = write_all(stream->file, header, sizeof(header)) &&
+              ((frame_count == 0) || write_all(stream->file, stream->frame_sizes, frame_count * 2 * sizeof(uint32_t))) &&
+              write_all(stream->file, footer, sizeof(footer));
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Compression thread.
+*
+*******************************************************************/
+static DWORD WINAPI stream_thread(LPVOID parameter)
+{
+    stream_t* stream = (stream_t*)parameter;
+    ZSTD_CCtx* context = zstd.createCCtx();
+    size_t capacity = zstd.compressBound(STREAM_BLOCK_SIZE);
+    uint8_t* frame = malloc(capacity);
+    void* item = NULL;
+
+    while (queue_pop_batch(&stream->queue, &item, 1) > 0)
+    {
+        stream_block_t* block = (stream_block_t*)item;
+        size_t size = 0;
+
+        if ((NULL != context) && (NULL != frame))
+        {
+            size = zstd.compressCCtx(context, frame, capacity, block->data, block->size, stream->level);
+        }
+
+        if ((NULL == context) || (NULL == frame) || zstd.isError(size))
+        {
+            fprintf(stderr, "Error: Failed to compress output block.\n");
+            write_frame(stream, block, NULL, 0);
+        }
+        else
+        {
+            write_frame(stream, block, frame, (uint32_t)size);
+        }
+
+        free(block);
+    }
+
+    if (NULL != context)
+    {
+        zstd.freeCCtx(context);
+    }
+
+    free(frame);
+
+    return 0;
+}
+
+/******************************************************************
+*
+* \details Create an output file.
+*
+* \param[out] stream : Stream.
+* \param[in] path    : Output file. Replaced if it exists.
+* \param[in] level   : zstd compression level, or 0 for no compression.
+* \param[in] threads : Compression threads.
+*
+* \return
+*   Return true if the stream was opened.
+*
+*******************************************************************/
+bool stream_open(stream_t* stream, const char* path, int level, unsigned threads)
+{
+    bool success = false;
+    HMODULE library = NULL;
+
+    memset(stream, 0, sizeof(stream_t));
+    // Not 0, so the failure path below only closes a file it created
+    stream->file = INVALID_HANDLE_VALUE;
+    stream->level = level;
+    stream->block = malloc(sizeof(stream_block_t));
+    InitializeSRWLock(&stream->lock);
+    InitializeConditionVariable(&stream->written);
+
+    if (level > 0)
+    {
+        // Remains loaded for the life of the process
+        library = LoadLibraryA(STREAM_LIBRARY);
+
+        if (NULL == library)
+        {
+            fprintf(stderr, "Error: Unable to load %s.\n", STREAM_LIBRARY);
+        }
+    }
+
+    if ((NULL != stream->block) && ((level == 0) || ((NULL != library) && load_zstd(library))))
+    {
+        stream->block->size = 0;
+        stream->file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        success = (INVALID_HANDLE_VALUE != stream->file);
+
+        if (!success)
+        {
+            fprintf(stderr, "Error: Unable to create %s.\n", path);
+        }
+    }
+
+    if (success && (level > 0))
+    {
+        unsigned thread_count = (threads == 0) ? 1 : min(threads, STREAM_MAX_THREADS);
+        success = queue_init(&stream->queue, thread_count * STREAM_QUEUE_DEPTH);
+        stream->thread_count = success ? thread_count : 0;
+
+        for (unsigned i = 0; success && (i < stream->thread_count); ++i)
+        {
+            stream->threads[i] = CreateThread(NULL, 0, stream_thread, stream, 0, NULL);
+            success = (NULL != stream->threads[i]);
+        }
+
+        if (!success)
+        {
+            stream->error = true;
+            stream_close(stream);
+        }
+    }
+    else if (!success)
+    {
+        free(stream->block);
+        stream->block = NULL;
+
+        if (INVALID_HANDLE_VALUE != stream->file)
+        {
+            CloseHandle(stream->file);
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details
+*   Append data to the stream. Data larger than a block is split
+*   across blocks. Called from a single thread.
+*
+* \param[in] stream : Stream.
+* \param[in] data   : Data.
+* \param[in] size   : Size of the data (in bytes).
+*
+* \return
+*   Return false if the data could not be written.
+*
+*******************************************************************/
+bool stream_write(stream_t* stream, const void* data, uint32_t size)
+{
+    bool success = !stream->error;
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    while (success && (size > 0))
+    {
+        if ((NULL != stream->block) && (stream->block->size + size > STREAM_BLOCK_SIZE))
+        {
+            success = submit_block(stream);
+        }
+
+        if (success && (NULL == stream->block))
+        {
+            stream->block = malloc(sizeof(stream_block_t));
+            success = (NULL != stream->block);
+
+            if (success)
+            {
+                stream->block->size = 0;
+            }
+        }
+
+        if (success)
+        {
+            uint32_t length = min(size, STREAM_BLOCK_SIZE - stream->block->size);
+            memcpy(&stream->block->data[stream->block->size], bytes, length);
+            stream->block->size += length;
+            bytes += length;
+            size -= length;
+        }
+    }
+
+    return success;
+}
+
+/******************************************************************
+*
+* \details Write the remaining data and close the file.
+*
+* \param[in] stream : Stream.
+*
+* \return
+*   Return true if all data was written.
+*
+*******************************************************************/
+bool stream_close(stream_t* stream)
+{
+    bool success = submit_block(stream);
+
+    if (stream->thread_count > 0)
+    {
+        queue_close(&stream->queue);
+
+        for (unsigned i = 0; i < stream->thread_count; ++i)
+        {
+            if (NULL != stream->threads[i])
+            {
+                WaitForSingleObject(stream->threads[i], INFINITE);
+                CloseHandle(stream->threads[i]);
+            }
+        }
+
+        queue_free(&stream->queue);
+        success = success && !stream->error && write_seek_table(stream);
+    }
+
+    success = success && !stream->error;
+
+    if (INVALID_HANDLE_VALUE != stream->file)
+    {
+        CloseHandle(stream->file);
+        stream->file = INVALID_HANDLE_VALUE;
+    }
+
+    free(stream->block);
+    free(stream->frame_sizes);
+    stream->block = NULL;
+    stream->frame_sizes = NULL;
+    stream->thread_count = 0;
+
+    return success;
+}
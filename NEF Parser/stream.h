@@ -0,0 +1,66 @@
+/**************************************************************//**
+*
+* \file stream.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Buffered output file with optional zstd compression.
+*
+*******************************************************************/
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "queue.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define STREAM_LIBRARY          "libzstd.dll"
+// Uncompressed size of each block. Each block is compressed as an independent frame.
+#define STREAM_BLOCK_SIZE       (1024 * 1024)
+#define STREAM_MAX_THREADS      16
+#define STREAM_MIN_LEVEL        1
+#define STREAM_MAX_LEVEL        19
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct stream_block_t stream_block_t;
+
+typedef struct
+{
+    HANDLE file;
+    int level;                  // Compression level (0 = uncompressed)
+    stream_block_t* block;      // Block being filled
+    uint64_t next_sequence;     // Sequence number of the next block
+    // Compression only
+    queue_t queue;              // Blocks waiting to be compressed
+    HANDLE threads[STREAM_MAX_THREADS];
+    unsigned thread_count;
+    SRWLOCK lock;
+    CONDITION_VARIABLE written; // Signalled when a block is written
+    uint64_t write_sequence;    // Sequence number of the next block to write
+    uint32_t* frame_sizes;      // Compressed and uncompressed size of each frame, for the seek table
+    uint64_t frame_count;
+    uint64_t frame_capacity;
+    bool error;
+} stream_t;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool stream_open(stream_t* stream, const char* path, int level, unsigned threads);
+bool stream_write(stream_t* stream, const void* data, uint32_t size);
+bool stream_close(stream_t* stream);
+
+#endif /* end stream.h */
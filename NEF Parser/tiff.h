@@ -27,6 +27,15 @@
 #define TIFF_MAGIC			0x2A
 #define TIFF_LITTLE_ENDIAN	0x4949 //"II"
 #define TIFF_BIG_ENDIAN		0x4D4D //"MM"
+// Olympus ORF files replace the TIFF magic number
+#define ORF_MAGIC			0x4F52 //"RO"
+#define ORF_MAGIC_ALT		0x5352 //"RS"
+// Maximum length of ASCII strings retained from an image file (including NULL)
+#define TIFF_MAX_STRING_LENGTH	96
+// Length of a TIFF date and time string "YYYY:MM:DD HH:MM:SS" (including NULL)
+#define TIFF_DATE_TIME_LENGTH	20
+// NewSubfileType of the full resolution image
+#define TIFF_SUBFILE_FULL_RESOLUTION	0
 
 /******************************************************************
 						Structures
@@ -74,30 +83,53 @@ typedef enum
 	TIFF_TYPE_SLONG		= 9,
 	TIFF_TYPE_SRATIONAL	= 10,
 	TIFF_TYPE_FLOAT		= 11,
-	TIFF_TYPE_DOUBLE	= 12
+	TIFF_TYPE_DOUBLE	= 12,
+	TIFF_TYPE_IFD		= 13
 } tiff_type_t;
 
 // Information describing the image
 typedef struct
 {
-	char* timestamp;
-	char* metering_mode;
-	char* focus_mode;
-	char* quality;
-	char* white_balance;
+	char timestamp[TIFF_DATE_TIME_LENGTH];
+	const char* metering_mode;
+	char focus_mode[TIFF_MAX_STRING_LENGTH];
+	char quality[TIFF_MAX_STRING_LENGTH];
+	char white_balance[TIFF_MAX_STRING_LENGTH];
 	float shutter_speed;
+	uint32_t exposure_time[2]; // ExposureTime as stored (numerator, denominator)
 	float aperature;
 	float focal_length;
 	uint32_t iso;
 	uint32_t shutter_count;
+	const char* compression; // Raw data compression (NULL if unknown)
+	uint32_t width;          // Full resolution image size (0 if unknown)
+	uint32_t height;
+	uint32_t raw_offset;     // Full resolution image data (0 bytes if unknown)
+	uint32_t raw_bytes;
 } image_data_t;
 
+// Information describing the lens
+typedef struct
+{
+	uint16_t data_version;        // LensData version (e.g. 204 for "0204")
+	uint8_t id_number;            // LensIDNumber
+	uint8_t mcu_version;          // Lens microcontroller firmware version
+	uint16_t z_lens_id;           // Z-mount lens ID (0 if not a Z-mount lens)
+	float f_stops;
+	float min_focal_length;       // mm
+	float max_focal_length;       // mm
+	float max_aperture_min_focal; // Maximum aperture at minimum focal length
+	float max_aperture_max_focal; // Maximum aperture at maximum focal length
+} lens_info_t;
+
 // Information describing the camera
 typedef struct
 {
-	char* model;
-	char* serial_number;
-	char* lens;
+	char make[TIFF_MAX_STRING_LENGTH];
+	char model[TIFF_MAX_STRING_LENGTH];
+	char serial_number[TIFF_MAX_STRING_LENGTH];
+	char lens[TIFF_MAX_STRING_LENGTH];
+	lens_info_t lens_info;
 } camera_data_t;
 
 /******************************************************************
@@ -0,0 +1,321 @@
+/**************************************************************//**
+*
+* \file trace.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Chrome trace event output. Spans are appended to a buffer owned
+*   by the calling thread, so recording a span never takes a lock.
+*   The buffers are written as complete ("X") events when the trace
+*   is closed, with one track per worker thread. The file is written
+*   through a stream, so it is compressed with --compress.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "trace.h"
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+typedef struct
+{
+    perf_stage_t stage;
+    uint64_t start;     // Performance counter ticks
+    uint64_t end;
+    const char* path;   // File being processed
+} trace_span_t;
+
+typedef struct trace_buffer_t
+{
+    DWORD thread_id;
+    const char* path;   // File being processed by the thread
+    trace_span_t* spans;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t dropped;   // Spans lost to allocation failures
+    struct trace_buffer_t* next;
+} trace_buffer_t;
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+bool trace_enabled = false;
+
+static stream_t trace_output;
+static DWORD trace_index = TLS_OUT_OF_INDEXES;
+static SRWLOCK trace_lock = SRWLOCK_INIT;
+static trace_buffer_t* trace_buffers = NULL; // Buffers of every thread that recorded a span
+static uint64_t trace_origin = 0;            // Ticks at trace_open
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static trace_buffer_t* trace_buffer(void);
+static void trace_print(const char* format, ...);
+static void write_json_string(const char* text);
+
+/******************************************************************
+*
+* \details Create the trace file and start recording spans.
+*
+* \param[in] path    : Trace file.
+* \param[in] level   : zstd compression level (0 = uncompressed).
+* \param[in] threads : Compression threads.
+*
+* \return
+*   Return true if the trace file was created.
+*
+*******************************************************************/
+bool trace_open(const char* path, int level, unsigned threads)
+{
+    LARGE_INTEGER ticks;
+
+    if (stream_open(&trace_output, path, level, threads))
+    {
+        trace_index = TlsAlloc();
+
+        if (TLS_OUT_OF_INDEXES == trace_index)
+        {
+            trace_output.error = true;
+            stream_close(&trace_output);
+        }
+        else
+        {
+            QueryPerformanceCounter(&ticks);
+            trace_origin = (uint64_t)ticks.QuadPart;
+            trace_enabled = true;
+        }
+    }
+
+    return trace_enabled;
+}
+
+/******************************************************************
+*
+* \details Buffer of the calling thread, created on first use.
+*
+* \return
+*   Return the buffer, or NULL if it could not be allocated.
+*
+*******************************************************************/
+static trace_buffer_t* trace_buffer(void)
+{
+    trace_buffer_t* buffer = (trace_buffer_t*)TlsGetValue(trace_index);
+
+    if (NULL == buffer)
+    {
+        buffer = calloc(1, sizeof(trace_buffer_t));
+
+        if (NULL != buffer)
+        {
+            buffer->thread_id = GetCurrentThreadId();
+            TlsSetValue(trace_index, buffer);
+            AcquireSRWLockExclusive(&trace_lock);
+            buffer->next = trace_buffers;
+            trace_buffers = buffer;
+            ReleaseSRWLockExclusive(&trace_lock);
+        }
+    }
+
+    return buffer;
+}
+
+/******************************************************************
+*
+* \details Set the file the calling thread is processing. Later
+*          spans of the thread are labelled with it.
+*
+* \param[in] path : File being processed. Must remain valid until
+*                   the trace is closed.
+*
+* \return None
+*
+*******************************************************************/
+void trace_file(const char* path)
+{
+    if (trace_enabled)
+    {
+        trace_buffer_t* buffer = trace_buffer();
+
+        if (NULL != buffer)
+        {
+            buffer->path = path;
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Record a stage of the file the calling thread is processing.
+*
+* \param[in] stage : Stage that finished.
+* \param[in] start : Performance counter ticks at the start of the stage.
+* \param[in] end   : Performance counter ticks at the end of the stage.
+*
+* \return None
+*
+*******************************************************************/
+void trace_span(perf_stage_t stage, uint64_t start, uint64_t end)
+{
+    trace_buffer_t* buffer = trace_enabled ? trace_buffer() : NULL;
+
+    if (NULL != buffer)
+    {
+        if (buffer->count == buffer->capacity)
+        {
+            uint32_t capacity = (buffer->capacity > 0) ? buffer->capacity * 2 : TRACE_INITIAL_CAPACITY;
+            trace_span_t* spans = realloc(buffer->spans, capacity * sizeof(trace_span_t));
+
+            if (NULL != spans)
+            {
+                buffer->spans = spans;
+                buffer->capacity = capacity;
+            }
+        }
+
+        if (buffer->count < buffer->capacity)
+        {
+            trace_span_t* span = &buffer->spans[buffer->count++];
+            span->stage = stage;
+            span->start = start;
+            span->end = end;
+            span->path = buffer->path;
+        }
+        else
+        {
+            buffer->dropped++;
+        }
+    }
+}
+
+/******************************************************************
+*
+* \details Write formatted text to the trace file.
+*
+* \param[in] format : printf format of the text.
+*
+* \return None
+*
+*******************************************************************/
+static void trace_print(const char* format, ...)
+{
+    char text[512];
+    va_list arguments;
+
+    va_start(arguments, format);
+    // Formatted pieces are short; paths are written by write_json_string
+    _vsnprintf_s(text, sizeof(text), _TRUNCATE, format, arguments);
+    va_end(arguments);
+
+    stream_write(&trace_output, text, (uint32_t)strlen(text));
+}
+
+/******************************************************************
+*
+* \details Write a JSON string, escaping quotes, backslashes and
+*          control characters.
+*
+* \param[in] text : String to write.
+*
+* \return None
+*
+*******************************************************************/
+static void write_json_string(const char* text)
+{
+    stream_write(&trace_output, "\"", 1);
+
+    for (const char* c = (NULL != text) ? text : ""; *c != '\0'; ++c)
+    {
+        if ((*c == '"') || (*c == '\\'))
+        {
+            stream_write(&trace_output, "\\", 1);
+            stream_write(&trace_output, c, 1);
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            trace_print("\\u%04X", (unsigned char)*c);
+        }
+        else
+        {
+            stream_write(&trace_output, c, 1);
+        }
+    }
+
+    stream_write(&trace_output, "\"", 1);
+}
+
+/******************************************************************
+*
+* \details
+*   Write the spans of every thread and close the trace file. Must
+*   be called after the threads recording spans have finished.
+*
+* \return
+*   Return true if the trace file was written.
+*
+*******************************************************************/
+bool trace_close(void)
+{
+    bool success = false;
+
+    if (trace_enabled)
+    {
+        LARGE_INTEGER frequency;
+        trace_buffer_t* buffer = trace_buffers;
+        uint32_t dropped = 0;
+        bool first = true;
+
+        trace_enabled = false;
+        QueryPerformanceFrequency(&frequency);
+        double scale = 1e6 / (double)frequency.QuadPart; // Trace timestamps are in microseconds
+        trace_print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        while (NULL != buffer)
+        {
+            trace_buffer_t* next = buffer->next;
+
+            trace_print("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"Worker %lu\"}}",
+                    first ? "" : ",\n", (unsigned long)buffer->thread_id, (unsigned long)buffer->thread_id);
+            first = false;
+
+            for (uint32_t i = 0; i < buffer->count; ++i)
+            {
+                const trace_span_t* span = &buffer->spans[i];
+
+                trace_print(",\n{\"name\":\"%s\",\"cat\":\"parse\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"file\":",
+                        perf_stage_name(span->stage), (unsigned long)buffer->thread_id,
+                        (double)(span->start - trace_origin) * scale, (double)(span->end - span->start) * scale);
+                write_json_string(span->path);
+                trace_print("}}");
+            }
+
+            dropped += buffer->dropped;
+            free(buffer->spans);
+            free(buffer);
+            buffer = next;
+        }
+
+        trace_print("\n]}\n");
+        success = stream_close(&trace_output);
+        trace_buffers = NULL;
+        TlsFree(trace_index);
+        trace_index = TLS_OUT_OF_INDEXES;
+
+        if (dropped > 0)
+        {
+            fprintf(stderr, "Error: Insufficient memory to trace %u spans.\n", dropped);
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,46 @@
+/**************************************************************//**
+*
+* \file trace.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Chrome trace event output (chrome://tracing or Perfetto) of the
+*   parse stages of each file and worker thread.
+*
+*******************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "perf.h"
+#include "stream.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define TRACE_INITIAL_CAPACITY 1024 // Spans per thread buffer
+
+/******************************************************************
+                        Global Variables
+*******************************************************************/
+// Set by trace_open before any parsing starts
+extern bool trace_enabled;
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+bool trace_open(const char* path, int level, unsigned threads);
+void trace_file(const char* path);
+void trace_span(perf_stage_t stage, uint64_t start, uint64_t end);
+bool trace_close(void);
+
+#endif /* end trace.h */
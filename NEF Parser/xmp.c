@@ -0,0 +1,249 @@
+/**************************************************************//**
+*
+* \file xmp.c
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Lightweight XMP property scanner. Properties are located by
+*   searching the packet for their qualified names rather than
+*   building an XML document, and values are returned as ranges
+*   within the packet. The scanner never reads outside the packet
+*   and does not allocate memory.
+*
+*******************************************************************/
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <string.h>
+#include <ctype.h>
+#include "xmp.h"
+#include "cpu.h"
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define XMP_LIST_ITEM   "<rdf:li"
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+static const char* skip_space(const char* begin, const char* end);
+static bool is_name_boundary(char c);
+static uint32_t scan_property(const char* begin, const char* end, unsigned property, const char* name,
+                              xmp_property_callback_t callback, void* context);
+
+/******************************************************************
+*
+* \details Skip whitespace in [begin, end).
+*
+*******************************************************************/
+static const char* skip_space(const char* begin, const char* end)
+{
+    while ((begin < end) && isspace((unsigned char)*begin))
+    {
+        begin++;
+    }
+
+    return begin;
+}
+
+/******************************************************************
+*
+* \details Check if a character terminates or precedes a qualified name.
+*
+*******************************************************************/
+static bool is_name_boundary(char c)
+{
+    return (c == '<') || (c == '>') || (c == '=') || (c == '/') || isspace((unsigned char)c);
+}
+
+/******************************************************************
+*
+* \details
+*   Scan the packet for the first occurrence of a property, in
+*   either attribute form (name="value") or element form
+*   (<name>value</name>, or <name><rdf:Bag><rdf:li>...).
+*
+* \return
+*   Return the number of values found.
+*
+*******************************************************************/
+static uint32_t scan_property(const char* begin, const char* end, unsigned property, const char* name,
+                              xmp_property_callback_t callback, void* context)
+{
+    uint32_t values = 0;
+    size_t length = strlen(name);
+    const char* cursor = begin;
+    const char* match;
+
+    while ((values == 0) && (NULL != (match = cpu_kernels.find(cursor, end, name, length))))
+    {
+        const char* next = match + length;
+        cursor = match + 1;
+
+        // Reject partial matches such as xmp:RatingPercent
+        if ((match == begin) || !is_name_boundary(match[-1]) || (next >= end) || !is_name_boundary(*next))
+        {
+            continue;
+        }
+
+        if ((match[-1] != '<') && (*next == '='))
+        {
+            // Attribute form
+            next = skip_space(next + 1, end);
+
+            if ((next < end) && ((*next == '"') || (*next == '\'')))
+            {
+                const char* close = memchr(next + 1, *next, end - next - 1);
+
+                if (NULL != close)
+                {
+                    callback(property, next + 1, (uint32_t)(close - next - 1), context);
+                    values++;
+                }
+            }
+        }
+        else if (match[-1] == '<')
+        {
+            // Element form. Skip attributes of the opening element.
+            const char* open_end = memchr(next, '>', end - next);
+
+            if ((NULL == open_end) || (open_end[-1] == '/'))
+            {
+                continue;
+            }
+
+            next = skip_space(open_end + 1, end);
+
+            if ((next < end) && (*next != '<'))
+            {
+                // Simple value
+                const char* close = memchr(next, '<', end - next);
+
+                if (NULL != close)
+                {
+                    callback(property, next, (uint32_t)(close - next), context);
+                    values++;
+                }
+            }
+            else
+            {
+                // Array value. Visit each list item until the closing element.
+                const char* close = cpu_kernels.find(next, end, name, length);
+                const char* item;
+
+                if (NULL == close)
+                {
+                    close = end;
+                }
+
+                while (NULL != (item = cpu_kernels.find(next, close, XMP_LIST_ITEM, sizeof(XMP_LIST_ITEM) - 1)))
+                {
+                    const char* item_end = memchr(item, '>', close - item);
+                    const char* value_end;
+
+                    if ((NULL == item_end) || (NULL == (value_end = memchr(item_end, '<', close - item_end))))
+                    {
+                        break;
+                    }
+
+                    callback(property, item_end + 1, (uint32_t)(value_end - item_end - 1), context);
+                    values++;
+                    next = value_end;
+                }
+            }
+        }
+    }
+
+    return values;
+}
+
+/******************************************************************
+*
+* \details Scan an XMP packet for a set of properties.
+*
+* \param[in] packet     : XMP packet to be scanned.
+* \param[in] properties : Qualified property names (e.g. "xmp:Rating").
+* \param[in] count      : Number of property names.
+* \param[in] callback   : Called for each property value found.
+* \param[in] context    : User context passed to callback.
+*
+* \return
+*   Return the number of values found.
+*
+*******************************************************************/
+uint32_t xmp_scan(const xmp_packet_t* packet, const char* const* properties, unsigned count,
+                  xmp_property_callback_t callback, void* context)
+{
+    uint32_t values = 0;
+
+    if ((NULL != packet) && (NULL != packet->data) && (NULL != properties) && (NULL != callback))
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            values += scan_property(packet->data, packet->data + packet->size, i, properties[i], callback, context);
+        }
+    }
+
+    return values;
+}
+
+/******************************************************************
+*
+* \details
+*   Append a property value to a NULL terminated string, decoding
+*   the predefined XML entities. Values are separated with
+*   XMP_LIST_SEPARATOR. The value is truncated if it does not fit.
+*
+* \param[out] destination : Destination string.
+* \param[in] size         : Size of the destination (in bytes).
+* \param[in] value        : Value returned by xmp_scan.
+* \param[in] length       : Length of the value.
+*
+* \return None
+*
+*******************************************************************/
+void xmp_append_value(char* destination, size_t size, const char* value, uint32_t length)
+{
+    static const struct { const char* entity; char c; } entities[] = {
+        { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' }
+    };
+    size_t position = strnlen(destination, size);
+
+    if ((position > 0) && (position + sizeof(XMP_LIST_SEPARATOR) < size))
+    {
+        memcpy(&destination[position], XMP_LIST_SEPARATOR, sizeof(XMP_LIST_SEPARATOR) - 1);
+        position += sizeof(XMP_LIST_SEPARATOR) - 1;
+    }
+
+    for (uint32_t i = 0; (i < length) && (position + 1 < size); ++i)
+    {
+        char c = value[i];
+
+        if (c == '&')
+        {
+            for (unsigned j = 0; j < sizeof(entities) / sizeof(entities[0]); ++j)
+            {
+                size_t entity_length = strlen(entities[j].entity);
+
+                if ((i + entity_length <= length) && (memcmp(&value[i], entities[j].entity, entity_length) == 0))
+                {
+                    c = entities[j].c;
+                    i += (uint32_t)entity_length - 1;
+                    break;
+                }
+            }
+        }
+
+        destination[position++] = c;
+    }
+
+    if (position < size)
+    {
+        destination[position] = '\0';
+    }
+}
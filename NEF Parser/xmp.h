@@ -0,0 +1,68 @@
+/**************************************************************//**
+*
+* \file xmp.h
+*
+* \author Nicholas Shanahan
+*
+* \date December 2020
+*
+* \details
+*	Extensible Metadata Platform (XMP) packet definitions.
+*   See https://www.adobe.com/devnet/xmp.html.
+*
+*******************************************************************/
+
+#ifndef XMP_H_
+#define XMP_H_
+
+/******************************************************************
+                        Includes
+*******************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************
+                        Defines
+*******************************************************************/
+#define XMP_MAX_PROPERTIES      8
+#define XMP_MAX_NAME_LENGTH     32
+#define XMP_MAX_VALUE_LENGTH    128
+#define XMP_LIST_SEPARATOR      "; "
+#define XMP_PROPERTY_RATING     "xmp:Rating"
+#define XMP_PROPERTY_LABEL      "xmp:Label"
+#define XMP_PROPERTY_KEYWORDS   "dc:subject"
+// Rating of a file without an xmp:Rating property
+#define XMP_RATING_NONE         (-2)
+
+/******************************************************************
+                        Typedefs
+*******************************************************************/
+// XMP packet located in the image file buffer. Not NULL terminated.
+typedef struct
+{
+    const char* data;
+    uint32_t size;
+} xmp_packet_t;
+
+// XMP property values extracted from an image file
+typedef struct
+{
+    bool present;  // File contains an XMP packet
+    int rating;    // xmp:Rating, or XMP_RATING_NONE
+    // Values of the configured properties. List values are joined with XMP_LIST_SEPARATOR.
+    char values[XMP_MAX_PROPERTIES][XMP_MAX_VALUE_LENGTH];
+} xmp_data_t;
+
+// Called for each value of a scanned property. List properties (rdf:Bag,
+// rdf:Seq and rdf:Alt) invoke the callback once per item. The value is
+// not NULL terminated and XML entities are not decoded.
+typedef void (*xmp_property_callback_t)(unsigned property, const char* value, uint32_t length, void* context);
+
+/******************************************************************
+                        Function Prototypes
+*******************************************************************/
+uint32_t xmp_scan(const xmp_packet_t* packet, const char* const* properties, unsigned count,
+                  xmp_property_callback_t callback, void* context);
+void xmp_append_value(char* destination, size_t size, const char* value, uint32_t length);
+
+#endif /* end xmp.h */